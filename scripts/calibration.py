@@ -0,0 +1,152 @@
+"""
+Generate the fixed-point calibration tables of the firmware.
+
+The infrared sensors distance is modelled as `a / sqrt(counts) + b`, where
+`counts` are the ambient-subtracted ADC counts, and the battery voltage as a
+linear function of the ADC counts. Models are fitted (least squares) from
+calibration CSV files or, if none is given, the nominal values are used.
+
+Infrared calibration CSV columns: `sensor,counts,millimeters`.
+Battery calibration CSV columns: `counts,millivolts`.
+
+The output (`src/calibration.c` by default) contains an interpolation table
+per infrared sensor, mapping counts to millimeters, and the battery gain and
+offset in Q16.16. These are the defaults, which the firmware replaces with
+the values in its flash storage, if any.
+"""
+import argparse
+import csv
+import math
+import os
+
+
+SOURCE = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                      '..', 'src', 'calibration.c')
+
+ADC_RESOLUTION = 4096
+LUT_SHIFT = 6
+LUT_SIZE = (ADC_RESOLUTION >> LUT_SHIFT) + 1
+IR_SENSORS = ['front_right', 'side_right', 'side_left', 'front_left']
+IR_MAX_DISTANCE_MM = 300
+
+# Nominal models: 3.3 V reference and a (47 + 10) / 10 voltage divider
+NOMINAL_IR_MODEL = (3600., -40.)
+NOMINAL_BATTERY_MODEL = (3300. * (47. + 10.) / 10. / ADC_RESOLUTION, 0.)
+
+
+def least_squares(xs, ys):
+    """
+    Fit `y = a * x + b`.
+    """
+    n = len(xs)
+    mean_x = sum(xs) / n
+    mean_y = sum(ys) / n
+    sxx = sum((x - mean_x) ** 2 for x in xs)
+    sxy = sum((x - mean_x) * (y - mean_y) for x, y in zip(xs, ys))
+    a = sxy / sxx
+    return a, mean_y - a * mean_x
+
+
+def fit_ir(path):
+    """
+    Fit the distance model of each sensor from a calibration file.
+    """
+    points = {sensor: ([], []) for sensor in range(len(IR_SENSORS))}
+    with open(path) as fd:
+        for row in csv.DictReader(fd):
+            sensor = int(row['sensor'])
+            counts = float(row['counts'])
+            if counts <= 0:
+                continue
+            points[sensor][0].append(1. / math.sqrt(counts))
+            points[sensor][1].append(float(row['millimeters']))
+    models = []
+    for sensor, (xs, ys) in sorted(points.items()):
+        if len(xs) < 2:
+            raise ValueError('Not enough points for sensor {}'.format(sensor))
+        models.append(least_squares(xs, ys))
+    return models
+
+
+def fit_battery(path):
+    with open(path) as fd:
+        rows = list(csv.DictReader(fd))
+    return least_squares([float(row['counts']) for row in rows],
+                         [float(row['millivolts']) for row in rows])
+
+
+def ir_table(model):
+    a, b = model
+    table = []
+    for i in range(LUT_SIZE):
+        counts = i << LUT_SHIFT
+        if not counts:
+            table.append(IR_MAX_DISTANCE_MM)
+            continue
+        distance = a / math.sqrt(counts) + b
+        table.append(int(round(min(max(distance, 0), IR_MAX_DISTANCE_MM))))
+    return table
+
+
+def format_table(values, indent):
+    lines = []
+    line = indent
+    for value in values:
+        item = '{},'.format(value)
+        if len(line.expandtabs()) + len(item) + 1 > 80:
+            lines.append(line.rstrip())
+            line = indent
+        line += item + ' '
+    lines.append(line.rstrip())
+    return '\n'.join(lines)
+
+
+def generate(ir_models, battery_model):
+    ir_tables = []
+    for sensor, model in zip(IR_SENSORS, ir_models):
+        ir_tables.append('    /* {} */\n    {{\n{}\n    }},'.format(
+            sensor, format_table(ir_table(model), '\t')))
+    models = '\n'.join('    {{{!r}f, {!r}f}},'.format(float(a), float(b))
+                       for a, b in ir_models)
+    gain, offset = battery_model
+    return '''/*
+ * Generated by `scripts/calibration.py`, do not edit.
+ */
+#include "calibration.h"
+
+uint16_t ir_distance_tables[IR_SENSORS_COUNT][LUT_SIZE] = {{
+{tables}
+}};
+
+const float ir_distance_models[IR_SENSORS_COUNT][2] = {{
+{models}
+}};
+
+int32_t battery_millivolts_gain = {gain};
+int32_t battery_millivolts_offset = {offset};
+'''.format(tables='\n'.join(ir_tables), models=models,
+           gain=int(round(gain * 65536)), offset=int(round(offset * 65536)))
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--ir', help='Infrared sensors calibration CSV')
+    parser.add_argument('--battery', help='Battery calibration CSV')
+    parser.add_argument('--output', default=SOURCE, help='Output C source')
+    return parser.parse_args()
+
+
+def main():
+    arguments = parse_arguments()
+    ir_models = [NOMINAL_IR_MODEL] * len(IR_SENSORS)
+    if arguments.ir:
+        ir_models = fit_ir(arguments.ir)
+    battery_model = NOMINAL_BATTERY_MODEL
+    if arguments.battery:
+        battery_model = fit_battery(arguments.battery)
+    with open(arguments.output, 'w') as fd:
+        fd.write(generate(ir_models, battery_model))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,203 @@
+"""
+Encode commands to send to the robot through the serial link.
+
+The commands layout is parsed from the firmware schema (`src/telemetry.h`),
+like the telemetry records. Each command is given by its name followed by
+its field values (fields not given are zero), for example:
+
+    python3 scripts/command.py start diagonals=1 stop brake=1 > commands.bin
+
+A maze in the usual corpus text format (`o---o` posts and walls, `|` walls,
+north at the top) can be uploaded before the commands with `--maze`.
+
+Runtime parameters (`src/parameters.h`) can be set by name before the
+commands with `--set`, for example:
+
+    python3 scripts/command.py --set LINEAR_KP=1800 --set LINEAR_KI=50000
+
+All the values are applied at once, with the last one. `--get` requests the
+current value of a parameter, or of all of them with `--get all`; the robot
+replies with `PARAMETER` records.
+
+The frames are written to the output, which can be a file (to feed the
+simulator with, see `meiga-sim -i`) or the serial device.
+"""
+import argparse
+import os
+import re
+import sys
+
+from telemetry import HEADER, encode_frame, parse_schema
+
+
+PARAMETERS = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                          '..', 'src', 'parameters.h')
+
+FIRST_COMMAND = 0x80
+MAZE_ROW = 0x82
+PARAMETER_GET = 0x83
+PARAMETER_SET = 0x84
+PARAMETERS_ALL = 0xFF
+NORTH, EAST, SOUTH, WEST = 1, 2, 4, 8
+
+
+def load_maze(path):
+    """
+    Read a maze in the corpus text format.
+
+    Returns
+    -------
+    A list of rows, from south to north, with the walls of each cell as a
+    bit per side.
+    """
+    with open(path) as fd:
+        lines = [line.rstrip('\n') for line in fd if line[:1] in 'o|']
+    if len(lines) < 3 or not len(lines) % 2:
+        raise ValueError('{}: invalid maze'.format(path))
+    size = len(lines) // 2
+    rows = []
+    for y in range(size):
+        row = 2 * (size - 1 - y)
+        cells = []
+        for x in range(size):
+            walls = 0
+            walls |= NORTH if lines[row][4 * x + 2:][:1] == '-' else 0
+            walls |= SOUTH if lines[row + 2][4 * x + 2:][:1] == '-' else 0
+            walls |= WEST if lines[row + 1][4 * x:][:1] == '|' else 0
+            walls |= EAST if lines[row + 1][4 * x + 4:][:1] == '|' else 0
+            cells.append(walls)
+        rows.append(cells)
+    return rows
+
+
+def maze_commands(rows, schema):
+    """
+    Encode a maze as a list of `MAZE_ROW` commands.
+    """
+    record = schema[MAZE_ROW]
+    length = len(record.fields) - 2
+    if len(rows) > length:
+        raise ValueError('Maze larger than {} cells'.format(length))
+    return [(MAZE_ROW, record,
+             [len(rows), y] + cells + [0] * (length - len(cells)))
+            for y, cells in enumerate(rows)]
+
+
+def parse_parameters(path=PARAMETERS):
+    """
+    Parse the runtime parameters list from the firmware header.
+
+    Returns
+    -------
+    A dictionary with the identifier of each parameter name.
+    """
+    with open(path) as fd:
+        source = fd.read()
+    names = re.findall(r'^\s*PARAMETER\((\w+),', source, re.MULTILINE)
+    return {name: identifier for identifier, name in enumerate(names)}
+
+
+def parameter_id(name, parameters):
+    if name.upper() not in parameters:
+        raise ValueError('Unknown parameter {} (known: {})'.format(
+            name, ', '.join(parameters)))
+    return parameters[name.upper()]
+
+
+def parameter_commands(gets, sets, schema, parameters):
+    """
+    Encode `PARAMETER_SET` commands, applied with the last one, followed by
+    `PARAMETER_GET` commands.
+    """
+    commands = []
+    record = schema[PARAMETER_SET]
+    for index, assignment in enumerate(sets):
+        if '=' not in assignment:
+            raise ValueError('Invalid assignment {}'.format(assignment))
+        name, value = assignment.split('=', 1)
+        commands.append((PARAMETER_SET, record, [
+            parameter_id(name, parameters), float(value),
+            int(index == len(sets) - 1)]))
+    record = schema[PARAMETER_GET]
+    for name in gets:
+        identifier = PARAMETERS_ALL if name == 'all' \
+            else parameter_id(name, parameters)
+        commands.append((PARAMETER_GET, record, [identifier]))
+    return commands
+
+
+def parse_commands(arguments, schema):
+    """
+    Parse a list of `NAME [FIELD=VALUE...]` commands.
+
+    Returns
+    -------
+    A list of `(identifier, record, values)` tuples.
+    """
+    by_name = {record.name: (identifier, record)
+               for identifier, record in schema.items()
+               if identifier >= FIRST_COMMAND}
+    commands = []
+    for argument in arguments:
+        if '=' not in argument:
+            if argument not in by_name:
+                raise ValueError('Unknown command {} (known: {})'.format(
+                    argument, ', '.join(sorted(by_name))))
+            identifier, record = by_name[argument]
+            commands.append((identifier, record, [0] * len(record.fields)))
+            continue
+        if not commands:
+            raise ValueError('Field {} before any command'.format(argument))
+        field, value = argument.split('=', 1)
+        identifier, record, values = commands[-1]
+        if field not in record.fields:
+            raise ValueError('Unknown field {} for {}'.format(
+                field, record.name))
+        index = record.fields.index(field)
+        values[index] = float(value) if record.codes[index] == 'f' \
+            else int(value, 0)
+    return commands
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(
+        description=__doc__.split('\n\n')[0],
+        formatter_class=argparse.RawDescriptionHelpFormatter,
+        epilog=__doc__.split('\n\n', 1)[1])
+    parser.add_argument('command', nargs='*',
+                        help='Command name or FIELD=VALUE')
+    parser.add_argument('--maze', '-m', help='Maze to upload first')
+    parser.add_argument('--set', '-s', action='append', default=[],
+                        metavar='NAME=VALUE', help='Set a parameter')
+    parser.add_argument('--get', '-g', action='append', default=[],
+                        metavar='NAME', help='Get a parameter, or all')
+    parser.add_argument('--output', '-o',
+                        help='Output file or serial device (default: stdout)')
+    parser.add_argument('--schema', default=HEADER,
+                        help='Firmware header with the records schema')
+    return parser.parse_args()
+
+
+def main():
+    arguments = parse_arguments()
+    schema = parse_schema(arguments.schema)
+    try:
+        commands = []
+        if arguments.maze:
+            commands += maze_commands(load_maze(arguments.maze), schema)
+        commands += parameter_commands(arguments.get, arguments.set, schema,
+                                       parse_parameters())
+        commands += parse_commands(arguments.command, schema)
+    except ValueError as error:
+        sys.exit(str(error))
+    stream = b''.join(encode_frame(identifier, record, values)
+                      for identifier, record, values in commands)
+    if arguments.output:
+        with open(arguments.output, 'wb') as fd:
+            fd.write(stream)
+    else:
+        sys.stdout.buffer.write(stream)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,102 @@
+"""
+Report the profiling zones statistics from a captured telemetry stream.
+
+The firmware sends a profile record per zone when a `profile_dump` command
+is received (see `scripts/command.py`). The last report in the capture is
+used. Zone names are parsed from the
+firmware header (`src/profile.h`).
+"""
+import argparse
+import os
+import re
+
+import telemetry
+
+
+HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                      '..', 'src', 'profile.h')
+
+SYSCLK_FREQUENCY_HZ = 168000000
+SYSTICK_FREQUENCY_HZ = 1000
+BAR_WIDTH = 40
+
+
+def parse_zones(path=HEADER):
+    """
+    Parse the profiling zone names, in enumeration order.
+    """
+    with open(path) as header:
+        source = header.read()
+    body = telemetry.macro_body(source, 'PROFILE_ZONES')
+    return [name.lower() for name in re.findall(r'ZONE\((\w+)\)', body)]
+
+
+def latest_reports(stream, schema):
+    """
+    Return the last profile record received for each zone.
+    """
+    reports = {}
+    for record, values in telemetry.iter_records(stream, schema):
+        if record.name != 'profile':
+            continue
+        report = dict(zip(record.fields, values))
+        reports[report['zone']] = report
+    return reports
+
+
+def histogram(report):
+    """
+    Return the non-empty log2 histogram bins as `(low, high, count)`.
+    """
+    bins = []
+    size = sum(1 for key in report if key.startswith('histogram_'))
+    for n in range(size):
+        count = report['histogram_{}'.format(n)]
+        if count:
+            bins.append((2 ** n if n else 0, 2 ** (n + 1) - 1, count))
+    return bins
+
+
+def print_report(reports, zones):
+    period = SYSCLK_FREQUENCY_HZ / SYSTICK_FREQUENCY_HZ
+    print('{:<24}{:>10}{:>10}{:>10}{:>10}{:>10}{:>8}'.format(
+        'zone', 'count', 'min', 'mean', 'max', 'max (us)', 'tick %'))
+    for zone, report in sorted(reports.items()):
+        name = zones[zone] if zone < len(zones) else str(zone)
+        mean = report['total'] / report['count']
+        print('{:<24}{:>10}{:>10}{:>10.0f}{:>10}{:>10.2f}{:>8.2f}'.format(
+            name, report['count'], report['min'], mean, report['max'],
+            report['max'] * 1e6 / SYSCLK_FREQUENCY_HZ,
+            mean * 100 / period))
+    for zone, report in sorted(reports.items()):
+        name = zones[zone] if zone < len(zones) else str(zone)
+        print('\n{} (cycles)'.format(name))
+        bins = histogram(report)
+        peak = max(count for _, _, count in bins)
+        for low, high, count in bins:
+            bar = '#' * max(1, round(count * BAR_WIDTH / peak))
+            print('{:>10} - {:<10}{:>10} {}'.format(low, high, count, bar))
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('capture', help='Captured binary stream')
+    parser.add_argument('--schema', default=telemetry.HEADER,
+                        help='Firmware header with the records schema')
+    parser.add_argument('--zones', default=HEADER,
+                        help='Firmware header with the profiling zones')
+    return parser.parse_args()
+
+
+def main():
+    arguments = parse_arguments()
+    schema = telemetry.parse_schema(arguments.schema)
+    with open(arguments.capture, 'rb') as fd:
+        reports = latest_reports(fd.read(), schema)
+    if not reports:
+        raise SystemExit('No profile records found')
+    print_report(reports, parse_zones(arguments.zones))
+
+
+if __name__ == '__main__':
+    main()
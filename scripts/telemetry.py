@@ -0,0 +1,249 @@
+"""
+Decode a captured binary telemetry stream.
+
+The records layout is parsed from the firmware schema (`src/telemetry.h`), so
+there is no need to keep a copy of it in sync. Each record type is written
+to a CSV file or, in columnar format, to a directory with a raw
+little-endian binary file per field plus a `schema.json` file describing the
+columns (which can be loaded with `numpy.fromfile`).
+"""
+import argparse
+import array
+import csv
+import json
+import os
+import re
+import struct
+import sys
+
+
+HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                      '..', 'src', 'telemetry.h')
+
+C_TYPES = {
+    'uint8_t': 'B',
+    'int8_t': 'b',
+    'uint16_t': 'H',
+    'int16_t': 'h',
+    'uint32_t': 'I',
+    'int32_t': 'i',
+    'uint64_t': 'Q',
+    'int64_t': 'q',
+    'float': 'f',
+}
+
+NUMPY_TYPES = {
+    'B': '|u1', 'b': '|i1', 'H': '<u2', 'h': '<i2', 'I': '<u4',
+    'i': '<i4', 'Q': '<u8', 'q': '<i8', 'f': '<f4',
+}
+
+
+class Record:
+    """
+    Binary record layout.
+    """
+    def __init__(self, name, fields):
+        self.name = name.lower()
+        self.fields = [field for field, _ in fields]
+        self.codes = [code for _, code in fields]
+        self.struct = struct.Struct('<' + ''.join(self.codes))
+
+    def unpack(self, payload):
+        return self.struct.unpack(payload)
+
+
+def macro_body(source, name):
+    """
+    Return the body of a multi-line `#define` macro.
+    """
+    match = re.search(r'#define {}\([\w, ]+\)((?:.*\\\n)*.*)'.format(name),
+                      source)
+    if not match:
+        raise ValueError('Macro {} not found in schema'.format(name))
+    return match.group(1)
+
+
+def parse_schema(path=HEADER):
+    """
+    Parse the records schema from the firmware header.
+
+    Returns
+    -------
+    A dictionary mapping record identifiers to `Record` instances.
+    """
+    with open(path) as header:
+        source = header.read()
+    schema = {}
+    records = re.findall(r'RECORD\((\w+), (\w+)\)',
+                         macro_body(source, 'TELEMETRY_RECORDS'))
+    for name, identifier in records:
+        body = macro_body(source, 'TELEMETRY_{}_FIELDS'.format(name))
+        fields = []
+        for kind, ctype, field, length in re.findall(
+                r'(FIELD|ARRAY)\((\w+), (\w+)(?:, (\d+))?\)', body):
+            if kind == 'FIELD':
+                fields.append((field, C_TYPES[ctype]))
+                continue
+            fields.extend(('{}_{}'.format(field, i), C_TYPES[ctype])
+                          for i in range(int(length)))
+        schema[int(identifier, 0)] = Record(name, fields)
+    return schema
+
+
+def cobs_decode(frame):
+    """
+    Decode a Consistent Overhead Byte Stuffing (COBS) frame.
+    """
+    output = bytearray()
+    index = 0
+    while index < len(frame):
+        code = frame[index]
+        if code == 0 or index + code > len(frame):
+            raise ValueError('Invalid COBS frame')
+        output += frame[index + 1:index + code]
+        index += code
+        if code < 0xFF and index < len(frame):
+            output.append(0)
+    return bytes(output)
+
+
+def cobs_encode(data):
+    """
+    Encode data with Consistent Overhead Byte Stuffing (COBS).
+
+    Data must be shorter than 254 bytes (a single COBS block).
+    """
+    output = bytearray()
+    for block in bytes(data).split(b'\x00'):
+        output.append(len(block) + 1)
+        output += block
+    return bytes(output)
+
+
+def crc16(data, crc=0xFFFF):
+    """
+    CRC-16/CCITT-FALSE.
+    """
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def decode_frame(frame, schema):
+    """
+    Decode a single frame, returning the record and its values.
+
+    Raises `ValueError` on corrupted frames or unknown records.
+    """
+    data = cobs_decode(frame)
+    if len(data) < 3:
+        raise ValueError('Frame too short')
+    payload, checksum = data[:-2], struct.unpack('<H', data[-2:])[0]
+    if crc16(payload) != checksum:
+        raise ValueError('CRC mismatch')
+    record = schema.get(payload[0])
+    if record is None or len(payload) - 1 != record.struct.size:
+        raise ValueError('Unknown record {}'.format(payload[0]))
+    return record, record.unpack(payload[1:])
+
+
+def encode_frame(identifier, record, values):
+    """
+    Encode a record as a frame, including the delimiter.
+    """
+    payload = bytes([identifier]) + record.struct.pack(*values)
+    payload += struct.pack('<H', crc16(payload))
+    return cobs_encode(payload) + b'\x00'
+
+
+def iter_records(stream, schema, errors=None):
+    """
+    Iterate over the valid records in a captured stream.
+
+    The trailing data after the last delimiter is an incomplete frame and is
+    ignored. Invalid frames (i.e.: a truncated first frame) are counted in
+    the `errors` list.
+    """
+    for frame in stream.split(b'\x00')[:-1]:
+        if not frame:
+            continue
+        try:
+            yield decode_frame(frame, schema)
+        except ValueError as error:
+            if errors is not None:
+                errors.append(str(error))
+
+
+def group_records(stream, schema, errors=None):
+    """
+    Group decoded values by record name.
+    """
+    groups = {}
+    for record, values in iter_records(stream, schema, errors):
+        groups.setdefault(record.name, (record, []))[1].append(values)
+    return groups
+
+
+def write_csv(groups, prefix):
+    for name, (record, rows) in groups.items():
+        with open('{}_{}.csv'.format(prefix, name), 'w', newline='') as fd:
+            writer = csv.writer(fd)
+            writer.writerow(record.fields)
+            writer.writerows(rows)
+
+
+def write_columns(groups, directory):
+    """
+    Write a directory per record with a binary file per field.
+    """
+    for name, (record, rows) in groups.items():
+        path = os.path.join(directory, name)
+        os.makedirs(path, exist_ok=True)
+        columns = list(zip(*rows))
+        for field, code, column in zip(record.fields, record.codes, columns):
+            values = array.array(code, column)
+            if sys.byteorder != 'little':
+                values.byteswap()
+            with open(os.path.join(path, field + '.bin'), 'wb') as fd:
+                values.tofile(fd)
+        schema = {
+            'rows': len(rows),
+            'columns': [{'name': field, 'dtype': NUMPY_TYPES[code]}
+                        for field, code in zip(record.fields, record.codes)],
+        }
+        with open(os.path.join(path, 'schema.json'), 'w') as fd:
+            json.dump(schema, fd, indent=2)
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('capture', help='Captured binary stream')
+    parser.add_argument('output', help='Output prefix (CSV) or directory')
+    parser.add_argument('--format', choices=['csv', 'columns'],
+                        default='csv', help='Output format')
+    parser.add_argument('--schema', default=HEADER,
+                        help='Firmware header with the records schema')
+    return parser.parse_args()
+
+
+def main():
+    arguments = parse_arguments()
+    schema = parse_schema(arguments.schema)
+    with open(arguments.capture, 'rb') as fd:
+        stream = fd.read()
+    errors = []
+    groups = group_records(stream, schema, errors)
+    if arguments.format == 'csv':
+        write_csv(groups, arguments.output)
+    else:
+        write_columns(groups, arguments.output)
+    for name, (_, rows) in groups.items():
+        sys.stderr.write('{}: {} records\n'.format(name, len(rows)))
+    sys.stderr.write('{} invalid frames\n'.format(len(errors)))
+
+
+if __name__ == '__main__':
+    main()
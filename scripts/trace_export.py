@@ -0,0 +1,175 @@
+"""
+Convert a trace dump from a captured telemetry stream to a Chrome trace.
+
+The firmware sends a `trace_info` record followed by the traced events in
+`trace_events` records when a `trace_dump` command is received (see
+`scripts/command.py`). The last dump in the capture is converted to the
+Chrome trace event JSON format, which can be opened with Perfetto
+(https://ui.perfetto.dev) or `chrome://tracing`.
+
+Interruption handlers and the SysTick tasks they run are shown in one track,
+background tasks in another one, so preemption shows as nesting. Handler,
+event and reason names are parsed from the firmware header (`src/trace.h`)
+and task names from the task table (`src/main.c`).
+"""
+import argparse
+import json
+import os
+import re
+import sys
+
+import telemetry
+
+
+SOURCES = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                       '..', 'src')
+HEADER = os.path.join(SOURCES, 'trace.h')
+TASKS = os.path.join(SOURCES, 'main.c')
+
+CYCLE_COUNTER_RANGE = 1 << 32
+PROCESS = 1
+TRACKS = {0: 'interrupts', 1: 'background'}
+
+
+def parse_enum(source, name, prefix):
+    """
+    Parse the member names of an enumeration, in order, without the prefix.
+    """
+    match = re.search(r'enum {} {{([^}}]*)}}'.format(name), source)
+    if not match:
+        raise ValueError('Enumeration {} not found'.format(name))
+    members = re.findall(r'(\w+),', match.group(1))
+    return [member[len(prefix):].lower() for member in members]
+
+
+def parse_names(header=HEADER, tasks=TASKS):
+    """
+    Parse the handler, event type, overflow, reason and task names.
+    """
+    with open(header) as fd:
+        source = fd.read()
+    body = telemetry.macro_body(source, 'TRACE_ISRS')
+    names = {
+        'isrs': [name.lower() for name in re.findall(r'ISR\((\w+)\)', body)],
+        'types': parse_enum(source, 'trace_type', 'TRACE_'),
+        'overflows': parse_enum(source, 'trace_serial_overflow',
+                                'TRACE_SERIAL_'),
+        'reasons': parse_enum(source, 'trace_freeze_reason',
+                              'TRACE_FREEZE_'),
+    }
+    with open(tasks) as fd:
+        names['tasks'] = re.findall(r'\.name = "(\w+)"', fd.read())
+    return names
+
+
+def latest_dump(stream, schema):
+    """
+    Return the cycle counter frequency and the events of the last dump.
+
+    Events are `(cycles, type, id, value)` tuples, oldest first. Events
+    missing from the capture are reported and skipped.
+    """
+    info = None
+    events = {}
+    for record, values in telemetry.iter_records(stream, schema):
+        fields = dict(zip(record.fields, values))
+        if record.name == 'trace_info':
+            info = fields
+            events = {}
+        elif record.name == 'trace_events' and info:
+            for i in range(fields['count']):
+                events[fields['offset'] + i] = tuple(
+                    fields['{}_{}'.format(field, i)]
+                    for field in ('cycles', 'type', 'id', 'value'))
+    if not info:
+        raise ValueError('No trace dump found')
+    missing = info['count'] - len(events)
+    if missing:
+        sys.stderr.write('{} events missing from the dump\n'.format(missing))
+    return info['frequency'], [events[i] for i in sorted(events)]
+
+
+def name(names, kind, index):
+    return names[kind][index] if index < len(names[kind]) \
+        else '{}{}'.format(kind[:-1], index)
+
+
+def convert(events, frequency, names):
+    """
+    Convert the events to Chrome trace events.
+
+    The cycle counter is unwrapped, assuming less than a full counter range
+    between consecutive events. Exits without a matching entry (the trace
+    starts in the middle of a handler or task) are dropped.
+    """
+    output = [{'ph': 'M', 'pid': PROCESS, 'tid': tid, 'name': 'thread_name',
+               'args': {'name': track}} for tid, track in TRACKS.items()]
+    output.append({'ph': 'M', 'pid': PROCESS, 'name': 'process_name',
+                   'args': {'name': 'meiga'}})
+    depth = {tid: 0 for tid in TRACKS}
+    elapsed = 0
+    previous = events[0][0] if events else 0
+    for cycles, kind, identifier, value in events:
+        elapsed += (cycles - previous) % CYCLE_COUNTER_RANGE
+        previous = cycles
+        event = {'pid': PROCESS, 'tid': 0, 'ts': elapsed * 1e6 / frequency}
+        kind = name(names, 'types', kind)
+        if kind in ('isr_enter', 'isr_exit'):
+            event['name'] = name(names, 'isrs', identifier)
+            event['cat'] = 'isr'
+        elif kind in ('task_start', 'task_stop'):
+            event['name'] = name(names, 'tasks', identifier)
+            event['cat'] = 'task'
+            event['tid'] = 1 if value else 0
+        if kind in ('isr_enter', 'task_start'):
+            event['ph'] = 'B'
+            depth[event['tid']] += 1
+        elif kind in ('isr_exit', 'task_stop'):
+            if not depth[event['tid']]:
+                continue
+            event['ph'] = 'E'
+            depth[event['tid']] -= 1
+        elif kind == 'saturation':
+            event.update(ph='C', name='pwm saturation',
+                         args={'saturated': identifier})
+        elif kind == 'serial_overflow':
+            event.update(ph='i', s='p',
+                         name='serial ' + name(names, 'overflows', identifier),
+                         args={'bytes': value})
+        elif kind == 'freeze':
+            event.update(ph='i', s='g',
+                         name='freeze: ' + name(names, 'reasons', identifier))
+        else:
+            event.update(ph='i', s='t', name='marker {}'.format(identifier),
+                         args={'value': value})
+        output.append(event)
+    return output
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('capture', help='Captured binary stream')
+    parser.add_argument('output', help='Output JSON file')
+    parser.add_argument('--schema', default=telemetry.HEADER,
+                        help='Firmware header with the records schema')
+    return parser.parse_args()
+
+
+def main():
+    arguments = parse_arguments()
+    schema = telemetry.parse_schema(arguments.schema)
+    with open(arguments.capture, 'rb') as fd:
+        stream = fd.read()
+    try:
+        frequency, events = latest_dump(stream, schema)
+    except ValueError as error:
+        sys.exit(str(error))
+    trace = convert(events, frequency, parse_names())
+    with open(arguments.output, 'w') as fd:
+        json.dump({'traceEvents': trace, 'displayTimeUnit': 'ns'}, fd)
+    sys.stderr.write('{} events, {:.3f} ms\n'.format(
+        len(events), trace[-1]['ts'] / 1e3 if events else 0.))
+
+
+if __name__ == '__main__':
+    main()
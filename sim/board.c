@@ -0,0 +1,111 @@
+#include <stdio.h>
+
+#include <libopencm3/stm32/adc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/spi.h>
+#include <libopencm3/stm32/timer.h>
+
+#include "mpu6500.h"
+#include "opencm3/peripherals.h"
+#include "robot.h"
+#include "simulation.h"
+
+/* Battery voltage divider and ADC reference, as in the board schematic */
+#define BATTERY_DIVIDER ((47. + 10.) / 10.)
+#define ADC_REFERENCE 3.3
+#define ADC_RESOLUTION 4096
+
+/*
+ * Infrared receivers (ADC channels 10 to 13), lit by the emitters on GPIOA
+ * pins 4 to 7. No walls are modelled: each receiver reads the ambient light
+ * plus a fixed reflection while its emitter is on.
+ */
+#define IR_FIRST_CHANNEL ADC_CHANNEL10
+#define IR_SENSORS 4
+#define IR_AMBIENT_COUNTS 180
+#define IR_REFLECTION_COUNTS 1400
+
+/**
+ * @brief Infrared receiver reading, depending on its emitter state.
+ */
+static uint16_t infrared_convert(uint8_t sensor)
+{
+	if (GPIO_ODR(GPIOA) & (GPIO4 << sensor))
+		return IR_AMBIENT_COUNTS + IR_REFLECTION_COUNTS;
+	return IR_AMBIENT_COUNTS;
+}
+
+/**
+ * @brief ADC inputs: infrared receivers (channels 10 to 13), battery
+ * (channel 14) and motors (channel 15) voltages.
+ */
+uint16_t sim_board_adc_convert(uint32_t adc, uint8_t channel)
+{
+	double voltage;
+
+	(void)adc;
+	if (channel >= IR_FIRST_CHANNEL &&
+	    channel < IR_FIRST_CHANNEL + IR_SENSORS)
+		return infrared_convert(channel - IR_FIRST_CHANNEL);
+	switch (channel) {
+	case ADC_CHANNEL14:
+	case ADC_CHANNEL15:
+		voltage = robot_get_state()->battery_voltage / BATTERY_DIVIDER;
+		break;
+	default:
+		return 0;
+	}
+	if (voltage >= ADC_REFERENCE)
+		return ADC_RESOLUTION - 1;
+	return (uint16_t)(voltage / ADC_REFERENCE * ADC_RESOLUTION);
+}
+
+/**
+ * @brief The MPU is the only device on SPI3.
+ */
+uint8_t sim_board_spi_exchange(uint32_t spi, uint8_t data)
+{
+	if (spi != SPI3)
+		return 0xFF;
+	return mpu6500_exchange(data);
+}
+
+/**
+ * @brief GPIOA15 is the MPU chip select (active low).
+ */
+void sim_board_gpio_write(uint32_t port, uint16_t odr)
+{
+	if (port == GPIOA)
+		mpu6500_select(!(odr & GPIO15));
+}
+
+/**
+ * @brief TIM1 update requests (DMA 2 stream 5) switch the infrared emitters.
+ */
+void sim_board_timer_update_dma(uint32_t timer)
+{
+	if (timer == TIM1)
+		sim_gpio_dma_bsrr(GPIOA);
+}
+
+void sim_board_usart_transmit(uint32_t usart, uint8_t data)
+{
+	(void)usart;
+	simulation_serial_output(data);
+}
+
+bool sim_board_usart_receive(uint32_t usart, uint8_t *data)
+{
+	(void)usart;
+	return simulation_serial_input(data);
+}
+
+void sim_board_wait_for_interrupt(void)
+{
+	simulation_step();
+}
+
+void sim_board_systick(void)
+{
+	simulation_systick();
+}
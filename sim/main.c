@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <libopencm3/cm3/cortex.h>
+
+#include "simulation.h"
+
+/* Firmware entry point (`main()` in `src/main.c`, renamed at build time) */
+int firmware_main(void);
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [-t SECONDS] [-o SERIAL_OUTPUT] [-i SERIAL_INPUT]\n"
+		"       [-d SECONDS] [-f FLASH_IMAGE]\n"
+		"\n"
+		"  -t  Simulated time to run (default: 1 s)\n"
+		"  -o  File to write USART1 output to ('-' for stdout)\n"
+		"  -i  File to feed USART1 input from ('-' for stdin)\n"
+		"  -d  Simulated time to start feeding the input at (default:\n"
+		"      1 s, after the gyroscope calibration)\n"
+		"  -f  File backing the flash storage sectors (persistent\n"
+		"      across runs)\n",
+		name);
+	exit(EXIT_FAILURE);
+}
+
+static FILE *open_input(const char *path)
+{
+	FILE *input;
+
+	if (path[0] == '-' && path[1] == '\0')
+		return stdin;
+	input = fopen(path, "rb");
+	if (!input) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+	return input;
+}
+
+static FILE *open_output(const char *path)
+{
+	FILE *output;
+
+	if (path[0] == '-' && path[1] == '\0')
+		return stdout;
+	output = fopen(path, "wb");
+	if (!output) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+	return output;
+}
+
+/**
+ * @brief Run the unmodified firmware against the simulated platform.
+ *
+ * The firmware `main()` performs the setup and may return or loop forever
+ * waiting for interruptions. Either way, waiting for interruptions is what
+ * advances the simulated world, until the requested time is reached.
+ */
+int main(int argc, char *argv[])
+{
+	struct simulation_options options = {.duration = 1.,
+					     .serial_input_delay = 1.};
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:o:i:d:f:h")) != -1) {
+		switch (opt) {
+		case 't':
+			options.duration = atof(optarg);
+			break;
+		case 'o':
+			options.serial_output = open_output(optarg);
+			break;
+		case 'i':
+			options.serial_input = open_input(optarg);
+			break;
+		case 'd':
+			options.serial_input_delay = atof(optarg);
+			break;
+		case 'f':
+			options.flash_image = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	simulation_start(&options);
+	firmware_main();
+	while (1)
+		__WFI();
+}
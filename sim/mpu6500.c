@@ -0,0 +1,248 @@
+#include <math.h>
+#include <string.h>
+
+#include "mpu6500.h"
+
+#define MPU_READ 0x80
+#define MPU_SMPLRT_DIV 0x19
+#define MPU_CONFIG 0x1A
+#define MPU_GYRO_CONFIG 0x1B
+#define MPU_ACCEL_CONFIG 0x1C
+#define MPU_FIFO_EN 0x23
+#define MPU_INT_STATUS 0x3A
+#define MPU_ACCEL_XOUT_H 0x3B
+#define MPU_TEMP_OUT_H 0x41
+#define MPU_GYRO_XOUT_H 0x43
+#define MPU_USER_CTRL 0x6A
+#define MPU_PWR_MGMT_1 0x6B
+#define MPU_FIFO_COUNT_H 0x72
+#define MPU_FIFO_COUNT_L 0x73
+#define MPU_FIFO_R_W 0x74
+#define MPU_WHOAMI 0x75
+#define MPU_WHOAMI_VALUE 0x70
+#define MPU_RESET 0x80
+
+#define CONFIG_FIFO_MODE 0x40
+#define CONFIG_DLPF_CFG 0x07
+#define GYRO_CONFIG_FCHOICE_B 0x03
+#define FIFO_EN_TEMP 0x80
+#define FIFO_EN_GYRO_X 0x40
+#define FIFO_EN_GYRO_Y 0x20
+#define FIFO_EN_GYRO_Z 0x10
+#define FIFO_EN_ACCEL 0x08
+#define INT_STATUS_FIFO_OFLOW 0x10
+#define USER_CTRL_FIFO_EN 0x40
+#define USER_CTRL_FIFO_RST 0x04
+
+#define FIFO_SIZE 512
+
+static uint8_t registers[128];
+static bool selected;
+static bool addressed;
+static bool reading;
+static uint8_t address;
+static uint8_t fifo[FIFO_SIZE];
+static uint16_t fifo_head;
+static uint16_t fifo_count;
+static uint32_t sample_elapsed_us;
+
+/**
+ * @brief Reset the register file to its power-on values.
+ */
+void mpu6500_reset(void)
+{
+	memset(registers, 0, sizeof(registers));
+	fifo_head = 0;
+	fifo_count = 0;
+	sample_elapsed_us = 0;
+	registers[MPU_PWR_MGMT_1] = 0x01;
+	registers[MPU_WHOAMI] = MPU_WHOAMI_VALUE;
+}
+
+/**
+ * @brief Chip select (active low NCS line) transitions.
+ */
+void mpu6500_select(bool select)
+{
+	if (select && !selected)
+		addressed = false;
+	selected = select;
+}
+
+static void write_register(uint8_t reg, uint8_t value)
+{
+	if (reg == MPU_PWR_MGMT_1 && (value & MPU_RESET)) {
+		mpu6500_reset();
+		return;
+	}
+	if (reg == MPU_USER_CTRL && (value & USER_CTRL_FIFO_RST)) {
+		fifo_count = 0;
+		value &= ~USER_CTRL_FIFO_RST;
+	}
+	if (reg == MPU_WHOAMI)
+		return;
+	registers[reg] = value;
+}
+
+/**
+ * @brief Read a register, with the FIFO side effects.
+ *
+ * Reading FIFO_R_W pops a byte from the FIFO (an empty FIFO reads as 0xFF)
+ * and the interrupt status is cleared on read.
+ */
+static uint8_t read_register(uint8_t reg)
+{
+	uint8_t value = registers[reg];
+
+	switch (reg) {
+	case MPU_FIFO_COUNT_H:
+		return fifo_count >> 8;
+	case MPU_FIFO_COUNT_L:
+		return fifo_count & 0xFF;
+	case MPU_FIFO_R_W:
+		if (!fifo_count)
+			return 0xFF;
+		value = fifo[fifo_head];
+		fifo_head = (fifo_head + 1) % FIFO_SIZE;
+		fifo_count--;
+		return value;
+	case MPU_INT_STATUS:
+		registers[reg] = 0;
+		return value;
+	default:
+		return value;
+	}
+}
+
+/**
+ * @brief Exchange one byte over SPI.
+ *
+ * The first byte of each transaction holds the register address and the
+ * read flag. Consecutive bytes auto-increment the register address, except
+ * for FIFO_R_W, so that the FIFO can be drained in a single burst.
+ */
+uint8_t mpu6500_exchange(uint8_t data)
+{
+	uint8_t reply = 0x00;
+
+	if (!selected)
+		return 0xFF;
+	if (!addressed) {
+		addressed = true;
+		reading = data & MPU_READ;
+		address = data & ~MPU_READ;
+		return 0x00;
+	}
+	if (reading)
+		reply = read_register(address);
+	else
+		write_register(address, data);
+	if (address != MPU_FIFO_R_W)
+		address = (address + 1) & 0x7F;
+	return reply;
+}
+
+static void store_word(uint8_t reg, double value)
+{
+	int16_t word;
+
+	if (value > INT16_MAX)
+		value = INT16_MAX;
+	if (value < INT16_MIN)
+		value = INT16_MIN;
+	word = (int16_t)lround(value);
+	registers[reg] = (uint16_t)word >> 8;
+	registers[reg + 1] = (uint16_t)word & 0xFF;
+}
+
+/**
+ * @brief Return the configured sample rate period, in microseconds.
+ *
+ * The internal sample rate is 8 kHz when the low pass filter is bypassed
+ * (DLPF_CFG 0 or 7, or FCHOICE_B set) and 1 kHz otherwise, in which case it
+ * is further divided by SMPLRT_DIV + 1.
+ */
+static uint32_t sample_period_us(void)
+{
+	uint8_t dlpf = registers[MPU_CONFIG] & CONFIG_DLPF_CFG;
+
+	if ((registers[MPU_GYRO_CONFIG] & GYRO_CONFIG_FCHOICE_B) || !dlpf ||
+	    dlpf == 7)
+		return 125;
+	return 1000 * (1 + registers[MPU_SMPLRT_DIV]);
+}
+
+static void fifo_push(uint8_t data)
+{
+	if (fifo_count == FIFO_SIZE) {
+		registers[MPU_INT_STATUS] |= INT_STATUS_FIFO_OFLOW;
+		if (registers[MPU_CONFIG] & CONFIG_FIFO_MODE)
+			return;
+		fifo_head = (fifo_head + 1) % FIFO_SIZE;
+		fifo_count--;
+	}
+	fifo[(fifo_head + fifo_count) % FIFO_SIZE] = data;
+	fifo_count++;
+}
+
+static void fifo_push_registers(uint8_t reg, uint8_t size)
+{
+	uint8_t i;
+
+	for (i = 0; i < size; i++)
+		fifo_push(registers[reg + i]);
+}
+
+/**
+ * @brief Write the enabled sensor registers to the FIFO, in register order.
+ */
+static void fifo_store_sample(void)
+{
+	uint8_t enabled = registers[MPU_FIFO_EN];
+
+	if (!(registers[MPU_USER_CTRL] & USER_CTRL_FIFO_EN))
+		return;
+	if (enabled & FIFO_EN_ACCEL)
+		fifo_push_registers(MPU_ACCEL_XOUT_H, 6);
+	if (enabled & FIFO_EN_TEMP)
+		fifo_push_registers(MPU_TEMP_OUT_H, 2);
+	if (enabled & FIFO_EN_GYRO_X)
+		fifo_push_registers(MPU_GYRO_XOUT_H, 2);
+	if (enabled & FIFO_EN_GYRO_Y)
+		fifo_push_registers(MPU_GYRO_XOUT_H + 2, 2);
+	if (enabled & FIFO_EN_GYRO_Z)
+		fifo_push_registers(MPU_GYRO_XOUT_H + 4, 2);
+}
+
+/**
+ * @brief Advance the sensor time, sampling at the configured rate.
+ */
+void mpu6500_step(uint32_t microseconds, const double gyro_dps[3],
+		  const double accel_g[3])
+{
+	sample_elapsed_us += microseconds;
+	while (sample_elapsed_us >= sample_period_us()) {
+		sample_elapsed_us -= sample_period_us();
+		mpu6500_sample(gyro_dps, accel_g);
+		fifo_store_sample();
+	}
+}
+
+/**
+ * @brief Latch a new sample in the output registers.
+ *
+ * Sensitivity depends on the full scale range configured by the firmware.
+ */
+void mpu6500_sample(const double gyro_dps[3], const double accel_g[3])
+{
+	double gyro_lsb = 131. / (1 << ((registers[MPU_GYRO_CONFIG] >> 3) & 3));
+	double accel_lsb =
+	    16384. / (1 << ((registers[MPU_ACCEL_CONFIG] >> 3) & 3));
+	uint8_t i;
+
+	for (i = 0; i < 3; i++) {
+		store_word(MPU_ACCEL_XOUT_H + 2 * i, accel_g[i] * accel_lsb);
+		store_word(MPU_GYRO_XOUT_H + 2 * i, gyro_dps[i] * gyro_lsb);
+	}
+	store_word(MPU_TEMP_OUT_H, 25. * 333.87);
+}
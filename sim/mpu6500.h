@@ -0,0 +1,14 @@
+#ifndef __SIM_MPU6500_H
+#define __SIM_MPU6500_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void mpu6500_reset(void);
+void mpu6500_select(bool selected);
+uint8_t mpu6500_exchange(uint8_t data);
+void mpu6500_step(uint32_t microseconds, const double gyro_dps[3],
+		  const double accel_g[3]);
+void mpu6500_sample(const double gyro_dps[3], const double accel_g[3]);
+
+#endif /* __SIM_MPU6500_H */
@@ -0,0 +1,210 @@
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/adc.h>
+
+#include "peripherals.h"
+
+#define ADC_COUNT 3
+#define ADC_CLOCK_MHZ 42
+
+static const uint16_t sample_cycles[8] = {3, 15, 28, 56, 84, 112, 144, 480};
+
+/* Position in the regular sequence and accumulated conversion time */
+static uint8_t sequence_index[ADC_COUNT];
+static uint32_t elapsed_ns[ADC_COUNT];
+
+static uint8_t adc_index(uint32_t adc)
+{
+	return (adc - ADC1) / 0x100;
+}
+
+void adc_power_on(uint32_t adc)
+{
+	ADC_CR2(adc) |= ADC_CR2_ADON;
+}
+
+void adc_power_off(uint32_t adc)
+{
+	ADC_CR2(adc) &= ~ADC_CR2_ADON;
+}
+
+void adc_enable_scan_mode(uint32_t adc)
+{
+	ADC_CR1(adc) |= ADC_CR1_SCAN;
+}
+
+void adc_disable_scan_mode(uint32_t adc)
+{
+	ADC_CR1(adc) &= ~ADC_CR1_SCAN;
+}
+
+void adc_set_single_conversion_mode(uint32_t adc)
+{
+	ADC_CR2(adc) &= ~ADC_CR2_CONT;
+}
+
+void adc_set_continuous_conversion_mode(uint32_t adc)
+{
+	ADC_CR2(adc) |= ADC_CR2_CONT;
+}
+
+void adc_set_right_aligned(uint32_t adc)
+{
+	ADC_CR2(adc) &= ~ADC_CR2_ALIGN;
+}
+
+void adc_set_sample_time_on_all_channels(uint32_t adc, uint8_t time)
+{
+	ADC_SMPR2(adc) = time;
+}
+
+/**
+ * @brief Store the regular sequence (SQR3 holds up to six channels).
+ */
+void adc_set_regular_sequence(uint32_t adc, uint8_t length, uint8_t channel[])
+{
+	uint32_t sqr3 = 0;
+	uint8_t i;
+
+	for (i = 0; i < length && i < 6; i++)
+		sqr3 |= (uint32_t)channel[i] << (5 * i);
+	ADC_SQR3(adc) = sqr3;
+	ADC_SQR1(adc) = (uint32_t)(length - 1) << 20;
+	sequence_index[adc_index(adc)] = 0;
+}
+
+void adc_enable_external_trigger_regular(uint32_t adc, uint32_t trigger,
+					 uint32_t polarity)
+{
+	ADC_CR2(adc) |= trigger | polarity;
+}
+
+void adc_disable_external_trigger_regular(uint32_t adc)
+{
+	ADC_CR2(adc) &= ~(0xFU << ADC_CR2_EXTSEL_SHIFT);
+	ADC_CR2(adc) &= ~(0x3U << ADC_CR2_EXTEN_SHIFT);
+}
+
+bool adc_eoc(uint32_t adc)
+{
+	return ADC_SR(adc) & ADC_SR_EOC;
+}
+
+uint32_t adc_read_regular(uint32_t adc)
+{
+	ADC_SR(adc) &= ~ADC_SR_EOC;
+	return ADC_DR(adc);
+}
+
+void adc_enable_dma(uint32_t adc)
+{
+	ADC_CR2(adc) |= ADC_CR2_DMA;
+}
+
+void adc_disable_dma(uint32_t adc)
+{
+	ADC_CR2(adc) &= ~ADC_CR2_DMA;
+}
+
+void adc_set_dma_continue(uint32_t adc)
+{
+	ADC_CR2(adc) |= ADC_CR2_DDS;
+}
+
+void adc_set_dma_terminate(uint32_t adc)
+{
+	ADC_CR2(adc) &= ~ADC_CR2_DDS;
+}
+
+static uint8_t sequence_length(uint32_t adc)
+{
+	return ((ADC_SQR1(adc) >> 20) & 0xF) + 1;
+}
+
+/**
+ * @brief Convert the next channel of the regular sequence.
+ *
+ * @return Whether the end of the sequence was reached.
+ */
+static bool convert_next(uint32_t adc)
+{
+	uint8_t *index = &sequence_index[adc_index(adc)];
+	uint8_t channel = (ADC_SQR3(adc) >> (5 * *index)) & 0x1F;
+
+	ADC_DR(adc) = sim_board_adc_convert(adc, channel);
+	ADC_SR(adc) |= ADC_SR_EOC | ADC_SR_STRT;
+	if (ADC_CR2(adc) & ADC_CR2_DMA)
+		sim_dma_write_peripheral((uint32_t)(uintptr_t)&ADC_DR(adc),
+					 ADC_DR(adc));
+	*index += 1;
+	if (*index < sequence_length(adc))
+		return false;
+	*index = 0;
+	return true;
+}
+
+/**
+ * @brief Convert the whole regular sequence (or a single channel).
+ */
+static void convert_sequence(uint32_t adc)
+{
+	if (!(ADC_CR1(adc) & ADC_CR1_SCAN)) {
+		sequence_index[adc_index(adc)] = 0;
+		convert_next(adc);
+		return;
+	}
+	while (!convert_next(adc))
+		;
+}
+
+void adc_start_conversion_regular(uint32_t adc)
+{
+	if (!(ADC_CR2(adc) & ADC_CR2_ADON))
+		return;
+	convert_sequence(adc);
+}
+
+/**
+ * @brief Trigger the regular conversions of the ADCs using a trigger source.
+ *
+ * @param[in] source External trigger selection (`ADC_CR2_EXTSEL_*`).
+ */
+void sim_adc_trigger(uint32_t source)
+{
+	uint32_t adc;
+	uint8_t i;
+
+	for (i = 0; i < ADC_COUNT; i++) {
+		adc = ADC1 + 0x100 * i;
+		if (!(ADC_CR2(adc) & ADC_CR2_ADON))
+			continue;
+		if (!(ADC_CR2(adc) & (0x3U << ADC_CR2_EXTEN_SHIFT)))
+			continue;
+		if ((ADC_CR2(adc) & (0xFU << ADC_CR2_EXTSEL_SHIFT)) != source)
+			continue;
+		convert_sequence(adc);
+	}
+}
+
+/**
+ * @brief Run continuous conversions for the elapsed time.
+ */
+void sim_adc_step(uint32_t microseconds)
+{
+	uint32_t adc;
+	uint32_t conversion_ns;
+	uint8_t i;
+
+	for (i = 0; i < ADC_COUNT; i++) {
+		adc = ADC1 + 0x100 * i;
+		if ((ADC_CR2(adc) & (ADC_CR2_ADON | ADC_CR2_CONT)) !=
+		    (ADC_CR2_ADON | ADC_CR2_CONT))
+			continue;
+		conversion_ns = (sample_cycles[ADC_SMPR2(adc) & 0x7] + 12) *
+				1000 / ADC_CLOCK_MHZ;
+		elapsed_ns[i] += microseconds * 1000;
+		while (elapsed_ns[i] >= conversion_ns) {
+			elapsed_ns[i] -= conversion_ns;
+			convert_next(adc);
+		}
+	}
+}
@@ -0,0 +1,196 @@
+#include <time.h>
+
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/dwt.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/scb.h>
+#include <libopencm3/cm3/sync.h>
+#include <libopencm3/cm3/systick.h>
+
+#include "peripherals.h"
+
+#define SIM_SYSCLK_MHZ 168
+
+static bool interrupts_masked;
+static bool cycle_counter_enabled;
+static bool systick_interrupt;
+static bool systick_pending;
+static uint32_t systick_frequency;
+static uint8_t irq_enabled[NVIC_IRQ_COUNT];
+static uint8_t irq_pending[NVIC_IRQ_COUNT];
+
+void cm_enable_interrupts(void)
+{
+	cm_mask_interrupts(0);
+}
+
+void cm_disable_interrupts(void)
+{
+	cm_mask_interrupts(1);
+}
+
+bool cm_is_masked_interrupts(void)
+{
+	return interrupts_masked;
+}
+
+/**
+ * @brief Mask interruptions, delivering pending ones when unmasking.
+ */
+uint32_t cm_mask_interrupts(uint32_t mask)
+{
+	uint32_t old = interrupts_masked;
+	uint8_t irqn;
+
+	interrupts_masked = mask;
+	if (mask)
+		return old;
+	if (systick_pending) {
+		systick_pending = false;
+		sim_board_systick();
+	}
+	for (irqn = 0; irqn < NVIC_IRQ_COUNT; irqn++) {
+		if (irq_pending[irqn]) {
+			irq_pending[irqn] = 0;
+			sim_irq_dispatch(irqn);
+		}
+	}
+	return old;
+}
+
+void __WFI(void)
+{
+	sim_board_wait_for_interrupt();
+}
+
+void __dmb(void)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief The cycle counter is derived from the host monotonic clock.
+ *
+ * It runs at the target SYSCLK rate, so profiling figures are expressed in
+ * target cycles even if they measure host execution time.
+ */
+bool dwt_enable_cycle_counter(void)
+{
+	cycle_counter_enabled = true;
+	return true;
+}
+
+uint32_t dwt_read_cycle_counter(void)
+{
+	struct timespec now;
+
+	if (!cycle_counter_enabled)
+		return 0;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)((now.tv_sec * 1000000000ULL + now.tv_nsec) *
+			  SIM_SYSCLK_MHZ / 1000);
+}
+
+void nvic_enable_irq(uint8_t irqn)
+{
+	irq_enabled[irqn] = 1;
+}
+
+void nvic_disable_irq(uint8_t irqn)
+{
+	irq_enabled[irqn] = 0;
+}
+
+uint8_t nvic_get_irq_enabled(uint8_t irqn)
+{
+	return irq_enabled[irqn];
+}
+
+void nvic_set_priority(uint8_t irqn, uint8_t priority)
+{
+	(void)irqn;
+	(void)priority;
+}
+
+/**
+ * @brief Raise an interruption request from a simulated peripheral.
+ */
+void sim_irq_raise(uint8_t irqn)
+{
+	if (!irq_enabled[irqn])
+		return;
+	if (interrupts_masked) {
+		irq_pending[irqn] = 1;
+		return;
+	}
+	sim_irq_dispatch(irqn);
+}
+
+void scb_reset_system(void)
+{
+}
+
+bool systick_set_frequency(uint32_t freq, uint32_t ahb)
+{
+	(void)ahb;
+	systick_frequency = freq;
+	return true;
+}
+
+void systick_counter_enable(void)
+{
+}
+
+void systick_counter_disable(void)
+{
+}
+
+void systick_interrupt_enable(void)
+{
+	systick_interrupt = true;
+}
+
+void systick_interrupt_disable(void)
+{
+	systick_interrupt = false;
+}
+
+/**
+ * @brief Raise the SysTick exception.
+ *
+ * It is delivered when interruptions are unmasked if they are masked.
+ */
+void sim_systick_raise(void)
+{
+	if (!systick_interrupt)
+		return;
+	if (interrupts_masked) {
+		systick_pending = true;
+		return;
+	}
+	sim_board_systick();
+}
+
+uint32_t sim_systick_frequency(void)
+{
+	return systick_frequency;
+}
+
+void mutex_lock(mutex_t *m)
+{
+	while (!mutex_trylock(m))
+		;
+}
+
+uint32_t mutex_trylock(mutex_t *m)
+{
+	if (*m != MUTEX_UNLOCKED)
+		return 0;
+	*m = MUTEX_LOCKED;
+	return 1;
+}
+
+void mutex_unlock(mutex_t *m)
+{
+	*m = MUTEX_UNLOCKED;
+}
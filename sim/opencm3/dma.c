@@ -0,0 +1,318 @@
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/dma.h>
+
+#include "peripherals.h"
+
+#define DMA_STREAMS 8
+
+/* Number of data items programmed when the stream was enabled */
+static uint16_t reload[2][DMA_STREAMS];
+
+static const uint8_t dma1_irqs[DMA_STREAMS] = {
+    NVIC_DMA1_STREAM0_IRQ, NVIC_DMA1_STREAM1_IRQ, NVIC_DMA1_STREAM2_IRQ,
+    NVIC_DMA1_STREAM3_IRQ, NVIC_DMA1_STREAM4_IRQ, NVIC_DMA1_STREAM5_IRQ,
+    NVIC_DMA1_STREAM6_IRQ, NVIC_DMA1_STREAM7_IRQ,
+};
+static const uint8_t dma2_irqs[DMA_STREAMS] = {
+    NVIC_DMA2_STREAM0_IRQ, NVIC_DMA2_STREAM1_IRQ, NVIC_DMA2_STREAM2_IRQ,
+    NVIC_DMA2_STREAM3_IRQ, NVIC_DMA2_STREAM4_IRQ, NVIC_DMA2_STREAM5_IRQ,
+    NVIC_DMA2_STREAM6_IRQ, NVIC_DMA2_STREAM7_IRQ,
+};
+
+static volatile uint32_t *isr_register(uint32_t dma, uint8_t stream)
+{
+	if (stream < 4)
+		return &DMA_LISR(dma);
+	return &DMA_HISR(dma);
+}
+
+void dma_stream_reset(uint32_t dma, uint8_t stream)
+{
+	DMA_SCR(dma, stream) = 0;
+	DMA_SNDTR(dma, stream) = 0;
+	DMA_SPAR(dma, stream) = 0;
+	DMA_SM0AR(dma, stream) = 0;
+	DMA_SM1AR(dma, stream) = 0;
+	dma_clear_interrupt_flags(dma, stream, 0x3D);
+}
+
+void dma_clear_interrupt_flags(uint32_t dma, uint8_t stream,
+			       uint32_t interrupts)
+{
+	*isr_register(dma, stream) &= ~(interrupts << DMA_ISR_OFFSET(stream));
+}
+
+bool dma_get_interrupt_flag(uint32_t dma, uint8_t stream, uint32_t interrupt)
+{
+	return (*isr_register(dma, stream) >> DMA_ISR_OFFSET(stream)) &
+	       interrupt;
+}
+
+void dma_enable_memory_increment_mode(uint32_t dma, uint8_t stream)
+{
+	DMA_SCR(dma, stream) |= DMA_SxCR_MINC;
+}
+
+void dma_disable_memory_increment_mode(uint32_t dma, uint8_t stream)
+{
+	DMA_SCR(dma, stream) &= ~DMA_SxCR_MINC;
+}
+
+void dma_enable_peripheral_increment_mode(uint32_t dma, uint8_t stream)
+{
+	DMA_SCR(dma, stream) |= DMA_SxCR_PINC;
+}
+
+void dma_enable_circular_mode(uint32_t dma, uint8_t stream)
+{
+	DMA_SCR(dma, stream) |= DMA_SxCR_CIRC;
+}
+
+void dma_enable_double_buffer_mode(uint32_t dma, uint8_t stream)
+{
+	DMA_SCR(dma, stream) |= DMA_SxCR_DBM;
+}
+
+void dma_set_peripheral_size(uint32_t dma, uint8_t stream,
+			     uint32_t peripheral_size)
+{
+	DMA_SCR(dma, stream) &= ~DMA_SxCR_PSIZE_MASK;
+	DMA_SCR(dma, stream) |= peripheral_size;
+}
+
+void dma_set_memory_size(uint32_t dma, uint8_t stream, uint32_t mem_size)
+{
+	DMA_SCR(dma, stream) &= ~DMA_SxCR_MSIZE_MASK;
+	DMA_SCR(dma, stream) |= mem_size;
+}
+
+void dma_set_priority(uint32_t dma, uint8_t stream, uint32_t prio)
+{
+	DMA_SCR(dma, stream) &= ~DMA_SxCR_PL_MASK;
+	DMA_SCR(dma, stream) |= prio;
+}
+
+void dma_set_transfer_mode(uint32_t dma, uint8_t stream, uint32_t direction)
+{
+	DMA_SCR(dma, stream) &= ~DMA_SxCR_DIR_MASK;
+	DMA_SCR(dma, stream) |= direction;
+}
+
+void dma_set_peripheral_address(uint32_t dma, uint8_t stream, uint32_t address)
+{
+	DMA_SPAR(dma, stream) = address;
+}
+
+void dma_set_memory_address(uint32_t dma, uint8_t stream, uint32_t address)
+{
+	DMA_SM0AR(dma, stream) = address;
+}
+
+void dma_set_memory_address_1(uint32_t dma, uint8_t stream, uint32_t address)
+{
+	DMA_SM1AR(dma, stream) = address;
+}
+
+void dma_set_number_of_data(uint32_t dma, uint8_t stream, uint16_t number)
+{
+	DMA_SNDTR(dma, stream) = number;
+}
+
+uint16_t dma_get_number_of_data(uint32_t dma, uint8_t stream)
+{
+	return DMA_SNDTR(dma, stream);
+}
+
+void dma_enable_transfer_complete_interrupt(uint32_t dma, uint8_t stream)
+{
+	DMA_SCR(dma, stream) |= DMA_SxCR_TCIE;
+}
+
+void dma_disable_transfer_complete_interrupt(uint32_t dma, uint8_t stream)
+{
+	DMA_SCR(dma, stream) &= ~DMA_SxCR_TCIE;
+}
+
+void dma_enable_half_transfer_interrupt(uint32_t dma, uint8_t stream)
+{
+	DMA_SCR(dma, stream) |= DMA_SxCR_HTIE;
+}
+
+void dma_disable_half_transfer_interrupt(uint32_t dma, uint8_t stream)
+{
+	DMA_SCR(dma, stream) &= ~DMA_SxCR_HTIE;
+}
+
+void dma_channel_select(uint32_t dma, uint8_t stream, uint32_t channel)
+{
+	DMA_SCR(dma, stream) &= ~DMA_SxCR_CHSEL_MASK;
+	DMA_SCR(dma, stream) |= channel;
+}
+
+void dma_enable_stream(uint32_t dma, uint8_t stream)
+{
+	reload[dma == DMA2][stream] = DMA_SNDTR(dma, stream);
+	DMA_SCR(dma, stream) |= DMA_SxCR_EN;
+}
+
+void dma_disable_stream(uint32_t dma, uint8_t stream)
+{
+	DMA_SCR(dma, stream) &= ~DMA_SxCR_EN;
+}
+
+uint8_t dma_get_target(uint32_t dma, uint8_t stream)
+{
+	return (DMA_SCR(dma, stream) & DMA_SxCR_CT) ? 1 : 0;
+}
+
+/**
+ * @brief Find an enabled stream serving a peripheral in a given direction.
+ */
+static bool find_stream(uint32_t peripheral_address, uint32_t direction,
+			uint32_t *dma, uint8_t *stream)
+{
+	static const uint32_t controllers[] = {DMA1, DMA2};
+	uint32_t scr;
+	uint8_t i;
+	uint8_t s;
+
+	for (i = 0; i < 2; i++) {
+		for (s = 0; s < DMA_STREAMS; s++) {
+			scr = DMA_SCR(controllers[i], s);
+			if (!(scr & DMA_SxCR_EN))
+				continue;
+			if ((scr & DMA_SxCR_DIR_MASK) != direction)
+				continue;
+			if (DMA_SPAR(controllers[i], s) != peripheral_address)
+				continue;
+			*dma = controllers[i];
+			*stream = s;
+			return true;
+		}
+	}
+	return false;
+}
+
+static uint8_t memory_size(uint32_t dma, uint8_t stream)
+{
+	return 1 << ((DMA_SCR(dma, stream) & DMA_SxCR_MSIZE_MASK) >>
+		     DMA_SxCR_MSIZE_SHIFT);
+}
+
+/**
+ * @brief Host address of the memory item for the current transfer.
+ */
+static uint8_t *memory_item(uint32_t dma, uint8_t stream)
+{
+	uint32_t scr = DMA_SCR(dma, stream);
+	uint32_t base;
+	uint32_t index = 0;
+
+	base = (scr & DMA_SxCR_CT) ? DMA_SM1AR(dma, stream)
+				   : DMA_SM0AR(dma, stream);
+	if (scr & DMA_SxCR_MINC)
+		index = reload[dma == DMA2][stream] - DMA_SNDTR(dma, stream);
+	return (uint8_t *)sim_address(base) + index * memory_size(dma, stream);
+}
+
+static void set_flag(uint32_t dma, uint8_t stream, uint32_t flag)
+{
+	uint32_t scr = DMA_SCR(dma, stream);
+	const uint8_t *irqs = (dma == DMA2) ? dma2_irqs : dma1_irqs;
+
+	*isr_register(dma, stream) |= flag << DMA_ISR_OFFSET(stream);
+	if ((flag == DMA_TCIF && (scr & DMA_SxCR_TCIE)) ||
+	    (flag == DMA_HTIF && (scr & DMA_SxCR_HTIE)))
+		sim_irq_raise(irqs[stream]);
+}
+
+/**
+ * @brief Account for a completed data item, handling circular reloads.
+ */
+static void advance(uint32_t dma, uint8_t stream)
+{
+	uint32_t scr;
+	uint16_t total = reload[dma == DMA2][stream];
+
+	DMA_SNDTR(dma, stream) -= 1;
+	if (DMA_SNDTR(dma, stream) == total / 2)
+		set_flag(dma, stream, DMA_HTIF);
+	if (DMA_SNDTR(dma, stream) > 0)
+		return;
+	scr = DMA_SCR(dma, stream);
+	if (scr & DMA_SxCR_DBM) {
+		DMA_SCR(dma, stream) = scr ^ DMA_SxCR_CT;
+		DMA_SNDTR(dma, stream) = total;
+	} else if (scr & DMA_SxCR_CIRC) {
+		DMA_SNDTR(dma, stream) = total;
+	} else {
+		DMA_SCR(dma, stream) = scr & ~DMA_SxCR_EN;
+	}
+	set_flag(dma, stream, DMA_TCIF);
+}
+
+/**
+ * @brief Serve a memory-to-peripheral request.
+ *
+ * @param[in] peripheral_address Data register of the requesting peripheral.
+ * @param[out] value Data item read from memory.
+ *
+ * @return Whether an enabled stream served the request.
+ */
+bool sim_dma_read_peripheral(uint32_t peripheral_address, uint32_t *value)
+{
+	uint32_t dma;
+	uint8_t stream;
+	uint8_t *item;
+
+	if (!find_stream(peripheral_address, DMA_SxCR_DIR_MEM_TO_PERIPHERAL,
+			 &dma, &stream))
+		return false;
+	item = memory_item(dma, stream);
+	switch (memory_size(dma, stream)) {
+	case 1:
+		*value = *item;
+		break;
+	case 2:
+		*value = *(uint16_t *)item;
+		break;
+	default:
+		*value = *(uint32_t *)item;
+		break;
+	}
+	advance(dma, stream);
+	return true;
+}
+
+/**
+ * @brief Serve a peripheral-to-memory request.
+ *
+ * @param[in] peripheral_address Data register of the requesting peripheral.
+ * @param[in] value Data item to store in memory.
+ *
+ * @return Whether an enabled stream served the request.
+ */
+bool sim_dma_write_peripheral(uint32_t peripheral_address, uint32_t value)
+{
+	uint32_t dma;
+	uint8_t stream;
+	uint8_t *item;
+
+	if (!find_stream(peripheral_address, DMA_SxCR_DIR_PERIPHERAL_TO_MEM,
+			 &dma, &stream))
+		return false;
+	item = memory_item(dma, stream);
+	switch (memory_size(dma, stream)) {
+	case 1:
+		*item = (uint8_t)value;
+		break;
+	case 2:
+		*(uint16_t *)item = (uint16_t)value;
+		break;
+	default:
+		*(uint32_t *)item = value;
+		break;
+	}
+	advance(dma, stream);
+	return true;
+}
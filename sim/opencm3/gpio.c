@@ -0,0 +1,86 @@
+#include <libopencm3/stm32/gpio.h>
+
+#include "peripherals.h"
+
+void gpio_mode_setup(uint32_t gpioport, uint8_t mode, uint8_t pull_up_down,
+		     uint16_t gpios)
+{
+	uint8_t i;
+
+	(void)pull_up_down;
+	for (i = 0; i < 16; i++) {
+		if (!(gpios & (1 << i)))
+			continue;
+		GPIO_MODER(gpioport) &= ~(0x3U << (2 * i));
+		GPIO_MODER(gpioport) |= (uint32_t)mode << (2 * i);
+	}
+}
+
+void gpio_set_af(uint32_t gpioport, uint8_t alt_func_num, uint16_t gpios)
+{
+	(void)gpioport;
+	(void)alt_func_num;
+	(void)gpios;
+}
+
+/**
+ * @brief Apply pending BSRR writes (from DMA or direct register access).
+ */
+static void apply_bsrr(uint32_t gpioport)
+{
+	uint32_t bsrr = GPIO_BSRR(gpioport);
+
+	if (!bsrr)
+		return;
+	GPIO_ODR(gpioport) &= ~(bsrr >> 16);
+	GPIO_ODR(gpioport) |= bsrr & 0xFFFF;
+	GPIO_BSRR(gpioport) = 0;
+	sim_board_gpio_write(gpioport, GPIO_ODR(gpioport));
+}
+
+void gpio_set(uint32_t gpioport, uint16_t gpios)
+{
+	GPIO_BSRR(gpioport) = gpios;
+	apply_bsrr(gpioport);
+}
+
+void gpio_clear(uint32_t gpioport, uint16_t gpios)
+{
+	GPIO_BSRR(gpioport) = (uint32_t)gpios << 16;
+	apply_bsrr(gpioport);
+}
+
+void gpio_toggle(uint32_t gpioport, uint16_t gpios)
+{
+	uint32_t port = GPIO_ODR(gpioport);
+
+	GPIO_BSRR(gpioport) = ((port & gpios) << 16) | (~port & gpios);
+	apply_bsrr(gpioport);
+}
+
+uint16_t gpio_get(uint32_t gpioport, uint16_t gpios)
+{
+	return gpio_port_read(gpioport) & gpios;
+}
+
+/**
+ * @brief Output pins read back their output level.
+ */
+uint16_t gpio_port_read(uint32_t gpioport)
+{
+	return (GPIO_IDR(gpioport) | GPIO_ODR(gpioport)) & 0xFFFF;
+}
+
+/**
+ * @brief Serve a memory-to-peripheral DMA transfer into a BSRR register.
+ */
+void sim_gpio_dma_bsrr(uint32_t gpioport)
+{
+	uint32_t value;
+
+	if (!sim_dma_read_peripheral((uint32_t)(uintptr_t)&GPIO_BSRR(gpioport),
+				     &value))
+		return;
+	GPIO_BSRR(gpioport) = value;
+	apply_bsrr(gpioport);
+}
@@ -0,0 +1,24 @@
+#ifndef __SIM_CM3_COMMON_H
+#define __SIM_CM3_COMMON_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Memory-mapped registers are redirected to the simulated address space.
+ *
+ * Peripheral and flash addresses are backed by host buffers, while any other
+ * address is assumed to be a host pointer (the simulator is linked without
+ * PIE so static buffers fit in 32 bits).
+ */
+#define MMIO8(addr) (*(volatile uint8_t *)sim_mmio32(addr))
+#define MMIO16(addr) (*(volatile uint16_t *)sim_mmio32(addr))
+#define MMIO32(addr) (*sim_mmio32(addr))
+
+#define BIT0 (1 << 0)
+#define BIT4 (1 << 4)
+#define BIT15 (1 << 15)
+
+volatile uint32_t *sim_mmio32(uint32_t address);
+
+#endif /* __SIM_CM3_COMMON_H */
@@ -0,0 +1,23 @@
+#ifndef __SIM_CM3_CORTEX_H
+#define __SIM_CM3_CORTEX_H
+
+#include <libopencm3/cm3/common.h>
+
+void cm_enable_interrupts(void);
+void cm_disable_interrupts(void);
+uint32_t cm_mask_interrupts(uint32_t mask);
+bool cm_is_masked_interrupts(void);
+
+/**
+ * Wait for interrupt.
+ *
+ * In the simulator this advances the world until the next SysTick period
+ * and executes any pending interruption handler.
+ */
+void __WFI(void);
+
+#define CM_ATOMIC_BLOCK()                                                      \
+	for (uint32_t __cm_atomic = cm_mask_interrupts(1), __cm_done = 0;      \
+	     !__cm_done; cm_mask_interrupts(__cm_atomic), __cm_done = 1)
+
+#endif /* __SIM_CM3_CORTEX_H */
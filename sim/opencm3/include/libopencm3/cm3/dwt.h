@@ -0,0 +1,12 @@
+#ifndef __SIM_CM3_DWT_H
+#define __SIM_CM3_DWT_H
+
+#include <libopencm3/cm3/common.h>
+
+bool dwt_enable_cycle_counter(void);
+uint32_t dwt_read_cycle_counter(void);
+
+/** Reading the cycle counter register samples the host clock */
+#define DWT_CYCCNT (dwt_read_cycle_counter())
+
+#endif /* __SIM_CM3_DWT_H */
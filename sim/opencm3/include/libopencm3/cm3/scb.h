@@ -0,0 +1,8 @@
+#ifndef __SIM_CM3_SCB_H
+#define __SIM_CM3_SCB_H
+
+#include <libopencm3/cm3/common.h>
+
+void scb_reset_system(void);
+
+#endif /* __SIM_CM3_SCB_H */
@@ -0,0 +1,16 @@
+#ifndef __SIM_CM3_SYNC_H
+#define __SIM_CM3_SYNC_H
+
+#include <libopencm3/cm3/common.h>
+
+typedef uint32_t mutex_t;
+
+#define MUTEX_UNLOCKED 0
+#define MUTEX_LOCKED 1
+
+void __dmb(void);
+void mutex_lock(mutex_t *m);
+uint32_t mutex_trylock(mutex_t *m);
+void mutex_unlock(mutex_t *m);
+
+#endif /* __SIM_CM3_SYNC_H */
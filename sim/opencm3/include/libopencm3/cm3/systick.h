@@ -0,0 +1,12 @@
+#ifndef __SIM_CM3_SYSTICK_H
+#define __SIM_CM3_SYSTICK_H
+
+#include <libopencm3/cm3/common.h>
+
+bool systick_set_frequency(uint32_t freq, uint32_t ahb);
+void systick_counter_enable(void);
+void systick_counter_disable(void);
+void systick_interrupt_enable(void);
+void systick_interrupt_disable(void);
+
+#endif /* __SIM_CM3_SYSTICK_H */
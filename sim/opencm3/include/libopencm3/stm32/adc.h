@@ -0,0 +1,81 @@
+#ifndef __SIM_STM32_ADC_H
+#define __SIM_STM32_ADC_H
+
+#include <libopencm3/cm3/common.h>
+
+#define ADC1 0x40012000
+#define ADC2 0x40012100
+#define ADC3 0x40012200
+
+#define ADC_SR(adc) MMIO32((adc) + 0x00)
+#define ADC_CR1(adc) MMIO32((adc) + 0x04)
+#define ADC_CR2(adc) MMIO32((adc) + 0x08)
+#define ADC_SMPR1(adc) MMIO32((adc) + 0x0C)
+#define ADC_SMPR2(adc) MMIO32((adc) + 0x10)
+#define ADC_SQR1(adc) MMIO32((adc) + 0x2C)
+#define ADC_SQR2(adc) MMIO32((adc) + 0x30)
+#define ADC_SQR3(adc) MMIO32((adc) + 0x34)
+#define ADC_JSQR(adc) MMIO32((adc) + 0x38)
+#define ADC_JDR1(adc) MMIO32((adc) + 0x3C)
+#define ADC_DR(adc) MMIO32((adc) + 0x4C)
+#define ADC1_DR ADC_DR(ADC1)
+#define ADC2_DR ADC_DR(ADC2)
+
+#define ADC_SR_EOC (1 << 1)
+#define ADC_SR_JEOC (1 << 2)
+#define ADC_SR_STRT (1 << 4)
+#define ADC_CR1_SCAN (1 << 8)
+#define ADC_CR2_ADON (1 << 0)
+#define ADC_CR2_CONT (1 << 1)
+#define ADC_CR2_DMA (1 << 8)
+#define ADC_CR2_DDS (1 << 9)
+#define ADC_CR2_ALIGN (1 << 11)
+#define ADC_CR2_EXTEN_SHIFT 28
+#define ADC_CR2_EXTSEL_SHIFT 24
+#define ADC_CR2_SWSTART (1 << 30)
+
+#define ADC_CHANNEL0 0x00
+#define ADC_CHANNEL10 0x0A
+#define ADC_CHANNEL11 0x0B
+#define ADC_CHANNEL12 0x0C
+#define ADC_CHANNEL13 0x0D
+#define ADC_CHANNEL14 0x0E
+#define ADC_CHANNEL15 0x0F
+
+#define ADC_SMPR_SMP_3CYC 0x0
+#define ADC_SMPR_SMP_15CYC 0x1
+#define ADC_SMPR_SMP_28CYC 0x2
+#define ADC_SMPR_SMP_56CYC 0x3
+#define ADC_SMPR_SMP_84CYC 0x4
+#define ADC_SMPR_SMP_112CYC 0x5
+#define ADC_SMPR_SMP_144CYC 0x6
+#define ADC_SMPR_SMP_480CYC 0x7
+
+#define ADC_CR2_EXTEN_DISABLED (0x0 << 28)
+#define ADC_CR2_EXTEN_RISING_EDGE (0x1 << 28)
+#define ADC_CR2_EXTSEL_TIM1_CC1 (0x0 << 24)
+#define ADC_CR2_EXTSEL_TIM1_CC2 (0x1 << 24)
+#define ADC_CR2_EXTSEL_TIM1_CC3 (0x2 << 24)
+#define ADC_CR2_EXTSEL_TIM8_CC1 (0xD << 24)
+
+void adc_power_on(uint32_t adc);
+void adc_power_off(uint32_t adc);
+void adc_enable_scan_mode(uint32_t adc);
+void adc_disable_scan_mode(uint32_t adc);
+void adc_set_single_conversion_mode(uint32_t adc);
+void adc_set_continuous_conversion_mode(uint32_t adc);
+void adc_set_right_aligned(uint32_t adc);
+void adc_set_sample_time_on_all_channels(uint32_t adc, uint8_t time);
+void adc_set_regular_sequence(uint32_t adc, uint8_t length, uint8_t channel[]);
+void adc_enable_external_trigger_regular(uint32_t adc, uint32_t trigger,
+					 uint32_t polarity);
+void adc_disable_external_trigger_regular(uint32_t adc);
+void adc_start_conversion_regular(uint32_t adc);
+bool adc_eoc(uint32_t adc);
+uint32_t adc_read_regular(uint32_t adc);
+void adc_enable_dma(uint32_t adc);
+void adc_disable_dma(uint32_t adc);
+void adc_set_dma_continue(uint32_t adc);
+void adc_set_dma_terminate(uint32_t adc);
+
+#endif /* __SIM_STM32_ADC_H */
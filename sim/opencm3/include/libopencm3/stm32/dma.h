@@ -0,0 +1,105 @@
+#ifndef __SIM_STM32_DMA_H
+#define __SIM_STM32_DMA_H
+
+#include <libopencm3/cm3/common.h>
+
+#define DMA1 0x40026000
+#define DMA2 0x40026400
+
+#define DMA_STREAM0 0
+#define DMA_STREAM1 1
+#define DMA_STREAM2 2
+#define DMA_STREAM3 3
+#define DMA_STREAM4 4
+#define DMA_STREAM5 5
+#define DMA_STREAM6 6
+#define DMA_STREAM7 7
+
+#define DMA_LISR(port) MMIO32((port) + 0x00)
+#define DMA_HISR(port) MMIO32((port) + 0x04)
+#define DMA_LIFCR(port) MMIO32((port) + 0x08)
+#define DMA_HIFCR(port) MMIO32((port) + 0x0C)
+#define DMA_STREAM(port, n) ((port) + 0x10 + (24 * (n)))
+#define DMA_SCR(port, n) MMIO32(DMA_STREAM(port, n) + 0x00)
+#define DMA_SNDTR(port, n) MMIO32(DMA_STREAM(port, n) + 0x04)
+#define DMA_SPAR(port, n) MMIO32(DMA_STREAM(port, n) + 0x08)
+#define DMA_SM0AR(port, n) MMIO32(DMA_STREAM(port, n) + 0x0C)
+#define DMA_SM1AR(port, n) MMIO32(DMA_STREAM(port, n) + 0x10)
+
+#define DMA_FEIF (1 << 0)
+#define DMA_DMEIF (1 << 2)
+#define DMA_TEIF (1 << 3)
+#define DMA_HTIF (1 << 4)
+#define DMA_TCIF (1 << 5)
+#define DMA_ISR_OFFSET(stream)                                                 \
+	(6 * ((stream) & 0x01) + 16 * (((stream) & 0x02) >> 1))
+
+#define DMA_SxCR_EN (1 << 0)
+#define DMA_SxCR_TEIE (1 << 2)
+#define DMA_SxCR_HTIE (1 << 3)
+#define DMA_SxCR_TCIE (1 << 4)
+#define DMA_SxCR_DIR_SHIFT 6
+#define DMA_SxCR_DIR_MASK (3 << 6)
+#define DMA_SxCR_DIR_PERIPHERAL_TO_MEM (0 << 6)
+#define DMA_SxCR_DIR_MEM_TO_PERIPHERAL (1 << 6)
+#define DMA_SxCR_DIR_MEM_TO_MEM (2 << 6)
+#define DMA_SxCR_CIRC (1 << 8)
+#define DMA_SxCR_PINC (1 << 9)
+#define DMA_SxCR_MINC (1 << 10)
+#define DMA_SxCR_PSIZE_SHIFT 11
+#define DMA_SxCR_PSIZE_MASK (3 << 11)
+#define DMA_SxCR_PSIZE_8BIT (0 << 11)
+#define DMA_SxCR_PSIZE_16BIT (1 << 11)
+#define DMA_SxCR_PSIZE_32BIT (2 << 11)
+#define DMA_SxCR_MSIZE_SHIFT 13
+#define DMA_SxCR_MSIZE_MASK (3 << 13)
+#define DMA_SxCR_MSIZE_8BIT (0 << 13)
+#define DMA_SxCR_MSIZE_16BIT (1 << 13)
+#define DMA_SxCR_MSIZE_32BIT (2 << 13)
+#define DMA_SxCR_PL_MASK (3 << 16)
+#define DMA_SxCR_PL_LOW (0 << 16)
+#define DMA_SxCR_PL_MEDIUM (1 << 16)
+#define DMA_SxCR_PL_HIGH (2 << 16)
+#define DMA_SxCR_PL_VERY_HIGH (3 << 16)
+#define DMA_SxCR_CT (1 << 19)
+#define DMA_SxCR_DBM (1 << 18)
+#define DMA_SxCR_CHSEL_SHIFT 25
+#define DMA_SxCR_CHSEL_MASK (7 << 25)
+#define DMA_SxCR_CHSEL_0 (0 << 25)
+#define DMA_SxCR_CHSEL_1 (1 << 25)
+#define DMA_SxCR_CHSEL_2 (2 << 25)
+#define DMA_SxCR_CHSEL_3 (3 << 25)
+#define DMA_SxCR_CHSEL_4 (4 << 25)
+#define DMA_SxCR_CHSEL_5 (5 << 25)
+#define DMA_SxCR_CHSEL_6 (6 << 25)
+#define DMA_SxCR_CHSEL_7 (7 << 25)
+
+void dma_stream_reset(uint32_t dma, uint8_t stream);
+void dma_clear_interrupt_flags(uint32_t dma, uint8_t stream,
+			       uint32_t interrupts);
+bool dma_get_interrupt_flag(uint32_t dma, uint8_t stream, uint32_t interrupt);
+void dma_enable_memory_increment_mode(uint32_t dma, uint8_t stream);
+void dma_disable_memory_increment_mode(uint32_t dma, uint8_t stream);
+void dma_enable_peripheral_increment_mode(uint32_t dma, uint8_t stream);
+void dma_enable_circular_mode(uint32_t dma, uint8_t stream);
+void dma_enable_double_buffer_mode(uint32_t dma, uint8_t stream);
+void dma_set_peripheral_size(uint32_t dma, uint8_t stream,
+			     uint32_t peripheral_size);
+void dma_set_memory_size(uint32_t dma, uint8_t stream, uint32_t mem_size);
+void dma_set_priority(uint32_t dma, uint8_t stream, uint32_t prio);
+void dma_set_transfer_mode(uint32_t dma, uint8_t stream, uint32_t direction);
+void dma_set_peripheral_address(uint32_t dma, uint8_t stream, uint32_t address);
+void dma_set_memory_address(uint32_t dma, uint8_t stream, uint32_t address);
+void dma_set_memory_address_1(uint32_t dma, uint8_t stream, uint32_t address);
+void dma_set_number_of_data(uint32_t dma, uint8_t stream, uint16_t number);
+uint16_t dma_get_number_of_data(uint32_t dma, uint8_t stream);
+void dma_enable_transfer_complete_interrupt(uint32_t dma, uint8_t stream);
+void dma_disable_transfer_complete_interrupt(uint32_t dma, uint8_t stream);
+void dma_enable_half_transfer_interrupt(uint32_t dma, uint8_t stream);
+void dma_disable_half_transfer_interrupt(uint32_t dma, uint8_t stream);
+void dma_channel_select(uint32_t dma, uint8_t stream, uint32_t channel);
+void dma_enable_stream(uint32_t dma, uint8_t stream);
+void dma_disable_stream(uint32_t dma, uint8_t stream);
+uint8_t dma_get_target(uint32_t dma, uint8_t stream);
+
+#endif /* __SIM_STM32_DMA_H */
@@ -0,0 +1,29 @@
+#ifndef __SIM_STM32_FLASH_H
+#define __SIM_STM32_FLASH_H
+
+#include <libopencm3/cm3/common.h>
+
+#define FLASH_ACR_LATENCY_5WS 0x05
+#define FLASH_ACR_PRFTEN (1 << 8)
+#define FLASH_ACR_ICEN (1 << 9)
+#define FLASH_ACR_DCEN (1 << 10)
+
+#define FLASH_CR_PROGRAM_X8 0
+#define FLASH_CR_PROGRAM_X16 1
+#define FLASH_CR_PROGRAM_X32 2
+#define FLASH_CR_PROGRAM_X64 3
+
+void flash_dcache_enable(void);
+void flash_dcache_disable(void);
+void flash_dcache_reset(void);
+void flash_icache_enable(void);
+void flash_icache_disable(void);
+void flash_set_ws(uint32_t ws);
+void flash_unlock(void);
+void flash_lock(void);
+void flash_erase_sector(uint8_t sector, uint32_t program_size);
+void flash_program_word(uint32_t address, uint32_t data);
+void flash_program(uint32_t address, const uint8_t *data, uint32_t len);
+uint32_t flash_get_status_flags(void);
+
+#endif /* __SIM_STM32_FLASH_H */
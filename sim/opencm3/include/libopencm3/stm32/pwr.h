@@ -0,0 +1,14 @@
+#ifndef __SIM_STM32_PWR_H
+#define __SIM_STM32_PWR_H
+
+#include <libopencm3/cm3/common.h>
+
+enum pwr_vos_scale {
+	PWR_SCALE1,
+	PWR_SCALE2,
+	PWR_SCALE3,
+};
+
+void pwr_set_vos_scale(enum pwr_vos_scale scale);
+
+#endif /* __SIM_STM32_PWR_H */
@@ -0,0 +1,88 @@
+#ifndef __SIM_STM32_RCC_H
+#define __SIM_STM32_RCC_H
+
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/pwr.h>
+
+#define RCC_BASE 0x40023800
+#define RCC_APB1ENR MMIO32(RCC_BASE + 0x40)
+
+#define RCC_CFGR_SW_HSI 0x0
+#define RCC_CFGR_SW_HSE 0x1
+#define RCC_CFGR_SW_PLL 0x2
+
+enum rcc_clock_3v3 {
+	RCC_CLOCK_3V3_48MHZ,
+	RCC_CLOCK_3V3_84MHZ,
+	RCC_CLOCK_3V3_120MHZ,
+	RCC_CLOCK_3V3_168MHZ,
+	RCC_CLOCK_3V3_180MHZ,
+	RCC_CLOCK_3V3_END
+};
+
+struct rcc_clock_scale {
+	uint8_t pllm;
+	uint16_t plln;
+	uint8_t pllp;
+	uint8_t pllq;
+	uint8_t pllr;
+	uint8_t pll_source;
+	uint32_t flash_config;
+	uint8_t hpre;
+	uint8_t ppre1;
+	uint8_t ppre2;
+	enum pwr_vos_scale voltage_scale;
+	uint32_t ahb_frequency;
+	uint32_t apb1_frequency;
+	uint32_t apb2_frequency;
+};
+
+extern const struct rcc_clock_scale rcc_hse_16mhz_3v3[RCC_CLOCK_3V3_END];
+
+extern uint32_t rcc_ahb_frequency;
+extern uint32_t rcc_apb1_frequency;
+extern uint32_t rcc_apb2_frequency;
+
+enum rcc_osc {
+	RCC_PLL,
+	RCC_PLLSAI,
+	RCC_PLLI2S,
+	RCC_HSE,
+	RCC_HSI,
+	RCC_LSE,
+	RCC_LSI
+};
+
+enum rcc_periph_clken {
+	RCC_GPIOA,
+	RCC_GPIOB,
+	RCC_GPIOC,
+	RCC_DMA1,
+	RCC_DMA2,
+	RCC_PWR,
+	RCC_SPI3,
+	RCC_TIM1,
+	RCC_TIM2,
+	RCC_TIM3,
+	RCC_TIM4,
+	RCC_TIM8,
+	RCC_TIM11,
+	RCC_USART1,
+	RCC_ADC1,
+	RCC_ADC2,
+};
+
+void rcc_periph_clock_enable(enum rcc_periph_clken clken);
+void rcc_peripheral_enable_clock(volatile uint32_t *reg, uint32_t en);
+void rcc_osc_on(enum rcc_osc osc);
+void rcc_osc_off(enum rcc_osc osc);
+void rcc_wait_for_osc_ready(enum rcc_osc osc);
+void rcc_wait_for_sysclk_status(enum rcc_osc osc);
+void rcc_set_sysclk_source(uint32_t clk);
+void rcc_set_hpre(uint32_t hpre);
+void rcc_set_ppre1(uint32_t ppre1);
+void rcc_set_ppre2(uint32_t ppre2);
+void rcc_set_main_pll_hsi(uint32_t pllm, uint32_t plln, uint32_t pllp,
+			  uint32_t pllq, uint32_t pllr);
+
+#endif /* __SIM_STM32_RCC_H */
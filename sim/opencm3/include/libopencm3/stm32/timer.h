@@ -0,0 +1,121 @@
+#ifndef __SIM_STM32_TIMER_H
+#define __SIM_STM32_TIMER_H
+
+#include <libopencm3/cm3/common.h>
+
+#define TIM2 0x40000000
+#define TIM3 0x40000400
+#define TIM4 0x40000800
+#define TIM1 0x40010000
+#define TIM8 0x40010400
+#define TIM11 0x40014800
+
+#define TIM_CR1(tim) MMIO32((tim) + 0x00)
+#define TIM_CR2(tim) MMIO32((tim) + 0x04)
+#define TIM_SMCR(tim) MMIO32((tim) + 0x08)
+#define TIM_DIER(tim) MMIO32((tim) + 0x0C)
+#define TIM_SR(tim) MMIO32((tim) + 0x10)
+#define TIM_EGR(tim) MMIO32((tim) + 0x14)
+#define TIM_CCMR1(tim) MMIO32((tim) + 0x18)
+#define TIM_CCMR2(tim) MMIO32((tim) + 0x1C)
+#define TIM_CCER(tim) MMIO32((tim) + 0x20)
+#define TIM_CNT(tim) MMIO32((tim) + 0x24)
+#define TIM_PSC(tim) MMIO32((tim) + 0x28)
+#define TIM_ARR(tim) MMIO32((tim) + 0x2C)
+#define TIM_RCR(tim) MMIO32((tim) + 0x30)
+#define TIM_CCR1(tim) MMIO32((tim) + 0x34)
+#define TIM_CCR2(tim) MMIO32((tim) + 0x38)
+#define TIM_CCR3(tim) MMIO32((tim) + 0x3C)
+#define TIM_CCR4(tim) MMIO32((tim) + 0x40)
+#define TIM_BDTR(tim) MMIO32((tim) + 0x44)
+#define TIM_DCR(tim) MMIO32((tim) + 0x48)
+#define TIM_DMAR(tim) MMIO32((tim) + 0x4C)
+#define TIM8_CCR1 TIM_CCR1(TIM8)
+#define TIM8_CCR2 TIM_CCR2(TIM8)
+#define TIM8_CCR3 TIM_CCR3(TIM8)
+#define TIM8_CCR4 TIM_CCR4(TIM8)
+
+#define TIM_CR1_CEN (1 << 0)
+#define TIM_CR1_UDIS (1 << 1)
+#define TIM_CR1_ARPE (1 << 7)
+#define TIM_CR1_CKD_CK_INT (0x0 << 8)
+#define TIM_CR1_CMS_EDGE (0x0 << 5)
+#define TIM_CR1_DIR_UP (0 << 4)
+#define TIM_CR1_DIR_DOWN (1 << 4)
+#define TIM_CR2_MMS_UPDATE (0x2 << 4)
+#define TIM_DIER_UIE (1 << 0)
+#define TIM_DIER_CC1IE (1 << 1)
+#define TIM_DIER_UDE (1 << 8)
+#define TIM_SR_UIF (1 << 0)
+#define TIM_EGR_UG (1 << 0)
+#define TIM_BDTR_MOE (1 << 15)
+#define TIM_CCER_CC1E (1 << 0)
+
+enum tim_oc_id {
+	TIM_OC1 = 0,
+	TIM_OC1N,
+	TIM_OC2,
+	TIM_OC2N,
+	TIM_OC3,
+	TIM_OC3N,
+	TIM_OC4,
+};
+
+enum tim_oc_mode {
+	TIM_OCM_FROZEN,
+	TIM_OCM_ACTIVE,
+	TIM_OCM_INACTIVE,
+	TIM_OCM_TOGGLE,
+	TIM_OCM_FORCE_LOW,
+	TIM_OCM_FORCE_HIGH,
+	TIM_OCM_PWM1,
+	TIM_OCM_PWM2,
+};
+
+enum tim_ic_id {
+	TIM_IC1,
+	TIM_IC2,
+	TIM_IC3,
+	TIM_IC4,
+};
+
+enum tim_ic_input {
+	TIM_IC_OUT = 0,
+	TIM_IC_IN_TI1 = 1,
+	TIM_IC_IN_TI2 = 2,
+	TIM_IC_IN_TRC = 3,
+	TIM_IC_IN_TI3 = 5,
+	TIM_IC_IN_TI4 = 6,
+};
+
+void timer_set_mode(uint32_t timer_peripheral, uint32_t clock_div,
+		    uint32_t alignment, uint32_t direction);
+void timer_set_prescaler(uint32_t timer_peripheral, uint32_t value);
+void timer_set_repetition_counter(uint32_t timer_peripheral, uint32_t value);
+void timer_set_period(uint32_t timer_peripheral, uint32_t period);
+void timer_enable_preload(uint32_t timer_peripheral);
+void timer_disable_preload(uint32_t timer_peripheral);
+void timer_continuous_mode(uint32_t timer_peripheral);
+void timer_enable_counter(uint32_t timer_peripheral);
+void timer_disable_counter(uint32_t timer_peripheral);
+void timer_enable_update_event(uint32_t timer_peripheral);
+void timer_disable_update_event(uint32_t timer_peripheral);
+void timer_generate_event(uint32_t timer_peripheral, uint32_t event);
+void timer_enable_irq(uint32_t timer_peripheral, uint32_t irq);
+void timer_disable_irq(uint32_t timer_peripheral, uint32_t irq);
+void timer_set_master_mode(uint32_t timer_peripheral, uint32_t mode);
+void timer_set_oc_mode(uint32_t timer_peripheral, enum tim_oc_id oc_id,
+		       enum tim_oc_mode oc_mode);
+void timer_enable_oc_preload(uint32_t timer_peripheral, enum tim_oc_id oc_id);
+void timer_set_oc_value(uint32_t timer_peripheral, enum tim_oc_id oc_id,
+			uint32_t value);
+void timer_enable_oc_output(uint32_t timer_peripheral, enum tim_oc_id oc_id);
+void timer_disable_oc_output(uint32_t timer_peripheral, enum tim_oc_id oc_id);
+void timer_enable_break_main_output(uint32_t timer_peripheral);
+void timer_slave_set_mode(uint32_t timer_peripheral, uint8_t mode);
+void timer_ic_set_input(uint32_t timer_peripheral, enum tim_ic_id ic,
+			enum tim_ic_input in);
+uint32_t timer_get_counter(uint32_t timer_peripheral);
+void timer_set_counter(uint32_t timer_peripheral, uint32_t count);
+
+#endif /* __SIM_STM32_TIMER_H */
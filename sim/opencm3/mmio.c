@@ -0,0 +1,41 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <libopencm3/cm3/common.h>
+
+#include "peripherals.h"
+
+#define FLASH_BASE 0x08000000
+#define FLASH_SIZE (1024 * 1024)
+#define PERIPH_BASE 0x40000000
+#define PERIPH_SIZE 0x00080000
+
+static uint8_t flash[FLASH_SIZE];
+static uint32_t peripherals[PERIPH_SIZE / sizeof(uint32_t)];
+static bool flash_initialized;
+
+/**
+ * @brief Translate a target address into a host address.
+ *
+ * Flash and peripheral ranges are backed by host buffers. Any other address
+ * is a host pointer (RAM), which is valid because the simulator is linked
+ * without PIE.
+ */
+void *sim_address(uint32_t address)
+{
+	if (address >= FLASH_BASE && address < FLASH_BASE + FLASH_SIZE) {
+		if (!flash_initialized) {
+			memset(flash, 0xFF, sizeof(flash));
+			flash_initialized = true;
+		}
+		return &flash[address - FLASH_BASE];
+	}
+	if (address >= PERIPH_BASE && address < PERIPH_BASE + PERIPH_SIZE)
+		return (uint8_t *)peripherals + (address - PERIPH_BASE);
+	return (void *)(uintptr_t)address;
+}
+
+volatile uint32_t *sim_mmio32(uint32_t address)
+{
+	return (volatile uint32_t *)sim_address(address);
+}
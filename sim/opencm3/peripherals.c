@@ -0,0 +1,12 @@
+#include "peripherals.h"
+
+/**
+ * @brief Advance the autonomous peripherals for the elapsed time.
+ */
+void sim_peripherals_step(uint32_t microseconds)
+{
+	sim_timer_step(microseconds);
+	sim_adc_step(microseconds);
+	sim_spi_step();
+	sim_usart_step(microseconds);
+}
@@ -0,0 +1,38 @@
+#ifndef __SIM_PERIPHERALS_H
+#define __SIM_PERIPHERALS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Interface between the simulated libopencm3 peripherals and the rest of the
+ * simulator. The firmware never includes this header.
+ */
+
+/* Implemented by the simulated peripherals */
+void *sim_address(uint32_t address);
+void sim_peripherals_step(uint32_t microseconds);
+void sim_irq_raise(uint8_t irqn);
+void sim_irq_dispatch(uint8_t irqn);
+void sim_systick_raise(void);
+uint32_t sim_systick_frequency(void);
+bool sim_dma_read_peripheral(uint32_t peripheral_address, uint32_t *value);
+bool sim_dma_write_peripheral(uint32_t peripheral_address, uint32_t value);
+void sim_adc_step(uint32_t microseconds);
+void sim_adc_trigger(uint32_t source);
+void sim_usart_step(uint32_t microseconds);
+void sim_spi_step(void);
+void sim_gpio_dma_bsrr(uint32_t gpioport);
+void sim_timer_step(uint32_t microseconds);
+
+/* Implemented by the board (device models wired to the peripherals) */
+uint16_t sim_board_adc_convert(uint32_t adc, uint8_t channel);
+uint8_t sim_board_spi_exchange(uint32_t spi, uint8_t data);
+void sim_board_gpio_write(uint32_t port, uint16_t odr);
+void sim_board_timer_update_dma(uint32_t timer);
+void sim_board_usart_transmit(uint32_t usart, uint8_t data);
+bool sim_board_usart_receive(uint32_t usart, uint8_t *data);
+void sim_board_wait_for_interrupt(void);
+void sim_board_systick(void);
+
+#endif /* __SIM_PERIPHERALS_H */
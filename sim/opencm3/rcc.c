@@ -0,0 +1,176 @@
+#include <libopencm3/stm32/flash.h>
+#include <libopencm3/stm32/pwr.h>
+#include <libopencm3/stm32/rcc.h>
+
+#include "peripherals.h"
+
+#define FLASH_BASE 0x08000000
+
+uint32_t rcc_ahb_frequency = 16000000;
+uint32_t rcc_apb1_frequency = 16000000;
+uint32_t rcc_apb2_frequency = 16000000;
+
+const struct rcc_clock_scale rcc_hse_16mhz_3v3[RCC_CLOCK_3V3_END] = {
+    [RCC_CLOCK_3V3_168MHZ] =
+	{
+	    .pllm = 16,
+	    .plln = 336,
+	    .pllp = 2,
+	    .pllq = 7,
+	    .pllr = 0,
+	    .flash_config = FLASH_ACR_DCEN | FLASH_ACR_ICEN |
+			    FLASH_ACR_LATENCY_5WS,
+	    .voltage_scale = PWR_SCALE1,
+	    .ahb_frequency = 168000000,
+	    .apb1_frequency = 42000000,
+	    .apb2_frequency = 84000000,
+	},
+};
+
+/* Start address and size (in KiB) of each STM32F405 flash sector */
+static const uint32_t sector_address[12] = {
+    0x08000000, 0x08004000, 0x08008000, 0x0800C000, 0x08010000, 0x08020000,
+    0x08040000, 0x08060000, 0x08080000, 0x080A0000, 0x080C0000, 0x080E0000,
+};
+static const uint32_t sector_size[12] = {16, 16, 16, 16, 64, 128,
+					 128, 128, 128, 128, 128, 128};
+
+static bool flash_locked = true;
+
+void rcc_periph_clock_enable(enum rcc_periph_clken clken)
+{
+	(void)clken;
+}
+
+void rcc_peripheral_enable_clock(volatile uint32_t *reg, uint32_t en)
+{
+	*reg |= en;
+}
+
+void rcc_osc_on(enum rcc_osc osc)
+{
+	(void)osc;
+}
+
+void rcc_osc_off(enum rcc_osc osc)
+{
+	(void)osc;
+}
+
+void rcc_wait_for_osc_ready(enum rcc_osc osc)
+{
+	(void)osc;
+}
+
+void rcc_wait_for_sysclk_status(enum rcc_osc osc)
+{
+	(void)osc;
+}
+
+void rcc_set_sysclk_source(uint32_t clk)
+{
+	(void)clk;
+}
+
+void rcc_set_hpre(uint32_t hpre)
+{
+	(void)hpre;
+}
+
+void rcc_set_ppre1(uint32_t ppre1)
+{
+	(void)ppre1;
+}
+
+void rcc_set_ppre2(uint32_t ppre2)
+{
+	(void)ppre2;
+}
+
+void rcc_set_main_pll_hsi(uint32_t pllm, uint32_t plln, uint32_t pllp,
+			  uint32_t pllq, uint32_t pllr)
+{
+	(void)pllm;
+	(void)plln;
+	(void)pllp;
+	(void)pllq;
+	(void)pllr;
+}
+
+void pwr_set_vos_scale(enum pwr_vos_scale scale)
+{
+	(void)scale;
+}
+
+void flash_dcache_enable(void)
+{
+}
+
+void flash_dcache_disable(void)
+{
+}
+
+void flash_dcache_reset(void)
+{
+}
+
+void flash_icache_enable(void)
+{
+}
+
+void flash_icache_disable(void)
+{
+}
+
+void flash_set_ws(uint32_t ws)
+{
+	(void)ws;
+}
+
+void flash_unlock(void)
+{
+	flash_locked = false;
+}
+
+void flash_lock(void)
+{
+	flash_locked = true;
+}
+
+uint32_t flash_get_status_flags(void)
+{
+	return 0;
+}
+
+void flash_erase_sector(uint8_t sector, uint32_t program_size)
+{
+	uint8_t *start;
+	uint32_t i;
+
+	(void)program_size;
+	if (flash_locked || sector >= 12)
+		return;
+	start = sim_address(sector_address[sector]);
+	for (i = 0; i < sector_size[sector] * 1024; i++)
+		start[i] = 0xFF;
+}
+
+/**
+ * @brief Program flash: bits can only be cleared, as in real NOR flash.
+ */
+void flash_program(uint32_t address, const uint8_t *data, uint32_t len)
+{
+	uint8_t *target;
+	uint32_t i;
+
+	if (flash_locked || address < FLASH_BASE)
+		return;
+	target = sim_address(address);
+	for (i = 0; i < len; i++)
+		target[i] &= data[i];
+}
+
+void flash_program_word(uint32_t address, uint32_t data)
+{
+	flash_program(address, (const uint8_t *)&data, sizeof(data));
+}
@@ -0,0 +1,99 @@
+#include <libopencm3/stm32/spi.h>
+
+#include "peripherals.h"
+
+/* Received data is kept apart from DR, which holds the last written byte */
+static uint16_t received;
+
+void spi_reset(uint32_t spi_peripheral)
+{
+	SPI_CR1(spi_peripheral) = 0;
+	SPI_CR2(spi_peripheral) = 0;
+	SPI_SR(spi_peripheral) = SPI_SR_TXE;
+}
+
+int spi_init_master(uint32_t spi, uint32_t br, uint32_t cpol, uint32_t cpha,
+		    uint32_t dff, uint32_t lsbfirst)
+{
+	SPI_CR1(spi) = br | cpol | cpha | dff | lsbfirst;
+	return 0;
+}
+
+void spi_enable(uint32_t spi)
+{
+	SPI_CR1(spi) |= SPI_CR1_SPE;
+}
+
+void spi_disable(uint32_t spi)
+{
+	SPI_CR1(spi) &= ~SPI_CR1_SPE;
+}
+
+void spi_enable_software_slave_management(uint32_t spi)
+{
+	(void)spi;
+}
+
+void spi_set_nss_high(uint32_t spi)
+{
+	(void)spi;
+}
+
+void spi_send(uint32_t spi, uint16_t data)
+{
+	SPI_DR(spi) = data;
+	received = sim_board_spi_exchange(spi, (uint8_t)data);
+	SPI_SR(spi) |= SPI_SR_RXNE | SPI_SR_TXE;
+}
+
+uint16_t spi_read(uint32_t spi)
+{
+	SPI_SR(spi) &= ~SPI_SR_RXNE;
+	return received;
+}
+
+uint16_t spi_xfer(uint32_t spi, uint16_t data)
+{
+	spi_send(spi, data);
+	return spi_read(spi);
+}
+
+void spi_enable_rx_dma(uint32_t spi)
+{
+	SPI_CR2(spi) |= SPI_CR2_RXDMAEN;
+}
+
+void spi_disable_rx_dma(uint32_t spi)
+{
+	SPI_CR2(spi) &= ~SPI_CR2_RXDMAEN;
+}
+
+void spi_enable_tx_dma(uint32_t spi)
+{
+	SPI_CR2(spi) |= SPI_CR2_TXDMAEN;
+}
+
+void spi_disable_tx_dma(uint32_t spi)
+{
+	SPI_CR2(spi) &= ~SPI_CR2_TXDMAEN;
+}
+
+/**
+ * @brief Run full-duplex DMA transfers on SPI3.
+ *
+ * Each data item is fetched from the TX stream, exchanged with the device
+ * and stored through the RX stream.
+ */
+void sim_spi_step(void)
+{
+	uint32_t address = (uint32_t)(uintptr_t)&SPI_DR(SPI3);
+	uint32_t value;
+
+	if ((SPI_CR2(SPI3) & (SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN)) !=
+	    (SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN))
+		return;
+	while (sim_dma_read_peripheral(address, &value)) {
+		received = sim_board_spi_exchange(SPI3, (uint8_t)value);
+		sim_dma_write_peripheral(address, received);
+	}
+}
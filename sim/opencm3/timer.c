@@ -0,0 +1,260 @@
+#include <libopencm3/stm32/adc.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/timer.h>
+
+#include "peripherals.h"
+
+/* Counting timers, with the ADC trigger source of their channel 1 */
+static const struct {
+	uint32_t timer;
+	uint32_t cc1_trigger;
+} counting_timers[] = {
+    {TIM1, ADC_CR2_EXTSEL_TIM1_CC1},
+    {TIM8, ADC_CR2_EXTSEL_TIM8_CC1},
+};
+
+#define COUNTING_TIMERS (sizeof(counting_timers) / sizeof(counting_timers[0]))
+
+/* Timer clock cycles not yet accounted by the prescaler */
+static uint32_t prescaler_cycles[COUNTING_TIMERS];
+
+static volatile uint32_t *ccr(uint32_t timer_peripheral, enum tim_oc_id oc_id)
+{
+	switch (oc_id) {
+	case TIM_OC1:
+	case TIM_OC1N:
+		return &TIM_CCR1(timer_peripheral);
+	case TIM_OC2:
+	case TIM_OC2N:
+		return &TIM_CCR2(timer_peripheral);
+	case TIM_OC3:
+	case TIM_OC3N:
+		return &TIM_CCR3(timer_peripheral);
+	default:
+		return &TIM_CCR4(timer_peripheral);
+	}
+}
+
+static uint32_t ccer_bit(enum tim_oc_id oc_id)
+{
+	return 1 << (2 * oc_id);
+}
+
+void timer_set_mode(uint32_t timer_peripheral, uint32_t clock_div,
+		    uint32_t alignment, uint32_t direction)
+{
+	TIM_CR1(timer_peripheral) &= ~(0x3FF << 4);
+	TIM_CR1(timer_peripheral) |= clock_div | alignment | direction;
+}
+
+void timer_set_prescaler(uint32_t timer_peripheral, uint32_t value)
+{
+	TIM_PSC(timer_peripheral) = value;
+}
+
+void timer_set_repetition_counter(uint32_t timer_peripheral, uint32_t value)
+{
+	TIM_RCR(timer_peripheral) = value;
+}
+
+void timer_set_period(uint32_t timer_peripheral, uint32_t period)
+{
+	TIM_ARR(timer_peripheral) = period;
+}
+
+void timer_enable_preload(uint32_t timer_peripheral)
+{
+	TIM_CR1(timer_peripheral) |= TIM_CR1_ARPE;
+}
+
+void timer_disable_preload(uint32_t timer_peripheral)
+{
+	TIM_CR1(timer_peripheral) &= ~TIM_CR1_ARPE;
+}
+
+void timer_continuous_mode(uint32_t timer_peripheral)
+{
+	(void)timer_peripheral;
+}
+
+void timer_enable_counter(uint32_t timer_peripheral)
+{
+	TIM_CR1(timer_peripheral) |= TIM_CR1_CEN;
+}
+
+void timer_disable_counter(uint32_t timer_peripheral)
+{
+	TIM_CR1(timer_peripheral) &= ~TIM_CR1_CEN;
+}
+
+void timer_enable_update_event(uint32_t timer_peripheral)
+{
+	TIM_CR1(timer_peripheral) &= ~TIM_CR1_UDIS;
+}
+
+void timer_disable_update_event(uint32_t timer_peripheral)
+{
+	TIM_CR1(timer_peripheral) |= TIM_CR1_UDIS;
+}
+
+/**
+ * @brief Update event: request a DMA transfer, if enabled.
+ */
+static void update_event(uint32_t timer_peripheral)
+{
+	if (TIM_CR1(timer_peripheral) & TIM_CR1_UDIS)
+		return;
+	TIM_SR(timer_peripheral) |= TIM_SR_UIF;
+	if (TIM_DIER(timer_peripheral) & TIM_DIER_UDE)
+		sim_board_timer_update_dma(timer_peripheral);
+}
+
+/**
+ * @brief Only the update generation (UG) is simulated.
+ */
+void timer_generate_event(uint32_t timer_peripheral, uint32_t event)
+{
+	if (!(event & TIM_EGR_UG))
+		return;
+	TIM_CNT(timer_peripheral) = 0;
+	update_event(timer_peripheral);
+}
+
+void timer_enable_irq(uint32_t timer_peripheral, uint32_t irq)
+{
+	TIM_DIER(timer_peripheral) |= irq;
+}
+
+void timer_disable_irq(uint32_t timer_peripheral, uint32_t irq)
+{
+	TIM_DIER(timer_peripheral) &= ~irq;
+}
+
+void timer_set_master_mode(uint32_t timer_peripheral, uint32_t mode)
+{
+	TIM_CR2(timer_peripheral) = mode;
+}
+
+void timer_set_oc_mode(uint32_t timer_peripheral, enum tim_oc_id oc_id,
+		       enum tim_oc_mode oc_mode)
+{
+	(void)timer_peripheral;
+	(void)oc_id;
+	(void)oc_mode;
+}
+
+void timer_enable_oc_preload(uint32_t timer_peripheral, enum tim_oc_id oc_id)
+{
+	(void)timer_peripheral;
+	(void)oc_id;
+}
+
+void timer_set_oc_value(uint32_t timer_peripheral, enum tim_oc_id oc_id,
+			uint32_t value)
+{
+	*ccr(timer_peripheral, oc_id) = value;
+}
+
+void timer_enable_oc_output(uint32_t timer_peripheral, enum tim_oc_id oc_id)
+{
+	TIM_CCER(timer_peripheral) |= ccer_bit(oc_id);
+}
+
+void timer_disable_oc_output(uint32_t timer_peripheral, enum tim_oc_id oc_id)
+{
+	TIM_CCER(timer_peripheral) &= ~ccer_bit(oc_id);
+}
+
+void timer_enable_break_main_output(uint32_t timer_peripheral)
+{
+	TIM_BDTR(timer_peripheral) |= TIM_BDTR_MOE;
+}
+
+void timer_slave_set_mode(uint32_t timer_peripheral, uint8_t mode)
+{
+	TIM_SMCR(timer_peripheral) = mode;
+}
+
+void timer_ic_set_input(uint32_t timer_peripheral, enum tim_ic_id ic,
+			enum tim_ic_input in)
+{
+	(void)timer_peripheral;
+	(void)ic;
+	(void)in;
+}
+
+uint32_t timer_get_counter(uint32_t timer_peripheral)
+{
+	return TIM_CNT(timer_peripheral);
+}
+
+void timer_set_counter(uint32_t timer_peripheral, uint32_t count)
+{
+	TIM_CNT(timer_peripheral) = count;
+}
+
+/**
+ * @brief Channel 1 compare event: trigger the ADC conversions, if enabled.
+ */
+static void compare_event(uint8_t index)
+{
+	if (!(TIM_CCER(counting_timers[index].timer) & TIM_CCER_CC1E))
+		return;
+	sim_adc_trigger(counting_timers[index].cc1_trigger);
+}
+
+/**
+ * @brief Count up, serving the compare and update events in order.
+ */
+static void count(uint8_t index, uint32_t ticks)
+{
+	uint32_t timer = counting_timers[index].timer;
+	uint32_t counter = TIM_CNT(timer);
+	uint32_t compare = TIM_CCR1(timer);
+	uint32_t period = TIM_ARR(timer);
+
+	while (ticks) {
+		if (counter < compare && compare <= period &&
+		    compare - counter <= ticks) {
+			ticks -= compare - counter;
+			counter = compare;
+			compare_event(index);
+			continue;
+		}
+		if (period - counter < ticks) {
+			ticks -= period - counter + 1;
+			counter = 0;
+			update_event(timer);
+			if (!compare)
+				compare_event(index);
+			continue;
+		}
+		counter += ticks;
+		ticks = 0;
+	}
+	TIM_CNT(timer) = counter;
+}
+
+/**
+ * @brief Advance the up-counting timers (TIM1 and TIM8).
+ *
+ * Both are APB2 timers, clocked at twice the APB2 frequency. Encoder timers
+ * are driven by the robot model.
+ */
+void sim_timer_step(uint32_t microseconds)
+{
+	uint32_t timer;
+	uint32_t prescaler;
+	uint8_t i;
+
+	for (i = 0; i < COUNTING_TIMERS; i++) {
+		timer = counting_timers[i].timer;
+		if (!(TIM_CR1(timer) & TIM_CR1_CEN))
+			continue;
+		prescaler = TIM_PSC(timer) + 1;
+		prescaler_cycles[i] +=
+		    microseconds * (2 * rcc_apb2_frequency / 1000000);
+		count(i, prescaler_cycles[i] / prescaler);
+		prescaler_cycles[i] %= prescaler;
+	}
+}
@@ -0,0 +1,161 @@
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/usart.h>
+
+#include "peripherals.h"
+
+/* Fraction of a character accumulated between steps (in bits) */
+static uint32_t pending_bits;
+static uint32_t rx_pending_bits;
+
+/* Whether a character was received since the last idle line */
+static bool rx_busy;
+
+void usart_set_baudrate(uint32_t usart, uint32_t baud)
+{
+	USART_BRR(usart) = (rcc_apb2_frequency + baud / 2) / baud;
+}
+
+void usart_set_databits(uint32_t usart, uint32_t bits)
+{
+	(void)usart;
+	(void)bits;
+}
+
+void usart_set_stopbits(uint32_t usart, uint32_t stopbits)
+{
+	USART_CR2(usart) = stopbits;
+}
+
+void usart_set_parity(uint32_t usart, uint32_t parity)
+{
+	(void)usart;
+	(void)parity;
+}
+
+void usart_set_mode(uint32_t usart, uint32_t mode)
+{
+	USART_CR1(usart) &= ~(USART_CR1_RE | USART_CR1_TE);
+	USART_CR1(usart) |= mode;
+}
+
+void usart_set_flow_control(uint32_t usart, uint32_t flowcontrol)
+{
+	(void)usart;
+	(void)flowcontrol;
+}
+
+void usart_enable(uint32_t usart)
+{
+	USART_CR1(usart) |= USART_CR1_UE;
+	USART_SR(usart) |= USART_SR_TXE | USART_SR_TC;
+}
+
+void usart_disable(uint32_t usart)
+{
+	USART_CR1(usart) &= ~USART_CR1_UE;
+}
+
+void usart_enable_tx_dma(uint32_t usart)
+{
+	USART_CR3(usart) |= USART_CR3_DMAT;
+}
+
+void usart_disable_tx_dma(uint32_t usart)
+{
+	USART_CR3(usart) &= ~USART_CR3_DMAT;
+}
+
+void usart_enable_rx_dma(uint32_t usart)
+{
+	USART_CR3(usart) |= USART_CR3_DMAR;
+}
+
+void usart_disable_rx_dma(uint32_t usart)
+{
+	USART_CR3(usart) &= ~USART_CR3_DMAR;
+}
+
+/**
+ * @brief Read the data register.
+ *
+ * Reading the data register after the status register also clears the idle
+ * line flag.
+ */
+uint32_t usart_recv(uint32_t usart)
+{
+	USART_SR(usart) &= ~(USART_SR_RXNE | USART_SR_IDLE | USART_SR_ORE);
+	return USART_DR(usart);
+}
+
+/**
+ * @brief Receive as many characters as the baud rate allows.
+ *
+ * Characters are stored by DMA, if enabled, or in the data register. A
+ * whole character time without data after receiving sets the idle line
+ * flag (and raises the interruption, if enabled).
+ */
+static void receive(uint32_t bits)
+{
+	uint32_t enabled = USART_CR1_UE | USART_CR1_RE;
+	uint8_t data;
+
+	if ((USART_CR1(USART1) & enabled) != enabled)
+		return;
+	rx_pending_bits += bits;
+	while (rx_pending_bits >= 10) {
+		rx_pending_bits -= 10;
+		if (!sim_board_usart_receive(USART1, &data)) {
+			rx_pending_bits = 0;
+			if (!rx_busy)
+				break;
+			rx_busy = false;
+			USART_SR(USART1) |= USART_SR_IDLE;
+			if (USART_CR1(USART1) & USART_CR1_IDLEIE)
+				sim_irq_raise(NVIC_USART1_IRQ);
+			break;
+		}
+		rx_busy = true;
+		if ((USART_CR3(USART1) & USART_CR3_DMAR) &&
+		    sim_dma_write_peripheral(
+			(uint32_t)(uintptr_t)&USART_DR(USART1), data))
+			continue;
+		if (USART_SR(USART1) & USART_SR_RXNE)
+			USART_SR(USART1) |= USART_SR_ORE;
+		USART_DR(USART1) = data;
+		USART_SR(USART1) |= USART_SR_RXNE;
+	}
+}
+
+/**
+ * @brief Transmit and receive as many characters as the baud rate allows.
+ *
+ * Characters are 10 bits long (start, 8 data bits and stop).
+ */
+void sim_usart_step(uint32_t microseconds)
+{
+	uint32_t value;
+	uint32_t baud;
+	uint32_t bits;
+	uint32_t enabled = USART_CR1_UE | USART_CR1_TE;
+
+	if (!USART_BRR(USART1))
+		return;
+	baud = rcc_apb2_frequency / USART_BRR(USART1);
+	bits = baud / 1000 * microseconds / 1000;
+	receive(bits);
+	if ((USART_CR1(USART1) & enabled) != enabled)
+		return;
+	pending_bits += bits;
+	while (pending_bits >= 10) {
+		if (!(USART_CR3(USART1) & USART_CR3_DMAT))
+			break;
+		if (!sim_dma_read_peripheral(
+			(uint32_t)(uintptr_t)&USART_DR(USART1), &value))
+			break;
+		pending_bits -= 10;
+		sim_board_usart_transmit(USART1, (uint8_t)value);
+	}
+	if (pending_bits >= 10)
+		pending_bits = 0;
+}
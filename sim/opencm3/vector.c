@@ -0,0 +1,69 @@
+#include <libopencm3/cm3/nvic.h>
+
+#include "peripherals.h"
+
+/*
+ * CCM data boundaries (defined in the firmware linker script). The host has
+ * no CCM: the range is empty, as `.ccm` data is zeroed by the loader.
+ */
+uint32_t _ccm;
+extern uint32_t _eccm __attribute__((alias("_ccm")));
+
+/**
+ * @brief Default handler for interruptions not used by the firmware.
+ */
+static void null_handler(void)
+{
+}
+
+#pragma weak sys_tick_handler = null_handler
+#pragma weak adc_isr = null_handler
+#pragma weak tim1_up_tim10_isr = null_handler
+#pragma weak usart1_isr = null_handler
+#pragma weak dma1_stream0_isr = null_handler
+#pragma weak dma1_stream1_isr = null_handler
+#pragma weak dma1_stream2_isr = null_handler
+#pragma weak dma1_stream3_isr = null_handler
+#pragma weak dma1_stream4_isr = null_handler
+#pragma weak dma1_stream5_isr = null_handler
+#pragma weak dma1_stream6_isr = null_handler
+#pragma weak dma1_stream7_isr = null_handler
+#pragma weak dma2_stream0_isr = null_handler
+#pragma weak dma2_stream1_isr = null_handler
+#pragma weak dma2_stream2_isr = null_handler
+#pragma weak dma2_stream3_isr = null_handler
+#pragma weak dma2_stream4_isr = null_handler
+#pragma weak dma2_stream5_isr = null_handler
+#pragma weak dma2_stream6_isr = null_handler
+#pragma weak dma2_stream7_isr = null_handler
+
+static void (*const vector_table[NVIC_IRQ_COUNT])(void) = {
+    [NVIC_ADC_IRQ] = adc_isr,
+    [NVIC_TIM1_UP_TIM10_IRQ] = tim1_up_tim10_isr,
+    [NVIC_USART1_IRQ] = usart1_isr,
+    [NVIC_DMA1_STREAM0_IRQ] = dma1_stream0_isr,
+    [NVIC_DMA1_STREAM1_IRQ] = dma1_stream1_isr,
+    [NVIC_DMA1_STREAM2_IRQ] = dma1_stream2_isr,
+    [NVIC_DMA1_STREAM3_IRQ] = dma1_stream3_isr,
+    [NVIC_DMA1_STREAM4_IRQ] = dma1_stream4_isr,
+    [NVIC_DMA1_STREAM5_IRQ] = dma1_stream5_isr,
+    [NVIC_DMA1_STREAM6_IRQ] = dma1_stream6_isr,
+    [NVIC_DMA1_STREAM7_IRQ] = dma1_stream7_isr,
+    [NVIC_DMA2_STREAM0_IRQ] = dma2_stream0_isr,
+    [NVIC_DMA2_STREAM1_IRQ] = dma2_stream1_isr,
+    [NVIC_DMA2_STREAM2_IRQ] = dma2_stream2_isr,
+    [NVIC_DMA2_STREAM3_IRQ] = dma2_stream3_isr,
+    [NVIC_DMA2_STREAM4_IRQ] = dma2_stream4_isr,
+    [NVIC_DMA2_STREAM5_IRQ] = dma2_stream5_isr,
+    [NVIC_DMA2_STREAM6_IRQ] = dma2_stream6_isr,
+    [NVIC_DMA2_STREAM7_IRQ] = dma2_stream7_isr,
+};
+
+/**
+ * @brief Execute the handler registered for an interruption.
+ */
+void sim_irq_dispatch(uint8_t irqn)
+{
+	if (vector_table[irqn])
+		vector_table[irqn]();
+}
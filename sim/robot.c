@@ -0,0 +1,132 @@
+#include <math.h>
+
+#include <libopencm3/stm32/timer.h>
+
+#include "robot.h"
+
+const struct robot_parameters robot_default_parameters = {
+    .battery_voltage = 8.0,
+    .battery_resistance = 0.15,
+    .motor_resistance = 3.4,
+    .motor_constant = 0.0041,
+    .motor_friction = 1e-7,
+    .rotor_inertia = 1e-7,
+    .gear_ratio = 4.,
+    .wheel_radius = 0.0125,
+    .wheels_separation = 0.07,
+    .mass = 0.1,
+    .encoder_counts_per_revolution = 2048.,
+};
+
+static struct robot_parameters parameters;
+static struct robot_state state;
+
+/**
+ * @brief Set the physical parameters and reset the robot state.
+ */
+void robot_configure(const struct robot_parameters *new_parameters)
+{
+	parameters = *new_parameters;
+	robot_reset();
+}
+
+void robot_reset(void)
+{
+	struct robot_state initial = {0};
+
+	initial.battery_voltage = parameters.battery_voltage;
+	state = initial;
+}
+
+const struct robot_state *robot_get_state(void)
+{
+	return &state;
+}
+
+/**
+ * @brief Duty cycle applied to a motor from its pair of TIM8 channels.
+ *
+ * A pair of compare values set to zero leaves the bridge floating (coast),
+ * which is signaled returning NAN.
+ */
+static double bridge_duty(uint32_t in1, uint32_t in2)
+{
+	uint32_t period = TIM_ARR(TIM8);
+
+	if (!period || !(TIM_CR1(TIM8) & TIM_CR1_CEN))
+		return NAN;
+	if (!(TIM_BDTR(TIM8) & TIM_BDTR_MOE))
+		return NAN;
+	if (in1 == 0 && in2 == 0)
+		return NAN;
+	return ((double)in1 - (double)in2) / period;
+}
+
+/**
+ * @brief Integrate the electrical and mechanical motor equations.
+ */
+static void motor_step(int motor, double duty, double dt)
+{
+	double inertia;
+	double voltage;
+	double current;
+	double torque;
+	double *speed = &state.motor_speed[motor];
+
+	inertia = parameters.rotor_inertia +
+		  parameters.mass / 2. * parameters.wheel_radius *
+		      parameters.wheel_radius /
+		      (parameters.gear_ratio * parameters.gear_ratio);
+	if (isnan(duty)) {
+		current = 0.;
+		voltage = 0.;
+	} else {
+		voltage = duty * state.battery_voltage;
+		current = (voltage - parameters.motor_constant * *speed) /
+			  parameters.motor_resistance;
+	}
+	torque = parameters.motor_constant * current -
+		 parameters.motor_friction * *speed;
+	*speed += torque / inertia * dt;
+	state.motor_current[motor] = current;
+	if (voltage * current > 0.)
+		state.energy += voltage * current * dt;
+	state.encoder_counts[motor] += *speed * dt *
+				       parameters.encoder_counts_per_revolution /
+				       (2. * M_PI);
+}
+
+/**
+ * @brief Advance the robot model.
+ *
+ * Motor voltages are read from the TIM8 compare registers and the encoder
+ * counters (TIM3 and TIM4) are updated with the resulting wheel rotation.
+ */
+void robot_step(double dt)
+{
+	double left;
+	double right;
+	double wheel_factor;
+
+	motor_step(ROBOT_LEFT, bridge_duty(TIM_CCR3(TIM8), TIM_CCR4(TIM8)), dt);
+	motor_step(ROBOT_RIGHT, bridge_duty(TIM_CCR1(TIM8), TIM_CCR2(TIM8)),
+		   dt);
+	state.battery_voltage =
+	    parameters.battery_voltage -
+	    parameters.battery_resistance * (fabs(state.motor_current[0]) +
+					     fabs(state.motor_current[1]));
+
+	wheel_factor = parameters.wheel_radius / parameters.gear_ratio;
+	left = state.motor_speed[ROBOT_LEFT] * wheel_factor;
+	right = state.motor_speed[ROBOT_RIGHT] * wheel_factor;
+	state.linear_speed = (left + right) / 2.;
+	state.angular_speed = (right - left) / parameters.wheels_separation;
+	state.x += state.linear_speed * cos(state.theta) * dt;
+	state.y += state.linear_speed * sin(state.theta) * dt;
+	state.theta += state.angular_speed * dt;
+
+	TIM_CNT(TIM3) = (uint16_t)(int64_t)floor(
+	    state.encoder_counts[ROBOT_LEFT]);
+	TIM_CNT(TIM4) = (uint16_t)(int64_t)floor(
+	    state.encoder_counts[ROBOT_RIGHT]);
+}
@@ -0,0 +1,49 @@
+#ifndef __SIM_ROBOT_H
+#define __SIM_ROBOT_H
+
+#include <stdint.h>
+
+/**
+ * Physical parameters of the differential-drive model.
+ *
+ * Each wheel is driven by a DC motor through a gearbox. The motor model
+ * includes the winding resistance, the back-EMF and the torque constants
+ * and the inertia reflected from the robot mass.
+ */
+struct robot_parameters {
+	double battery_voltage;
+	double battery_resistance;
+	double motor_resistance;
+	double motor_constant;
+	double motor_friction;
+	double rotor_inertia;
+	double gear_ratio;
+	double wheel_radius;
+	double wheels_separation;
+	double mass;
+	double encoder_counts_per_revolution;
+};
+
+struct robot_state {
+	double x;
+	double y;
+	double theta;
+	double linear_speed;
+	double angular_speed;
+	double motor_speed[2];
+	double motor_current[2];
+	double encoder_counts[2];
+	double battery_voltage;
+	double energy;
+};
+
+enum { ROBOT_LEFT, ROBOT_RIGHT };
+
+extern const struct robot_parameters robot_default_parameters;
+
+void robot_configure(const struct robot_parameters *parameters);
+void robot_reset(void);
+void robot_step(double dt);
+const struct robot_state *robot_get_state(void);
+
+#endif /* __SIM_ROBOT_H */
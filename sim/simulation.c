@@ -0,0 +1,212 @@
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <libopencm3/cm3/nvic.h>
+
+#include "mpu6500.h"
+#include "opencm3/peripherals.h"
+#include "robot.h"
+#include "simulation.h"
+
+#define DEFAULT_SYSTICK_FREQUENCY_HZ 1000
+#define PHYSICS_SUBSTEPS 10
+#define GYRO_Z_BIAS_DPS 0.5
+#define RADIANS_TO_DEGREES (180. / M_PI)
+
+/* Flash sectors 10 and 11, reserved for the firmware storage */
+#define FLASH_STORAGE_ADDRESS 0x080C0000
+#define FLASH_STORAGE_SIZE (256 * 1024)
+
+static struct simulation_options options;
+static uint64_t ticks;
+static uint64_t serial_bytes;
+static double simulated_time;
+static double host_start;
+static double handler_total;
+static double handler_min = INFINITY;
+static double handler_max;
+static uint64_t handler_calls;
+
+static double host_time(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Load the storage flash sectors from the image file, if any.
+ *
+ * A missing file is left as erased flash, so that it is created at the end
+ * of the first run.
+ */
+static void load_flash_image(void)
+{
+	FILE *image;
+
+	if (!options.flash_image)
+		return;
+	image = fopen(options.flash_image, "rb");
+	if (!image)
+		return;
+	if (fread(sim_address(FLASH_STORAGE_ADDRESS), 1, FLASH_STORAGE_SIZE,
+		  image) != FLASH_STORAGE_SIZE)
+		fprintf(stderr, "%s: short flash image\n", options.flash_image);
+	fclose(image);
+}
+
+static void save_flash_image(void)
+{
+	FILE *image;
+
+	if (!options.flash_image)
+		return;
+	image = fopen(options.flash_image, "wb");
+	if (!image) {
+		perror(options.flash_image);
+		return;
+	}
+	fwrite(sim_address(FLASH_STORAGE_ADDRESS), 1, FLASH_STORAGE_SIZE,
+	       image);
+	fclose(image);
+}
+
+void simulation_start(const struct simulation_options *new_options)
+{
+	options = *new_options;
+	load_flash_image();
+	robot_configure(options.robot ? options.robot
+				      : &robot_default_parameters);
+	mpu6500_reset();
+	host_start = host_time();
+}
+
+/**
+ * @brief Feed the robot motion to the inertial sensor.
+ *
+ * The gyroscope has a constant zero-rate offset, like the real sensor, which
+ * the firmware is expected to calibrate.
+ */
+static void step_sensors(uint32_t microseconds)
+{
+	const struct robot_state *state = robot_get_state();
+	double gyro[3] = {0., 0.,
+			  state->angular_speed * RADIANS_TO_DEGREES +
+			      GYRO_Z_BIAS_DPS};
+	double accel[3] = {0., 0., 1.};
+
+	mpu6500_step(microseconds, gyro, accel);
+}
+
+/**
+ * @brief Execute the SysTick handler measuring its host execution time.
+ */
+void simulation_systick(void)
+{
+	double start;
+	double elapsed;
+
+	start = host_time();
+	sys_tick_handler();
+	elapsed = host_time() - start;
+	handler_total += elapsed;
+	handler_calls++;
+	if (elapsed < handler_min)
+		handler_min = elapsed;
+	if (elapsed > handler_max)
+		handler_max = elapsed;
+}
+
+/**
+ * @brief Advance the world one SysTick period.
+ *
+ * The physics model, the inertial sensor and the autonomous peripherals
+ * (DMA, ADC, USART) run in sub-steps; then the SysTick exception is raised
+ * (and served when interruptions are not masked).
+ */
+void simulation_step(void)
+{
+	uint32_t frequency = sim_systick_frequency();
+	uint32_t period_us;
+	int i;
+
+	if (!frequency)
+		frequency = DEFAULT_SYSTICK_FREQUENCY_HZ;
+	period_us = 1000000 / frequency;
+	for (i = 0; i < PHYSICS_SUBSTEPS; i++) {
+		robot_step(period_us * 1e-6 / PHYSICS_SUBSTEPS);
+		sim_peripherals_step(period_us / PHYSICS_SUBSTEPS);
+		step_sensors(period_us / PHYSICS_SUBSTEPS);
+	}
+	simulated_time += period_us * 1e-6;
+	ticks++;
+	sim_systick_raise();
+	if (options.period_hook)
+		options.period_hook();
+	if (simulated_time >= options.duration)
+		simulation_finish();
+}
+
+void simulation_serial_output(uint8_t data)
+{
+	serial_bytes++;
+	if (options.serial_output)
+		fputc(data, options.serial_output);
+}
+
+/**
+ * @brief Get the next serial input byte, if any.
+ *
+ * The input is fed at the link baud rate once the input delay is reached.
+ */
+bool simulation_serial_input(uint8_t *data)
+{
+	int value;
+
+	if (!options.serial_input ||
+	    simulated_time < options.serial_input_delay)
+		return false;
+	value = fgetc(options.serial_input);
+	if (value == EOF)
+		return false;
+	*data = (uint8_t)value;
+	return true;
+}
+
+/**
+ * @brief Print a summary report and terminate the simulation.
+ *
+ * The report is replaced by the finish hook, if any.
+ */
+void simulation_finish(void)
+{
+	const struct robot_state *state = robot_get_state();
+	double host_elapsed = host_time() - host_start;
+
+	if (options.serial_output)
+		fflush(options.serial_output);
+	save_flash_image();
+	if (options.finish_hook) {
+		options.finish_hook();
+		exit(EXIT_SUCCESS);
+	}
+	fprintf(stderr, "simulated time: %.3f s (%llu ticks)\n",
+		simulated_time, (unsigned long long)ticks);
+	fprintf(stderr, "host time: %.3f s (%.1fx real time)\n", host_elapsed,
+		simulated_time / host_elapsed);
+	if (handler_calls)
+		fprintf(stderr,
+			"sys_tick_handler: min %.2f us, mean %.2f us, "
+			"max %.2f us\n",
+			handler_min * 1e6, handler_total / handler_calls * 1e6,
+			handler_max * 1e6);
+	fprintf(stderr, "pose: x %.4f m, y %.4f m, theta %.4f rad\n", state->x,
+		state->y, state->theta);
+	fprintf(stderr, "energy: %.3f J, battery: %.3f V\n", state->energy,
+		state->battery_voltage);
+	fprintf(stderr, "serial: %llu bytes\n",
+		(unsigned long long)serial_bytes);
+	exit(EXIT_SUCCESS);
+}
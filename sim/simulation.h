@@ -0,0 +1,43 @@
+#ifndef __SIM_SIMULATION_H
+#define __SIM_SIMULATION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "robot.h"
+
+/**
+ * Simulation options.
+ *
+ * - Simulated time to run, in seconds.
+ * - File to write the USART1 output to (optional).
+ * - File to feed the USART1 input from (optional), and simulated time to
+ *   start feeding it at, in seconds.
+ * - File backing the flash storage sectors (optional).
+ * - Robot physical parameters (optional, `robot_default_parameters` if not
+ *   set).
+ * - Function called after every SysTick period (optional), which may end
+ *   the simulation calling `simulation_finish()`.
+ * - Function called when the simulation finishes (optional), instead of
+ *   printing the report.
+ */
+struct simulation_options {
+	double duration;
+	FILE *serial_output;
+	FILE *serial_input;
+	double serial_input_delay;
+	const char *flash_image;
+	const struct robot_parameters *robot;
+	void (*period_hook)(void);
+	void (*finish_hook)(void);
+};
+
+void simulation_start(const struct simulation_options *options);
+void simulation_step(void);
+void simulation_systick(void);
+void simulation_serial_output(uint8_t data);
+bool simulation_serial_input(uint8_t *data);
+void simulation_finish(void);
+
+#endif /* __SIM_SIMULATION_H */
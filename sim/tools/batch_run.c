@@ -0,0 +1,601 @@
+/*
+ * Run batches of simulated speed runs, for parameter sweeps.
+ *
+ * Each job is a full firmware simulation (see `simulation.c`): once the
+ * gyroscope is calibrated, the maze walls are set, the fastest run is
+ * planned with the job parameters and started, and the unmodified SysTick
+ * tasks drive the TIM8 PWM outputs through the motion profiler and the
+ * speed controller, against the physics model of the motors and the
+ * TIM3/TIM4 encoders. A job ends when the robot stops after the run, when a
+ * collision is detected (the PWM output kept saturated, see
+ * `pwm_saturation()`) or after the timeout.
+ *
+ * Jobs are the cartesian product of the swept values (grid search) or
+ * random samples of the swept ranges (random search), for each maze. They
+ * are run by a pool of worker processes, one per core by default, which
+ * claim the next pending job from a shared counter, so the load stays
+ * balanced whatever each run takes. Each job runs in its own child process,
+ * from the firmware zero-initialized state: nothing mutable is shared but
+ * the counter and the result slot each job writes.
+ *
+ * The results table is written as CSV, in job order, so that batches are
+ * reproducible for a given seed whatever the number of workers. The exit
+ * status is non-zero if any job crashed.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libopencm3/cm3/cortex.h>
+
+#include "collision.h"
+#include "control.h"
+#include "gyro.h"
+#include "maze_corpus.h"
+#include "motion.h"
+#include "planner.h"
+
+#include "../robot.h"
+#include "../simulation.h"
+
+#define MAX_VALUES 32
+#define MAX_MAZES 4096
+
+/** Simulated time allowed for the startup (gyroscope calibration) */
+#define STARTUP_TIMEOUT 2.
+
+/** Speeds below which the robot is considered stopped after the run */
+#define STOPPED_LINEAR_SPEED 0.001
+#define STOPPED_ANGULAR_SPEED 0.01
+
+#define MICROS 1e-6
+
+enum parameter {
+	MAX_SPEED,
+	MAX_DIAGONAL_SPEED,
+	ACCELERATION,
+	LATERAL_ACCELERATION,
+	DIAGONALS,
+	S_CURVE,
+	FEEDFORWARD,
+	LINEAR_KP,
+	LINEAR_KI,
+	ANGULAR_KP,
+	ANGULAR_KI,
+	BATTERY_VOLTAGE,
+	PARAMETERS_COUNT,
+};
+
+static const char *const parameter_names[PARAMETERS_COUNT] = {
+    "max_speed",  "max_diagonal_speed", "acceleration",
+    "lateral_acceleration", "diagonals", "s_curve",
+    "feedforward", "linear_kp", "linear_ki",
+    "angular_kp", "angular_ki", "battery_voltage",
+};
+
+/**
+ * Values of a swept parameter: a list (grid and random search) or a range
+ * (random search only) from `values[0]` to `values[1]`.
+ */
+struct sweep {
+	float values[MAX_VALUES];
+	uint8_t count;
+	bool range;
+};
+
+enum job_status {
+	JOB_PENDING,
+	JOB_COMPLETED,
+	JOB_COLLISION,
+	JOB_TIMEOUT,
+	JOB_NO_PLAN,
+	JOB_CRASHED,
+};
+
+static const char *const status_names[] = {
+    "pending", "completed", "collision", "timeout", "no-plan", "crashed",
+};
+
+struct job {
+	uint32_t maze;
+	float values[PARAMETERS_COUNT];
+};
+
+/**
+ * Job results.
+ *
+ * - Run time planned and simulated, from the start to the stop, in seconds.
+ * - Energy drawn from the battery during the run, in joules.
+ * - Distance between the robot and the pose integrated from the motion
+ *   setpoints, at the end and the maximum during the run, in meters.
+ * - Maximum consecutive saturated PWM periods and collision trips.
+ * - Host time taken by the whole simulation, in seconds.
+ */
+struct job_result {
+	enum job_status status;
+	float planned;
+	float run_time;
+	float energy;
+	float error;
+	float max_error;
+	uint32_t max_saturation;
+	uint32_t trips;
+	float host_time;
+};
+
+/** Memory shared with the workers */
+struct shared {
+	uint32_t next;
+	struct job_result results[];
+};
+
+static struct sweep sweeps[PARAMETERS_COUNT];
+static struct corpus_maze *mazes;
+static char (*maze_names)[32];
+static uint32_t maze_count;
+static struct job *jobs;
+static uint32_t job_count;
+static struct shared *shared;
+static double timeout = 30.;
+
+/* State of the job run by the current process */
+static const struct job *job;
+static struct job_result *result;
+static struct planner_move moves[PLANNER_MAX_MOVES];
+static bool running;
+static uint32_t periods;
+static uint32_t start_period;
+static double start_energy;
+static double ideal_x;
+static double ideal_y;
+static double ideal_theta;
+
+/* Firmware entry point (`main()` in `src/main.c`, renamed at build time) */
+int firmware_main(void);
+
+static double now(void)
+{
+	struct timespec time;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Plan the run with the job parameters and start it.
+ */
+static void start_run(void)
+{
+	const struct robot_state *state = robot_get_state();
+	const float *values = job->values;
+	struct planner_limits planner_limits;
+	struct motion_limits motion_limits;
+	struct control_gains gains;
+	struct planner_stats stats;
+	uint16_t count;
+
+	corpus_apply(&mazes[job->maze]);
+	motion_limits.shape = values[S_CURVE] ? MOTION_S_CURVE
+					      : MOTION_TRAPEZOIDAL;
+	motion_limits.acceleration =
+	    (int32_t)(values[ACCELERATION] * MICROMETERS_PER_METER);
+	if (motion_limits.shape == MOTION_S_CURVE)
+		motion_limits.acceleration = (int32_t)(
+		    motion_limits.acceleration / (1. - MOTION_JERK_FRACTION));
+	motion_set_limits(&motion_limits);
+	planner_limits.max_speed = values[MAX_SPEED];
+	planner_limits.max_diagonal_speed = values[MAX_DIAGONAL_SPEED];
+	planner_limits.acceleration = motion_average_acceleration();
+	planner_limits.lateral_acceleration = values[LATERAL_ACCELERATION];
+	planner_limits.diagonals = values[DIAGONALS] != 0.f;
+	planner_set_limits(&planner_limits);
+	count = planner_plan(moves, PLANNER_MAX_MOVES);
+	if (!count) {
+		result->status = JOB_NO_PLAN;
+		simulation_finish();
+	}
+	planner_get_stats(&stats);
+	result->planned = stats.time;
+
+	gains.feedforward = values[FEEDFORWARD];
+	gains.linear_kp = values[LINEAR_KP];
+	gains.linear_ki = values[LINEAR_KI];
+	gains.angular_kp = values[ANGULAR_KP];
+	gains.angular_ki = values[ANGULAR_KI];
+	control_set_gains(&gains);
+	motion_run(moves, count);
+	control_enable();
+
+	start_period = periods;
+	start_energy = state->energy;
+	ideal_x = state->x;
+	ideal_y = state->y;
+	ideal_theta = state->theta;
+	running = true;
+}
+
+/**
+ * @brief Supervise the job after every SysTick period.
+ *
+ * The pose integrated from the setpoints is where a perfect tracking would
+ * have taken the robot.
+ */
+static void supervise(void)
+{
+	const struct robot_state *state = robot_get_state();
+	struct motion_setpoint setpoint;
+	double linear;
+	double error;
+
+	periods++;
+	if (!running) {
+		if (gyro_calibrated())
+			start_run();
+		return;
+	}
+	motion_get_setpoint(&setpoint);
+	linear = setpoint.linear_velocity * MICROS / SYSTICK_FREQUENCY_HZ;
+	ideal_x += linear * cos(ideal_theta);
+	ideal_y += linear * sin(ideal_theta);
+	ideal_theta +=
+	    setpoint.angular_velocity * MICROS / SYSTICK_FREQUENCY_HZ;
+	error = hypot(state->x - ideal_x, state->y - ideal_y);
+	if (error > result->max_error)
+		result->max_error = (float)error;
+	if (pwm_saturation() > result->max_saturation)
+		result->max_saturation = pwm_saturation();
+
+	if (collision_detected()) {
+		result->status = JOB_COLLISION;
+		simulation_finish();
+	}
+	if (motion_is_idle() &&
+	    fabs(state->linear_speed) < STOPPED_LINEAR_SPEED &&
+	    fabs(state->angular_speed) < STOPPED_ANGULAR_SPEED) {
+		result->status = JOB_COMPLETED;
+		simulation_finish();
+	}
+}
+
+static void finish(void)
+{
+	const struct robot_state *state = robot_get_state();
+
+	if (result->status == JOB_PENDING)
+		result->status = JOB_TIMEOUT;
+	if (!running)
+		return;
+	result->run_time =
+	    (float)(periods - start_period) / SYSTICK_FREQUENCY_HZ;
+	result->energy = (float)(state->energy - start_energy);
+	result->error = (float)hypot(state->x - ideal_x, state->y - ideal_y);
+	result->trips = collision_trip_count();
+}
+
+/**
+ * @brief Run a job in the current (child) process, which never returns.
+ */
+static void run_job(uint32_t index)
+{
+	struct robot_parameters parameters = robot_default_parameters;
+	struct simulation_options options = {
+	    .duration = STARTUP_TIMEOUT + timeout,
+	    .robot = &parameters,
+	    .period_hook = supervise,
+	    .finish_hook = finish,
+	};
+
+	job = &jobs[index];
+	result = &shared->results[index];
+	parameters.battery_voltage = job->values[BATTERY_VOLTAGE];
+	simulation_start(&options);
+	firmware_main();
+	while (1)
+		__WFI();
+}
+
+/**
+ * @brief Run the pending jobs until there are none left.
+ */
+static void work(void)
+{
+	uint32_t index;
+	pid_t child;
+	int status;
+	double start;
+
+	while ((index = __atomic_fetch_add(&shared->next, 1,
+					   __ATOMIC_RELAXED)) < job_count) {
+		start = now();
+		child = fork();
+		if (!child)
+			run_job(index);
+		if (child < 0 || waitpid(child, &status, 0) < 0 ||
+		    !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+			shared->results[index].status = JOB_CRASHED;
+		shared->results[index].host_time = (float)(now() - start);
+	}
+}
+
+static float random_between(float min, float max)
+{
+	return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+/**
+ * @brief Create the jobs for every maze, by grid or random search.
+ *
+ * @return Whether the sweeps are valid for the search.
+ */
+static bool create_jobs(uint32_t samples)
+{
+	float values[PARAMETERS_COUNT];
+	const struct sweep *sweep;
+	uint32_t combinations = 1;
+	uint32_t rest;
+	uint32_t maze;
+	uint32_t i;
+	int p;
+
+	for (p = 0; p < PARAMETERS_COUNT; p++) {
+		if (sweeps[p].range && !samples)
+			return false;
+		combinations *= sweeps[p].range ? 1 : sweeps[p].count;
+	}
+	if (samples)
+		combinations = samples;
+	job_count = combinations * maze_count;
+	jobs = calloc(job_count, sizeof(*jobs));
+	if (!jobs)
+		return false;
+	for (i = 0; i < combinations; i++) {
+		rest = i;
+		for (p = 0; p < PARAMETERS_COUNT; p++) {
+			sweep = &sweeps[p];
+			if (sweep->range)
+				values[p] = random_between(sweep->values[0],
+							   sweep->values[1]);
+			else if (samples)
+				values[p] = sweep->values[(uint32_t)rand() %
+							  sweep->count];
+			else
+				values[p] = sweep->values[rest % sweep->count];
+			rest /= sweep->count;
+		}
+		for (maze = 0; maze < maze_count; maze++) {
+			jobs[i * maze_count + maze].maze = maze;
+			memcpy(jobs[i * maze_count + maze].values, values,
+			       sizeof(values));
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Set the default value of each parameter, from the firmware.
+ */
+static void set_defaults(void)
+{
+	struct planner_limits planner_limits;
+	struct motion_limits motion_limits;
+	struct control_gains gains;
+	float defaults[PARAMETERS_COUNT];
+	int p;
+
+	planner_get_limits(&planner_limits);
+	motion_get_limits(&motion_limits);
+	control_get_gains(&gains);
+	defaults[MAX_SPEED] = planner_limits.max_speed;
+	defaults[MAX_DIAGONAL_SPEED] = planner_limits.max_diagonal_speed;
+	defaults[ACCELERATION] = planner_limits.acceleration;
+	defaults[LATERAL_ACCELERATION] = planner_limits.lateral_acceleration;
+	defaults[DIAGONALS] = planner_limits.diagonals;
+	defaults[S_CURVE] = motion_limits.shape == MOTION_S_CURVE;
+	defaults[FEEDFORWARD] = gains.feedforward;
+	defaults[LINEAR_KP] = gains.linear_kp;
+	defaults[LINEAR_KI] = gains.linear_ki;
+	defaults[ANGULAR_KP] = gains.angular_kp;
+	defaults[ANGULAR_KI] = gains.angular_ki;
+	defaults[BATTERY_VOLTAGE] =
+	    (float)robot_default_parameters.battery_voltage;
+	for (p = 0; p < PARAMETERS_COUNT; p++) {
+		sweeps[p].values[0] = defaults[p];
+		sweeps[p].count = 1;
+	}
+}
+
+/**
+ * @brief Parse a `NAME=VALUE,...` or `NAME=MIN:MAX` sweep.
+ */
+static bool parse_sweep(char *text)
+{
+	char *value = strchr(text, '=');
+	struct sweep *sweep = NULL;
+	char *end;
+	int p;
+
+	if (!value)
+		return false;
+	*value++ = '\0';
+	for (p = 0; p < PARAMETERS_COUNT; p++)
+		if (!strcmp(text, parameter_names[p]))
+			sweep = &sweeps[p];
+	if (!sweep)
+		return false;
+	sweep->count = 0;
+	sweep->range = strchr(value, ':') != NULL;
+	while (sweep->count < MAX_VALUES) {
+		sweep->values[sweep->count++] = strtof(value, &end);
+		if (end == value)
+			return false;
+		if (!*end)
+			break;
+		if (*end != (sweep->range ? ':' : ','))
+			return false;
+		value = end + 1;
+	}
+	return *end == '\0' && (!sweep->range || sweep->count == 2);
+}
+
+static void print_results(void)
+{
+	const struct job_result *job_result;
+	int p;
+	uint32_t i;
+
+	printf("job,maze");
+	for (p = 0; p < PARAMETERS_COUNT; p++)
+		printf(",%s", parameter_names[p]);
+	printf(",status,planned,run_time,energy,error,max_error,"
+	       "max_saturation,trips,host_time\n");
+	for (i = 0; i < job_count; i++) {
+		job_result = &shared->results[i];
+		printf("%u,%s", i, maze_names[jobs[i].maze]);
+		for (p = 0; p < PARAMETERS_COUNT; p++)
+			printf(",%g", jobs[i].values[p]);
+		printf(",%s,%.3f,%.3f,%.3f,%.4f,%.4f,%u,%u,%.3f\n",
+		       status_names[job_result->status], job_result->planned,
+		       job_result->run_time, job_result->energy,
+		       job_result->error, job_result->max_error,
+		       job_result->max_saturation, job_result->trips,
+		       job_result->host_time);
+	}
+}
+
+static uint32_t print_summary(double elapsed, long workers)
+{
+	uint32_t counts[JOB_CRASHED + 1] = {0};
+	uint32_t i;
+
+	for (i = 0; i < job_count; i++)
+		counts[shared->results[i].status]++;
+	fprintf(stderr,
+		"%u jobs in %.1f s with %ld workers (%.1f jobs/s): "
+		"%u completed, %u collisions, %u timeouts, %u without plan, "
+		"%u crashed\n",
+		job_count, elapsed, workers, job_count / elapsed,
+		counts[JOB_COMPLETED], counts[JOB_COLLISION],
+		counts[JOB_TIMEOUT], counts[JOB_NO_PLAN], counts[JOB_CRASHED]);
+	return counts[JOB_CRASHED];
+}
+
+static void usage(const char *name)
+{
+	int p;
+
+	fprintf(stderr,
+		"Usage: %s [-j WORKERS] [-n MAZES] [-s SIZE] [-r SEED]\n"
+		"       [-R SAMPLES] [-t SECONDS] [-p NAME=VALUES]... "
+		"[MAZE_FILE...]\n"
+		"\n"
+		"  -j  Worker processes (default: one per core)\n"
+		"  -n  Random mazes to generate (default: 10 if no files)\n"
+		"  -s  Random maze size (default: 16)\n"
+		"  -r  Random seed (default: 1)\n"
+		"  -R  Random search samples (default: grid search)\n"
+		"  -t  Simulated time allowed for each run (default: 30 s)\n"
+		"  -p  Parameter values, as a list (`NAME=A,B,...`) or, for\n"
+		"      random search, a range (`NAME=MIN:MAX`)\n"
+		"\n"
+		"Parameters:",
+		name);
+	for (p = 0; p < PARAMETERS_COUNT; p++)
+		fprintf(stderr, "%s %s", p % 4 ? "" : "\n ",
+			parameter_names[p]);
+	fprintf(stderr, "\n");
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	long workers = sysconf(_SC_NPROCESSORS_ONLN);
+	uint32_t samples = 0;
+	int random_mazes = -1;
+	int size = MAZE_CLASSIC_SIZE;
+	double start;
+	long i;
+	int opt;
+
+	srand(1);
+	set_defaults();
+	while ((opt = getopt(argc, argv, "j:n:s:r:R:t:p:h")) != -1) {
+		switch (opt) {
+		case 'j':
+			workers = atol(optarg);
+			break;
+		case 'n':
+			random_mazes = atoi(optarg);
+			break;
+		case 's':
+			size = atoi(optarg);
+			if (size < 4 || size > MAZE_MAX_SIZE)
+				usage(argv[0]);
+			break;
+		case 'r':
+			srand((unsigned)atoi(optarg));
+			break;
+		case 'R':
+			samples = (uint32_t)atol(optarg);
+			break;
+		case 't':
+			timeout = atof(optarg);
+			break;
+		case 'p':
+			if (!parse_sweep(optarg))
+				usage(argv[0]);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (random_mazes < 0)
+		random_mazes = optind < argc ? 0 : 10;
+	if (workers < 1 || argc - optind + random_mazes > MAX_MAZES)
+		usage(argv[0]);
+
+	mazes = calloc(MAX_MAZES, sizeof(*mazes));
+	maze_names = calloc(MAX_MAZES, sizeof(*maze_names));
+	if (!mazes || !maze_names)
+		return EXIT_FAILURE;
+	for (i = optind; i < argc; i++, maze_count++) {
+		if (!corpus_load(argv[i], &mazes[maze_count]))
+			return EXIT_FAILURE;
+		snprintf(maze_names[maze_count], sizeof(*maze_names), "%s",
+			 strrchr(argv[i], '/') ? strrchr(argv[i], '/') + 1
+					       : argv[i]);
+	}
+	for (i = 0; i < random_mazes; i++, maze_count++) {
+		corpus_generate(&mazes[maze_count], (uint8_t)size);
+		snprintf(maze_names[maze_count], sizeof(*maze_names),
+			 "random-%dx%d-%ld", size, size, i);
+	}
+	if (!create_jobs(samples))
+		usage(argv[0]);
+
+	shared = mmap(NULL,
+		      sizeof(*shared) + job_count * sizeof(struct job_result),
+		      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1,
+		      0);
+	if (shared == MAP_FAILED) {
+		perror("mmap");
+		return EXIT_FAILURE;
+	}
+	fflush(stdout);
+	start = now();
+	for (i = 0; i < workers; i++) {
+		if (!fork()) {
+			work();
+			_exit(EXIT_SUCCESS);
+		}
+	}
+	while (wait(NULL) > 0)
+		;
+	print_results();
+	return print_summary(now() - start, workers) ? EXIT_FAILURE
+						     : EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+/*
+ * Replay a recorded run through the firmware state estimator.
+ *
+ * The input is the CSV file of the telemetry state records (see
+ * `scripts/telemetry.py`), streamed every SysTick period (`STATE_STREAM`
+ * command with a period of 1). The fixed-point estimator is compared against
+ * a double precision implementation of the same filter, and the estimated
+ * pose is written as CSV to the standard output.
+ *
+ * The exit status is non-zero if the position or heading error exceeds the
+ * tolerance.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "estimator.h"
+
+#define LINE_SIZE 1024
+#define MAX_COLUMNS 64
+#define POSITION_TOLERANCE_MM 1.
+#define HEADING_TOLERANCE_DEG 0.1
+
+struct reference {
+	double x;
+	double y;
+	double heading;
+	double odometry_heading;
+};
+
+/*
+ * The replay is single-threaded: the estimator critical sections need no
+ * interrupt masking.
+ */
+uint32_t cm_mask_interrupts(uint32_t mask)
+{
+	(void)mask;
+	return 0;
+}
+
+static int column_index(char *header, const char *name)
+{
+	char *field;
+	int index = 0;
+
+	for (field = strtok(header, ",\r\n"); field;
+	     field = strtok(NULL, ",\r\n"), index++)
+		if (!strcmp(field, name))
+			return index;
+	return -1;
+}
+
+static int find_column(const char *header, const char *name)
+{
+	char copy[LINE_SIZE];
+	int index;
+
+	strncpy(copy, header, sizeof(copy) - 1);
+	copy[sizeof(copy) - 1] = '\0';
+	index = column_index(copy, name);
+	if (index < 0) {
+		fprintf(stderr, "Column %s not found\n", name);
+		exit(EXIT_FAILURE);
+	}
+	return index;
+}
+
+static int parse_row(char *line, long *values)
+{
+	char *field;
+	int count = 0;
+
+	for (field = strtok(line, ",\r\n"); field && count < MAX_COLUMNS;
+	     field = strtok(NULL, ",\r\n"))
+		values[count++] = strtol(field, NULL, 10);
+	return count;
+}
+
+/**
+ * @brief Double precision implementation of `estimator_update()`.
+ */
+static void reference_update(struct reference *state,
+			     const struct estimator_input *input)
+{
+	double meters_per_count = 2 * PI * WHEEL_RADIUS_MICROMETERS * 1e-6 /
+				  (MOTOR_GEAR_RATIO *
+				   ENCODER_COUNTS_PER_MOTOR_REVOLUTION);
+	double separation = WHEELS_SEPARATION_MICROMETERS * 1e-6;
+	double gain = 1. / (1 << ESTIMATOR_ODOMETRY_SHIFT);
+	double gyro_rotation;
+	double rotation;
+	double distance;
+
+	state->odometry_heading +=
+	    (input->delta_right - input->delta_left) * meters_per_count /
+	    separation;
+	gyro_rotation = (double)input->gyro_z /
+			(1 << ESTIMATOR_GYRO_RATE_SHIFT) /
+			ESTIMATOR_GYRO_LSB_PER_DPS * PI /
+			180. / SYSTICK_FREQUENCY_HZ;
+	rotation = gyro_rotation +
+		   gain * (state->odometry_heading -
+			   (state->heading + gyro_rotation));
+	distance = (input->delta_left + input->delta_right) / 2. *
+		   meters_per_count;
+	state->x += distance * cos(state->heading + rotation / 2);
+	state->y += distance * sin(state->heading + rotation / 2);
+	state->heading += rotation;
+}
+
+static double heading_degrees(uint32_t heading)
+{
+	return (int32_t)heading * 360. / ESTIMATOR_ANGLE_PER_TURN;
+}
+
+int main(int argc, char *argv[])
+{
+	struct reference reference = {0};
+	struct estimator_input input;
+	struct estimator_pose pose;
+	char line[LINE_SIZE];
+	long values[MAX_COLUMNS];
+	int left_column;
+	int right_column;
+	int gyro_column;
+	uint16_t last_left = 0;
+	uint16_t last_right = 0;
+	bool first = true;
+	double position_error = 0.;
+	double heading_error = 0.;
+	double error;
+	FILE *fd;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s state.csv\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	fd = fopen(argv[1], "r");
+	if (!fd || !fgets(line, sizeof(line), fd)) {
+		perror(argv[1]);
+		return EXIT_FAILURE;
+	}
+	left_column = find_column(line, "encoder_left");
+	right_column = find_column(line, "encoder_right");
+	gyro_column = find_column(line, "gyro_z");
+
+	estimator_init();
+	printf("x_mm,y_mm,heading_deg,reference_x_mm,reference_y_mm,"
+	       "reference_heading_deg\n");
+	while (fgets(line, sizeof(line), fd)) {
+		if (parse_row(line, values) <= gyro_column)
+			continue;
+		if (first) {
+			last_left = (uint16_t)values[left_column];
+			last_right = (uint16_t)values[right_column];
+			first = false;
+		}
+		input.delta_left =
+		    (int16_t)((uint16_t)values[left_column] - last_left);
+		input.delta_right =
+		    (int16_t)((uint16_t)values[right_column] - last_right);
+		input.gyro_z = (int32_t)(values[gyro_column] *
+					 (1 << ESTIMATOR_GYRO_RATE_SHIFT));
+		last_left = (uint16_t)values[left_column];
+		last_right = (uint16_t)values[right_column];
+
+		estimator_update(&input);
+		reference_update(&reference, &input);
+		estimator_get(&pose);
+
+		error = hypot(pose.x * 1e-6 - reference.x * 1e3,
+			      pose.y * 1e-6 - reference.y * 1e3);
+		if (error > position_error)
+			position_error = error;
+		error = fabs(remainder(heading_degrees(pose.heading) -
+					   reference.heading * 180. / M_PI,
+				       360.));
+		if (error > heading_error)
+			heading_error = error;
+		printf("%.3f,%.3f,%.4f,%.3f,%.3f,%.4f\n", pose.x * 1e-6,
+		       pose.y * 1e-6, heading_degrees(pose.heading),
+		       reference.x * 1e3, reference.y * 1e3,
+		       remainder(reference.heading * 180. / M_PI, 360.));
+	}
+	fclose(fd);
+
+	fprintf(stderr, "max error: position %.3f mm, heading %.4f deg\n",
+		position_error, heading_error);
+	if (position_error > POSITION_TOLERANCE_MM ||
+	    heading_error > HEADING_TOLERANCE_DEG)
+		return EXIT_FAILURE;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,271 @@
+/*
+ * Benchmark the maze solver exploring a corpus of mazes.
+ *
+ * Mazes are read from corpus files or generated at random (see
+ * `maze_corpus.c`). For each maze, the robot explores from the start cell to
+ * the goal, discovering the walls of each visited cell. The incremental
+ * distance updates are timed and checked after every cell against a full
+ * flood fill computed on a separate copy of the walls, so the solver state
+ * is never resynchronized. The firmware full flood fill is timed afterwards,
+ * visiting the same cells on a fresh maze.
+ *
+ * The exit status is non-zero if any incremental update differs from the
+ * full flood fill.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "maze.h"
+#include "maze_corpus.h"
+
+struct result {
+	uint32_t cells;
+	uint32_t mismatches;
+	double incremental_total;
+	double incremental_max;
+	double flood_total;
+	double flood_max;
+	struct maze_stats stats;
+};
+
+/** Cells visited by the exploration, in order */
+static uint16_t path[4 * MAZE_MAX_CELLS];
+
+static const int delta_x[MAZE_DIRECTIONS_COUNT] = {0, 1, 0, -1};
+static const int delta_y[MAZE_DIRECTIONS_COUNT] = {1, 0, -1, 0};
+
+static double now(void)
+{
+	struct timespec time;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Full flood fill on a copy of the known walls.
+ *
+ * A plain breadth-first search from the goal cells, independent from the
+ * solver (unknown sides are assumed to be open, like the solver does).
+ */
+static void reference_flood(uint16_t distances[MAZE_MAX_SIZE][MAZE_MAX_SIZE])
+{
+	static bool open[MAZE_MAX_SIZE][MAZE_MAX_SIZE][MAZE_DIRECTIONS_COUNT];
+	static uint16_t queue[MAZE_MAX_CELLS];
+	enum maze_direction direction;
+	uint8_t size = maze_size();
+	uint32_t head = 0;
+	uint32_t tail = 0;
+	int x;
+	int y;
+	int next_x;
+	int next_y;
+
+	for (y = 0; y < size; y++) {
+		for (x = 0; x < size; x++) {
+			for (direction = MAZE_NORTH;
+			     direction < MAZE_DIRECTIONS_COUNT; direction++)
+				open[y][x][direction] =
+				    maze_get_wall((uint8_t)x, (uint8_t)y,
+						  direction) !=
+				    MAZE_WALL_PRESENT;
+			distances[y][x] = MAZE_UNREACHABLE;
+			if (maze_is_goal((uint8_t)x, (uint8_t)y)) {
+				distances[y][x] = 0;
+				queue[tail++] = (uint16_t)(y * size + x);
+			}
+		}
+	}
+	while (head < tail) {
+		x = queue[head] % size;
+		y = queue[head] / size;
+		head++;
+		for (direction = MAZE_NORTH; direction < MAZE_DIRECTIONS_COUNT;
+		     direction++) {
+			if (!open[y][x][direction])
+				continue;
+			next_x = x + delta_x[direction];
+			next_y = y + delta_y[direction];
+			if (distances[next_y][next_x] != MAZE_UNREACHABLE)
+				continue;
+			distances[next_y][next_x] = distances[y][x] + 1;
+			queue[tail++] = (uint16_t)(next_y * size + next_x);
+		}
+	}
+}
+
+/**
+ * @brief Check the incremental distances against a full flood fill.
+ *
+ * The solver state is only read.
+ *
+ * @return Number of cells with a different distance.
+ */
+static uint32_t check_distances(void)
+{
+	static uint16_t reference[MAZE_MAX_SIZE][MAZE_MAX_SIZE];
+	uint8_t size = maze_size();
+	uint32_t mismatches = 0;
+	uint8_t x;
+	uint8_t y;
+
+	reference_flood(reference);
+	for (y = 0; y < size; y++)
+		for (x = 0; x < size; x++)
+			if (reference[y][x] != maze_distance(x, y))
+				mismatches++;
+	return mismatches;
+}
+
+/**
+ * @brief Discover the walls of a cell.
+ */
+static void discover(const struct corpus_maze *truth, int x, int y)
+{
+	enum maze_direction direction;
+
+	for (direction = MAZE_NORTH; direction < MAZE_DIRECTIONS_COUNT;
+	     direction++)
+		maze_set_wall((uint8_t)x, (uint8_t)y, direction,
+			      truth->walls[y][x][direction]);
+}
+
+/**
+ * @brief Time full flood fills, discovering the explored cells again.
+ *
+ * The walls of each cell of the exploration path are discovered on a
+ * fresh maze, and the distances are flooded from scratch after each one.
+ */
+static void time_floods(const struct corpus_maze *truth,
+			struct result *result)
+{
+	double elapsed;
+	uint32_t i;
+
+	maze_reset(truth->size);
+	for (i = 0; i < result->cells; i++) {
+		discover(truth, path[i] % MAZE_MAX_SIZE,
+			 path[i] / MAZE_MAX_SIZE);
+		elapsed = now();
+		maze_flood();
+		elapsed = now() - elapsed;
+		result->flood_total += elapsed;
+		if (elapsed > result->flood_max)
+			result->flood_max = elapsed;
+	}
+}
+
+/**
+ * @brief Explore a maze from the start cell until the goal is reached.
+ */
+static void explore(const struct corpus_maze *truth, struct result *result)
+{
+	enum maze_direction heading = MAZE_NORTH;
+	uint32_t limit = sizeof(path) / sizeof(path[0]);
+	double elapsed;
+	int x = 0;
+	int y = 0;
+
+	memset(result, 0, sizeof(*result));
+	maze_reset(truth->size);
+	while (result->cells < limit) {
+		elapsed = now();
+		discover(truth, x, y);
+		elapsed = now() - elapsed;
+		result->incremental_total += elapsed;
+		if (elapsed > result->incremental_max)
+			result->incremental_max = elapsed;
+		result->mismatches += check_distances();
+		path[result->cells++] = (uint16_t)(y * MAZE_MAX_SIZE + x);
+		if (maze_is_goal((uint8_t)x, (uint8_t)y) ||
+		    maze_distance((uint8_t)x, (uint8_t)y) == MAZE_UNREACHABLE)
+			break;
+		heading = maze_next_direction((uint8_t)x, (uint8_t)y, heading);
+		x += delta_x[heading];
+		y += delta_y[heading];
+	}
+	maze_get_stats(&result->stats);
+	time_floods(truth, result);
+}
+
+static void report(const char *name, const struct result *result)
+{
+	const struct maze_stats *stats = &result->stats;
+
+	printf("%-24s %6u %6u %6u %8u %10.2f %10.2f %10.2f %10.2f%s\n", name,
+	       result->cells, stats->walls, stats->updates, stats->cells,
+	       result->incremental_total / result->cells * 1e6,
+	       result->incremental_max * 1e6,
+	       result->flood_total / result->cells * 1e6,
+	       result->flood_max * 1e6,
+	       result->mismatches ? " MISMATCH" : "");
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [-n MAZES] [-s SIZE] [-r SEED] [MAZE_FILE...]\n"
+		"\n"
+		"  -n  Random mazes to generate (default: 100 if no files)\n"
+		"  -s  Random maze size (default: 16)\n"
+		"  -r  Random seed (default: 1)\n",
+		name);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	static struct corpus_maze truth;
+	struct result result;
+	char name[32];
+	uint32_t mismatches = 0;
+	int mazes = -1;
+	int size = MAZE_CLASSIC_SIZE;
+	int opt;
+	int i;
+
+	srand(1);
+	while ((opt = getopt(argc, argv, "n:s:r:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			mazes = atoi(optarg);
+			break;
+		case 's':
+			size = atoi(optarg);
+			if (size < 4 || size > MAZE_MAX_SIZE)
+				usage(argv[0]);
+			break;
+		case 'r':
+			srand((unsigned)atoi(optarg));
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (mazes < 0)
+		mazes = optind < argc ? 0 : 100;
+
+	printf("%-24s %6s %6s %6s %8s %10s %10s %10s %10s\n", "maze", "cells",
+	       "walls", "updates", "repaired", "inc (us)", "inc max",
+	       "flood (us)", "flood max");
+	for (i = optind; i < argc; i++) {
+		if (!corpus_load(argv[i], &truth))
+			return EXIT_FAILURE;
+		explore(&truth, &result);
+		mismatches += result.mismatches;
+		report(strrchr(argv[i], '/') ? strrchr(argv[i], '/') + 1
+					     : argv[i],
+		       &result);
+	}
+	for (i = 0; i < mazes; i++) {
+		corpus_generate(&truth, (uint8_t)size);
+		explore(&truth, &result);
+		mismatches += result.mismatches;
+		snprintf(name, sizeof(name), "random-%dx%d-%d", size, size, i);
+		report(name, &result);
+	}
+	return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,166 @@
+/*
+ * Maze corpus for the host tools.
+ *
+ * Mazes are read from text files in the usual corpus format (`o---o` posts
+ * and walls, `|` walls, north at the top) or generated at random.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "maze_corpus.h"
+
+#define LINE_SIZE 256
+#define RANDOM_LOOPS_PER_SIZE 2
+
+static const int delta_x[MAZE_DIRECTIONS_COUNT] = {0, 1, 0, -1};
+static const int delta_y[MAZE_DIRECTIONS_COUNT] = {1, 0, -1, 0};
+
+static void set_wall(struct corpus_maze *maze, int x, int y,
+		     enum maze_direction direction, bool present)
+{
+	int nx = x + delta_x[direction];
+	int ny = y + delta_y[direction];
+
+	if (x < 0 || y < 0 || x >= maze->size || y >= maze->size)
+		return;
+	maze->walls[y][x][direction] = present;
+	if (nx < 0 || ny < 0 || nx >= maze->size || ny >= maze->size)
+		return;
+	maze->walls[ny][nx][(direction + 2) % MAZE_DIRECTIONS_COUNT] = present;
+}
+
+/**
+ * @brief Read a maze in the corpus text format.
+ */
+bool corpus_load(const char *path, struct corpus_maze *maze)
+{
+	char lines[2 * MAZE_MAX_SIZE + 1][LINE_SIZE];
+	int count = 0;
+	int row;
+	int x;
+	int y;
+	FILE *fd;
+
+	fd = fopen(path, "r");
+	if (!fd) {
+		perror(path);
+		return false;
+	}
+	while (count < 2 * MAZE_MAX_SIZE + 1 &&
+	       fgets(lines[count], LINE_SIZE, fd))
+		if (lines[count][0] == 'o' || lines[count][0] == '|')
+			count++;
+	fclose(fd);
+	if (count < 3 || !(count % 2)) {
+		fprintf(stderr, "%s: invalid maze\n", path);
+		return false;
+	}
+
+	memset(maze, 0, sizeof(*maze));
+	maze->size = (uint8_t)(count / 2);
+	for (y = 0; y < maze->size; y++) {
+		row = 2 * (maze->size - 1 - y);
+		for (x = 0; x < maze->size; x++) {
+			set_wall(maze, x, y, MAZE_NORTH,
+				       lines[row][4 * x + 2] == '-');
+			set_wall(maze, x, y, MAZE_SOUTH,
+				       lines[row + 2][4 * x + 2] == '-');
+			set_wall(maze, x, y, MAZE_WEST,
+				       lines[row + 1][4 * x] == '|');
+			set_wall(maze, x, y, MAZE_EAST,
+				       lines[row + 1][4 * x + 4] == '|');
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Generate a random maze with loops and an open central goal.
+ *
+ * A perfect maze is carved with a randomized depth-first search, and then
+ * some random inner walls are removed to create loops. As in competition
+ * mazes, the start cell is only open to the north.
+ */
+void corpus_generate(struct corpus_maze *maze, uint8_t size)
+{
+	static uint16_t stack[MAZE_MAX_CELLS];
+	static bool visited[MAZE_MAX_SIZE][MAZE_MAX_SIZE];
+	enum maze_direction options[MAZE_DIRECTIONS_COUNT];
+	enum maze_direction direction;
+	int count;
+	int depth = 0;
+	int x;
+	int y;
+	int nx;
+	int ny;
+	int i;
+
+	memset(maze, 0, sizeof(*maze));
+	memset(visited, 0, sizeof(visited));
+	maze->size = size;
+	for (y = 0; y < size; y++)
+		for (x = 0; x < size; x++)
+			for (i = 0; i < MAZE_DIRECTIONS_COUNT; i++)
+				maze->walls[y][x][i] = true;
+
+	visited[0][0] = true;
+	visited[1][0] = true;
+	set_wall(maze, 0, 0, MAZE_NORTH, false);
+	stack[depth++] = MAZE_MAX_SIZE;
+	while (depth) {
+		x = stack[depth - 1] % MAZE_MAX_SIZE;
+		y = stack[depth - 1] / MAZE_MAX_SIZE;
+		count = 0;
+		for (i = 0; i < MAZE_DIRECTIONS_COUNT; i++) {
+			nx = x + delta_x[i];
+			ny = y + delta_y[i];
+			if (nx >= 0 && ny >= 0 && nx < size && ny < size &&
+			    !visited[ny][nx])
+				options[count++] = (enum maze_direction)i;
+		}
+		if (!count) {
+			depth--;
+			continue;
+		}
+		direction = options[rand() % count];
+		nx = x + delta_x[direction];
+		ny = y + delta_y[direction];
+		set_wall(maze, x, y, direction, false);
+		visited[ny][nx] = true;
+		stack[depth++] = (uint16_t)(ny * MAZE_MAX_SIZE + nx);
+	}
+
+	for (i = 0; i < RANDOM_LOOPS_PER_SIZE * size; i++) {
+		x = rand() % (size - 1);
+		y = rand() % (size - 1);
+		if (x || y)
+			set_wall(maze, x, y,
+				 rand() % 2 ? MAZE_NORTH : MAZE_EAST, false);
+	}
+	x = size / 2 - 1;
+	y = size / 2 - 1;
+	set_wall(maze, x, y, MAZE_NORTH, false);
+	set_wall(maze, x, y, MAZE_EAST, false);
+	set_wall(maze, x + 1, y + 1, MAZE_SOUTH, false);
+	set_wall(maze, x + 1, y + 1, MAZE_WEST, false);
+}
+
+/**
+ * @brief Load all the walls of a corpus maze in the solver, as if the maze
+ * had been completely explored.
+ */
+void corpus_apply(const struct corpus_maze *maze)
+{
+	enum maze_direction direction;
+	uint8_t x;
+	uint8_t y;
+
+	maze_reset(maze->size);
+	for (y = 0; y < maze->size; y++)
+		for (x = 0; x < maze->size; x++)
+			for (direction = MAZE_NORTH;
+			     direction < MAZE_DIRECTIONS_COUNT; direction++)
+				maze_set_wall(x, y, direction,
+					      maze->walls[y][x][direction]);
+}
@@ -0,0 +1,19 @@
+#ifndef __MAZE_CORPUS_H
+#define __MAZE_CORPUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "maze.h"
+
+/** Actual maze walls, indexed as `[y][x][direction]` */
+struct corpus_maze {
+	uint8_t size;
+	bool walls[MAZE_MAX_SIZE][MAZE_MAX_SIZE][MAZE_DIRECTIONS_COUNT];
+};
+
+bool corpus_load(const char *path, struct corpus_maze *maze);
+void corpus_generate(struct corpus_maze *maze, uint8_t size);
+void corpus_apply(const struct corpus_maze *maze);
+
+#endif /* __MAZE_CORPUS_H */
@@ -0,0 +1,228 @@
+/*
+ * Run the motion profiler on planned speed runs.
+ *
+ * Mazes are read from corpus files or generated at random (see
+ * `maze_corpus.c`), with all their walls known. For each maze, the fastest
+ * run is planned and compiled into motion phases, which are then executed
+ * tick by tick as in the motor loop, with the queue refilled every
+ * `FEED_PERIOD` ticks as by the background task. With S-curves, the peak
+ * acceleration is raised so that the average matches the planner.
+ *
+ * The setpoints are integrated and checked: the travelled distance and the
+ * heading change must match the plan, the linear velocity must never change
+ * faster than the acceleration limit (so moves chain without steps), the
+ * queue must never run out while moving and the run must end stopped. The
+ * exit status is non-zero if any run fails a check.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "maze.h"
+#include "maze_corpus.h"
+#include "motion.h"
+#include "planner.h"
+
+#define FEED_PERIOD 10
+#define MAX_TICKS 600000
+
+#define MICRORADIANS_PER_STEP 785398.
+#define DISTANCE_TOLERANCE_UM 2000.
+#define ANGLE_TOLERANCE_URAD 1000.
+#define ACCELERATION_TOLERANCE 1.05
+
+struct result {
+	uint16_t moves;
+	float planned;
+	uint32_t ticks;
+	double distance_error;
+	double angle_error;
+	double max_acceleration;
+	double update;
+	struct motion_stats stats;
+	bool stopped;
+};
+
+/**
+ * @brief Interruption masking, for the critical sections of the profiler.
+ *
+ * The motor loop runs in this same thread, so there is nothing to mask.
+ */
+uint32_t cm_mask_interrupts(uint32_t mask)
+{
+	(void)mask;
+	return 0;
+}
+
+static double now(void)
+{
+	struct timespec time;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static void run(struct result *result)
+{
+	static struct planner_move moves[PLANNER_MAX_MOVES];
+	struct motion_setpoint setpoint;
+	struct planner_stats stats;
+	int32_t last_linear = 0;
+	double distance = 0.;
+	double angle = 0.;
+	double acceleration;
+	double elapsed;
+	uint16_t i;
+
+	memset(result, 0, sizeof(*result));
+	result->moves = planner_plan(moves, PLANNER_MAX_MOVES);
+	if (!result->moves)
+		return;
+	planner_get_stats(&stats);
+	result->planned = stats.time;
+	for (i = 0; i < result->moves; i++) {
+		distance +=
+		    planner_move_length(&moves[i]) * MICROMETERS_PER_METER;
+		angle += planner_move_angle(&moves[i]) * MICRORADIANS_PER_STEP;
+	}
+
+	motion_reset();
+	motion_run(moves, result->moves);
+	while (!motion_is_idle() && result->ticks < MAX_TICKS) {
+		if (!(result->ticks % FEED_PERIOD))
+			motion_feed();
+		elapsed = now();
+		motion_update();
+		result->update += now() - elapsed;
+		motion_get_setpoint(&setpoint);
+		result->ticks++;
+		distance -= (double)setpoint.linear_velocity /
+			    SYSTICK_FREQUENCY_HZ;
+		angle -= (double)setpoint.angular_velocity /
+			 SYSTICK_FREQUENCY_HZ;
+		acceleration = fabs((double)(setpoint.linear_velocity -
+					     last_linear) *
+				    SYSTICK_FREQUENCY_HZ);
+		if (acceleration > result->max_acceleration)
+			result->max_acceleration = acceleration;
+		last_linear = setpoint.linear_velocity;
+	}
+	result->distance_error = distance;
+	result->angle_error = angle;
+	result->update /= result->ticks ? result->ticks : 1;
+	result->stopped = motion_is_idle() && !setpoint.linear_velocity &&
+			  !setpoint.angular_velocity;
+	motion_get_stats(&result->stats);
+}
+
+static bool check(const struct result *result)
+{
+	struct motion_limits limits;
+
+	motion_get_limits(&limits);
+	return result->moves && result->stopped &&
+	       fabs(result->distance_error) <= DISTANCE_TOLERANCE_UM &&
+	       fabs(result->angle_error) <= ANGLE_TOLERANCE_URAD &&
+	       result->max_acceleration <=
+		   limits.acceleration * ACCELERATION_TOLERANCE &&
+	       !result->stats.underruns && !result->stats.clamped;
+}
+
+static bool profile(const char *name, const struct corpus_maze *truth)
+{
+	struct result result;
+	bool valid;
+
+	corpus_apply(truth);
+	run(&result);
+	valid = check(&result);
+	printf("%-24s %6u %8.3f %8.3f %8.3f %8.3f %8.2f %6u %6u %8.0f%s\n",
+	       name, result.moves, result.planned,
+	       (double)result.ticks / SYSTICK_FREQUENCY_HZ,
+	       result.distance_error / 1000., result.angle_error / 1000.,
+	       result.max_acceleration / MICROMETERS_PER_METER,
+	       result.stats.underruns, result.stats.clamped,
+	       result.update * 1e9, valid ? "" : " INVALID");
+	return valid;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [-n MAZES] [-s SIZE] [-r SEED] [-t] [MAZE_FILE...]\n"
+		"\n"
+		"  -n  Random mazes to generate (default: 100 if no files)\n"
+		"  -s  Random maze size (default: 16)\n"
+		"  -r  Random seed (default: 1)\n"
+		"  -t  Trapezoidal ramps (default: S-curve)\n",
+		name);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	static struct corpus_maze truth;
+	struct planner_limits planner_limits;
+	struct motion_limits motion_limits;
+	char name[32];
+	uint32_t invalid = 0;
+	int mazes = -1;
+	int size = MAZE_CLASSIC_SIZE;
+	int opt;
+	int i;
+
+	srand(1);
+	motion_get_limits(&motion_limits);
+	while ((opt = getopt(argc, argv, "n:s:r:th")) != -1) {
+		switch (opt) {
+		case 'n':
+			mazes = atoi(optarg);
+			break;
+		case 's':
+			size = atoi(optarg);
+			if (size < 4 || size > MAZE_MAX_SIZE)
+				usage(argv[0]);
+			break;
+		case 'r':
+			srand((unsigned)atoi(optarg));
+			break;
+		case 't':
+			motion_limits.shape = MOTION_TRAPEZOIDAL;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (mazes < 0)
+		mazes = optind < argc ? 0 : 100;
+	planner_get_limits(&planner_limits);
+	motion_limits.acceleration =
+	    (int32_t)(planner_limits.acceleration * MICROMETERS_PER_METER);
+	if (motion_limits.shape == MOTION_S_CURVE)
+		motion_limits.acceleration = (int32_t)(
+		    motion_limits.acceleration / (1. - MOTION_JERK_FRACTION));
+	motion_set_limits(&motion_limits);
+	planner_limits.acceleration = motion_average_acceleration();
+	planner_set_limits(&planner_limits);
+
+	printf("%-24s %6s %8s %8s %8s %8s %8s %6s %6s %8s\n", "maze", "moves",
+	       "plan (s)", "run (s)", "dist mm", "ang mrad", "acc m/s2",
+	       "under", "clamp", "tick ns");
+	for (i = optind; i < argc; i++) {
+		if (!corpus_load(argv[i], &truth))
+			return EXIT_FAILURE;
+		invalid += !profile(strrchr(argv[i], '/')
+					? strrchr(argv[i], '/') + 1
+					: argv[i],
+				    &truth);
+	}
+	for (i = 0; i < mazes; i++) {
+		corpus_generate(&truth, (uint8_t)size);
+		snprintf(name, sizeof(name), "random-%dx%d-%d", size, size, i);
+		invalid += !profile(name, &truth);
+	}
+	return invalid ? EXIT_FAILURE : EXIT_SUCCESS;
+}
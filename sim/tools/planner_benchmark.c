@@ -0,0 +1,276 @@
+/*
+ * Benchmark the speed run planner on a corpus of explored mazes.
+ *
+ * Mazes are read from corpus files or generated at random (see
+ * `maze_corpus.c`), with all their walls known. For each maze, the fastest
+ * run is planned with orthogonal moves only and with diagonal moves, and the
+ * planning time and predicted run times are reported.
+ *
+ * Each plan is replayed on the actual walls: straights must only cross open
+ * edges, and the run must stop at the center of a goal cell. The exit status
+ * is non-zero if any plan is invalid or missing.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "maze.h"
+#include "maze_corpus.h"
+#include "planner.h"
+
+#define HEADINGS_COUNT 8
+
+struct result {
+	uint16_t moves;
+	uint32_t expanded;
+	double planning;
+	float time;
+	bool valid;
+};
+
+/** Turn end point and angle, as a right turn heading north (north-east) */
+struct turn_end {
+	uint8_t type;
+	int x;
+	int y;
+	int angle;
+};
+
+static const struct turn_end turn_ends[] = {
+    {PLANNER_TURN_SEARCH_90, 1, 1, 2}, {PLANNER_TURN_90, 2, 2, 2},
+    {PLANNER_TURN_180, 4, 0, 4},       {PLANNER_TURN_45_IN, 1, 2, 1},
+    {PLANNER_TURN_135_IN, 2, 1, 3},    {PLANNER_TURN_V90, 2, 0, 2},
+    {PLANNER_TURN_45_OUT, 2, 1, 1},    {PLANNER_TURN_135_OUT, 2, -1, 3},
+};
+
+static const int delta_x[HEADINGS_COUNT] = {0, 1, 1, 1, 0, -1, -1, -1};
+static const int delta_y[HEADINGS_COUNT] = {1, 1, 0, -1, -1, -1, 0, 1};
+
+static const char *const move_names[] = {
+    "straight", "diagonal", "search 90", "90", "180", "45 in", "135 in",
+    "v90", "45 out", "135 out", "stop",
+};
+
+static bool verbose;
+
+static double now(void)
+{
+	struct timespec time;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Check a half grid point against the actual walls.
+ */
+static bool passable(const struct corpus_maze *truth, int x, int y)
+{
+	int limit = 2 * truth->size;
+
+	if (x <= 0 || y <= 0 || x >= limit || y >= limit)
+		return false;
+	if ((x & 1) && (y & 1))
+		return true;
+	if (x & 1)
+		return !truth->walls[y / 2][x / 2][MAZE_SOUTH];
+	if (y & 1)
+		return !truth->walls[y / 2][x / 2][MAZE_WEST];
+	return false;
+}
+
+/**
+ * @brief Replay a plan from the start cell, heading north.
+ */
+static bool replay(const struct corpus_maze *truth,
+		   const struct planner_move *moves, uint16_t count)
+{
+	const struct turn_end *turn;
+	int heading = 0;
+	int x = 1;
+	int y = 1;
+	int ex;
+	int ey;
+	int swap;
+	uint16_t i;
+	int j;
+
+	for (i = 0; i < count; i++) {
+		switch (moves[i].type) {
+		case PLANNER_STOP:
+			return i == count - 1 && (x & 1) && (y & 1) &&
+			       maze_is_goal((uint8_t)(x / 2), (uint8_t)(y / 2));
+		case PLANNER_STRAIGHT:
+		case PLANNER_DIAGONAL:
+			if ((moves[i].type == PLANNER_DIAGONAL) !=
+			    (heading & 1))
+				return false;
+			for (j = 0; j < moves[i].value; j++) {
+				x += delta_x[heading];
+				y += delta_y[heading];
+				if (!passable(truth, x, y))
+					return false;
+			}
+			break;
+		default:
+			turn = NULL;
+			for (j = 0; j < (int)(sizeof(turn_ends) /
+					      sizeof(turn_ends[0]));
+			     j++)
+				if (turn_ends[j].type == moves[i].type)
+					turn = &turn_ends[j];
+			if (!turn)
+				return false;
+			ex = turn->x;
+			ey = turn->y;
+			if (moves[i].value > 0) {
+				if (heading & 1) {
+					swap = ex;
+					ex = ey;
+					ey = swap;
+				} else {
+					ex = -ex;
+				}
+			}
+			for (j = heading / 2; j; j--) {
+				swap = ex;
+				ex = ey;
+				ey = -swap;
+			}
+			x += ex;
+			y += ey;
+			heading = (heading + (moves[i].value > 0 ? -turn->angle
+								: turn->angle) +
+				   HEADINGS_COUNT) %
+				  HEADINGS_COUNT;
+			if (!passable(truth, x, y))
+				return false;
+		}
+	}
+	return false;
+}
+
+static void print_moves(const struct planner_move *moves, uint16_t count)
+{
+	uint16_t i;
+
+	for (i = 0; i < count; i++) {
+		if (moves[i].type == PLANNER_STRAIGHT ||
+		    moves[i].type == PLANNER_DIAGONAL)
+			fprintf(stderr, "%s %d", move_names[moves[i].type],
+				moves[i].value);
+		else if (moves[i].type == PLANNER_STOP)
+			fprintf(stderr, "%s\n", move_names[moves[i].type]);
+		else
+			fprintf(stderr, "%s %s", move_names[moves[i].type],
+				moves[i].value > 0 ? "left" : "right");
+		if (i < count - 1)
+			fprintf(stderr, ", ");
+	}
+}
+
+static void plan(const struct corpus_maze *truth, bool diagonals,
+		 struct result *result)
+{
+	static struct planner_move moves[PLANNER_MAX_MOVES];
+	struct planner_limits limits;
+	struct planner_stats stats;
+
+	planner_get_limits(&limits);
+	limits.diagonals = diagonals;
+	planner_set_limits(&limits);
+	result->planning = now();
+	result->moves = planner_plan(moves, PLANNER_MAX_MOVES);
+	result->planning = now() - result->planning;
+	planner_get_stats(&stats);
+	result->expanded = stats.expanded;
+	result->time = stats.time;
+	result->valid = result->moves && replay(truth, moves, result->moves);
+	if (verbose)
+		print_moves(moves, result->moves);
+}
+
+static bool benchmark(const char *name, const struct corpus_maze *truth)
+{
+	struct result orthogonal;
+	struct result diagonal;
+
+	corpus_apply(truth);
+	plan(truth, false, &orthogonal);
+	plan(truth, true, &diagonal);
+	printf("%-24s %6u %6u %8u %10.0f %6u %8u %10.0f %8.3f %8.3f %6.1f%s\n",
+	       name, maze_distance(0, 0), orthogonal.moves, orthogonal.expanded,
+	       orthogonal.planning * 1e6, diagonal.moves, diagonal.expanded,
+	       diagonal.planning * 1e6, orthogonal.time, diagonal.time,
+	       100. * (orthogonal.time - diagonal.time) / orthogonal.time,
+	       orthogonal.valid && diagonal.valid ? "" : " INVALID");
+	return orthogonal.valid && diagonal.valid;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [-n MAZES] [-s SIZE] [-r SEED] [-v] [MAZE_FILE...]\n"
+		"\n"
+		"  -n  Random mazes to generate (default: 100 if no files)\n"
+		"  -s  Random maze size (default: 16)\n"
+		"  -r  Random seed (default: 1)\n"
+		"  -v  Print the planned moves to stderr\n",
+		name);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	static struct corpus_maze truth;
+	char name[32];
+	uint32_t invalid = 0;
+	int mazes = -1;
+	int size = MAZE_CLASSIC_SIZE;
+	int opt;
+	int i;
+
+	srand(1);
+	while ((opt = getopt(argc, argv, "n:s:r:vh")) != -1) {
+		switch (opt) {
+		case 'n':
+			mazes = atoi(optarg);
+			break;
+		case 's':
+			size = atoi(optarg);
+			if (size < 4 || size > MAZE_MAX_SIZE)
+				usage(argv[0]);
+			break;
+		case 'r':
+			srand((unsigned)atoi(optarg));
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (mazes < 0)
+		mazes = optind < argc ? 0 : 100;
+
+	printf("%-24s %6s %6s %8s %10s %6s %8s %10s %8s %8s %6s\n", "maze",
+	       "cells", "moves", "expanded", "plan (us)", "moves", "expanded",
+	       "plan (us)", "run (s)", "diag (s)", "gain %");
+	for (i = optind; i < argc; i++) {
+		if (!corpus_load(argv[i], &truth))
+			return EXIT_FAILURE;
+		invalid += !benchmark(strrchr(argv[i], '/')
+					  ? strrchr(argv[i], '/') + 1
+					  : argv[i],
+				      &truth);
+	}
+	for (i = 0; i < mazes; i++) {
+		corpus_generate(&truth, (uint8_t)size);
+		snprintf(name, sizeof(name), "random-%dx%d-%d", size, size, i);
+		invalid += !benchmark(name, &truth);
+	}
+	return invalid ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,225 @@
+/*
+ * Stress test of the lock-free queues (`src/queue.c`) with host threads.
+ *
+ * Producer threads push sequence-numbered elements as fast as they can while
+ * a consumer thread pops them, both retrying when the queue is full or empty.
+ * The consumer checks that every element arrives exactly once, intact and,
+ * for each producer, in order. Elements are larger than a word, so a torn
+ * copy is detected.
+ *
+ * Threads preempt each other at any instruction, which exercises far more
+ * interleavings than interrupt handlers on the robot. Build with `make tsan`
+ * to also check the memory ordering with ThreadSanitizer.
+ *
+ * The exit status is non-zero if any check fails.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "queue.h"
+
+#define MAX_PRODUCERS 16
+#define MAX_CAPACITY (1 << 16)
+#define SPIN_LIMIT 64
+
+struct element {
+	uint32_t producer;
+	uint32_t sequence;
+	uint64_t check;
+};
+
+struct producer {
+	pthread_t thread;
+	uint32_t id;
+	uint64_t full;
+};
+
+static struct spsc_queue spsc;
+static struct mpsc_queue mpsc;
+static struct element buffer[MAX_CAPACITY];
+static volatile uint32_t sequence[MAX_CAPACITY];
+static struct producer producers[MAX_PRODUCERS];
+static uint32_t producer_count = 4;
+static uint32_t element_count = 1000000;
+static uint32_t capacity = 64;
+static bool multiple;
+
+static double now(void)
+{
+	struct timespec time;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static uint64_t check_value(uint32_t producer, uint32_t number)
+{
+	uint64_t value = ((uint64_t)producer << 32 | number);
+
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdULL;
+	value ^= value >> 33;
+	return value;
+}
+
+static bool push(const struct element *element)
+{
+	return multiple ? mpsc_queue_push(&mpsc, element)
+			: spsc_queue_push(&spsc, element);
+}
+
+static bool pop(struct element *element)
+{
+	return multiple ? mpsc_queue_pop(&mpsc, element)
+			: spsc_queue_pop(&spsc, element);
+}
+
+/**
+ * @brief Back off after a failed push or pop, yielding every few tries.
+ */
+static void back_off(uint32_t *spins)
+{
+	if (++*spins % SPIN_LIMIT == 0)
+		sched_yield();
+}
+
+static void *produce(void *argument)
+{
+	struct producer *producer = argument;
+	struct element element;
+	uint32_t spins = 0;
+	uint32_t number;
+
+	element.producer = producer->id;
+	for (number = 0; number < element_count; number++) {
+		element.sequence = number;
+		element.check = check_value(producer->id, number);
+		while (!push(&element)) {
+			producer->full++;
+			back_off(&spins);
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Pop every element and check it.
+ *
+ * @return The number of errors.
+ */
+static uint64_t consume(uint64_t *empty)
+{
+	uint32_t expected[MAX_PRODUCERS] = {0};
+	uint64_t total = (uint64_t)element_count * producer_count;
+	uint64_t received = 0;
+	uint64_t errors = 0;
+	struct element element;
+	uint32_t spins = 0;
+
+	while (received < total) {
+		if (!pop(&element)) {
+			(*empty)++;
+			back_off(&spins);
+			continue;
+		}
+		received++;
+		if (element.producer >= producer_count ||
+		    element.check !=
+			check_value(element.producer, element.sequence)) {
+			if (errors++ < 10)
+				fprintf(stderr, "corrupted element %u/%u\n",
+					element.producer, element.sequence);
+			continue;
+		}
+		if (element.sequence != expected[element.producer] &&
+		    errors++ < 10)
+			fprintf(stderr, "producer %u: got %u, expected %u\n",
+				element.producer, element.sequence,
+				expected[element.producer]);
+		expected[element.producer] = element.sequence + 1;
+	}
+	if (pop(&element) && errors++ < 10)
+		fprintf(stderr, "unexpected element after the last one\n");
+	return errors;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [-m] [-p PRODUCERS] [-n ELEMENTS] [-c CAPACITY]\n"
+		"\n"
+		"  -m  Test the multi-producer queue (default: SPSC)\n"
+		"  -p  Producer threads, with -m (default: 4, max: %d)\n"
+		"  -n  Elements pushed by each producer (default: 1000000)\n"
+		"  -c  Queue capacity, a power of two (default: 64)\n",
+		name, MAX_PRODUCERS);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t empty = 0;
+	uint64_t full = 0;
+	uint64_t errors;
+	double start;
+	uint32_t i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "mp:n:c:h")) != -1) {
+		switch (opt) {
+		case 'm':
+			multiple = true;
+			break;
+		case 'p':
+			producer_count = (uint32_t)atoi(optarg);
+			break;
+		case 'n':
+			element_count = (uint32_t)atoi(optarg);
+			break;
+		case 'c':
+			capacity = (uint32_t)atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!multiple)
+		producer_count = 1;
+	if (!producer_count || producer_count > MAX_PRODUCERS ||
+	    capacity > MAX_CAPACITY)
+		usage(argv[0]);
+	if (multiple ? !mpsc_queue_init(&mpsc, buffer, sequence,
+					sizeof(buffer[0]), capacity)
+		     : !spsc_queue_init(&spsc, buffer, sizeof(buffer[0]),
+					capacity)) {
+		fprintf(stderr, "Invalid capacity %u\n", capacity);
+		return EXIT_FAILURE;
+	}
+
+	start = now();
+	for (i = 0; i < producer_count; i++) {
+		producers[i].id = i;
+		if (pthread_create(&producers[i].thread, NULL, produce,
+				   &producers[i])) {
+			perror("pthread_create");
+			return EXIT_FAILURE;
+		}
+	}
+	errors = consume(&empty);
+	for (i = 0; i < producer_count; i++) {
+		pthread_join(producers[i].thread, NULL);
+		full += producers[i].full;
+	}
+
+	printf("%s queue, %u producers, capacity %u: %llu elements in %.3f s, "
+	       "%llu full, %llu empty, %llu errors\n",
+	       multiple ? "MPSC" : "SPSC", producer_count, capacity,
+	       (unsigned long long)element_count * producer_count,
+	       now() - start, (unsigned long long)full,
+	       (unsigned long long)empty, (unsigned long long)errors);
+	return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,627 @@
+/*
+ * Replay recorded sensor logs through the firmware SysTick tasks.
+ *
+ * The input is the binary serial capture of a recording (see `recorder.c`):
+ * the known maze walls and a `RECORDER_START` record, followed by a
+ * `SENSORS` record per SysTick period and a `RECORDER_COMMAND` record per
+ * command received. Each period is fed to the unmodified parameters,
+ * odometry, gyroscope, estimator, motion, speed controller and collision
+ * modules, which read the recorded encoder counters, gyroscope FIFO, clock
+ * and cycle counter through the platform functions below, in the same order
+ * as the firmware tasks (`src/main.c`). Commands are executed with the
+ * firmware handlers after the period that precedes them in the capture,
+ * and the queued motion is fed after every period.
+ *
+ * The motors output is not simulated: the compare register writes are
+ * discarded, and the power applied to each motor (after saturation, see
+ * `motor.c`) is part of the outputs of each period.
+ *
+ * Each log is replayed in a child process, so it starts from the firmware
+ * zero-initialized state. The replay is deterministic: the digest of the
+ * outputs of every period only changes if the log or the firmware code
+ * does, so a library of runs can be checked for regressions by comparing
+ * the digests and final poses.
+ *
+ * The exit status is non-zero if any log can not be read or has no
+ * recording.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "collision.h"
+#include "command.h"
+#include "control.h"
+#include "estimator.h"
+#include "executive.h"
+#include "gyro.h"
+#include "motion.h"
+#include "motor.h"
+#include "odometry.h"
+#include "parameters.h"
+#include "telemetry.h"
+
+#define MPU_FIFO_COUNT_H 0x72
+#define MPU_FIFO_R_W 0x74
+
+#define CRC16_INIT 0xFFFF
+#define CRC16_POLYNOMIAL 0x1021
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+#define NANOMETERS_PER_METER 1e9
+
+struct result {
+	uint32_t records;
+	uint32_t commands;
+	uint32_t gaps;
+	uint32_t invalid;
+	uint32_t truncated;
+	uint64_t digest;
+	struct estimator_pose pose;
+	double host_time;
+};
+
+static struct telemetry_sensors current;
+static struct maze_map map;
+static uint32_t truncated_reads;
+static uint8_t pending_address;
+static uint8_t pending_size;
+static void (*pending_callback)(const uint8_t *data, uint8_t size);
+static bool csv;
+
+/*
+ * Platform functions, reading the current record.
+ */
+uint32_t cm_mask_interrupts(uint32_t mask)
+{
+	(void)mask;
+	return 0;
+}
+
+uint32_t read_cycle_counter(void)
+{
+	return current.cycles;
+}
+
+uint32_t dwt_read_cycle_counter(void)
+{
+	return current.cycles;
+}
+
+uint32_t get_clock_ticks(void)
+{
+	return current.ticks;
+}
+
+uint16_t get_battery_millivolts(void)
+{
+	return current.battery_millivolts;
+}
+
+uint32_t get_ir_readings(uint16_t readings[IR_SENSORS_COUNT])
+{
+	memcpy(readings, current.ir, sizeof(current.ir));
+	return current.ir_sequence;
+}
+
+uint16_t read_encoder_left(void)
+{
+	return current.encoder_left;
+}
+
+uint16_t read_encoder_right(void)
+{
+	return current.encoder_right;
+}
+
+/**
+ * @brief Read the recorded FIFO count and burst of samples.
+ *
+ * Samples missing from the record (see `struct recorder_stats`) read as
+ * zero, and the period is counted as truncated.
+ */
+void mpu_read_registers(uint8_t address, uint8_t *data, uint8_t size)
+{
+	uint8_t i;
+
+	memset(data, 0, size);
+	if (address == MPU_FIFO_COUNT_H && size == 2) {
+		data[0] = (uint8_t)(current.gyro_fifo_count >> 8);
+		data[1] = (uint8_t)current.gyro_fifo_count;
+		return;
+	}
+	if (address != MPU_FIFO_R_W)
+		return;
+	if (size / 2 > current.gyro_samples ||
+	    current.gyro_samples > sizeof(current.gyro) / sizeof(int16_t))
+		truncated_reads++;
+	for (i = 0; i + 1 < size && i / 2 < sizeof(current.gyro) / 2; i += 2) {
+		data[i] = (uint8_t)((uint16_t)current.gyro[i / 2] >> 8);
+		data[i + 1] = (uint8_t)current.gyro[i / 2];
+	}
+}
+
+/**
+ * @brief Start a burst read, completed when the next period is replayed.
+ *
+ * With `GYRO_FIFO_DMA`, the burst processed in a period is the one started
+ * in the previous period, and its samples are recorded with the former.
+ */
+bool mpu_read_registers_dma(uint8_t address, uint8_t size,
+			    void (*callback)(const uint8_t *data, uint8_t size))
+{
+	pending_address = address;
+	pending_size = size;
+	pending_callback = callback;
+	return true;
+}
+
+/**
+ * @brief Complete the pending burst read with the current record samples.
+ */
+bool mpu_read_registers_dma_busy(void)
+{
+	uint8_t data[MPU_BURST_MAX_SIZE];
+	void (*callback)(const uint8_t *data, uint8_t size) = pending_callback;
+
+	if (!callback)
+		return false;
+	pending_callback = NULL;
+	mpu_read_registers(pending_address, data, pending_size);
+	callback(data, pending_size);
+	return false;
+}
+
+void mpu_write_register(uint8_t address, uint8_t value)
+{
+	(void)address;
+	(void)value;
+}
+
+void setup_spi_low_speed(void)
+{
+}
+
+void setup_spi_high_speed(void)
+{
+}
+
+/*
+ * Motors output, discarded (the applied power is read from `motor.c`).
+ */
+volatile uint32_t *sim_mmio32(uint32_t address)
+{
+	static uint32_t discarded;
+
+	(void)address;
+	return &discarded;
+}
+
+void timer_set_oc_value(uint32_t timer_peripheral, enum tim_oc_id oc_id,
+			uint32_t value)
+{
+	(void)timer_peripheral;
+	(void)oc_id;
+	(void)value;
+}
+
+void timer_enable_update_event(uint32_t timer_peripheral)
+{
+	(void)timer_peripheral;
+}
+
+void timer_disable_update_event(uint32_t timer_peripheral)
+{
+	(void)timer_peripheral;
+}
+
+/*
+ * Firmware modules the command handlers use, without effect on the
+ * replayed outputs. Stored values are never loaded, and records sent to the
+ * host are discarded.
+ */
+bool storage_read(enum storage_key key, void *data, uint16_t size)
+{
+	(void)key;
+	(void)data;
+	(void)size;
+	return false;
+}
+
+bool storage_write(enum storage_key key, const void *data, uint16_t size)
+{
+	(void)key;
+	(void)data;
+	(void)size;
+	return true;
+}
+
+bool settings_save_maze(void)
+{
+	return true;
+}
+
+bool settings_save_calibration(void)
+{
+	return true;
+}
+
+bool telemetry_send(enum telemetry_record type, const void *record,
+		    uint8_t size)
+{
+	(void)type;
+	(void)record;
+	(void)size;
+	return true;
+}
+
+uint16_t telemetry_decode(uint8_t *frame, uint16_t size)
+{
+	(void)frame;
+	(void)size;
+	return 0;
+}
+
+void telemetry_set_state_period(uint16_t period)
+{
+	(void)period;
+}
+
+uint16_t serial_receive(uint8_t **frame)
+{
+	(void)frame;
+	return 0;
+}
+
+bool executive_get_stats(uint32_t index, struct task_stats *stats)
+{
+	(void)index;
+	(void)stats;
+	return false;
+}
+
+uint32_t executive_get_load(void)
+{
+	return 0;
+}
+
+void executive_reset_stats(void)
+{
+}
+
+void benchmark_conversions(void)
+{
+}
+
+void benchmark_placement(void)
+{
+}
+
+static double now(void)
+{
+	struct timespec time;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static uint16_t crc16(const uint8_t *data, size_t size)
+{
+	uint16_t crc = CRC16_INIT;
+	int bit;
+
+	while (size--) {
+		crc ^= (uint16_t)(*data++ << 8);
+		for (bit = 0; bit < 8; bit++)
+			crc = crc & 0x8000
+				  ? (uint16_t)(crc << 1) ^ CRC16_POLYNOMIAL
+				  : (uint16_t)(crc << 1);
+	}
+	return crc;
+}
+
+/**
+ * @brief Decode a COBS frame (without the delimiter) in place.
+ *
+ * @return The decoded size, or 0 if the frame is invalid.
+ */
+static size_t cobs_decode(uint8_t *frame, size_t size)
+{
+	size_t index = 0;
+	size_t length = 0;
+	uint8_t code;
+
+	while (index < size) {
+		code = frame[index];
+		if (!code || index + code > size)
+			return 0;
+		memmove(&frame[length], &frame[index + 1], code - 1);
+		length += code - 1;
+		index += code;
+		if (code < 0xFF && index < size)
+			frame[length++] = 0;
+	}
+	return length;
+}
+
+static void hash(uint64_t *digest, const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+
+	while (size--) {
+		*digest ^= *bytes++;
+		*digest *= FNV_PRIME;
+	}
+}
+
+/**
+ * @brief Restore the state captured when the recording started.
+ *
+ * The maze walls are the ones received before the start record. Parameters
+ * are applied as the `PARAMETER_SET` command does, so the speed controller
+ * ones take effect in the first period.
+ */
+static void start(const struct telemetry_recorder_start *record)
+{
+	uint8_t id;
+
+	current.encoder_left = record->encoder_left;
+	current.encoder_right = record->encoder_right;
+	current.ticks = record->ticks;
+	pending_callback = NULL;
+	odometry_reset();
+	estimator_init();
+	motion_reset();
+	gyro_recalibrate();
+	if (record->gyro_calibrated)
+		gyro_set_bias(record->gyro_bias);
+	parameters_load();
+	for (id = 0; id < PARAMETERS_COUNT; id++)
+		parameters_stage(id, record->parameters[id]);
+	parameters_apply();
+	map.size = record->maze_size;
+	if (!maze_set_map(&map))
+		maze_reset(MAZE_CLASSIC_SIZE);
+}
+
+/**
+ * @brief Run the SysTick tasks, as the firmware does, and the motion feed.
+ */
+static void tick(struct result *result)
+{
+	struct estimator_input input;
+	struct odometry odometry;
+	struct motion_setpoint setpoint;
+	struct estimator_pose *pose = &result->pose;
+	int32_t rate;
+	int32_t power_left;
+	int32_t power_right;
+	uint32_t start_cycles;
+
+	parameters_update();
+
+	odometry_update();
+	gyro_update();
+
+	odometry_get(&odometry);
+	input.delta_left = odometry.delta_left;
+	input.delta_right = odometry.delta_right;
+	input.gyro_z = gyro_get_rate();
+	start_cycles = read_cycle_counter();
+	estimator_update(&input);
+	estimator_account(read_cycle_counter() - start_cycles);
+
+	motion_update();
+	control_update();
+
+	collision_update();
+
+	motion_feed();
+
+	estimator_get(pose);
+	motion_get_setpoint(&setpoint);
+	rate = gyro_get_rate();
+	power_left = get_power_left();
+	power_right = get_power_right();
+	hash(&result->digest, &pose->x, sizeof(pose->x));
+	hash(&result->digest, &pose->y, sizeof(pose->y));
+	hash(&result->digest, &pose->heading, sizeof(pose->heading));
+	hash(&result->digest, &rate, sizeof(rate));
+	hash(&result->digest, &setpoint, sizeof(setpoint));
+	hash(&result->digest, &power_left, sizeof(power_left));
+	hash(&result->digest, &power_right, sizeof(power_right));
+	if (csv)
+		printf("%u,%.6f,%.6f,%.4f,%d,%d,%d,%d,%d\n", current.ticks,
+		       pose->x / NANOMETERS_PER_METER,
+		       pose->y / NANOMETERS_PER_METER,
+		       pose->heading * 360. / ESTIMATOR_ANGLE_PER_TURN, rate,
+		       setpoint.linear_velocity, setpoint.angular_velocity,
+		       power_left, power_right);
+}
+
+/**
+ * @brief Execute a recorded command, and feed the motion it queued.
+ *
+ * The command status is part of the outputs.
+ */
+static void execute(const struct telemetry_recorder_command *record,
+		    struct result *result)
+{
+	uint8_t status;
+
+	status = (uint8_t)command_execute(record->type, record->data,
+					  record->size);
+	motion_feed();
+	hash(&result->digest, &record->type, sizeof(record->type));
+	hash(&result->digest, &status, sizeof(status));
+}
+
+/**
+ * @brief Replay every frame of a capture, after the first start record.
+ */
+static bool replay(uint8_t *stream, size_t size, struct result *result)
+{
+	struct telemetry_recorder_start start_record;
+	struct telemetry_recorder_command command;
+	struct telemetry_recorder_maze maze;
+	uint8_t *frame = stream;
+	uint8_t *end = stream + size;
+	uint8_t *delimiter;
+	size_t length;
+	bool started = false;
+	uint32_t last_ticks = 0;
+
+	memset(result, 0, sizeof(*result));
+	result->digest = FNV_OFFSET;
+	result->host_time = now();
+	while ((delimiter = memchr(frame, 0, (size_t)(end - frame)))) {
+		length = cobs_decode(frame, (size_t)(delimiter - frame));
+		if (length >= 3 &&
+		    crc16(frame, length - 2) ==
+			(frame[length - 2] | frame[length - 1] << 8)) {
+			length -= 3;
+			if (frame[0] == TELEMETRY_RECORDER_MAZE &&
+			    length == sizeof(maze) && !started) {
+				memcpy(&maze, &frame[1], length);
+				if (maze.offset + sizeof(maze.walls) <=
+				    sizeof(map.walls))
+					memcpy(&map.walls[maze.offset],
+					       maze.walls, sizeof(maze.walls));
+			} else if (frame[0] == TELEMETRY_RECORDER_START &&
+				   length == sizeof(start_record) && !started) {
+				memcpy(&start_record, &frame[1], length);
+				start(&start_record);
+				last_ticks = start_record.ticks;
+				started = true;
+			} else if (frame[0] == TELEMETRY_SENSORS &&
+				   length == sizeof(current) && started) {
+				memcpy(&current, &frame[1], length);
+				result->gaps += current.ticks - last_ticks - 1;
+				last_ticks = current.ticks;
+				tick(result);
+				result->records++;
+			} else if (frame[0] == TELEMETRY_RECORDER_COMMAND &&
+				   length == sizeof(command) && started) {
+				memcpy(&command, &frame[1], length);
+				execute(&command, result);
+				result->commands++;
+			}
+		} else if (delimiter > frame) {
+			result->invalid++;
+		}
+		frame = delimiter + 1;
+	}
+	result->host_time = now() - result->host_time;
+	result->truncated = truncated_reads;
+	return started;
+}
+
+static bool replay_file(const char *path, struct result *result)
+{
+	uint8_t *stream;
+	FILE *file;
+	long size;
+	bool started;
+
+	file = fopen(path, "rb");
+	if (!file) {
+		perror(path);
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	stream = malloc((size_t)size + 1);
+	if (!stream || fread(stream, 1, (size_t)size, file) != (size_t)size) {
+		fprintf(stderr, "%s: read error\n", path);
+		fclose(file);
+		free(stream);
+		return false;
+	}
+	fclose(file);
+	started = replay(stream, (size_t)size, result);
+	free(stream);
+	if (!started)
+		fprintf(stderr, "%s: no recording found\n", path);
+	return started;
+}
+
+static void report(const char *path, const struct result *result)
+{
+	double simulated = (double)result->records / SYSTICK_FREQUENCY_HZ;
+
+	printf("%-24s %8u %6u %6u %6u %6u %9.4f %9.4f %8.2f %016llx %8.0f\n",
+	       strrchr(path, '/') ? strrchr(path, '/') + 1 : path,
+	       result->records, result->commands, result->gaps,
+	       result->invalid, result->truncated,
+	       result->pose.x / NANOMETERS_PER_METER,
+	       result->pose.y / NANOMETERS_PER_METER,
+	       result->pose.heading * 360. / ESTIMATOR_ANGLE_PER_TURN,
+	       (unsigned long long)result->digest,
+	       result->host_time > 0. ? simulated / result->host_time : 0.);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [-c] LOG_FILE...\n"
+		"\n"
+		"  -c  Write the outputs of every period as CSV instead of a\n"
+		"      summary per log\n",
+		name);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	struct result result;
+	uint32_t failed = 0;
+	pid_t child;
+	int status;
+	int opt;
+	int i;
+
+	while ((opt = getopt(argc, argv, "ch")) != -1) {
+		switch (opt) {
+		case 'c':
+			csv = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind >= argc)
+		usage(argv[0]);
+
+	if (csv)
+		printf("ticks,x,y,heading,gyro_rate,linear_velocity,"
+		       "angular_velocity,power_left,power_right\n");
+	else
+		printf("%-24s %8s %6s %6s %6s %6s %9s %9s %8s %16s %8s\n",
+		       "log", "ticks", "cmds", "gaps", "bad", "trunc", "x (m)",
+		       "y (m)", "heading", "digest", "speed");
+	fflush(stdout);
+	for (i = optind; i < argc; i++) {
+		child = fork();
+		if (child < 0) {
+			perror("fork");
+			return EXIT_FAILURE;
+		}
+		if (!child) {
+			if (!replay_file(argv[i], &result))
+				_exit(EXIT_FAILURE);
+			if (!csv)
+				report(argv[i], &result);
+			fflush(stdout);
+			_exit(EXIT_SUCCESS);
+		}
+		if (waitpid(child, &status, 0) < 0 || !WIFEXITED(status) ||
+		    WEXITSTATUS(status) != EXIT_SUCCESS)
+			failed++;
+	}
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,225 @@
+/*
+ * Check the framing of the commands received through the serial link.
+ *
+ * Each case is a full firmware simulation (see `simulation.c`) fed with a
+ * serial input that mixes valid command frames with empty frames
+ * (back-to-back delimiters), frames too long for the reception buffer (see
+ * `SERIAL_RX_MAX_FRAME`), complete or still growing when they are checked,
+ * and invalid ones, each followed right away by a command. At the end of the simulation, every command must have been
+ * received and decoded, and only the expected frames dropped or discarded.
+ *
+ * Each case runs in its own child process, from the firmware
+ * zero-initialized state. The exit status is non-zero if any case fails.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <libopencm3/cm3/cortex.h>
+
+#include "command.h"
+#include "serial.h"
+#include "telemetry.h"
+
+#include "../simulation.h"
+
+/** Simulated time to run each case, and to start feeding its input at */
+#define CASE_DURATION 0.5
+#define CASE_INPUT_DELAY 0.1
+
+#define MAX_INPUT 4096
+
+#define CRC16_INIT 0xFFFF
+#define CRC16_POLYNOMIAL 0x1021
+
+/**
+ * Test case: serial input and expected statistics at the end.
+ *
+ * - Valid commands.
+ * - Frames discarded for a bad encoding or CRC.
+ * - Frames dropped for being too long.
+ */
+struct test_case {
+	const char *name;
+	void (*build)(void);
+	uint32_t received;
+	uint32_t invalid;
+	uint32_t dropped;
+};
+
+static uint8_t input[MAX_INPUT];
+static size_t input_size;
+static const struct test_case *current;
+
+/* Firmware entry point (`main()` in `src/main.c`, renamed at build time) */
+int firmware_main(void);
+
+static uint16_t crc16(const uint8_t *data, size_t size)
+{
+	uint16_t crc = CRC16_INIT;
+	int bit;
+
+	while (size--) {
+		crc ^= (uint16_t)(*data++ << 8);
+		for (bit = 0; bit < 8; bit++)
+			crc = crc & 0x8000
+				  ? (uint16_t)(crc << 1) ^ CRC16_POLYNOMIAL
+				  : (uint16_t)(crc << 1);
+	}
+	return crc;
+}
+
+static void append(uint8_t byte, size_t count)
+{
+	while (count-- && input_size < MAX_INPUT)
+		input[input_size++] = byte;
+}
+
+/**
+ * @brief Append a `PROFILE_RESET` command frame, with its delimiter.
+ *
+ * The command has no fields, so the COBS encoding of the type and the CRC
+ * is a single block (none of them is zero).
+ */
+static void append_command(void)
+{
+	uint8_t record[3] = {TELEMETRY_PROFILE_RESET};
+	uint16_t crc = crc16(record, 1);
+
+	record[1] = (uint8_t)crc;
+	record[2] = (uint8_t)(crc >> 8);
+	append(sizeof(record) + 1, 1);
+	append(record[0], 1);
+	append(record[1], 1);
+	append(record[2], 1);
+	append(0, 1);
+}
+
+static void commands(void)
+{
+	append_command();
+	append_command();
+}
+
+static void empty_frames(void)
+{
+	append(0, 1);
+	append_command();
+	append(0, 2);
+	append_command();
+	append(0, 3);
+	append_command();
+}
+
+static void long_frame(void)
+{
+	append(0x55, SERIAL_RX_MAX_FRAME + 1);
+	append(0, 1);
+	append_command();
+	append(0x55, SERIAL_RX_MAX_FRAME + 1);
+	append(0, 2);
+	append_command();
+}
+
+/**
+ * @brief Append a frame that takes several command periods to receive.
+ *
+ * It is checked while still growing, so it must be dropped once and its
+ * remaining bytes discarded up to the delimiter.
+ */
+static void growing_frame(void)
+{
+	append(0x55, MAX_INPUT - 64);
+	append(0, 1);
+	append_command();
+}
+
+static void bad_frame(void)
+{
+	append(0x55, 4);
+	append(0, 1);
+	append_command();
+}
+
+static const struct test_case cases[] = {
+    {"commands", commands, 2, 0, 0},
+    {"empty-frames", empty_frames, 3, 0, 0},
+    {"long-frame", long_frame, 2, 0, 2},
+    {"growing-frame", growing_frame, 1, 0, 1},
+    {"bad-frame", bad_frame, 1, 1, 0},
+};
+
+/**
+ * @brief Check the statistics at the end of the case simulation.
+ */
+static void check(void)
+{
+	struct command_stats command;
+	struct serial_stats serial;
+
+	command_get_stats(&command);
+	serial_get_stats(&serial);
+	printf("%-16s %8u %8u %8u %s\n", current->name, command.received,
+	       command.invalid, serial.rx_dropped,
+	       command.received == current->received &&
+		       command.invalid == current->invalid &&
+		       serial.rx_dropped == current->dropped
+		   ? "ok"
+		   : "FAIL");
+	fflush(stdout);
+	if (command.received != current->received ||
+	    command.invalid != current->invalid ||
+	    serial.rx_dropped != current->dropped)
+		exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Run a case in the current (child) process, which never returns.
+ */
+static void run_case(const struct test_case *test)
+{
+	struct simulation_options options = {
+	    .duration = CASE_DURATION,
+	    .serial_input_delay = CASE_INPUT_DELAY,
+	    .finish_hook = check,
+	};
+
+	current = test;
+	test->build();
+	options.serial_input = fmemopen(input, input_size, "rb");
+	if (!options.serial_input) {
+		perror("fmemopen");
+		exit(EXIT_FAILURE);
+	}
+	simulation_start(&options);
+	firmware_main();
+	while (1)
+		__WFI();
+}
+
+int main(void)
+{
+	uint32_t failed = 0;
+	pid_t child;
+	int status;
+	size_t i;
+
+	printf("%-16s %8s %8s %8s\n", "case", "received", "invalid",
+	       "dropped");
+	fflush(stdout);
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		child = fork();
+		if (child < 0) {
+			perror("fork");
+			return EXIT_FAILURE;
+		}
+		if (!child)
+			run_case(&cases[i]);
+		if (waitpid(child, &status, 0) < 0 || !WIFEXITED(status) ||
+		    WEXITSTATUS(status) != EXIT_SUCCESS)
+			failed++;
+	}
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+#include "benchmark.h"
+
+/** ADC counts step between benchmark samples */
+#define BENCHMARK_COUNTS_STEP 7
+
+/** Iterations of the memory placement benchmark */
+#define BENCHMARK_PLACEMENT_ITERATIONS 1000
+
+static volatile float float_sink;
+static volatile uint16_t fixed_sink;
+static CCM struct estimator_state estimator_copy;
+
+/**
+ * @brief Float conversion of infrared counts to distance (reference).
+ */
+static float ir_counts_to_millimeters_float(enum ir_sensor sensor,
+					    uint16_t counts)
+{
+	float distance;
+
+	if (!counts)
+		return IR_MAX_DISTANCE_MM;
+	distance = ir_distance_models[sensor][0] / sqrtf((float)counts) +
+		   ir_distance_models[sensor][1];
+	if (distance > IR_MAX_DISTANCE_MM)
+		return IR_MAX_DISTANCE_MM;
+	if (distance < 0.f)
+		return 0.f;
+	return distance;
+}
+
+/**
+ * @brief Compare the cycles of the float and fixed-point conversions.
+ *
+ * Each conversion is timed in its own profiling zone, over the whole ADC
+ * range, so the results are sent with the profile report (see the
+ * `TELEMETRY_PROFILE_DUMP` command).
+ */
+void benchmark_conversions(void)
+{
+	enum ir_sensor sensor;
+	uint16_t counts;
+
+	for (counts = 0; counts < ADC_RESOLUTION;
+	     counts += BENCHMARK_COUNTS_STEP) {
+		sensor = counts % IR_SENSORS_COUNT;
+
+		PROFILE_BEGIN(PROFILE_BENCHMARK_IR_FLOAT);
+		float_sink = ir_counts_to_millimeters_float(sensor, counts);
+		PROFILE_END(PROFILE_BENCHMARK_IR_FLOAT);
+
+		PROFILE_BEGIN(PROFILE_BENCHMARK_IR_LUT);
+		fixed_sink = ir_counts_to_millimeters(sensor, counts);
+		PROFILE_END(PROFILE_BENCHMARK_IR_LUT);
+
+		PROFILE_BEGIN(PROFILE_BENCHMARK_BATTERY_FLOAT);
+		float_sink = (float)counts * (float)(ADC_LSB * VOLT_DIV_FACTOR);
+		PROFILE_END(PROFILE_BENCHMARK_BATTERY_FLOAT);
+
+		PROFILE_BEGIN(PROFILE_BENCHMARK_BATTERY_FIXED);
+		fixed_sink = battery_counts_to_millivolts(counts);
+		PROFILE_END(PROFILE_BENCHMARK_BATTERY_FIXED);
+	}
+}
+
+/**
+ * @brief Time the estimator step placed in SRAM, with its state in CCM.
+ *
+ * The step is run on a copy of the estimator state (placed like the real
+ * one), so the estimation task keeps updating the pose meanwhile. Run it
+ * with the firmware built with and without memory placement
+ * (`MEMORY_PLACEMENT=0`) and compare the profile reports (see the
+ * `TELEMETRY_PROFILE_DUMP` command). The motor output is timed by the speed
+ * controller itself (`PROFILE_MOTOR_OUTPUT`).
+ */
+void benchmark_placement(void)
+{
+	struct estimator_input input;
+	int32_t i;
+
+	memset(&estimator_copy, 0, sizeof(estimator_copy));
+	for (i = 0; i < BENCHMARK_PLACEMENT_ITERATIONS; i++) {
+		input.delta_left = i % 17;
+		input.delta_right = i % 23;
+		input.gyro_z = i * 64;
+
+		PROFILE_BEGIN(PROFILE_BENCHMARK_ESTIMATOR);
+		estimator_step(&estimator_copy, &input);
+		PROFILE_END(PROFILE_BENCHMARK_ESTIMATOR);
+	}
+}
@@ -0,0 +1,26 @@
+#ifndef __BENCHMARK_H
+#define __BENCHMARK_H
+
+#include <math.h>
+#include <stdint.h>
+
+#include "calibration.h"
+#include "estimator.h"
+#include "profile.h"
+#include "setup.h"
+
+/**
+ * Benchmarks, run with the `TELEMETRY_BENCHMARK` command.
+ *
+ * - `BENCHMARK_CONVERSIONS`: see `benchmark_conversions()`.
+ * - `BENCHMARK_PLACEMENT`: see `benchmark_placement()`.
+ */
+enum benchmark_test {
+	BENCHMARK_CONVERSIONS,
+	BENCHMARK_PLACEMENT,
+};
+
+void benchmark_conversions(void);
+void benchmark_placement(void);
+
+#endif /* __BENCHMARK_H */
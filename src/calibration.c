@@ -0,0 +1,45 @@
+/*
+ * Generated by `scripts/calibration.py`, do not edit.
+ */
+#include "calibration.h"
+
+uint16_t ir_distance_tables[IR_SENSORS_COUNT][LUT_SIZE] = {
+    /* front_right */
+    {
+	300, 300, 278, 220, 185, 161, 144, 130, 119, 110, 102, 96, 90, 85, 80,
+	76, 72, 69, 66, 63, 61, 58, 56, 54, 52, 50, 48, 47, 45, 44, 42, 41, 40,
+	38, 37, 36, 35, 34, 33, 32, 31, 30, 29, 29, 28, 27, 26, 26, 25, 24, 24,
+	23, 22, 22, 21, 21, 20, 20, 19, 19, 18, 18, 17, 17, 16,
+    },
+    /* side_right */
+    {
+	300, 300, 278, 220, 185, 161, 144, 130, 119, 110, 102, 96, 90, 85, 80,
+	76, 72, 69, 66, 63, 61, 58, 56, 54, 52, 50, 48, 47, 45, 44, 42, 41, 40,
+	38, 37, 36, 35, 34, 33, 32, 31, 30, 29, 29, 28, 27, 26, 26, 25, 24, 24,
+	23, 22, 22, 21, 21, 20, 20, 19, 19, 18, 18, 17, 17, 16,
+    },
+    /* side_left */
+    {
+	300, 300, 278, 220, 185, 161, 144, 130, 119, 110, 102, 96, 90, 85, 80,
+	76, 72, 69, 66, 63, 61, 58, 56, 54, 52, 50, 48, 47, 45, 44, 42, 41, 40,
+	38, 37, 36, 35, 34, 33, 32, 31, 30, 29, 29, 28, 27, 26, 26, 25, 24, 24,
+	23, 22, 22, 21, 21, 20, 20, 19, 19, 18, 18, 17, 17, 16,
+    },
+    /* front_left */
+    {
+	300, 300, 278, 220, 185, 161, 144, 130, 119, 110, 102, 96, 90, 85, 80,
+	76, 72, 69, 66, 63, 61, 58, 56, 54, 52, 50, 48, 47, 45, 44, 42, 41, 40,
+	38, 37, 36, 35, 34, 33, 32, 31, 30, 29, 29, 28, 27, 26, 26, 25, 24, 24,
+	23, 22, 22, 21, 21, 20, 20, 19, 19, 18, 18, 17, 17, 16,
+    },
+};
+
+const float ir_distance_models[IR_SENSORS_COUNT][2] = {
+    {3600.0f, -40.0f},
+    {3600.0f, -40.0f},
+    {3600.0f, -40.0f},
+    {3600.0f, -40.0f},
+};
+
+int32_t battery_millivolts_gain = 300960;
+int32_t battery_millivolts_offset = 0;
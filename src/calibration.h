@@ -0,0 +1,64 @@
+#ifndef __CALIBRATION_H
+#define __CALIBRATION_H
+
+#include <stdint.h>
+
+#include "infrared.h"
+#include "setup.h"
+
+/**
+ * Interpolation tables.
+ *
+ * Tables map 12-bit ADC counts to a value with a point every `2^LUT_SHIFT`
+ * counts (plus the end point), and are generated with
+ * `scripts/calibration.py` into `calibration.c`. Tables are kept in RAM so
+ * that they can be replaced with stored values (see `settings_load()`).
+ */
+#define LUT_SHIFT 6
+#define LUT_SIZE ((ADC_RESOLUTION >> LUT_SHIFT) + 1)
+
+/** Distance reported without reflection (as in `scripts/calibration.py`) */
+#define IR_MAX_DISTANCE_MM 300
+
+extern uint16_t ir_distance_tables[IR_SENSORS_COUNT][LUT_SIZE];
+extern const float ir_distance_models[IR_SENSORS_COUNT][2];
+extern int32_t battery_millivolts_gain;
+extern int32_t battery_millivolts_offset;
+
+/**
+ * @brief Linear interpolation on a table.
+ *
+ * @param[in] table Interpolation table.
+ * @param[in] counts ADC counts (0 to ADC_RESOLUTION - 1).
+ */
+static inline uint16_t lut_interpolate(const uint16_t table[LUT_SIZE],
+				       uint16_t counts)
+{
+	uint16_t index = counts >> LUT_SHIFT;
+	int32_t fraction = counts & ((1 << LUT_SHIFT) - 1);
+	int32_t low = table[index];
+	int32_t high = table[index + 1];
+
+	return (uint16_t)(low + (((high - low) * fraction) >> LUT_SHIFT));
+}
+
+/**
+ * @brief Convert infrared sensor counts to distance, in millimeters.
+ */
+static inline uint16_t ir_counts_to_millimeters(enum ir_sensor sensor,
+						uint16_t counts)
+{
+	return lut_interpolate(ir_distance_tables[sensor], counts);
+}
+
+/**
+ * @brief Convert battery ADC counts to voltage, in millivolts.
+ */
+static inline uint16_t battery_counts_to_millivolts(uint16_t counts)
+{
+	return (uint16_t)(((int64_t)counts * battery_millivolts_gain +
+			   battery_millivolts_offset) >>
+			  16);
+}
+
+#endif /* __CALIBRATION_H */
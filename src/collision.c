@@ -0,0 +1,190 @@
+#include "collision.h"
+
+/** SysTick periods with saturated PWM output that trigger a collision */
+#define SATURATION_TICKS                                                       \
+	((uint32_t)(MAX_PWM_SATURATION_PERIOD * SYSTICK_FREQUENCY_HZ))
+
+static volatile enum collision_policy policy = COLLISION_DRIVE_OFF;
+static volatile uint32_t saturation_ticks = SATURATION_TICKS;
+static volatile uint32_t saturated_ticks;
+static volatile bool detected;
+static volatile bool limited;
+static volatile int32_t unlimited_power;
+static struct collision_trip trips[COLLISION_LOG_SIZE];
+static volatile uint32_t trip_count;
+
+/**
+ * @brief Set the action taken when a collision is detected.
+ *
+ * The default is `COLLISION_DRIVE_OFF`. It can be tuned at runtime (see
+ * `parameters.h`).
+ */
+void collision_set_policy(enum collision_policy new_policy)
+{
+	policy = new_policy;
+}
+
+/**
+ * @brief Get the action taken when a collision is detected.
+ */
+enum collision_policy collision_get_policy(void)
+{
+	return policy;
+}
+
+/**
+ * @brief Set the SysTick periods with saturated PWM output that trigger a
+ * collision.
+ *
+ * The default is `MAX_PWM_SATURATION_PERIOD`.
+ */
+void collision_set_saturation_ticks(uint32_t ticks)
+{
+	saturation_ticks = ticks ? ticks : 1;
+}
+
+/**
+ * @brief Get the SysTick periods with saturated PWM output that trigger a
+ * collision.
+ */
+uint32_t collision_get_saturation_ticks(void)
+{
+	return saturation_ticks;
+}
+
+/**
+ * @brief Log a collision trip.
+ */
+static void log_trip(enum collision_policy action)
+{
+	struct collision_trip *trip = &trips[trip_count % COLLISION_LOG_SIZE];
+
+	trip->cycles = read_cycle_counter();
+	trip->ticks = get_clock_ticks();
+	trip->power_left = get_power_left();
+	trip->power_right = get_power_right();
+	trip->policy = action;
+	trip_count++;
+}
+
+/**
+ * @brief Stop the motors and ignore further power changes.
+ */
+static void stop(enum collision_policy action)
+{
+	if (action == COLLISION_DRIVE_BREAK)
+		drive_break();
+	else
+		drive_off();
+	lock_motors();
+	detected = true;
+	trace_freeze(TRACE_FREEZE_COLLISION);
+}
+
+/**
+ * @brief Supervise the motors output saturation.
+ *
+ * To be called once per SysTick period. A collision is detected when the
+ * PWM output stays saturated for the saturation period (see
+ * `collision_set_saturation_ticks()`), regardless of how often the motors
+ * power is updated. Only the output of the speed controller is supervised,
+ * so nothing is detected while it is disabled. Each trip is logged and the
+ * configured policy is applied. Saturation periods are traced, and the
+ * trace is frozen when the motors are stopped.
+ */
+void collision_update(void)
+{
+	if (detected)
+		return;
+	if (!control_is_enabled() || !pwm_saturation()) {
+		if (saturated_ticks)
+			trace(TRACE_SATURATION, 0,
+			      saturated_ticks > UINT16_MAX
+				  ? UINT16_MAX
+				  : (uint16_t)saturated_ticks);
+		saturated_ticks = 0;
+		return;
+	}
+	if (!saturated_ticks)
+		trace(TRACE_SATURATION, 1, 0);
+	if (++saturated_ticks < saturation_ticks)
+		return;
+	saturated_ticks = 0;
+
+	if (policy == COLLISION_LIMIT_CURRENT &&
+	    get_power_limit() > COLLISION_POWER_LIMIT) {
+		log_trip(COLLISION_LIMIT_CURRENT);
+		if (!limited)
+			unlimited_power = get_power_limit();
+		limited = true;
+		set_power_limit(COLLISION_POWER_LIMIT);
+		return;
+	}
+	log_trip(policy == COLLISION_DRIVE_BREAK ? COLLISION_DRIVE_BREAK
+						 : COLLISION_DRIVE_OFF);
+	stop(policy);
+}
+
+/**
+ * @brief Return whether the motors were stopped after a collision.
+ */
+bool collision_detected(void)
+{
+	return detected;
+}
+
+/**
+ * @brief Restore the motors after a collision.
+ *
+ * The power limit in effect before the `COLLISION_LIMIT_CURRENT` policy
+ * reduced it, if it did, is restored and the motors are unlocked. The trips
+ * log is kept.
+ */
+void collision_reset(void)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		detected = false;
+		saturated_ticks = 0;
+		reset_pwm_saturation();
+		if (limited)
+			set_power_limit(unlimited_power);
+		limited = false;
+		unlock_motors();
+	}
+}
+
+/**
+ * @brief Copy the latest collision trips, oldest first.
+ *
+ * @param[out] output Buffer to store the trips.
+ * @param[in] size Maximum number of trips to copy.
+ *
+ * @return Number of trips copied.
+ */
+uint32_t collision_get_trips(struct collision_trip *output, uint32_t size)
+{
+	uint32_t count = 0;
+	uint32_t first;
+	uint32_t i;
+
+	CM_ATOMIC_BLOCK()
+	{
+		first = trip_count > COLLISION_LOG_SIZE
+			    ? trip_count - COLLISION_LOG_SIZE
+			    : 0;
+		if (size > trip_count - first)
+			size = trip_count - first;
+		for (i = trip_count - size; i < trip_count; i++)
+			output[count++] = trips[i % COLLISION_LOG_SIZE];
+	}
+	return count;
+}
+
+/**
+ * @brief Return the total number of collision trips.
+ */
+uint32_t collision_trip_count(void)
+{
+	return trip_count;
+}
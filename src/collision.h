@@ -0,0 +1,54 @@
+#ifndef __COLLISION_H
+#define __COLLISION_H
+
+#include <stdint.h>
+
+#include <libopencm3/cm3/cortex.h>
+
+#include "mmlib/clock.h"
+
+#include "control.h"
+#include "motor.h"
+#include "platform.h"
+#include "trace.h"
+
+/** Number of collision trips kept in the log */
+#define COLLISION_LOG_SIZE 8
+
+/** Power limit applied by the `COLLISION_LIMIT_CURRENT` policy */
+#define COLLISION_POWER_LIMIT (MAX_PWM_PERIOD / 4)
+
+/**
+ * Action taken when a collision is detected.
+ *
+ * - `COLLISION_DRIVE_OFF`: let both motors coast and lock them.
+ * - `COLLISION_DRIVE_BREAK`: short both motor windings and lock them.
+ * - `COLLISION_LIMIT_CURRENT`: limit the motors power to
+ *   `COLLISION_POWER_LIMIT`. If the output keeps saturating for another
+ *   saturation period, the motors are turned off and locked.
+ */
+enum collision_policy {
+	COLLISION_DRIVE_OFF,
+	COLLISION_DRIVE_BREAK,
+	COLLISION_LIMIT_CURRENT,
+};
+
+struct collision_trip {
+	uint32_t cycles;
+	uint32_t ticks;
+	int32_t power_left;
+	int32_t power_right;
+	enum collision_policy policy;
+};
+
+void collision_set_policy(enum collision_policy policy);
+enum collision_policy collision_get_policy(void);
+void collision_set_saturation_ticks(uint32_t ticks);
+uint32_t collision_get_saturation_ticks(void);
+void collision_update(void);
+bool collision_detected(void);
+void collision_reset(void);
+uint32_t collision_get_trips(struct collision_trip *trips, uint32_t size);
+uint32_t collision_trip_count(void);
+
+#endif /* __COLLISION_H */
@@ -0,0 +1,533 @@
+#include "command.h"
+
+/**
+ * Command handlers, by record type.
+ *
+ * Each handler receives the record fields in place, in the reception ring
+ * buffer, and returns the execution status.
+ */
+struct command {
+	uint8_t type;
+	uint8_t size;
+	enum command_status (*run)(const void *record);
+};
+
+/** Events per `TELEMETRY_TRACE_EVENTS` record */
+#define TRACE_EVENTS_PER_RECORD                                                \
+	(sizeof(((struct telemetry_trace_events *)0)->id))
+
+static struct command_stats stats;
+
+/**
+ * Ongoing trace dump: events already sent and events to send, from the
+ * oldest one kept, and whether to resume tracing once done.
+ */
+static bool dumping;
+static uint32_t dump_offset;
+static uint32_t dump_count;
+static bool dump_resume;
+
+/**
+ * Ongoing profile report: next zone to send (`PROFILE_ZONES_COUNT` when
+ * there is none), and whether to reset the statistics once done.
+ */
+static uint8_t profile_next = PROFILE_ZONES_COUNT;
+static bool profile_reset_after;
+
+/**
+ * Ongoing task statistics report: next task to send, and whether to reset
+ * the statistics once done.
+ */
+static bool tasks_dumping;
+static uint32_t tasks_next;
+static bool tasks_reset_after;
+
+/**
+ * @brief Plan the fastest run on the known maze walls and start it.
+ *
+ * Rejected while the gyroscope is not calibrated, while moving or after a
+ * collision (until it is acknowledged with `COLLISION_RESET`), or if there
+ * is no path to the goal.
+ */
+static enum command_status start(const void *record)
+{
+	const struct telemetry_start *command = record;
+	static struct planner_move moves[PLANNER_MAX_MOVES];
+	struct planner_limits limits;
+	uint16_t count;
+
+	if (!gyro_calibrated() || !motion_is_idle() || collision_detected())
+		return COMMAND_REJECTED;
+	planner_get_limits(&limits);
+	limits.diagonals = command->diagonals;
+	planner_set_limits(&limits);
+	count = planner_plan(moves, PLANNER_MAX_MOVES);
+	if (!count)
+		return COMMAND_REJECTED;
+	motion_reset();
+	motion_run(moves, count);
+	control_enable();
+	return COMMAND_OK;
+}
+
+/**
+ * @brief Stop any motion and turn the motors off, or brake them.
+ */
+static enum command_status stop(const void *record)
+{
+	const struct telemetry_stop *command = record;
+
+	control_disable();
+	motion_reset();
+	if (command->brake)
+		drive_break();
+	return COMMAND_OK;
+}
+
+/**
+ * @brief Set the walls of a maze row, replacing the known walls.
+ *
+ * Rows must be sent in order: the first one resets the maze to the given
+ * size. Each cell has a bit per side (`1 << direction`) set if there is a
+ * wall. Rejected while moving.
+ */
+static enum command_status maze_row(const void *record)
+{
+	const struct telemetry_maze_row *command = record;
+	uint8_t direction;
+	uint8_t x;
+
+	if (!motion_is_idle() || !command->size ||
+	    command->size > sizeof(command->walls) ||
+	    command->row >= command->size)
+		return COMMAND_REJECTED;
+	if (!command->row)
+		maze_reset(command->size);
+	else if (maze_size() != command->size)
+		return COMMAND_REJECTED;
+	for (x = 0; x < command->size; x++)
+		for (direction = 0; direction < MAZE_DIRECTIONS_COUNT;
+		     direction++)
+			maze_set_wall(x, command->row,
+				      (enum maze_direction)direction,
+				      command->walls[x] & (1 << direction));
+	return COMMAND_OK;
+}
+
+/**
+ * @brief Send a parameter description and value.
+ */
+static bool send_parameter(uint8_t id)
+{
+	struct telemetry_parameter record;
+	struct parameter parameter;
+
+	if (!parameters_get(id, &parameter))
+		return false;
+	record.id = id;
+	record.type = (uint8_t)parameter.type;
+	record.when = (uint8_t)parameter.when;
+	record.value = parameter.value;
+	record.min = parameter.min;
+	record.max = parameter.max;
+	record.default_value = parameter.default_value;
+	return telemetry_send(TELEMETRY_PARAMETER, &record, sizeof(record));
+}
+
+/**
+ * @brief Send a `PARAMETER` record, or one per parameter for
+ * `PARAMETERS_ALL`.
+ *
+ * Rejected if the parameter does not exist or the records do not fit in
+ * the transmission buffer.
+ */
+static enum command_status parameter_get(const void *record)
+{
+	const struct telemetry_parameter_get *command = record;
+	uint8_t id;
+
+	if (command->id != PARAMETERS_ALL)
+		return send_parameter(command->id) ? COMMAND_OK
+						   : COMMAND_REJECTED;
+	for (id = 0; id < PARAMETERS_COUNT; id++)
+		if (!send_parameter(id))
+			return COMMAND_REJECTED;
+	return COMMAND_OK;
+}
+
+/**
+ * @brief Stage a parameter value and, if requested, apply all the staged
+ * values at once.
+ *
+ * Rejected if the value is out of range, or if the parameter can only be
+ * changed while stopped and the robot is moving.
+ */
+static enum command_status parameter_set(const void *record)
+{
+	const struct telemetry_parameter_set *command = record;
+	float value;
+
+	memcpy(&value, &command->value, sizeof(value));
+	if (!parameters_stage(command->id, value))
+		return COMMAND_REJECTED;
+	if (command->apply && !parameters_apply())
+		return COMMAND_REJECTED;
+	return COMMAND_OK;
+}
+
+/**
+ * @brief Store the current parameter values, or restore and store the
+ * defaults.
+ *
+ * Rejected while moving.
+ */
+static enum command_status parameter_commit(const void *record)
+{
+	const struct telemetry_parameter_commit *command = record;
+
+	if (command->defaults && !parameters_restore_defaults())
+		return COMMAND_REJECTED;
+	return parameters_commit() ? COMMAND_OK : COMMAND_REJECTED;
+}
+
+/**
+ * @brief Freeze the trace and start dumping it.
+ *
+ * A `TRACE_INFO` record is sent straight away. The events follow, oldest
+ * first, in `TRACE_EVENTS` records sent as the transmission queue drains
+ * (see `send_trace()`). If the trace was already frozen (i.e.: after a
+ * collision) the events that led to it are dumped. Rejected while another
+ * dump is ongoing.
+ */
+static enum command_status trace_dump(const void *record)
+{
+	const struct telemetry_trace_dump *command = record;
+	struct telemetry_trace_info info;
+
+	if (dumping)
+		return COMMAND_REJECTED;
+	trace_freeze(TRACE_FREEZE_REQUEST);
+	info.count = (uint16_t)trace_count();
+	info.frequency = SYSCLK_FREQUENCY_HZ;
+	if (!telemetry_send(TELEMETRY_TRACE_INFO, &info, sizeof(info)))
+		return COMMAND_REJECTED;
+	dump_offset = 0;
+	dump_count = info.count;
+	dump_resume = command->resume;
+	dumping = true;
+	return COMMAND_OK;
+}
+
+/**
+ * @brief Start streaming `STATE` records every given number of SysTick
+ * periods, or stop it with a zero period.
+ */
+static enum command_status state_stream(const void *record)
+{
+	const struct telemetry_state_stream *command = record;
+
+	telemetry_set_state_period(command->period);
+	return COMMAND_OK;
+}
+
+/**
+ * @brief Start sending the profiling zones statistics.
+ *
+ * A `PROFILE` record is sent per zone, as the transmission queue drains
+ * (see `send_profile()`). The statistics are reset once all of them are
+ * sent, if requested. Rejected while another report is ongoing.
+ */
+static enum command_status profile_dump(const void *record)
+{
+	const struct telemetry_profile_dump *command = record;
+
+	if (profile_next < PROFILE_ZONES_COUNT)
+		return COMMAND_REJECTED;
+	profile_next = 0;
+	profile_reset_after = command->reset;
+	return COMMAND_OK;
+}
+
+/**
+ * @brief Reset the statistics of all profiling zones.
+ */
+static enum command_status reset_profile(const void *record)
+{
+	(void)record;
+	profile_reset();
+	return COMMAND_OK;
+}
+
+/**
+ * @brief Start sending the CPU load and the statistics of each task.
+ *
+ * A `TASK_STATS` record is sent per task, in the task table order, as the
+ * transmission queue drains (see `send_tasks()`). The statistics are reset
+ * once all of them are sent, if requested. Rejected while another report
+ * is ongoing.
+ */
+static enum command_status task_stats_dump(const void *record)
+{
+	const struct telemetry_task_stats_dump *command = record;
+
+	if (tasks_dumping)
+		return COMMAND_REJECTED;
+	tasks_next = 0;
+	tasks_reset_after = command->reset;
+	tasks_dumping = true;
+	return COMMAND_OK;
+}
+
+/**
+ * @brief Run a benchmark (`enum benchmark_test`).
+ *
+ * The results are accumulated in their profiling zones, to be sent with
+ * `PROFILE_DUMP`. Rejected for unknown benchmarks.
+ */
+static enum command_status benchmark(const void *record)
+{
+	const struct telemetry_benchmark *command = record;
+
+	switch (command->test) {
+	case BENCHMARK_CONVERSIONS:
+		benchmark_conversions();
+		return COMMAND_OK;
+	case BENCHMARK_PLACEMENT:
+		benchmark_placement();
+		return COMMAND_OK;
+	default:
+		return COMMAND_REJECTED;
+	}
+}
+
+/**
+ * @brief Acknowledge a collision: stop any motion and restore the motors.
+ *
+ * The speed controller is left disabled, so the next run must be started
+ * with `START`.
+ */
+static enum command_status reset_collision(const void *record)
+{
+	(void)record;
+	control_disable();
+	motion_reset();
+	collision_reset();
+	return COMMAND_OK;
+}
+
+/**
+ * @brief Start or stop recording the sensor inputs and commands.
+ *
+ * Starting is rejected while moving or after a collision, as the replay
+ * starts from a stopped robot, or if the start records do not fit in the
+ * transmission queue.
+ */
+static enum command_status recorder(const void *record)
+{
+	const struct telemetry_recorder *command = record;
+
+	if (!command->start) {
+		recorder_stop();
+		return COMMAND_OK;
+	}
+	if (!motion_is_idle() || control_is_enabled() || collision_detected())
+		return COMMAND_REJECTED;
+	return recorder_start() ? COMMAND_OK : COMMAND_REJECTED;
+}
+
+/**
+ * @brief Store the known maze walls, to be loaded on the next startup.
+ *
+ * Rejected unless the robot is stopped (see `control_robot_stopped()`), as
+ * writing to flash stalls the CPU.
+ */
+static enum command_status maze_save(const void *record)
+{
+	(void)record;
+	if (!control_robot_stopped())
+		return COMMAND_REJECTED;
+	return settings_save_maze() ? COMMAND_OK : COMMAND_REJECTED;
+}
+
+/**
+ * @brief Store the IR sensors and battery calibration, to be loaded on the
+ * next startup.
+ *
+ * Rejected unless the robot is stopped, as `MAZE_SAVE`.
+ */
+static enum command_status calibration_save(const void *record)
+{
+	(void)record;
+	if (!control_robot_stopped())
+		return COMMAND_REJECTED;
+	return settings_save_calibration() ? COMMAND_OK : COMMAND_REJECTED;
+}
+
+static const struct command commands[] = {
+    {TELEMETRY_START, sizeof(struct telemetry_start), start},
+    {TELEMETRY_STOP, sizeof(struct telemetry_stop), stop},
+    {TELEMETRY_MAZE_ROW, sizeof(struct telemetry_maze_row), maze_row},
+    {TELEMETRY_PARAMETER_GET, sizeof(struct telemetry_parameter_get),
+     parameter_get},
+    {TELEMETRY_PARAMETER_SET, sizeof(struct telemetry_parameter_set),
+     parameter_set},
+    {TELEMETRY_PARAMETER_COMMIT, sizeof(struct telemetry_parameter_commit),
+     parameter_commit},
+    {TELEMETRY_TRACE_DUMP, sizeof(struct telemetry_trace_dump), trace_dump},
+    {TELEMETRY_STATE_STREAM, sizeof(struct telemetry_state_stream),
+     state_stream},
+    {TELEMETRY_PROFILE_DUMP, sizeof(struct telemetry_profile_dump),
+     profile_dump},
+    {TELEMETRY_PROFILE_RESET, sizeof(struct telemetry_profile_reset),
+     reset_profile},
+    {TELEMETRY_TASK_STATS_DUMP, sizeof(struct telemetry_task_stats_dump),
+     task_stats_dump},
+    {TELEMETRY_BENCHMARK, sizeof(struct telemetry_benchmark), benchmark},
+    {TELEMETRY_COLLISION_RESET, sizeof(struct telemetry_collision_reset),
+     reset_collision},
+    {TELEMETRY_RECORDER, sizeof(struct telemetry_recorder), recorder},
+    {TELEMETRY_MAZE_SAVE, sizeof(struct telemetry_maze_save), maze_save},
+    {TELEMETRY_CALIBRATION_SAVE, sizeof(struct telemetry_calibration_save),
+     calibration_save},
+};
+
+/**
+ * @brief Execute a decoded command record.
+ *
+ * Also used by the host replay of recorded commands (see `recorder.h`).
+ */
+enum command_status command_execute(uint8_t type, const uint8_t *record,
+				    uint16_t size)
+{
+	uint8_t i;
+
+	for (i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+		if (commands[i].type != type)
+			continue;
+		if (commands[i].size != size)
+			return COMMAND_BAD_SIZE;
+		return commands[i].run(record);
+	}
+	return COMMAND_UNKNOWN;
+}
+
+/**
+ * @brief Send the next events of an ongoing trace dump, while they fit in
+ * the transmission queue.
+ *
+ * Once all the events are sent, tracing is resumed if requested.
+ */
+static void send_trace(void)
+{
+	struct trace_event events[TRACE_EVENTS_PER_RECORD];
+	struct telemetry_trace_events record;
+	uint32_t count;
+	uint32_t i;
+
+	while (dumping) {
+		if (dump_offset >= dump_count) {
+			dumping = false;
+			if (dump_resume)
+				trace_resume();
+			return;
+		}
+		memset(&record, 0, sizeof(record));
+		count = trace_read(dump_offset, events,
+				   TRACE_EVENTS_PER_RECORD);
+		record.offset = (uint16_t)dump_offset;
+		record.count = (uint8_t)count;
+		for (i = 0; i < count; i++) {
+			record.cycles[i] = events[i].cycles;
+			record.type[i] = events[i].type;
+			record.id[i] = events[i].id;
+			record.value[i] = events[i].value;
+		}
+		if (!telemetry_send(TELEMETRY_TRACE_EVENTS, &record,
+				    sizeof(record)))
+			return;
+		dump_offset += count;
+	}
+}
+
+/**
+ * @brief Send the next zones of an ongoing profile report, while they fit
+ * in the transmission queue.
+ */
+static void send_profile(void)
+{
+	if (profile_next >= PROFILE_ZONES_COUNT)
+		return;
+	profile_next = profile_send_report(profile_next);
+	if (profile_next == PROFILE_ZONES_COUNT && profile_reset_after)
+		profile_reset();
+}
+
+/**
+ * @brief Send the next tasks of an ongoing task statistics report, while
+ * they fit in the transmission queue.
+ */
+static void send_tasks(void)
+{
+	struct telemetry_task_stats record;
+	struct task_stats task;
+
+	while (tasks_dumping) {
+		if (!executive_get_stats(tasks_next, &task)) {
+			tasks_dumping = false;
+			if (tasks_reset_after)
+				executive_reset_stats();
+			return;
+		}
+		record.task = (uint8_t)tasks_next;
+		record.load = (uint16_t)executive_get_load();
+		record.runs = task.runs;
+		record.overruns = task.overruns;
+		record.last = task.last;
+		record.wcet = task.wcet;
+		record.total = task.total;
+		if (!telemetry_send(TELEMETRY_TASK_STATS, &record,
+				    sizeof(record)))
+			return;
+		tasks_next++;
+	}
+}
+
+/**
+ * @brief Execute the commands received since the last call.
+ *
+ * Run as a background task, often enough for the reception ring buffer not
+ * to overrun (see `SERIAL_RX_BUFFER_SIZE`). Frames are decoded and parsed
+ * in place. Every valid frame is executed, recorded if the recorder is
+ * running, and acknowledged with a `COMMAND_ACK` record. Ongoing trace
+ * dumps, profile and task statistics reports continue afterwards.
+ */
+void command_update(void)
+{
+	struct telemetry_command_ack ack;
+	uint8_t *frame;
+	uint16_t size;
+
+	while ((size = serial_receive(&frame))) {
+		size = telemetry_decode(frame, size);
+		if (!size) {
+			stats.invalid++;
+			continue;
+		}
+		stats.received++;
+		ack.command = frame[0];
+		ack.status =
+		    (uint8_t)command_execute(frame[0], &frame[1], size - 1);
+		recorder_command(frame[0], &frame[1], size - 1);
+		if (ack.status != COMMAND_OK)
+			stats.failed++;
+		telemetry_send(TELEMETRY_COMMAND_ACK, &ack, sizeof(ack));
+	}
+	send_trace();
+	send_profile();
+	send_tasks();
+}
+
+void command_get_stats(struct command_stats *copy)
+{
+	*copy = stats;
+}
@@ -0,0 +1,58 @@
+#ifndef __COMMAND_H
+#define __COMMAND_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "benchmark.h"
+#include "collision.h"
+#include "control.h"
+#include "executive.h"
+#include "gyro.h"
+#include "maze.h"
+#include "motion.h"
+#include "motor.h"
+#include "parameters.h"
+#include "planner.h"
+#include "profile.h"
+#include "recorder.h"
+#include "serial.h"
+#include "settings.h"
+#include "telemetry.h"
+#include "trace.h"
+
+/**
+ * Command execution status, reported in the `TELEMETRY_COMMAND_ACK` record.
+ *
+ * - `COMMAND_OK`: the command was executed.
+ * - `COMMAND_REJECTED`: the command can not be executed in the current
+ *   state (i.e.: starting a run while moving).
+ * - `COMMAND_BAD_SIZE`: the record size does not match the schema.
+ * - `COMMAND_UNKNOWN`: the record type is not a known command.
+ */
+enum command_status {
+	COMMAND_OK,
+	COMMAND_REJECTED,
+	COMMAND_BAD_SIZE,
+	COMMAND_UNKNOWN,
+};
+
+/**
+ * Command statistics.
+ *
+ * - Valid frames received.
+ * - Frames discarded for a bad encoding or CRC.
+ * - Commands not executed (any status but `COMMAND_OK`).
+ */
+struct command_stats {
+	uint32_t received;
+	uint32_t invalid;
+	uint32_t failed;
+};
+
+enum command_status command_execute(uint8_t type, const uint8_t *record,
+				    uint16_t size);
+void command_update(void);
+void command_get_stats(struct command_stats *stats);
+
+#endif /* __COMMAND_H */
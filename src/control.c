@@ -0,0 +1,130 @@
+#include "control.h"
+
+/** Linear velocity scale, from micrometers to meters per second */
+#define LINEAR_SCALE (1.f / MICROMETERS_PER_METER)
+
+/** Wheel speed per angular velocity, from microradians to meters/second */
+#define ANGULAR_SCALE                                                          \
+	(WHEELS_SEPARATION_MICROMETERS / 2.f / MICROMETERS_PER_METER /        \
+	 1000000.f)
+
+static struct control_gains gains = {
+    .feedforward = 168.f,
+    .linear_kp = 1500.f,
+    .linear_ki = 40000.f,
+    .angular_kp = 4000.f,
+    .angular_ki = 40000.f,
+};
+static volatile bool enabled;
+static CCM float linear_integral;
+static CCM float angular_integral;
+
+/**
+ * @brief Set the speed controller gains.
+ *
+ * They take effect in the next SysTick period, so they can be changed while
+ * the controller is running.
+ */
+void control_set_gains(const struct control_gains *new_gains)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		gains = *new_gains;
+	}
+}
+
+void control_get_gains(struct control_gains *copy)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		*copy = gains;
+	}
+}
+
+/**
+ * @brief Start driving the motors from the motion setpoints.
+ *
+ * The integral terms start from zero.
+ */
+void control_enable(void)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		linear_integral = 0.f;
+		angular_integral = 0.f;
+		enabled = true;
+	}
+}
+
+/**
+ * @brief Stop driving the motors, letting them coast.
+ */
+void control_disable(void)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		enabled = false;
+		drive_off();
+	}
+}
+
+bool control_is_enabled(void)
+{
+	return enabled;
+}
+
+/**
+ * @brief Whether the robot is stopped and not about to move.
+ *
+ * That is, no motion is queued, the speed controller is disabled and the
+ * wheels are not moving. Long operations that stall the CPU (i.e.: flash
+ * writes, see `storage_write()`) must only be started when this is true.
+ */
+bool control_robot_stopped(void)
+{
+	return motion_is_idle() && !enabled &&
+	       !odometry_get_linear_velocity() &&
+	       !odometry_get_angular_velocity();
+}
+
+/**
+ * @brief Drive the motors to follow the motion setpoints.
+ *
+ * To be called once per SysTick period, after `motion_update()` and the
+ * odometry update. Each loop adds a feed-forward term to a PI controller on
+ * the filtered odometry velocities. The integral terms are frozen while the
+ * output is saturated, so they do not wind up against a wall.
+ */
+RAMFUNC void control_update(void)
+{
+	struct motion_setpoint setpoint;
+	float linear_target;
+	float angular_target;
+	float linear_error;
+	float angular_error;
+	float linear;
+	float angular;
+
+	if (!enabled)
+		return;
+	motion_get_setpoint(&setpoint);
+	linear_target = setpoint.linear_velocity * LINEAR_SCALE;
+	angular_target = setpoint.angular_velocity * ANGULAR_SCALE;
+	linear_error =
+	    linear_target - odometry_get_linear_velocity() * LINEAR_SCALE;
+	angular_error =
+	    angular_target - odometry_get_angular_velocity() * ANGULAR_SCALE;
+	if (!pwm_saturation()) {
+		linear_integral += linear_error / SYSTICK_FREQUENCY_HZ;
+		angular_integral += angular_error / SYSTICK_FREQUENCY_HZ;
+	}
+	linear = gains.feedforward * linear_target +
+		 gains.linear_kp * linear_error +
+		 gains.linear_ki * linear_integral;
+	angular = gains.feedforward * angular_target +
+		  gains.angular_kp * angular_error +
+		  gains.angular_ki * angular_integral;
+	PROFILE_BEGIN(PROFILE_MOTOR_OUTPUT);
+	power_both((int32_t)(linear - angular), (int32_t)(linear + angular));
+	PROFILE_END(PROFILE_MOTOR_OUTPUT);
+}
@@ -0,0 +1,44 @@
+#ifndef __CONTROL_H
+#define __CONTROL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <libopencm3/cm3/cortex.h>
+
+#include "motion.h"
+#include "motor.h"
+#include "odometry.h"
+#include "profile.h"
+#include "setup.h"
+
+/**
+ * Speed controller gains.
+ *
+ * The linear and angular loops both work with wheel speeds: the angular
+ * velocity is converted to the speed difference between each wheel and the
+ * robot center.
+ *
+ * - Feed-forward, in PWM counts per meter per second.
+ * - Linear loop proportional gain, in PWM counts per meter per second.
+ * - Linear loop integral gain, in PWM counts per meter.
+ * - Angular loop proportional gain, in PWM counts per meter per second.
+ * - Angular loop integral gain, in PWM counts per meter.
+ */
+struct control_gains {
+	float feedforward;
+	float linear_kp;
+	float linear_ki;
+	float angular_kp;
+	float angular_ki;
+};
+
+void control_set_gains(const struct control_gains *gains);
+void control_get_gains(struct control_gains *gains);
+void control_enable(void);
+void control_disable(void);
+bool control_is_enabled(void);
+bool control_robot_stopped(void);
+void control_update(void);
+
+#endif /* __CONTROL_H */
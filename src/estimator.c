@@ -0,0 +1,179 @@
+#include "estimator.h"
+
+/** Sine table: a quarter turn in `2^SINE_BITS` steps, in Q1.15 */
+#define SINE_BITS 8
+#define SINE_SIZE ((1 << SINE_BITS) + 1)
+#define SINE_ONE 32768
+#define QUARTER_SHIFT 30
+#define INDEX_SHIFT (QUARTER_SHIFT - SINE_BITS)
+
+/** Wheel travel per encoder count, in nanometers */
+#define NANOMETERS_PER_COUNT                                                   \
+	(2 * PI * WHEEL_RADIUS_MICROMETERS * 1000 /                            \
+	 (MOTOR_GEAR_RATIO * ENCODER_COUNTS_PER_MOTOR_REVOLUTION))
+
+/**
+ * Heading change per count of difference between the wheels, and per
+ * gyroscope LSB in a SysTick period, in binary angle units (Q8).
+ */
+#define ODOMETRY_ANGLE_PER_COUNT                                               \
+	((int64_t)(NANOMETERS_PER_COUNT /                                      \
+		   (WHEELS_SEPARATION_MICROMETERS * 1000.) /                   \
+		   (2 * PI) * ESTIMATOR_ANGLE_PER_TURN * 256))
+#define GYRO_ANGLE_PER_LSB                                                     \
+	((int64_t)(ESTIMATOR_ANGLE_PER_TURN / ESTIMATOR_GYRO_LSB_PER_DPS /     \
+		   (360. * SYSTICK_FREQUENCY_HZ) * 256))
+#define NANOMETERS_PER_COUNT_Q8 ((int64_t)(NANOMETERS_PER_COUNT * 256))
+
+static CCM int32_t sine[SINE_SIZE];
+static CCM struct estimator_state estimate;
+static CCM struct estimator_stats stats;
+
+/**
+ * @brief Build the sine table and reset the estimate.
+ *
+ * The table is computed once (in float) so that the update only uses
+ * integer arithmetic.
+ */
+void estimator_init(void)
+{
+	int i;
+
+	for (i = 0; i < SINE_SIZE; i++)
+		sine[i] = (int32_t)lroundf(
+		    sinf((float)i / (SINE_SIZE - 1) * (float)PI / 2) *
+		    SINE_ONE);
+	estimator_reset();
+}
+
+/**
+ * @brief Reset the pose (origin, heading 0) and the statistics.
+ */
+void estimator_reset(void)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		memset(&estimate, 0, sizeof(estimate));
+		memset(&stats, 0, sizeof(stats));
+	}
+}
+
+/**
+ * @brief Sine of a binary angle, in Q1.15, with linear interpolation.
+ */
+RAMFUNC int32_t estimator_sin(uint32_t angle)
+{
+	uint32_t quadrant = angle >> QUARTER_SHIFT;
+	uint32_t offset = angle & ((1u << QUARTER_SHIFT) - 1);
+	uint32_t index;
+	int32_t fraction;
+	int32_t value;
+
+	if (quadrant & 1)
+		offset = (1u << QUARTER_SHIFT) - offset;
+	index = offset >> INDEX_SHIFT;
+	fraction = (int32_t)((offset >> (INDEX_SHIFT - 15)) & 0x7FFF);
+	value = sine[index];
+	if (index < SINE_SIZE - 1)
+		value += ((sine[index + 1] - value) * fraction) >> 15;
+	return (quadrant & 2) ? -value : value;
+}
+
+/**
+ * @brief Cosine of a binary angle, in Q1.15.
+ */
+RAMFUNC int32_t estimator_cos(uint32_t angle)
+{
+	return estimator_sin(angle + (1u << QUARTER_SHIFT));
+}
+
+/**
+ * @brief Update an estimator state with the measurements of a period.
+ *
+ * The heading is the gyroscope heading, corrected towards the odometry
+ * heading by a complementary filter. The position is integrated with the
+ * mean wheel travel along the mid-period heading.
+ *
+ * Only integer multiplications, shifts and a table interpolation are used,
+ * with no loops nor data-dependent branches, so the execution time is
+ * bounded (see `estimator_account()`).
+ *
+ * @param[in,out] state State to update (i.e.: a copy, for benchmarking).
+ * @param[in] input Measurements of the period.
+ */
+RAMFUNC void estimator_step(struct estimator_state *state,
+			    const struct estimator_input *input)
+{
+	struct estimator_pose *pose = &state->pose;
+	int32_t difference = input->delta_right - input->delta_left;
+	int32_t gyro_rotation;
+	int32_t correction;
+	uint32_t middle;
+	int64_t distance;
+
+	state->odometry_heading +=
+	    (uint32_t)((difference * ODOMETRY_ANGLE_PER_COUNT) >> 8);
+	gyro_rotation = (int32_t)((input->gyro_z * GYRO_ANGLE_PER_LSB) >>
+				  (8 + ESTIMATOR_GYRO_RATE_SHIFT));
+	correction = (int32_t)(state->odometry_heading -
+			       (pose->heading + gyro_rotation));
+	pose->rotation =
+	    gyro_rotation + (correction >> ESTIMATOR_ODOMETRY_SHIFT);
+
+	distance = ((input->delta_left + input->delta_right) *
+		    NANOMETERS_PER_COUNT_Q8) >>
+		   9;
+	middle = pose->heading + (uint32_t)(pose->rotation / 2);
+	pose->x += (distance * estimator_cos(middle)) >> 15;
+	pose->y += (distance * estimator_sin(middle)) >> 15;
+	pose->heading += (uint32_t)pose->rotation;
+	pose->distance = (int32_t)distance;
+}
+
+/**
+ * @brief Update the pose with the measurements of a SysTick period.
+ *
+ * @see `estimator_step()`.
+ */
+RAMFUNC void estimator_update(const struct estimator_input *input)
+{
+	estimator_step(&estimate, input);
+}
+
+/**
+ * @brief Account for the cycles taken by an update.
+ *
+ * Updates exceeding `ESTIMATOR_CYCLE_BUDGET` are counted.
+ *
+ * @param[in] cycles Cycles measured with `read_cycle_counter()`.
+ */
+void estimator_account(uint32_t cycles)
+{
+	stats.updates++;
+	if (cycles > stats.wcet)
+		stats.wcet = cycles;
+	if (cycles > ESTIMATOR_CYCLE_BUDGET)
+		stats.over_budget++;
+}
+
+/**
+ * @brief Get a consistent copy of the estimated pose.
+ */
+void estimator_get(struct estimator_pose *output)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		*output = estimate.pose;
+	}
+}
+
+/**
+ * @brief Get a consistent copy of the estimator statistics.
+ */
+void estimator_get_stats(struct estimator_stats *output)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		*output = stats;
+	}
+}
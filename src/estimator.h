@@ -0,0 +1,88 @@
+#ifndef __ESTIMATOR_H
+#define __ESTIMATOR_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <libopencm3/cm3/cortex.h>
+
+#include "setup.h"
+
+/**
+ * Heading units (binary angle): a full turn is 2^32, so angles wrap
+ * naturally with integer arithmetic.
+ */
+#define ESTIMATOR_ANGLE_PER_TURN 4294967296.
+
+/** Gyroscope sensitivity, with the full scale set to 2000 deg/s */
+#define ESTIMATOR_GYRO_LSB_PER_DPS 16.4
+#define ESTIMATOR_GYRO_RATE_SHIFT 8
+
+/**
+ * Complementary filter gain (`1 / 2^ESTIMATOR_ODOMETRY_SHIFT`).
+ *
+ * The gyroscope heading is corrected towards the odometry heading with this
+ * gain every period, which removes the gyroscope bias drift at low
+ * frequencies (a time constant of about 256 periods).
+ */
+#define ESTIMATOR_ODOMETRY_SHIFT 8
+
+/** Worst-case cycles allowed for an update */
+#define ESTIMATOR_CYCLE_BUDGET 1000
+
+/**
+ * Estimator inputs for a period.
+ *
+ * - Encoder counts travelled by each wheel.
+ * - Bias-corrected gyroscope yaw rate (Z axis), in LSB with
+ *   `ESTIMATOR_GYRO_RATE_SHIFT` fractional bits.
+ */
+struct estimator_input {
+	int32_t delta_left;
+	int32_t delta_right;
+	int32_t gyro_z;
+};
+
+/**
+ * Estimated pose.
+ *
+ * - Position in nanometers (Q0), with the heading as a binary angle.
+ * - Linear and angular displacement of the last period, in nanometers and
+ *   binary angle units.
+ */
+struct estimator_pose {
+	int64_t x;
+	int64_t y;
+	uint32_t heading;
+	int32_t distance;
+	int32_t rotation;
+};
+
+/**
+ * Estimator state: the estimated pose and the odometry heading the
+ * gyroscope heading is corrected towards.
+ */
+struct estimator_state {
+	struct estimator_pose pose;
+	uint32_t odometry_heading;
+};
+
+struct estimator_stats {
+	uint32_t updates;
+	uint32_t wcet;
+	uint32_t over_budget;
+};
+
+void estimator_init(void);
+void estimator_reset(void);
+void estimator_update(const struct estimator_input *input);
+void estimator_step(struct estimator_state *state,
+		    const struct estimator_input *input);
+void estimator_account(uint32_t cycles);
+void estimator_get(struct estimator_pose *pose);
+void estimator_get_stats(struct estimator_stats *stats);
+int32_t estimator_cos(uint32_t angle);
+int32_t estimator_sin(uint32_t angle);
+
+#endif /* __ESTIMATOR_H */
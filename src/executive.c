@@ -0,0 +1,203 @@
+#include "executive.h"
+
+#define CYCLES_PER_TICK (SYSCLK_FREQUENCY_HZ / SYSTICK_FREQUENCY_HZ)
+
+static struct task *tasks;
+static uint32_t tasks_count;
+static uint32_t idle_cycles;
+static uint32_t window_start;
+static uint32_t window_ticks;
+static volatile uint32_t load;
+
+/**
+ * @brief Set the task table and reset the tasks statistics.
+ *
+ * To be called before enabling the SysTick interruption.
+ *
+ * @param[in] table Task table, sorted by decreasing priority.
+ * @param[in] size Number of tasks in the table.
+ */
+void executive_start(struct task *table, uint32_t size)
+{
+	uint32_t i;
+
+	for (i = 0; i < size; i++) {
+		table[i].countdown = table[i].offset;
+		table[i].pending = false;
+		memset(&table[i].stats, 0, sizeof(table[i].stats));
+	}
+	tasks = table;
+	tasks_count = size;
+	idle_cycles = 0;
+	window_ticks = 0;
+	window_start = DWT_CYCCNT;
+	load = 0;
+}
+
+/**
+ * @brief Account for a task execution.
+ */
+static void account(struct task *task, uint32_t cycles)
+{
+	task->stats.runs++;
+	task->stats.last = cycles;
+	task->stats.total += cycles;
+	if (cycles > task->stats.wcet)
+		task->stats.wcet = cycles;
+}
+
+/**
+ * @brief Update the CPU load at the end of each load window.
+ *
+ * The load is the fraction of the window not spent waiting for interrupts
+ * in the background loop.
+ */
+static void update_load(void)
+{
+	uint32_t now;
+	uint32_t elapsed;
+
+	if (++window_ticks < EXECUTIVE_LOAD_WINDOW_TICKS)
+		return;
+	now = DWT_CYCCNT;
+	elapsed = now - window_start;
+	if (idle_cycles > elapsed)
+		idle_cycles = elapsed;
+	load = elapsed ? (uint32_t)((uint64_t)(elapsed - idle_cycles) * 1000 /
+				    elapsed)
+		       : 0;
+	idle_cycles = 0;
+	window_ticks = 0;
+	window_start = now;
+}
+
+/**
+ * @brief Release the tasks and run the interrupt-context ones.
+ *
+ * To be called from the SysTick handler. A background task released while
+ * still pending (it did not complete before its next release) counts as an
+ * overrun. An interrupt task that ends after the next SysTick period was due
+ * counts as an overrun too.
+ */
+void executive_tick(void)
+{
+	uint32_t tick_start = DWT_CYCCNT;
+	uint32_t start;
+	uint32_t end;
+	struct task *task;
+	uint32_t i;
+
+	for (i = 0; i < tasks_count; i++) {
+		task = &tasks[i];
+		if (task->countdown) {
+			task->countdown--;
+			continue;
+		}
+		task->countdown = task->period - 1;
+		if (task->context == TASK_BACKGROUND) {
+			if (task->pending)
+				task->stats.overruns++;
+			task->pending = true;
+			continue;
+		}
+		trace(TRACE_TASK_START, (uint8_t)i, TASK_INTERRUPT);
+		start = DWT_CYCCNT;
+		task->run();
+		end = DWT_CYCCNT;
+		trace(TRACE_TASK_STOP, (uint8_t)i, TASK_INTERRUPT);
+		account(task, end - start);
+		if (end - tick_start > CYCLES_PER_TICK)
+			task->stats.overruns++;
+	}
+	update_load();
+}
+
+/**
+ * @brief Return the highest priority pending background task, if any.
+ */
+static struct task *next_pending(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < tasks_count; i++)
+		if (tasks[i].context == TASK_BACKGROUND && tasks[i].pending)
+			return &tasks[i];
+	return NULL;
+}
+
+/**
+ * @brief Background loop: run the pending tasks or sleep.
+ *
+ * Interruptions are masked while checking for pending tasks and sleeping,
+ * so a release can not be missed before `__WFI()` and the time waiting for
+ * the interruption does not include its handler.
+ */
+void executive_run(void)
+{
+	struct task *task;
+	uint32_t start;
+
+	while (true) {
+		task = next_pending();
+		if (task) {
+			trace(TRACE_TASK_START, (uint8_t)(task - tasks),
+			      TASK_BACKGROUND);
+			start = DWT_CYCCNT;
+			task->run();
+			account(task, DWT_CYCCNT - start);
+			trace(TRACE_TASK_STOP, (uint8_t)(task - tasks),
+			      TASK_BACKGROUND);
+			task->pending = false;
+			continue;
+		}
+		cm_disable_interrupts();
+		if (!next_pending()) {
+			start = DWT_CYCCNT;
+			__WFI();
+			idle_cycles += DWT_CYCCNT - start;
+		}
+		cm_enable_interrupts();
+	}
+}
+
+/**
+ * @brief Get a consistent copy of a task statistics.
+ *
+ * @param[in] index Task index in the table.
+ * @param[out] stats Task statistics.
+ *
+ * @return Whether the index is valid.
+ */
+bool executive_get_stats(uint32_t index, struct task_stats *stats)
+{
+	if (index >= tasks_count)
+		return false;
+	CM_ATOMIC_BLOCK()
+	{
+		*stats = tasks[index].stats;
+	}
+	return true;
+}
+
+/**
+ * @brief Return the CPU load of the last window, in per mille.
+ */
+uint32_t executive_get_load(void)
+{
+	return load;
+}
+
+/**
+ * @brief Reset the statistics of all the tasks.
+ */
+void executive_reset_stats(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < tasks_count; i++) {
+		CM_ATOMIC_BLOCK()
+		{
+			memset(&tasks[i].stats, 0, sizeof(tasks[i].stats));
+		}
+	}
+}
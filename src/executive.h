@@ -0,0 +1,71 @@
+#ifndef __EXECUTIVE_H
+#define __EXECUTIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/dwt.h>
+
+#include "setup.h"
+#include "trace.h"
+
+/** SysTick periods over which the CPU load is computed */
+#define EXECUTIVE_LOAD_WINDOW_TICKS 1000
+
+/**
+ * Task execution context.
+ *
+ * - `TASK_INTERRUPT`: run from the SysTick handler when released. Its
+ *   deadline is the next SysTick period.
+ * - `TASK_BACKGROUND`: released from the SysTick handler and run from the
+ *   background loop (preemptible by interruptions). Its deadline is the next
+ *   release.
+ */
+enum task_context {
+	TASK_INTERRUPT,
+	TASK_BACKGROUND,
+};
+
+/**
+ * Task execution statistics.
+ *
+ * Execution times are measured in clock cycles and, for background tasks,
+ * include preemption by interruptions.
+ */
+struct task_stats {
+	uint32_t runs;
+	uint32_t overruns;
+	uint32_t last;
+	uint32_t wcet;
+	uint64_t total;
+};
+
+/**
+ * Task table entry.
+ *
+ * Tasks are released every `period` SysTick periods, starting `offset`
+ * periods after the executive starts (which can be used to spread tasks
+ * that share a period). Tables are sorted by decreasing priority: on each
+ * context, the first released task in the table runs first.
+ */
+struct task {
+	const char *name;
+	void (*run)(void);
+	uint32_t period;
+	uint32_t offset;
+	enum task_context context;
+	uint32_t countdown;
+	volatile bool pending;
+	struct task_stats stats;
+};
+
+void executive_start(struct task *table, uint32_t size);
+void executive_tick(void);
+void executive_run(void) __attribute__((noreturn));
+bool executive_get_stats(uint32_t index, struct task_stats *stats);
+uint32_t executive_get_load(void);
+void executive_reset_stats(void);
+
+#endif /* __EXECUTIVE_H */
@@ -0,0 +1,316 @@
+#include "gyro.h"
+
+#define MPU_SMPLRT_DIV 0x19
+#define MPU_CONFIG 0x1A
+#define MPU_FIFO_EN 0x23
+#define MPU_USER_CTRL 0x6A
+#define MPU_FIFO_COUNT_H 0x72
+#define MPU_FIFO_R_W 0x74
+
+#define CONFIG_FIFO_MODE 0x40
+#define FIFO_EN_GYRO_Z 0x10
+#define USER_CTRL_FIFO_EN 0x40
+#define USER_CTRL_FIFO_RST 0x04
+
+#define FIFO_SIZE 512
+#define FIFO_COUNT_MASK 0x1FFF
+#define SAMPLE_SIZE 2
+
+/** Burst read size: four SysTick periods of samples */
+#define BURST_MAX_SIZE                                                         \
+	(4 * SAMPLE_SIZE * GYRO_SAMPLE_RATE_HZ / SYSTICK_FREQUENCY_HZ)
+
+_Static_assert(BURST_MAX_SIZE <= MPU_BURST_MAX_SIZE,
+	       "Burst too long for the DMA read");
+
+static CCM uint8_t burst[BURST_MAX_SIZE];
+static CCM uint16_t fifo_count;
+static CCM uint16_t burst_size;
+static CCM int16_t last_sample;
+static volatile int32_t rate;
+static volatile int32_t bias;
+static volatile bool calibrated;
+static int64_t calibration_sum;
+static uint32_t calibration_samples;
+static uint32_t stationary_ticks;
+static struct gyro_stats stats;
+#ifdef GYRO_FIFO_DMA
+static uint8_t dma_burst[BURST_MAX_SIZE];
+static volatile uint16_t dma_burst_size;
+static volatile bool dma_burst_ready;
+#endif
+
+static void reset_fifo(void)
+{
+	mpu_write_register(MPU_USER_CTRL,
+			   USER_CTRL_FIFO_EN | USER_CTRL_FIFO_RST);
+}
+
+/**
+ * @brief Configure the MPU to sample the gyroscope Z axis into its FIFO.
+ *
+ * The low pass filter is bypassed so that the sensor samples at
+ * `GYRO_SAMPLE_RATE_HZ`. The FIFO stops accepting samples when full, so that
+ * it always holds whole samples, and is reset on overflow. Registers are
+ * written with the SPI at low speed, as required by the sensor.
+ */
+void start_gyro_fifo(void)
+{
+	setup_spi_low_speed();
+	mpu_write_register(MPU_CONFIG, CONFIG_FIFO_MODE);
+	mpu_write_register(MPU_SMPLRT_DIV, 0);
+	mpu_write_register(MPU_FIFO_EN, FIFO_EN_GYRO_Z);
+	reset_fifo();
+	setup_spi_high_speed();
+	gyro_recalibrate();
+}
+
+/**
+ * @brief Restart the bias calibration.
+ *
+ * The robot must be kept still until `gyro_calibrated()` returns true.
+ */
+void gyro_recalibrate(void)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		calibrated = false;
+		calibration_sum = 0;
+		calibration_samples = 0;
+		stationary_ticks = 0;
+	}
+}
+
+/**
+ * @brief Set a known bias (i.e.: a stored one), skipping the calibration.
+ *
+ * The bias keeps being refined online.
+ *
+ * @param[in] value Bias, in LSB (`GYRO_RATE_SHIFT`).
+ */
+void gyro_set_bias(int32_t value)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		bias = value;
+		calibrated = true;
+	}
+}
+
+/**
+ * @brief Update the bias calibration with the samples of a period.
+ *
+ * While not calibrated, samples of stationary periods are averaged (any
+ * motion restarts the average). Once calibrated, the bias keeps being
+ * refined with a slow filter after the robot has been stationary for
+ * `GYRO_STATIONARY_TICKS`, to follow the temperature drift.
+ */
+static void update_bias(int32_t sum, uint32_t count, int32_t mean,
+			bool stationary)
+{
+	if (!calibrated) {
+		if (!stationary) {
+			calibration_sum = 0;
+			calibration_samples = 0;
+			return;
+		}
+		calibration_sum += sum;
+		calibration_samples += count;
+		if (calibration_samples >= GYRO_CALIBRATION_SAMPLES) {
+			bias = (int32_t)(calibration_sum *
+					 (1 << GYRO_RATE_SHIFT) /
+					 calibration_samples);
+			calibrated = true;
+		}
+		return;
+	}
+	if (stationary_ticks >= GYRO_STATIONARY_TICKS)
+		bias += (mean - bias) >> GYRO_BIAS_SHIFT;
+}
+
+/**
+ * @brief Read the number of bytes to drain from the FIFO.
+ *
+ * The FIFO is reset on overflow.
+ *
+ * @return Whole samples to read, up to `BURST_MAX_SIZE` bytes, or 0.
+ */
+static uint16_t read_fifo_count(void)
+{
+	uint8_t count_bytes[2];
+	uint16_t size;
+
+	mpu_read_registers(MPU_FIFO_COUNT_H, count_bytes, sizeof(count_bytes));
+	size = (count_bytes[0] << 8 | count_bytes[1]) & FIFO_COUNT_MASK;
+	fifo_count = size;
+	if (size >= FIFO_SIZE) {
+		reset_fifo();
+		stats.overflows++;
+		return 0;
+	}
+	if (size > BURST_MAX_SIZE)
+		size = BURST_MAX_SIZE;
+	return size - size % SAMPLE_SIZE;
+}
+
+/**
+ * @brief Average a burst of samples and update the yaw rate and the bias.
+ */
+static void process_burst(uint16_t size)
+{
+	struct odometry odometry;
+	uint32_t count = size / SAMPLE_SIZE;
+	int32_t sum = 0;
+	int16_t sample = 0;
+	int16_t minimum = INT16_MAX;
+	int16_t maximum = INT16_MIN;
+	int32_t mean;
+	uint32_t i;
+	bool stationary;
+
+	for (i = 0; i < size; i += SAMPLE_SIZE) {
+		sample = (int16_t)(burst[i] << 8 | burst[i + 1]);
+		sum += sample;
+		if (sample < minimum)
+			minimum = sample;
+		if (sample > maximum)
+			maximum = sample;
+	}
+	last_sample = sample;
+	stats.samples += count;
+	stats.bursts++;
+
+	mean = sum * (1 << GYRO_RATE_SHIFT) / (int32_t)count;
+	odometry_get(&odometry);
+	stationary = !odometry.delta_left && !odometry.delta_right &&
+		     maximum - minimum <= GYRO_STATIONARY_SPREAD_LSB;
+	stationary_ticks = stationary ? stationary_ticks + 1 : 0;
+	update_bias(sum, count, mean, stationary);
+	rate = mean - bias;
+}
+
+#ifdef GYRO_FIFO_DMA
+/**
+ * @brief Keep a burst read in the background, executed from the DMA
+ * interruption.
+ *
+ * It is kept apart from `burst`, which holds the samples processed in the
+ * current period until the next update (see `gyro_get_last_burst()`).
+ */
+static void burst_received(const uint8_t *data, uint8_t size)
+{
+	memcpy(dma_burst, data, size);
+	dma_burst_size = size;
+	dma_burst_ready = true;
+}
+
+/**
+ * @brief Update the yaw rate with the burst read in the previous period, and
+ * start reading the next one in the background.
+ *
+ * Only the FIFO count is polled, so the SysTick handler does not wait for the
+ * burst, but the rate lags one period behind the polled update. If the
+ * previous burst is still being read, the period is skipped and the rate
+ * left unchanged.
+ */
+void gyro_update(void)
+{
+	uint16_t size;
+
+	burst_size = 0;
+	if (mpu_read_registers_dma_busy())
+		return;
+	if (dma_burst_ready) {
+		dma_burst_ready = false;
+		burst_size = dma_burst_size;
+		memcpy(burst, dma_burst, burst_size);
+		process_burst(burst_size);
+	}
+	size = read_fifo_count();
+	if (size)
+		mpu_read_registers_dma(MPU_FIFO_R_W, (uint8_t)size,
+				       burst_received);
+}
+#else
+/**
+ * @brief Drain the MPU FIFO and update the yaw rate.
+ *
+ * Called every SysTick period. All samples stored since the last call are
+ * read in a single SPI burst and averaged, which reduces the noise compared
+ * to a single register reading. The rate is left unchanged if there are no
+ * new samples.
+ */
+void gyro_update(void)
+{
+	uint16_t size;
+
+	burst_size = 0;
+	size = read_fifo_count();
+	if (!size)
+		return;
+	mpu_read_registers(MPU_FIFO_R_W, burst, size);
+	burst_size = size;
+	process_burst(size);
+}
+#endif
+
+/**
+ * @brief Return the bias-corrected yaw rate, in LSB (`GYRO_RATE_SHIFT`).
+ */
+int32_t gyro_get_rate(void)
+{
+	return rate;
+}
+
+/**
+ * @brief Return the estimated zero-rate bias, in LSB (`GYRO_RATE_SHIFT`).
+ */
+int32_t gyro_get_bias(void)
+{
+	return bias;
+}
+
+/**
+ * @brief Return whether the startup bias calibration has completed.
+ */
+bool gyro_calibrated(void)
+{
+	return calibrated;
+}
+
+/**
+ * @brief Return the last raw sample read from the FIFO, in LSB.
+ */
+int16_t gyro_get_last_sample(void)
+{
+	return last_sample;
+}
+
+/**
+ * @brief Get the FIFO readings of the last update.
+ *
+ * Meant to record the sensor inputs, from the same SysTick period as the
+ * update.
+ *
+ * @param[out] data Burst of samples read (big-endian), if any.
+ * @param[out] size Burst size, in bytes (0 if no samples were read).
+ *
+ * @return The FIFO count register value.
+ */
+uint16_t gyro_get_last_burst(const uint8_t **data, uint16_t *size)
+{
+	*data = burst;
+	*size = burst_size;
+	return fifo_count;
+}
+
+/**
+ * @brief Get a consistent copy of the FIFO statistics.
+ */
+void gyro_get_stats(struct gyro_stats *output)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		*output = stats;
+	}
+}
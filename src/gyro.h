@@ -0,0 +1,49 @@
+#ifndef __GYRO_H
+#define __GYRO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <libopencm3/cm3/cortex.h>
+
+#include "odometry.h"
+#include "platform.h"
+#include "setup.h"
+
+/** FIFO sample rate (low pass filter bypassed, 250 Hz bandwidth) */
+#define GYRO_SAMPLE_RATE_HZ 8000
+
+/** Fractional bits of the rates and the bias (in LSB) */
+#define GYRO_RATE_SHIFT 8
+
+/** Samples averaged for the startup bias calibration */
+#define GYRO_CALIBRATION_SAMPLES 2048
+
+/**
+ * Stationary detection: both wheels stopped and a peak-to-peak gyroscope
+ * noise below the threshold, for at least the given number of periods.
+ */
+#define GYRO_STATIONARY_SPREAD_LSB 16
+#define GYRO_STATIONARY_TICKS 100
+
+/** Online bias refinement gain (`1 / 2^GYRO_BIAS_SHIFT`) */
+#define GYRO_BIAS_SHIFT 8
+
+struct gyro_stats {
+	uint32_t samples;
+	uint32_t bursts;
+	uint32_t overflows;
+};
+
+void start_gyro_fifo(void);
+void gyro_update(void);
+int32_t gyro_get_rate(void);
+int32_t gyro_get_bias(void);
+int16_t gyro_get_last_sample(void);
+bool gyro_calibrated(void);
+void gyro_recalibrate(void);
+void gyro_set_bias(int32_t value);
+uint16_t gyro_get_last_burst(const uint8_t **data, uint16_t *size);
+void gyro_get_stats(struct gyro_stats *stats);
+
+#endif /* __GYRO_H */
@@ -0,0 +1,165 @@
+#include "infrared.h"
+#include "calibration.h"
+
+/** Acquisition slots: ambient (all emitters off) and one per sensor lit */
+#define IR_SLOTS (1 + IR_SENSORS_COUNT)
+#define IR_EMITTERS (GPIO4 | GPIO5 | GPIO6 | GPIO7)
+
+/** GPIOA set/reset words written at the start of each slot */
+static const uint32_t emitters_sequence[IR_SLOTS] = {
+    IR_EMITTERS << 16,
+    GPIO4 | ((IR_EMITTERS & ~GPIO4) << 16),
+    GPIO5 | ((IR_EMITTERS & ~GPIO5) << 16),
+    GPIO6 | ((IR_EMITTERS & ~GPIO6) << 16),
+    GPIO7 | ((IR_EMITTERS & ~GPIO7) << 16),
+};
+
+/** Two halves of a full sequence of conversions (ping-pong buffer) */
+static volatile uint16_t samples[2][IR_SLOTS][IR_SENSORS_COUNT];
+static volatile uint8_t ready_half;
+static volatile uint32_t sequence;
+
+/**
+ * @brief Start the infrared sensors acquisition in the background.
+ *
+ * The acquisition is fully sequenced by hardware:
+ *
+ * - On each TIM1 update event, DMA 2 stream 5 (channel 6) writes the next
+ *   word of `emitters_sequence` into GPIOA_BSRR, switching the emitters for
+ *   the new slot.
+ * - `IR_SAMPLE_DELAY_US` after the slot starts, TIM1 channel 1 triggers a
+ *   scan conversion of all the receivers on ADC1.
+ * - DMA 2 stream 0 (channel 0) moves the conversions into `samples`, in
+ *   circular mode. The half-transfer and transfer-complete interruptions
+ *   only flag which half holds the latest complete sequence.
+ *
+ * A full sequence takes `IR_SLOTS * IR_SLOT_PERIOD_US` (250 us).
+ */
+void start_ir_sensors(void)
+{
+	dma_stream_reset(DMA2, DMA_STREAM0);
+	dma_enable_memory_increment_mode(DMA2, DMA_STREAM0);
+	dma_enable_circular_mode(DMA2, DMA_STREAM0);
+	dma_set_peripheral_size(DMA2, DMA_STREAM0, DMA_SxCR_PSIZE_16BIT);
+	dma_set_memory_size(DMA2, DMA_STREAM0, DMA_SxCR_MSIZE_16BIT);
+	dma_set_priority(DMA2, DMA_STREAM0, DMA_SxCR_PL_HIGH);
+	dma_set_transfer_mode(DMA2, DMA_STREAM0,
+			      DMA_SxCR_DIR_PERIPHERAL_TO_MEM);
+	dma_set_peripheral_address(DMA2, DMA_STREAM0, (uint32_t)&ADC1_DR);
+	dma_set_memory_address(DMA2, DMA_STREAM0, (uint32_t)samples);
+	dma_set_number_of_data(DMA2, DMA_STREAM0,
+			       sizeof(samples) / sizeof(samples[0][0][0]));
+	dma_channel_select(DMA2, DMA_STREAM0, DMA_SxCR_CHSEL_0);
+	dma_enable_half_transfer_interrupt(DMA2, DMA_STREAM0);
+	dma_enable_transfer_complete_interrupt(DMA2, DMA_STREAM0);
+	dma_enable_stream(DMA2, DMA_STREAM0);
+
+	dma_stream_reset(DMA2, DMA_STREAM5);
+	dma_enable_memory_increment_mode(DMA2, DMA_STREAM5);
+	dma_enable_circular_mode(DMA2, DMA_STREAM5);
+	dma_set_peripheral_size(DMA2, DMA_STREAM5, DMA_SxCR_PSIZE_32BIT);
+	dma_set_memory_size(DMA2, DMA_STREAM5, DMA_SxCR_MSIZE_32BIT);
+	dma_set_priority(DMA2, DMA_STREAM5, DMA_SxCR_PL_HIGH);
+	dma_set_transfer_mode(DMA2, DMA_STREAM5,
+			      DMA_SxCR_DIR_MEM_TO_PERIPHERAL);
+	dma_set_peripheral_address(DMA2, DMA_STREAM5, (uint32_t)&GPIOA_BSRR);
+	dma_set_memory_address(DMA2, DMA_STREAM5,
+			       (uint32_t)emitters_sequence);
+	dma_set_number_of_data(DMA2, DMA_STREAM5, IR_SLOTS);
+	dma_channel_select(DMA2, DMA_STREAM5, DMA_SxCR_CHSEL_6);
+	dma_enable_stream(DMA2, DMA_STREAM5);
+
+	/* The update event starts the first slot (and resets the counter) */
+	timer_generate_event(TIM1, TIM_EGR_UG);
+	timer_enable_counter(TIM1);
+}
+
+/**
+ * @brief Stop the infrared sensors acquisition and turn the emitters off.
+ */
+void stop_ir_sensors(void)
+{
+	timer_disable_counter(TIM1);
+	dma_disable_stream(DMA2, DMA_STREAM5);
+	dma_disable_stream(DMA2, DMA_STREAM0);
+	gpio_clear(GPIOA, IR_EMITTERS);
+}
+
+/**
+ * @brief Flag the buffer half that holds the latest complete sequence.
+ */
+RAMFUNC void dma2_stream0_isr(void)
+{
+	TRACE_ISR_BEGIN(TRACE_ISR_INFRARED_DMA);
+	if (dma_get_interrupt_flag(DMA2, DMA_STREAM0, DMA_HTIF)) {
+		dma_clear_interrupt_flags(DMA2, DMA_STREAM0, DMA_HTIF);
+		ready_half = 0;
+		sequence++;
+	}
+	if (dma_get_interrupt_flag(DMA2, DMA_STREAM0, DMA_TCIF)) {
+		dma_clear_interrupt_flags(DMA2, DMA_STREAM0, DMA_TCIF);
+		ready_half = 1;
+		sequence++;
+	}
+	TRACE_ISR_END(TRACE_ISR_INFRARED_DMA);
+}
+
+/**
+ * @brief Return the number of complete acquisition sequences.
+ */
+uint32_t get_ir_sequence(void)
+{
+	return sequence;
+}
+
+/**
+ * @brief Get the latest ambient-subtracted infrared readings.
+ *
+ * The readings are copied from the last complete sequence, while the DMA
+ * fills the other half of the buffer. The copy is retried if a new sequence
+ * completes meanwhile, so all the readings come from the same sequence.
+ *
+ * @param[out] readings ADC counts of each sensor (lit minus ambient).
+ *
+ * @return The sequence number of the readings (0 if none is available).
+ */
+uint32_t get_ir_readings(uint16_t readings[IR_SENSORS_COUNT])
+{
+	volatile uint16_t(*half)[IR_SENSORS_COUNT];
+	uint32_t current;
+	uint16_t ambient;
+	uint16_t lit;
+	int i;
+
+	do {
+		current = sequence;
+		half = samples[ready_half];
+		for (i = 0; i < IR_SENSORS_COUNT; i++) {
+			ambient = half[0][i];
+			lit = half[1 + i][i];
+			readings[i] = lit > ambient ? lit - ambient : 0;
+		}
+	} while (current != sequence);
+	return current;
+}
+
+/**
+ * @brief Get the latest distances measured by the infrared sensors.
+ *
+ * Readings are converted with the calibration tables (see `calibration.h`).
+ *
+ * @param[out] distances Distance of each sensor, in millimeters.
+ *
+ * @return The sequence number of the readings (0 if none is available).
+ */
+uint32_t get_ir_distances(uint16_t distances[IR_SENSORS_COUNT])
+{
+	uint16_t readings[IR_SENSORS_COUNT];
+	uint32_t current;
+	int i;
+
+	current = get_ir_readings(readings);
+	for (i = 0; i < IR_SENSORS_COUNT; i++)
+		distances[i] = ir_counts_to_millimeters(i, readings[i]);
+	return current;
+}
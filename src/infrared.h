@@ -0,0 +1,34 @@
+#ifndef __INFRARED_H
+#define __INFRARED_H
+
+#include <stdint.h>
+
+#include <libopencm3/stm32/adc.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/timer.h>
+
+#include "setup.h"
+#include "trace.h"
+
+/**
+ * Infrared sensors.
+ *
+ * Sensor `n` is lit by the emitter on GPIOA pin `4 + n` and read through the
+ * receiver on ADC channel `10 + n`.
+ */
+enum ir_sensor {
+	IR_FRONT_RIGHT,
+	IR_SIDE_RIGHT,
+	IR_SIDE_LEFT,
+	IR_FRONT_LEFT,
+	IR_SENSORS_COUNT,
+};
+
+void start_ir_sensors(void);
+void stop_ir_sensors(void);
+uint32_t get_ir_sequence(void);
+uint32_t get_ir_readings(uint16_t readings[IR_SENSORS_COUNT]);
+uint32_t get_ir_distances(uint16_t distances[IR_SENSORS_COUNT]);
+
+#endif /* __INFRARED_H */
@@ -1,21 +1,185 @@
 #include "mmlib/clock.h"
 
+#include "collision.h"
+#include "command.h"
+#include "control.h"
+#include "estimator.h"
+#include "executive.h"
+#include "gyro.h"
+#include "infrared.h"
+#include "motion.h"
+#include "odometry.h"
+#include "parameters.h"
+#include "profile.h"
+#include "recorder.h"
+#include "settings.h"
+#include "telemetry.h"
 #include "setup.h"
+#include "trace.h"
+
+/** Battery voltage below which the motors are turned off (3.5 V per cell) */
+#define LOW_BATTERY_VOLTAGE 7.0f
+
+/** Trace marker of the low battery reaction, with the millivolts as value */
+#define LOW_BATTERY_MARKER 1
+
+_Static_assert(GYRO_RATE_SHIFT == ESTIMATOR_GYRO_RATE_SHIFT,
+	       "Gyroscope rate format mismatch");
+
+/**
+ * @brief Turn the motors off when the battery voltage is low.
+ *
+ * Called once from the battery monitor interruption (see
+ * `set_low_battery_callback()`). Any ongoing run is left to finish without
+ * power, so the robot stops where it is.
+ */
+static void low_battery(float voltage)
+{
+	control_disable();
+	trace_marker(LOW_BATTERY_MARKER, (uint16_t)(voltage * 1000));
+}
+
+/**
+ * @brief Read the encoders and the gyroscope FIFO.
+ */
+static void sensing(void)
+{
+	PROFILE_BEGIN(PROFILE_SENSING);
+	odometry_update();
+	gyro_update();
+	PROFILE_END(PROFILE_SENSING);
+}
+
+/**
+ * @brief Feed the estimator with the last odometry and gyroscope readings.
+ *
+ * Only the update itself is accounted against the estimator cycle budget,
+ * not the sensors reading.
+ */
+static void estimation(void)
+{
+	struct estimator_input input;
+	struct odometry odometry;
+	uint32_t start;
+
+	PROFILE_BEGIN(PROFILE_ESTIMATION);
+	odometry_get(&odometry);
+	input.delta_left = odometry.delta_left;
+	input.delta_right = odometry.delta_right;
+	input.gyro_z = gyro_get_rate();
+	start = read_cycle_counter();
+	estimator_update(&input);
+	estimator_account(read_cycle_counter() - start);
+	PROFILE_END(PROFILE_ESTIMATION);
+}
+
+/**
+ * @brief Generate the motion setpoints for the current tick and follow them.
+ */
+static void control(void)
+{
+	PROFILE_BEGIN(PROFILE_CONTROL);
+	motion_update();
+	control_update();
+	PROFILE_END(PROFILE_CONTROL);
+}
+
+/**
+ * Task table, sorted by decreasing priority.
+ */
+static struct task tasks[] = {
+    {.name = "parameters",
+     .run = parameters_update,
+     .period = 1,
+     .context = TASK_INTERRUPT},
+    {.name = "sensing",
+     .run = sensing,
+     .period = 1,
+     .context = TASK_INTERRUPT},
+    {.name = "estimation",
+     .run = estimation,
+     .period = 1,
+     .context = TASK_INTERRUPT},
+    {.name = "control",
+     .run = control,
+     .period = 1,
+     .context = TASK_INTERRUPT},
+    {.name = "collision",
+     .run = collision_update,
+     .period = 1,
+     .context = TASK_INTERRUPT},
+    {.name = "recorder",
+     .run = recorder_update,
+     .period = 1,
+     .context = TASK_INTERRUPT},
+    {.name = "telemetry",
+     .run = telemetry_update,
+     .period = 1,
+     .context = TASK_INTERRUPT},
+    {.name = "motion",
+     .run = motion_feed,
+     .period = 10,
+     .context = TASK_BACKGROUND},
+    {.name = "command",
+     .run = command_update,
+     .period = 10,
+     .context = TASK_BACKGROUND},
+    {.name = "settings",
+     .run = settings_update,
+     .period = 1000,
+     .context = TASK_BACKGROUND},
+};
 
 /**
  * @brief Handle the SysTick interruptions.
  */
-void sys_tick_handler(void)
+RAMFUNC void sys_tick_handler(void)
 {
+	TRACE_ISR_BEGIN(TRACE_ISR_SYSTICK);
+	PROFILE_BEGIN(PROFILE_SYSTICK);
 	clock_tick();
+	executive_tick();
+	PROFILE_END(PROFILE_SYSTICK);
+	TRACE_ISR_END(TRACE_ISR_SYSTICK);
+}
+
+/**
+ * @brief Handle the hard faults.
+ *
+ * Configurable faults (memory management, bus and usage) are not enabled, so
+ * they escalate to a hard fault too. The motors are turned off and the trace
+ * is frozen before resetting the system. The trace is kept across the reset,
+ * to be dumped afterwards (see `trace_init()`).
+ */
+void hard_fault_handler(void)
+{
+	drive_off();
+	trace_freeze(TRACE_FREEZE_FAULT);
+	scb_reset_system();
 }
 
 /**
- * @brief Initial setup and infinite wait.
+ * @brief Initial setup and background loop.
  */
 int main(void)
 {
 	setup();
+	profile_reset();
+	odometry_reset();
+	estimator_init();
+	motion_reset();
+	start_ir_sensors();
+	start_gyro_fifo();
+	serial_start_reception();
+	set_low_battery_callback(LOW_BATTERY_VOLTAGE, low_battery);
+	settings_load();
+	parameters_load();
+	if (!settings_load_maze())
+		maze_reset(MAZE_CLASSIC_SIZE);
+#ifdef RECORDER_AUTOSTART
+	recorder_start();
+#endif
+	executive_start(tasks, sizeof(tasks) / sizeof(tasks[0]));
 	systick_interrupt_enable();
-	return 0;
+	executive_run();
 }
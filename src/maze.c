@@ -0,0 +1,477 @@
+#include "maze.h"
+
+#define EDGE_BITS 2
+#define EDGE_MASK 0x3
+#define NORTH_SHIFT 0
+#define EAST_SHIFT EDGE_BITS
+#define CELL_BITS (2 * EDGE_BITS)
+
+/**
+ * Invalidated cells (as a fraction of the maze) above which a full flood is
+ * faster than propagating distances into them again.
+ */
+#define REPAIR_MAX_FRACTION_SHIFT 3
+
+#define CELL(x, y) ((uint16_t)((y)*MAZE_MAX_SIZE + (x)))
+#define CELL_X(cell) ((uint8_t)((cell) % MAZE_MAX_SIZE))
+#define CELL_Y(cell) ((uint8_t)((cell) / MAZE_MAX_SIZE))
+
+static uint8_t size = MAZE_CLASSIC_SIZE;
+static uint8_t walls[MAZE_WALLS_SIZE];
+static uint32_t goals[MAZE_MAX_CELLS / 32];
+static uint16_t distances[MAZE_MAX_CELLS];
+
+/**
+ * Work buffers: a FIFO queue (with a bit set to avoid queuing a cell twice)
+ * and the list of cells whose distance was invalidated.
+ */
+static uint16_t queue[MAZE_MAX_CELLS];
+static uint32_t queued[MAZE_MAX_CELLS / 32];
+static uint16_t queue_head;
+static uint16_t queue_count;
+static uint16_t invalidated[MAZE_MAX_CELLS];
+static uint16_t invalidated_count;
+
+static struct maze_stats stats;
+
+static const int8_t delta_x[MAZE_DIRECTIONS_COUNT] = {0, 1, 0, -1};
+static const int8_t delta_y[MAZE_DIRECTIONS_COUNT] = {1, 0, -1, 0};
+
+static bool test_bit(const uint32_t *set, uint16_t cell)
+{
+	return set[cell / 32] & (1u << (cell % 32));
+}
+
+static void assign_bit(uint32_t *set, uint16_t cell, bool value)
+{
+	if (value)
+		set[cell / 32] |= 1u << (cell % 32);
+	else
+		set[cell / 32] &= ~(1u << (cell % 32));
+}
+
+static enum maze_wall read_edge(uint16_t cell, uint8_t shift)
+{
+	shift += (cell & 1) * CELL_BITS;
+	return (enum maze_wall)((walls[cell / 2] >> shift) & EDGE_MASK);
+}
+
+static void write_edge(uint16_t cell, uint8_t shift, enum maze_wall wall)
+{
+	shift += (cell & 1) * CELL_BITS;
+	walls[cell / 2] = (uint8_t)((walls[cell / 2] & ~(EDGE_MASK << shift)) |
+				    (wall << shift));
+}
+
+/**
+ * @brief Locate the stored edge of a cell side.
+ *
+ * South and west sides are stored as the north and east edges of the
+ * neighbour cell.
+ *
+ * @return Whether the side is stored (false for the outer boundary).
+ */
+static bool locate_edge(uint8_t x, uint8_t y, enum maze_direction direction,
+			uint16_t *cell, uint8_t *shift)
+{
+	switch (direction) {
+	case MAZE_NORTH:
+		*cell = CELL(x, y);
+		*shift = NORTH_SHIFT;
+		return y < size - 1;
+	case MAZE_EAST:
+		*cell = CELL(x, y);
+		*shift = EAST_SHIFT;
+		return x < size - 1;
+	case MAZE_SOUTH:
+		*cell = CELL(x, y - 1);
+		*shift = NORTH_SHIFT;
+		return y > 0;
+	case MAZE_WEST:
+	default:
+		*cell = CELL(x - 1, y);
+		*shift = EAST_SHIFT;
+		return x > 0;
+	}
+}
+
+/**
+ * @brief Return the state of a cell side (the boundary is always a wall).
+ */
+enum maze_wall maze_get_wall(uint8_t x, uint8_t y,
+			     enum maze_direction direction)
+{
+	uint16_t cell;
+	uint8_t shift;
+
+	if (!locate_edge(x, y, direction, &cell, &shift))
+		return MAZE_WALL_PRESENT;
+	return read_edge(cell, shift);
+}
+
+/**
+ * @brief Return whether the neighbour in a direction can be reached.
+ *
+ * Unknown sides are assumed to be open.
+ */
+static bool accessible(uint16_t cell, enum maze_direction direction)
+{
+	return maze_get_wall(CELL_X(cell), CELL_Y(cell), direction) !=
+	       MAZE_WALL_PRESENT;
+}
+
+static uint16_t neighbour(uint16_t cell, enum maze_direction direction)
+{
+	return CELL(CELL_X(cell) + delta_x[direction],
+		    CELL_Y(cell) + delta_y[direction]);
+}
+
+static void queue_reset(void)
+{
+	queue_head = 0;
+	queue_count = 0;
+	memset(queued, 0, sizeof(queued));
+}
+
+static void queue_push(uint16_t cell)
+{
+	if (test_bit(queued, cell))
+		return;
+	assign_bit(queued, cell, true);
+	queue[(queue_head + queue_count) % MAZE_MAX_CELLS] = cell;
+	queue_count++;
+}
+
+static uint16_t queue_pop(void)
+{
+	uint16_t cell = queue[queue_head];
+
+	queue_head = (queue_head + 1) % MAZE_MAX_CELLS;
+	queue_count--;
+	assign_bit(queued, cell, false);
+	return cell;
+}
+
+/**
+ * @brief Propagate distances from the queued cells (breadth-first).
+ *
+ * Distances only decrease, so cells are queued again if a shorter path is
+ * found. When all queued cells have the same distance (i.e.: a full flood
+ * from the goals) each cell is visited once.
+ */
+static void propagate(void)
+{
+	enum maze_direction direction;
+	uint16_t distance;
+	uint16_t cell;
+	uint16_t next;
+
+	while (queue_count) {
+		cell = queue_pop();
+		distance = distances[cell] + 1;
+		for (direction = MAZE_NORTH; direction < MAZE_DIRECTIONS_COUNT;
+		     direction++) {
+			if (!accessible(cell, direction))
+				continue;
+			next = neighbour(cell, direction);
+			if (distances[next] <= distance)
+				continue;
+			distances[next] = distance;
+			queue_push(next);
+		}
+	}
+}
+
+/**
+ * @brief Compute all distances to the goal from scratch.
+ */
+void maze_flood(void)
+{
+	uint8_t x;
+	uint8_t y;
+
+	queue_reset();
+	for (y = 0; y < size; y++) {
+		for (x = 0; x < size; x++) {
+			if (test_bit(goals, CELL(x, y))) {
+				distances[CELL(x, y)] = 0;
+				queue_push(CELL(x, y));
+			} else {
+				distances[CELL(x, y)] = MAZE_UNREACHABLE;
+			}
+		}
+	}
+	propagate();
+	stats.floods++;
+}
+
+/**
+ * @brief Return whether a cell keeps a neighbour one step closer to the goal.
+ */
+static bool supported(uint16_t cell)
+{
+	enum maze_direction direction;
+
+	if (test_bit(goals, cell))
+		return true;
+	for (direction = MAZE_NORTH; direction < MAZE_DIRECTIONS_COUNT;
+	     direction++)
+		if (accessible(cell, direction) &&
+		    distances[neighbour(cell, direction)] ==
+			distances[cell] - 1)
+			return true;
+	return false;
+}
+
+/**
+ * @brief Invalidate the distances that depended on a removed step.
+ *
+ * Starting from the cell that lost its step towards the goal, cells are
+ * visited in increasing (old) distance order. A cell is invalidated when
+ * none of its neighbours one step closer to the goal remains valid, in which
+ * case the cells one step further away are checked next.
+ */
+static void invalidate(uint16_t start)
+{
+	enum maze_direction direction;
+	uint16_t distance;
+	uint16_t cell;
+	uint16_t next;
+
+	invalidated_count = 0;
+	queue_reset();
+	queue_push(start);
+	while (queue_count) {
+		cell = queue_pop();
+		if (distances[cell] == MAZE_UNREACHABLE || supported(cell))
+			continue;
+		distance = distances[cell];
+		distances[cell] = MAZE_UNREACHABLE;
+		invalidated[invalidated_count++] = cell;
+		for (direction = MAZE_NORTH; direction < MAZE_DIRECTIONS_COUNT;
+		     direction++) {
+			if (!accessible(cell, direction))
+				continue;
+			next = neighbour(cell, direction);
+			if (distances[next] == distance + 1)
+				queue_push(next);
+		}
+	}
+}
+
+/**
+ * @brief Propagate distances again into the invalidated cells.
+ *
+ * Each invalidated cell is seeded from its valid neighbours, which keep
+ * their (unchanged) distances. Seeds have different distances, so a cell
+ * may be updated more than once, which is why large regions are flooded
+ * from scratch instead (see `wall_added()`).
+ */
+static void repair(void)
+{
+	enum maze_direction direction;
+	uint16_t distance;
+	uint16_t cell;
+	uint16_t i;
+
+	queue_reset();
+	for (i = 0; i < invalidated_count; i++) {
+		cell = invalidated[i];
+		for (direction = MAZE_NORTH; direction < MAZE_DIRECTIONS_COUNT;
+		     direction++) {
+			if (!accessible(cell, direction))
+				continue;
+			distance = distances[neighbour(cell, direction)];
+			if (distance != MAZE_UNREACHABLE &&
+			    distance + 1 < distances[cell])
+				distances[cell] = distance + 1;
+		}
+		if (distances[cell] != MAZE_UNREACHABLE)
+			queue_push(cell);
+	}
+	propagate();
+	stats.cells += invalidated_count;
+}
+
+/**
+ * @brief Update the distances after a wall is added between two cells.
+ *
+ * Adding a wall can only increase distances, and only if the wall blocks
+ * the step between a cell and a neighbour one step closer to the goal, and
+ * that cell has no other such neighbour. Otherwise nothing changes, which
+ * is the usual case while exploring.
+ */
+static void wall_added(uint16_t a, uint16_t b)
+{
+	uint16_t far;
+
+	if (distances[a] == MAZE_UNREACHABLE ||
+	    distances[b] == MAZE_UNREACHABLE)
+		return;
+	if (distances[a] == distances[b] + 1)
+		far = a;
+	else if (distances[b] == distances[a] + 1)
+		far = b;
+	else
+		return;
+	if (supported(far))
+		return;
+	stats.updates++;
+	invalidate(far);
+	if (invalidated_count > (size * size) >> REPAIR_MAX_FRACTION_SHIFT)
+		maze_flood();
+	else
+		repair();
+}
+
+/**
+ * @brief Start with an unknown maze, with the goal at the center.
+ *
+ * @param[in] new_size Maze size (up to MAZE_MAX_SIZE).
+ */
+void maze_reset(uint8_t new_size)
+{
+	if (new_size > MAZE_MAX_SIZE)
+		new_size = MAZE_MAX_SIZE;
+	size = new_size;
+	memset(walls, MAZE_WALL_UNKNOWN, sizeof(walls));
+	memset(&stats, 0, sizeof(stats));
+	maze_set_goal(size / 2 - 1, size / 2 - 1, 2, 2);
+}
+
+/**
+ * @brief Set the goal area, and compute all distances.
+ */
+void maze_set_goal(uint8_t x, uint8_t y, uint8_t width, uint8_t height)
+{
+	uint8_t i;
+	uint8_t j;
+
+	memset(goals, 0, sizeof(goals));
+	for (j = y; j < y + height && j < size; j++)
+		for (i = x; i < x + width && i < size; i++)
+			assign_bit(goals, CELL(i, j), true);
+	maze_flood();
+}
+
+uint8_t maze_size(void)
+{
+	return size;
+}
+
+bool maze_is_goal(uint8_t x, uint8_t y)
+{
+	return test_bit(goals, CELL(x, y));
+}
+
+/**
+ * @brief Record a discovered cell side, updating the distances.
+ *
+ * Only new walls require an update (unknown sides are already assumed to
+ * be open), which is incremental (see `wall_added()`). Correcting a wall to
+ * open floods the whole maze again.
+ *
+ * @param[in] x Cell column.
+ * @param[in] y Cell row.
+ * @param[in] direction Cell side.
+ * @param[in] present Whether there is a wall.
+ *
+ * @return Whether the side state changed.
+ */
+bool maze_set_wall(uint8_t x, uint8_t y, enum maze_direction direction,
+		   bool present)
+{
+	enum maze_wall wall = present ? MAZE_WALL_PRESENT : MAZE_WALL_OPEN;
+	enum maze_wall previous;
+	uint16_t cell;
+	uint8_t shift;
+
+	if (x >= size || y >= size ||
+	    !locate_edge(x, y, direction, &cell, &shift))
+		return false;
+	previous = read_edge(cell, shift);
+	if (previous == wall)
+		return false;
+	write_edge(cell, shift, wall);
+	if (present) {
+		stats.walls++;
+		wall_added(CELL(x, y), neighbour(CELL(x, y), direction));
+	} else if (previous == MAZE_WALL_PRESENT) {
+		maze_flood();
+	}
+	return true;
+}
+
+/**
+ * @brief Return the number of steps from a cell to the goal.
+ */
+uint16_t maze_distance(uint8_t x, uint8_t y)
+{
+	return distances[CELL(x, y)];
+}
+
+/**
+ * @brief Return the direction to the accessible neighbour closest to the goal.
+ *
+ * On ties, going straight is preferred.
+ *
+ * @param[in] x Cell column.
+ * @param[in] y Cell row.
+ * @param[in] heading Current heading.
+ */
+enum maze_direction maze_next_direction(uint8_t x, uint8_t y,
+					enum maze_direction heading)
+{
+	enum maze_direction best = heading;
+	enum maze_direction direction;
+	uint16_t best_distance = MAZE_UNREACHABLE;
+	uint16_t distance;
+	uint8_t i;
+
+	for (i = 0; i < MAZE_DIRECTIONS_COUNT; i++) {
+		direction = (enum maze_direction)((heading + i) %
+						  MAZE_DIRECTIONS_COUNT);
+		if (!accessible(CELL(x, y), direction))
+			continue;
+		distance = distances[neighbour(CELL(x, y), direction)];
+		if (distance < best_distance) {
+			best = direction;
+			best_distance = distance;
+		}
+	}
+	return best;
+}
+
+/**
+ * @brief Get a copy of the discovered walls.
+ */
+void maze_get_map(struct maze_map *map)
+{
+	map->size = size;
+	memcpy(map->walls, walls, sizeof(walls));
+}
+
+/**
+ * @brief Restore the discovered walls (i.e.: a stored map).
+ *
+ * The goal is set at the center, and all distances are computed.
+ *
+ * @return Whether the map was valid.
+ */
+bool maze_set_map(const struct maze_map *map)
+{
+	if (!map->size || map->size > MAZE_MAX_SIZE)
+		return false;
+	maze_reset(map->size);
+	memcpy(walls, map->walls, sizeof(walls));
+	maze_flood();
+	return true;
+}
+
+/**
+ * @brief Get a copy of the solver statistics.
+ */
+void maze_get_stats(struct maze_stats *output)
+{
+	*output = stats;
+}
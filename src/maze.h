@@ -0,0 +1,84 @@
+#ifndef __MAZE_H
+#define __MAZE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Maze dimensions.
+ *
+ * Both the classic (16x16) and the half-size (32x32) mazes are supported,
+ * with storage for the largest one. Cells are indexed as
+ * `y * MAZE_MAX_SIZE + x`, with the start cell (0, 0) at the south-west
+ * corner.
+ */
+#define MAZE_CLASSIC_SIZE 16
+#define MAZE_HALF_SIZE 32
+#define MAZE_MAX_SIZE MAZE_HALF_SIZE
+#define MAZE_MAX_CELLS (MAZE_MAX_SIZE * MAZE_MAX_SIZE)
+
+/** Distance of the cells with no known path to the goal */
+#define MAZE_UNREACHABLE UINT16_MAX
+
+/**
+ * Wall map size: the north and east edges of each cell are stored (the
+ * south and west edges are the north and east edges of the neighbours), with
+ * two bits per edge.
+ */
+#define MAZE_WALLS_SIZE (MAZE_MAX_CELLS / 2)
+
+enum maze_direction {
+	MAZE_NORTH,
+	MAZE_EAST,
+	MAZE_SOUTH,
+	MAZE_WEST,
+	MAZE_DIRECTIONS_COUNT,
+};
+
+/** Edge state (two bits) */
+enum maze_wall {
+	MAZE_WALL_UNKNOWN = 0,
+	MAZE_WALL_OPEN = 1,
+	MAZE_WALL_PRESENT = 2,
+};
+
+/**
+ * Discovered walls, as stored (see `settings_save_maze()`).
+ */
+struct maze_map {
+	uint8_t size;
+	uint8_t walls[MAZE_WALLS_SIZE];
+};
+
+/**
+ * Solver statistics.
+ *
+ * - Walls added, and how many of them required distances to be updated.
+ * - Cells whose distance was invalidated and propagated again.
+ * - Full flood fills.
+ */
+struct maze_stats {
+	uint32_t walls;
+	uint32_t updates;
+	uint32_t cells;
+	uint32_t floods;
+};
+
+void maze_reset(uint8_t size);
+void maze_set_goal(uint8_t x, uint8_t y, uint8_t width, uint8_t height);
+uint8_t maze_size(void);
+bool maze_is_goal(uint8_t x, uint8_t y);
+enum maze_wall maze_get_wall(uint8_t x, uint8_t y,
+			     enum maze_direction direction);
+bool maze_set_wall(uint8_t x, uint8_t y, enum maze_direction direction,
+		   bool present);
+uint16_t maze_distance(uint8_t x, uint8_t y);
+enum maze_direction maze_next_direction(uint8_t x, uint8_t y,
+					enum maze_direction heading);
+void maze_flood(void);
+void maze_get_map(struct maze_map *map);
+bool maze_set_map(const struct maze_map *map);
+void maze_get_stats(struct maze_stats *stats);
+
+#endif /* __MAZE_H */
@@ -0,0 +1,458 @@
+#include "motion.h"
+
+/**
+ * Moves are compiled ahead of time, in the background, into phases where
+ * both velocities go from a start value to an end value following the ramp
+ * shape (a constant velocity is a phase with no change). The motor loop only
+ * steps through the queued phases, looking up and interpolating the shape
+ * table, so consecutive moves chain without stopping.
+ *
+ * Compiled phases last a whole number of ticks, so the travelled distance
+ * is not exactly the requested one. The difference is carried over to the
+ * next straight, so the error does not grow along a run.
+ */
+#define MICRORADIANS_PER_STEP 785398
+
+/** Straight overrun, in micrometers, counted as a clamped end velocity */
+#define MOTION_OVERRUN_TOLERANCE 1000.f
+
+struct phase {
+	uint16_t ticks;
+	uint32_t step;
+	int32_t linear_start;
+	int32_t linear_change;
+	int32_t angular_start;
+	int32_t angular_change;
+};
+
+static struct motion_limits limits = {
+    .acceleration = 3000000,
+    .shape = MOTION_S_CURVE,
+};
+
+/**
+ * Ramp shape, from 0 to `1 << MOTION_SHAPE_SHIFT`, sampled at
+ * `MOTION_SHAPE_SIZE + 1` evenly spaced points. Shapes are symmetric, so the
+ * average value over a ramp is one half whatever the shape.
+ */
+static CCM uint16_t shape_table[MOTION_SHAPE_SIZE + 1];
+
+/**
+ * Phase queue, filled in the background and consumed by the motor loop.
+ */
+static CCM struct phase queue[MOTION_QUEUE_SIZE];
+static volatile uint8_t head;
+static volatile uint8_t tail;
+
+/** Motor loop state */
+static CCM uint16_t elapsed;
+static CCM struct motion_setpoint setpoint;
+static struct motion_stats stats;
+
+/** Compiler state: end velocity of the last queued move and distance error */
+static float queued_velocity;
+static float residual;
+
+/** Planned run being compiled */
+static const struct planner_move *run_moves;
+static uint16_t run_count;
+static uint16_t run_index;
+
+/**
+ * @brief Fill the ramp shape table for the current limits.
+ *
+ * S-curves have a normalized acceleration rising linearly during the first
+ * jerk fraction of the ramp, constant, and falling linearly during the last
+ * one. With no jerk fraction the acceleration is constant.
+ */
+static void fill_shape_table(void)
+{
+	float fraction = limits.shape == MOTION_S_CURVE ? MOTION_JERK_FRACTION
+							: 0.f;
+	float peak = 1.f / (1.f - fraction);
+	float position;
+	float value;
+	uint16_t i;
+
+	for (i = 0; i <= MOTION_SHAPE_SIZE; i++) {
+		position = (float)i / MOTION_SHAPE_SIZE;
+		if (position < fraction)
+			value = peak * position * position / (2 * fraction);
+		else if (position <= 1.f - fraction)
+			value = peak * (fraction / 2 + position - fraction);
+		else
+			value = 1.f - peak * (1.f - position) *
+					  (1.f - position) / (2 * fraction);
+		shape_table[i] =
+		    (uint16_t)(value * (1 << MOTION_SHAPE_SHIFT) + 0.5f);
+	}
+}
+
+/**
+ * @brief Set the profile limits and rebuild the shape table.
+ *
+ * Must be called while idle, as it resets the motion queue.
+ */
+void motion_set_limits(const struct motion_limits *new_limits)
+{
+	limits = *new_limits;
+	motion_reset();
+}
+
+void motion_get_limits(struct motion_limits *copy)
+{
+	*copy = limits;
+}
+
+/**
+ * @brief Average acceleration of a velocity ramp, in m/s^2.
+ *
+ * The planner acceleration must not exceed this value, so straights can
+ * reach the planned turn speeds within their length.
+ */
+float motion_average_acceleration(void)
+{
+	float acceleration = (float)limits.acceleration / MICROMETERS_PER_METER;
+
+	if (limits.shape == MOTION_S_CURVE)
+		acceleration *= 1.f - MOTION_JERK_FRACTION;
+	return acceleration;
+}
+
+/**
+ * @brief Stop any motion, empty the queue and rebuild the shape table.
+ *
+ * The setpoints are set to zero, so the robot is expected to be stopped.
+ */
+void motion_reset(void)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		head = 0;
+		tail = 0;
+		elapsed = 0;
+		memset(&setpoint, 0, sizeof(setpoint));
+		memset(&stats, 0, sizeof(stats));
+	}
+	fill_shape_table();
+	queued_velocity = 0.f;
+	residual = 0.f;
+	run_moves = NULL;
+	run_count = 0;
+	run_index = 0;
+}
+
+static uint8_t free_phases(void)
+{
+	return (uint8_t)((tail - head - 1 + MOTION_QUEUE_SIZE) %
+			 MOTION_QUEUE_SIZE);
+}
+
+static uint16_t seconds_to_ticks(float seconds)
+{
+	float ticks = seconds * SYSTICK_FREQUENCY_HZ + 0.5f;
+
+	if (ticks <= 0.f)
+		return 0;
+	if (ticks >= UINT16_MAX)
+		return UINT16_MAX;
+	return (uint16_t)ticks;
+}
+
+/**
+ * @brief Duration of a velocity ramp, in ticks.
+ *
+ * Rounded up, so the acceleration never exceeds the limit.
+ */
+static uint16_t ramp_ticks(float change, float acceleration)
+{
+	return seconds_to_ticks(change / acceleration +
+				0.5f / SYSTICK_FREQUENCY_HZ - 1e-6f);
+}
+
+/**
+ * @brief Distance travelled during a ramp of a number of ticks.
+ *
+ * Setpoints are sampled at the end of each tick, and the shape is
+ * symmetric, so the samples of a ramp average to one half plus half a
+ * sample.
+ */
+static float ramp_distance(float start, float end, uint16_t ticks)
+{
+	return (start * ticks + (end - start) * (ticks + 1) / 2) /
+	       SYSTICK_FREQUENCY_HZ;
+}
+
+/**
+ * @brief Queue a phase, unless it is empty.
+ */
+static void push_phase(uint16_t ticks, float linear_start, float linear_end,
+		       int32_t angular_start, int32_t angular_end)
+{
+	struct phase *phase = &queue[head];
+
+	if (!ticks)
+		return;
+	phase->ticks = ticks;
+	phase->step = ((uint32_t)MOTION_SHAPE_SIZE << 16) / ticks;
+	phase->linear_start = (int32_t)linear_start;
+	phase->linear_change = (int32_t)linear_end - phase->linear_start;
+	phase->angular_start = angular_start;
+	phase->angular_change = angular_end - angular_start;
+	CM_ATOMIC_BLOCK()
+	{
+		head = (uint8_t)((head + 1) % MOTION_QUEUE_SIZE);
+	}
+}
+
+/**
+ * @brief Queue a straight, starting at the end velocity of the last move.
+ *
+ * The velocity ramps up towards `max_velocity`, cruises and ramps down to
+ * `end_velocity`. If the end velocity can not be reached within the
+ * distance, it is reached anyway with the shortest ramp and the straight is
+ * longer than requested (see `struct motion_stats`). The distance error is
+ * carried over to the next straight.
+ *
+ * @param[in] distance Distance, in micrometers.
+ * @param[in] max_velocity Maximum velocity, in micrometers per second.
+ * @param[in] end_velocity End velocity, in micrometers per second.
+ *
+ * @return Whether the straight was queued, or the queue was full.
+ */
+bool motion_push_straight(int32_t distance, int32_t max_velocity,
+			  int32_t end_velocity)
+{
+	float acceleration = (float)limits.acceleration;
+	float start = queued_velocity;
+	float end = (float)end_velocity;
+	float target = distance + residual;
+	float travelled;
+	float peak;
+	bool clamped;
+	uint16_t up;
+	uint16_t cruise = 0;
+	uint16_t down;
+
+	if (free_phases() < MOTION_MOVE_PHASES)
+		return false;
+	if (limits.shape == MOTION_S_CURVE)
+		acceleration *= 1.f - MOTION_JERK_FRACTION;
+	clamped = fabsf(end * end - start * start) >
+		  2 * acceleration * (target > 0.f ? target : 0.f);
+	if (clamped) {
+		peak = start > end ? start : end;
+	} else {
+		peak = sqrtf(acceleration * target +
+			     (start * start + end * end) / 2);
+		if (peak > max_velocity)
+			peak = (float)max_velocity;
+		if (peak < start)
+			peak = start;
+		if (peak < end)
+			peak = end;
+	}
+	up = ramp_ticks(peak - start, acceleration);
+	down = ramp_ticks(peak - end, acceleration);
+	travelled =
+	    ramp_distance(start, peak, up) + ramp_distance(peak, end, down);
+	if (peak > 0.f && target > travelled)
+		cruise = seconds_to_ticks((target - travelled) / peak);
+	travelled += peak * cruise / SYSTICK_FREQUENCY_HZ;
+	residual = target - travelled;
+	if (clamped && residual < -MOTION_OVERRUN_TOLERANCE)
+		stats.clamped++;
+
+	push_phase(up, start, peak, 0, 0);
+	push_phase(cruise, peak, peak, 0, 0);
+	push_phase(down, peak, end, 0, 0);
+	queued_velocity = end;
+	return true;
+}
+
+/**
+ * @brief Queue a turn, at a constant linear velocity.
+ *
+ * The angular velocity ramps up, holds and ramps down, each ramp taking
+ * `MOTION_TURN_RAMP_FRACTION` of the turn, so that it integrates to the
+ * turn angle. The linear velocity should be the end velocity of the last
+ * move.
+ *
+ * @param[in] angle Turn angle, in microradians (counter-clockwise positive).
+ * @param[in] distance Path length, in micrometers.
+ * @param[in] velocity Linear velocity, in micrometers per second.
+ *
+ * @return Whether the turn was queued, or the queue was full (or the
+ * velocity is not positive).
+ */
+bool motion_push_turn(int32_t angle, int32_t distance, int32_t velocity)
+{
+	uint16_t ticks;
+	uint16_t ramp;
+	uint16_t hold;
+	int32_t peak;
+
+	if (free_phases() < MOTION_MOVE_PHASES || velocity <= 0)
+		return false;
+	ticks = seconds_to_ticks((float)distance / velocity);
+	if (ticks < 2)
+		ticks = 2;
+	ramp = (uint16_t)(ticks * MOTION_TURN_RAMP_FRACTION + 0.5f);
+	if (!ramp)
+		ramp = 1;
+	hold = (uint16_t)(ticks - 2 * ramp);
+	peak = (int32_t)((int64_t)angle * SYSTICK_FREQUENCY_HZ / (ramp + hold));
+	residual += distance - (float)velocity * ticks / SYSTICK_FREQUENCY_HZ;
+
+	push_phase(ramp, (float)velocity, (float)velocity, 0, peak);
+	push_phase(hold, (float)velocity, (float)velocity, peak, peak);
+	push_phase(ramp, (float)velocity, (float)velocity, peak, 0);
+	queued_velocity = (float)velocity;
+	return true;
+}
+
+static int32_t meters_to_micrometers(float meters)
+{
+	return (int32_t)(meters * MICROMETERS_PER_METER + 0.5f);
+}
+
+/**
+ * @brief Queue a planned move, ending at the speed of the next one.
+ */
+static bool push_move(const struct planner_move *move,
+		      const struct planner_move *next)
+{
+	int32_t distance = meters_to_micrometers(planner_move_length(move));
+	int32_t speed = meters_to_micrometers(planner_move_speed(move));
+
+	switch (move->type) {
+	case PLANNER_STRAIGHT:
+	case PLANNER_DIAGONAL:
+		return motion_push_straight(
+		    distance, speed,
+		    next ? meters_to_micrometers(planner_move_speed(next)) : 0);
+	case PLANNER_STOP:
+		return motion_push_straight(0, 0, 0);
+	default:
+		return motion_push_turn(planner_move_angle(move) *
+					    MICRORADIANS_PER_STEP,
+					distance, speed);
+	}
+}
+
+/**
+ * @brief Start compiling a planned run, from the end of the queued moves.
+ *
+ * The moves are compiled by `motion_feed()` as the queue empties, so the
+ * buffer must be kept until the run is compiled. The speeds and lengths are
+ * those of the last plan (see `planner_move_speed()`).
+ */
+void motion_run(const struct planner_move *moves, uint16_t count)
+{
+	run_moves = moves;
+	run_count = count;
+	run_index = 0;
+	motion_feed();
+}
+
+/**
+ * @brief Compile the next moves of the run while there is room in the queue.
+ *
+ * To be called from the background often enough for the queue not to run
+ * out of phases (each move takes at least tens of ticks).
+ */
+void motion_feed(void)
+{
+	const struct planner_move *next;
+
+	while (run_index < run_count) {
+		next = run_index + 1 < run_count ? &run_moves[run_index + 1]
+						 : NULL;
+		if (!push_move(&run_moves[run_index], next))
+			break;
+		run_index++;
+	}
+}
+
+/**
+ * @brief Evaluate the ramp shape at a Q16 table position.
+ */
+static RAMFUNC int32_t shape(uint32_t position)
+{
+	uint32_t index = position >> 16;
+	int32_t low;
+
+	if (index >= MOTION_SHAPE_SIZE)
+		return shape_table[MOTION_SHAPE_SIZE];
+	low = shape_table[index];
+	return low + (int32_t)(((shape_table[index + 1] - low) *
+				(int32_t)(position & 0xffff)) >>
+			       16);
+}
+
+static RAMFUNC int32_t interpolate(int32_t start, int32_t change,
+				   int32_t value)
+{
+	return start +
+	       (int32_t)(((int64_t)change * value) >> MOTION_SHAPE_SHIFT);
+}
+
+/**
+ * @brief Compute the setpoints for the current tick.
+ *
+ * To be called once per SysTick period. When the queue is empty, the last
+ * setpoints are kept (which are zero after a run ending with a stop).
+ */
+RAMFUNC void motion_update(void)
+{
+	const struct phase *phase;
+	int32_t value;
+
+	if (head == tail) {
+		if (setpoint.linear_velocity || setpoint.angular_velocity)
+			stats.underruns++;
+		return;
+	}
+	phase = &queue[tail];
+	elapsed++;
+	if (elapsed < phase->ticks)
+		value = shape(elapsed * phase->step);
+	else
+		value = 1 << MOTION_SHAPE_SHIFT;
+	setpoint.linear_velocity =
+	    interpolate(phase->linear_start, phase->linear_change, value);
+	setpoint.angular_velocity =
+	    interpolate(phase->angular_start, phase->angular_change, value);
+	if (elapsed >= phase->ticks) {
+		elapsed = 0;
+		tail = (uint8_t)((tail + 1) % MOTION_QUEUE_SIZE);
+		stats.phases++;
+	}
+}
+
+/**
+ * @brief Get a consistent copy of the current setpoints.
+ */
+void motion_get_setpoint(struct motion_setpoint *copy)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		*copy = setpoint;
+	}
+}
+
+/**
+ * @brief Whether the run is compiled and all its phases were executed.
+ */
+bool motion_is_idle(void)
+{
+	return run_index >= run_count && head == tail;
+}
+
+void motion_get_stats(struct motion_stats *copy)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		*copy = stats;
+	}
+}
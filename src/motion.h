@@ -0,0 +1,97 @@
+#ifndef __MOTION_H
+#define __MOTION_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <libopencm3/cm3/cortex.h>
+
+#include "planner.h"
+#include "setup.h"
+
+/** Ramp shape table entries (plus the end point) */
+#define MOTION_SHAPE_BITS 8
+#define MOTION_SHAPE_SIZE (1 << MOTION_SHAPE_BITS)
+
+/** Ramp shape values are in Q15 (`1 << MOTION_SHAPE_SHIFT` is the end) */
+#define MOTION_SHAPE_SHIFT 15
+
+/** Fraction of an S-curve ramp taken by each jerk-limited phase */
+#define MOTION_JERK_FRACTION 0.25f
+
+/** Fraction of a turn taken by each angular velocity ramp */
+#define MOTION_TURN_RAMP_FRACTION 0.25f
+
+/** Queued phases (each move takes up to `MOTION_MOVE_PHASES`) */
+#define MOTION_QUEUE_SIZE 32
+#define MOTION_MOVE_PHASES 3
+
+/**
+ * Velocity ramp shapes.
+ *
+ * - `MOTION_TRAPEZOIDAL`: constant acceleration.
+ * - `MOTION_S_CURVE`: acceleration ramped up and down with a constant jerk,
+ *   each jerk phase taking `MOTION_JERK_FRACTION` of the ramp.
+ */
+enum motion_shape {
+	MOTION_TRAPEZOIDAL,
+	MOTION_S_CURVE,
+};
+
+/**
+ * Profile limits.
+ *
+ * - Peak linear acceleration (and deceleration), in micrometers per second
+ *   squared. S-curve ramps are longer than trapezoidal ones for the same
+ *   peak, with an average acceleration `1 - MOTION_JERK_FRACTION` times the
+ *   peak.
+ * - Ramp shape.
+ */
+struct motion_limits {
+	int32_t acceleration;
+	enum motion_shape shape;
+};
+
+/**
+ * Velocity setpoints for the current tick.
+ *
+ * - Linear velocity, in micrometers per second.
+ * - Angular velocity, in microradians per second (counter-clockwise
+ *   positive).
+ */
+struct motion_setpoint {
+	int32_t linear_velocity;
+	int32_t angular_velocity;
+};
+
+/**
+ * Profile statistics since the last reset.
+ *
+ * - Phases completed by the motor loop.
+ * - Ticks where the queue was empty while moving.
+ * - Moves where the end velocity could not be reached within the distance,
+ *   which are then longer than requested.
+ */
+struct motion_stats {
+	uint32_t phases;
+	uint32_t underruns;
+	uint32_t clamped;
+};
+
+void motion_set_limits(const struct motion_limits *limits);
+void motion_get_limits(struct motion_limits *limits);
+float motion_average_acceleration(void);
+void motion_reset(void);
+bool motion_push_straight(int32_t distance, int32_t max_velocity,
+			  int32_t end_velocity);
+bool motion_push_turn(int32_t angle, int32_t distance, int32_t velocity);
+void motion_run(const struct planner_move *moves, uint16_t count);
+void motion_feed(void);
+void motion_update(void);
+void motion_get_setpoint(struct motion_setpoint *setpoint);
+bool motion_is_idle(void);
+void motion_get_stats(struct motion_stats *stats);
+
+#endif /* __MOTION_H */
@@ -2,84 +2,163 @@
 
 static volatile uint32_t saturated_left;
 static volatile uint32_t saturated_right;
+static volatile int32_t applied_power_left;
+static volatile int32_t applied_power_right;
+static volatile int32_t power_limit = MAX_PWM_PERIOD;
+static volatile bool locked;
 
 /**
- * @brief Set left motor power.
- *
- * Power is set modulating the PWM signal sent to the motor driver.
+ * @brief Saturate a motor power and compute the H-bridge compare values.
  *
  * This function checks for possible PWM saturation. If that is the case the
- * value will be limited to the maximum PWM allowed and the `saturated_left`
- * variable will be incremented by one. This variable is later used to check
- * if multiple consecutive saturated values occurred, which is interpreted as
- * a collision.
+ * value will be limited to the maximum PWM allowed (see `set_power_limit()`)
+ * and the `saturated` variable will be incremented by one. This variable is
+ * later used to check if multiple consecutive saturated values occurred,
+ * which is interpreted as a collision.
  *
  * @param[in] power Power value from -MAX_PWM_PERIOD to MAX_PWM_PERIOD.
+ * @param[in,out] saturated Consecutive saturated values counter.
+ * @param[out] forward Compare value for the forward channel.
+ * @param[out] backward Compare value for the backward channel.
+ *
+ * @return The power to be applied (after saturation).
  */
-void power_left(int32_t power)
+static RAMFUNC int32_t bridge_compare_values(int32_t power,
+					     volatile uint32_t *saturated,
+					     uint32_t *forward,
+					     uint32_t *backward)
 {
-	bool forward = true;
+	bool reverse = false;
 
 	if (power < 0) {
 		power = -power;
-		forward = false;
+		reverse = true;
 	}
-	if (power > MAX_PWM_PERIOD) {
-		power = MAX_PWM_PERIOD;
-		saturated_left += 1;
+	if (power > power_limit) {
+		power = power_limit;
+		*saturated += 1;
 	} else {
-		saturated_left = 0;
+		*saturated = 0;
 	}
-	if (forward) {
-		timer_set_oc_value(TIM8, TIM_OC3, MAX_PWM_PERIOD);
-		timer_set_oc_value(TIM8, TIM_OC4, MAX_PWM_PERIOD - power);
-	} else {
-		timer_set_oc_value(TIM8, TIM_OC3, MAX_PWM_PERIOD - power);
-		timer_set_oc_value(TIM8, TIM_OC4, MAX_PWM_PERIOD);
+	if (reverse) {
+		*forward = MAX_PWM_PERIOD - power;
+		*backward = MAX_PWM_PERIOD;
+		return -power;
 	}
+	*forward = MAX_PWM_PERIOD;
+	*backward = MAX_PWM_PERIOD - power;
+	return power;
 }
 
 /**
- * @brief Set right motor power.
+ * @brief Set left motor power.
  *
- * Power is set modulating the PWM signal sent to the motor driver.
+ * Power is set modulating the PWM signal sent to the motor driver. The value
+ * is saturated as described in `bridge_compare_values()`. It has no effect
+ * while the motors are locked (see `lock_motors()`).
  *
- * This function checks for possible PWM saturation. If that is the case the
- * value will be limited to the maximum PWM allowed and the `saturated_right`
- * variable will be incremented by one. This variable is later used to check
- * if multiple consecutive saturated values occurred, which is interpreted as
- * a collision.
+ * @param[in] power Power value from -MAX_PWM_PERIOD to MAX_PWM_PERIOD.
+ */
+RAMFUNC void power_left(int32_t power)
+{
+	uint32_t forward;
+	uint32_t backward;
+
+	if (locked)
+		return;
+
+	applied_power_left =
+	    bridge_compare_values(power, &saturated_left, &forward, &backward);
+	timer_set_oc_value(TIM8, TIM_OC3, forward);
+	timer_set_oc_value(TIM8, TIM_OC4, backward);
+}
+
+/**
+ * @brief Set right motor power.
+ *
+ * Power is set modulating the PWM signal sent to the motor driver. The value
+ * is saturated as described in `bridge_compare_values()`. It has no effect
+ * while the motors are locked (see `lock_motors()`).
  *
  * @param[in] power Power value from -MAX_PWM_PERIOD to MAX_PWM_PERIOD.
  */
-void power_right(int32_t power)
+RAMFUNC void power_right(int32_t power)
 {
-	bool forward = true;
+	uint32_t forward;
+	uint32_t backward;
 
-	if (power < 0) {
-		power = -power;
-		forward = false;
-	}
-	if (power > MAX_PWM_PERIOD) {
-		power = MAX_PWM_PERIOD;
-		saturated_right += 1;
-	} else {
-		saturated_right = 0;
-	}
-	if (forward) {
-		timer_set_oc_value(TIM8, TIM_OC1, MAX_PWM_PERIOD);
-		timer_set_oc_value(TIM8, TIM_OC2, MAX_PWM_PERIOD - power);
-	} else {
-		timer_set_oc_value(TIM8, TIM_OC1, MAX_PWM_PERIOD - power);
-		timer_set_oc_value(TIM8, TIM_OC2, MAX_PWM_PERIOD);
-	}
+	if (locked)
+		return;
+
+	applied_power_right =
+	    bridge_compare_values(power, &saturated_right, &forward, &backward);
+	timer_set_oc_value(TIM8, TIM_OC1, forward);
+	timer_set_oc_value(TIM8, TIM_OC2, backward);
+}
+
+/**
+ * @brief Set both motors power, taking effect in the same PWM period.
+ *
+ * The compare registers are preloaded (see `setup_motor_driver()`), so new
+ * values are only transferred to the outputs on the TIM8 update event. The
+ * update event is disabled while the four registers are written, so that
+ * both motors always change at the same period boundary, without a
+ * half-updated bridge in between. It has no effect while the motors are
+ * locked (see `lock_motors()`).
+ *
+ * @param[in] left Left motor power, from -MAX_PWM_PERIOD to MAX_PWM_PERIOD.
+ * @param[in] right Right motor power, from -MAX_PWM_PERIOD to MAX_PWM_PERIOD.
+ */
+RAMFUNC void power_both(int32_t left, int32_t right)
+{
+	uint32_t left_forward;
+	uint32_t left_backward;
+	uint32_t right_forward;
+	uint32_t right_backward;
+
+	if (locked)
+		return;
+
+	applied_power_left = bridge_compare_values(
+	    left, &saturated_left, &left_forward, &left_backward);
+	applied_power_right = bridge_compare_values(
+	    right, &saturated_right, &right_forward, &right_backward);
+
+	timer_disable_update_event(TIM8);
+	TIM_CCR1(TIM8) = right_forward;
+	TIM_CCR2(TIM8) = right_backward;
+	TIM_CCR3(TIM8) = left_forward;
+	TIM_CCR4(TIM8) = left_backward;
+	timer_enable_update_event(TIM8);
+}
+
+/**
+ * @brief Return the power last applied to the left motor (after saturation).
+ */
+int32_t get_power_left(void)
+{
+	return applied_power_left;
+}
+
+/**
+ * @brief Return the power last applied to the right motor (after saturation).
+ */
+int32_t get_power_right(void)
+{
+	return applied_power_right;
 }
 
 /**
  * @brief Break both motors (short the motor winding).
+ *
+ * The PWM saturation counters are reset, as no power is applied.
  */
 void drive_break(void)
 {
+	applied_power_left = 0;
+	applied_power_right = 0;
+	saturated_left = 0;
+	saturated_right = 0;
 	timer_set_oc_value(TIM8, TIM_OC1, MAX_PWM_PERIOD);
 	timer_set_oc_value(TIM8, TIM_OC2, MAX_PWM_PERIOD);
 	timer_set_oc_value(TIM8, TIM_OC3, MAX_PWM_PERIOD);
@@ -88,9 +167,15 @@ void drive_break(void)
 
 /**
  * @brief Disable the motor driver (let both motors coast).
+ *
+ * The PWM saturation counters are reset, as no power is applied.
  */
 void drive_off(void)
 {
+	applied_power_left = 0;
+	applied_power_right = 0;
+	saturated_left = 0;
+	saturated_right = 0;
 	timer_set_oc_value(TIM8, TIM_OC1, 0);
 	timer_set_oc_value(TIM8, TIM_OC2, 0);
 	timer_set_oc_value(TIM8, TIM_OC3, 0);
@@ -115,3 +200,55 @@ void reset_pwm_saturation(void)
 	saturated_left = 0;
 	saturated_right = 0;
 }
+
+/**
+ * @brief Set the maximum power applied to the motors.
+ *
+ * Higher power values are saturated to this limit, which can be used to
+ * reduce the motor currents.
+ *
+ * @param[in] limit Power limit, from 0 to MAX_PWM_PERIOD.
+ */
+void set_power_limit(int32_t limit)
+{
+	if (limit < 0)
+		limit = 0;
+	if (limit > MAX_PWM_PERIOD)
+		limit = MAX_PWM_PERIOD;
+	power_limit = limit;
+}
+
+/**
+ * @brief Return the maximum power applied to the motors.
+ */
+int32_t get_power_limit(void)
+{
+	return power_limit;
+}
+
+/**
+ * @brief Ignore power changes until `unlock_motors()` is called.
+ *
+ * Used to keep the motors off (or breaking) after a collision, even if the
+ * control loop keeps setting the motors power.
+ */
+void lock_motors(void)
+{
+	locked = true;
+}
+
+/**
+ * @brief Allow power changes again after `lock_motors()`.
+ */
+void unlock_motors(void)
+{
+	locked = false;
+}
+
+/**
+ * @brief Return whether power changes are being ignored.
+ */
+bool motors_locked(void)
+{
+	return locked;
+}
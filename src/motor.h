@@ -8,9 +8,17 @@
 
 void drive_break(void);
 void drive_off(void);
+int32_t get_power_left(void);
+int32_t get_power_limit(void);
+int32_t get_power_right(void);
+void lock_motors(void);
+bool motors_locked(void);
 uint32_t pwm_saturation(void);
+void power_both(int32_t left, int32_t right);
 void power_left(int32_t power);
 void power_right(int32_t power);
 void reset_pwm_saturation(void);
+void set_power_limit(int32_t limit);
+void unlock_motors(void);
 
 #endif /* __MOTOR_H */
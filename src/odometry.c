@@ -0,0 +1,135 @@
+#include "odometry.h"
+
+/** Wheel travel per encoder count */
+#define NANOMETERS_PER_COUNT                                                   \
+	((int64_t)(2 * PI * WHEEL_RADIUS_MICROMETERS * 1000 /                  \
+		   (MOTOR_GEAR_RATIO * ENCODER_COUNTS_PER_MOTOR_REVOLUTION)))
+
+#define MICRORADIANS_PER_RADIAN 1000000
+
+/**
+ * Velocity low-pass filter.
+ *
+ * Exponential moving average of the counts per period, in Q16.16, with a
+ * smoothing factor of `1 / 2^ODOMETRY_FILTER_SHIFT` (a time constant of about
+ * 8 periods).
+ */
+#define ODOMETRY_FILTER_SHIFT 3
+#define ODOMETRY_FILTER_FRACTION_BITS 16
+
+static CCM struct odometry state;
+static CCM int32_t filtered_left;
+static CCM int32_t filtered_right;
+
+/**
+ * @brief Reset the odometry to zero, starting from the current encoders.
+ */
+void odometry_reset(void)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		memset(&state, 0, sizeof(state));
+		state.raw_left = read_encoder_left();
+		state.raw_right = read_encoder_right();
+		filtered_left = 0;
+		filtered_right = 0;
+	}
+}
+
+/**
+ * @brief Update the filtered estimate with the new counts of a period.
+ */
+static int32_t filter(int32_t filtered, int32_t delta)
+{
+	return filtered +
+	       ((delta * (1 << ODOMETRY_FILTER_FRACTION_BITS) - filtered) >>
+		ODOMETRY_FILTER_SHIFT);
+}
+
+/**
+ * @brief Sample the encoders and update the odometry.
+ *
+ * To be called once per SysTick period. The encoder counters wrap at 16
+ * bits, so the difference with the previous reading is interpreted as a
+ * signed 16-bit value, which is valid as long as the wheels do not travel
+ * more than 32767 counts (about 31 cm) in a period.
+ *
+ * Wheel travel in nanometers per millisecond equals the velocity in
+ * micrometers per second.
+ */
+void odometry_update(void)
+{
+	uint16_t raw_left = read_encoder_left();
+	uint16_t raw_right = read_encoder_right();
+	int64_t left;
+	int64_t right;
+
+	state.delta_left = (int16_t)(raw_left - state.raw_left);
+	state.delta_right = (int16_t)(raw_right - state.raw_right);
+	state.raw_left = raw_left;
+	state.raw_right = raw_right;
+	state.counts_left += state.delta_left;
+	state.counts_right += state.delta_right;
+
+	filtered_left = filter(filtered_left, state.delta_left);
+	filtered_right = filter(filtered_right, state.delta_right);
+	left = (int64_t)filtered_left * NANOMETERS_PER_COUNT *
+	       (SYSTICK_FREQUENCY_HZ / 1000);
+	right = (int64_t)filtered_right * NANOMETERS_PER_COUNT *
+		(SYSTICK_FREQUENCY_HZ / 1000);
+	state.linear_velocity =
+	    (int32_t)((left + right) >> (ODOMETRY_FILTER_FRACTION_BITS + 1));
+	state.angular_velocity = (int32_t)(
+	    ((right - left) * MICRORADIANS_PER_RADIAN /
+	     WHEELS_SEPARATION_MICROMETERS) >>
+	    ODOMETRY_FILTER_FRACTION_BITS);
+}
+
+/**
+ * @brief Get a consistent copy of the odometry state.
+ */
+void odometry_get(struct odometry *snapshot)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		*snapshot = state;
+	}
+}
+
+int64_t odometry_get_counts_left(void)
+{
+	int64_t counts;
+
+	CM_ATOMIC_BLOCK()
+	{
+		counts = state.counts_left;
+	}
+	return counts;
+}
+
+int64_t odometry_get_counts_right(void)
+{
+	int64_t counts;
+
+	CM_ATOMIC_BLOCK()
+	{
+		counts = state.counts_right;
+	}
+	return counts;
+}
+
+/**
+ * @brief Get the filtered linear velocity, in micrometers per second.
+ */
+int32_t odometry_get_linear_velocity(void)
+{
+	return state.linear_velocity;
+}
+
+/**
+ * @brief Get the filtered angular velocity, in microradians per second.
+ */
+int32_t odometry_get_angular_velocity(void)
+{
+	return state.angular_velocity;
+}
@@ -0,0 +1,38 @@
+#ifndef __ODOMETRY_H
+#define __ODOMETRY_H
+
+#include <stdint.h>
+
+#include <libopencm3/cm3/cortex.h>
+
+#include "platform.h"
+
+/**
+ * Odometry snapshot.
+ *
+ * - Cumulative and last-period encoder counts for each wheel.
+ * - Raw encoder counters at the last update (or reset).
+ * - Filtered linear velocity, in micrometers per second.
+ * - Filtered angular velocity, in microradians per second (counter-clockwise
+ *   positive).
+ */
+struct odometry {
+	int64_t counts_left;
+	int64_t counts_right;
+	int32_t delta_left;
+	int32_t delta_right;
+	uint16_t raw_left;
+	uint16_t raw_right;
+	int32_t linear_velocity;
+	int32_t angular_velocity;
+};
+
+void odometry_reset(void);
+void odometry_update(void);
+void odometry_get(struct odometry *snapshot);
+int64_t odometry_get_counts_left(void);
+int64_t odometry_get_counts_right(void);
+int32_t odometry_get_linear_velocity(void);
+int32_t odometry_get_angular_velocity(void);
+
+#endif /* __ODOMETRY_H */
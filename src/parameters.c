@@ -0,0 +1,324 @@
+#include "parameters.h"
+
+_Static_assert(PARAMETERS_COUNT <= 32, "Staged parameters mask too small");
+
+#define PARAMETER_INFO(name, type, min, max, when)                             \
+	{PARAMETER_TYPE_##type, PARAMETER_WHEN_##when, min, max},
+
+struct parameter_info {
+	enum parameter_type type;
+	enum parameter_when when;
+	float min;
+	float max;
+};
+
+static const struct parameter_info info[] = {PARAMETERS(PARAMETER_INFO)};
+
+static float values[PARAMETERS_COUNT];
+static float defaults[PARAMETERS_COUNT];
+static float staged[PARAMETERS_COUNT];
+static uint32_t staged_mask;
+static float pending[PARAMETERS_COUNT];
+static volatile uint32_t pending_mask;
+
+/**
+ * @brief Read a parameter value from the module it belongs to.
+ */
+static float read(enum parameter_id id)
+{
+	struct control_gains gains;
+	struct planner_limits limits;
+	struct motion_limits motion;
+
+	control_get_gains(&gains);
+	planner_get_limits(&limits);
+	motion_get_limits(&motion);
+	switch (id) {
+	case PARAMETER_POWER_LIMIT:
+		return (float)get_power_limit();
+	case PARAMETER_SATURATION_TICKS:
+		return (float)collision_get_saturation_ticks();
+	case PARAMETER_FEEDFORWARD:
+		return gains.feedforward;
+	case PARAMETER_LINEAR_KP:
+		return gains.linear_kp;
+	case PARAMETER_LINEAR_KI:
+		return gains.linear_ki;
+	case PARAMETER_ANGULAR_KP:
+		return gains.angular_kp;
+	case PARAMETER_ANGULAR_KI:
+		return gains.angular_ki;
+	case PARAMETER_MAX_SPEED:
+		return limits.max_speed;
+	case PARAMETER_MAX_DIAGONAL_SPEED:
+		return limits.max_diagonal_speed;
+	case PARAMETER_ACCELERATION:
+		return motion_average_acceleration();
+	case PARAMETER_LATERAL_ACCELERATION:
+		return limits.lateral_acceleration;
+	case PARAMETER_S_CURVE:
+		return motion.shape == MOTION_S_CURVE ? 1.f : 0.f;
+	case PARAMETER_COLLISION_POLICY:
+		return (float)collision_get_policy();
+	default:
+		return 0.f;
+	}
+}
+
+/**
+ * @brief Set the ramps acceleration and shape, for both the motion profile
+ * and the planner.
+ *
+ * The motion limit is the peak acceleration: with S-curve ramps it is raised
+ * so that the average acceleration is the planned one.
+ */
+static void write_ramps(float acceleration, bool s_curve)
+{
+	struct planner_limits limits;
+	struct motion_limits motion;
+
+	motion.shape = s_curve ? MOTION_S_CURVE : MOTION_TRAPEZOIDAL;
+	if (s_curve)
+		acceleration /= 1.f - MOTION_JERK_FRACTION;
+	motion.acceleration = (int32_t)(acceleration * MICROMETERS_PER_METER);
+	motion_set_limits(&motion);
+	planner_get_limits(&limits);
+	limits.acceleration = motion_average_acceleration();
+	planner_set_limits(&limits);
+}
+
+/**
+ * @brief Write a parameter value to the module it belongs to.
+ */
+static void write(enum parameter_id id, float value)
+{
+	struct control_gains gains;
+	struct planner_limits limits;
+
+	control_get_gains(&gains);
+	planner_get_limits(&limits);
+	switch (id) {
+	case PARAMETER_POWER_LIMIT:
+		set_power_limit((int32_t)value);
+		return;
+	case PARAMETER_SATURATION_TICKS:
+		collision_set_saturation_ticks((uint32_t)value);
+		return;
+	case PARAMETER_COLLISION_POLICY:
+		collision_set_policy((enum collision_policy)value);
+		return;
+	case PARAMETER_FEEDFORWARD:
+		gains.feedforward = value;
+		break;
+	case PARAMETER_LINEAR_KP:
+		gains.linear_kp = value;
+		break;
+	case PARAMETER_LINEAR_KI:
+		gains.linear_ki = value;
+		break;
+	case PARAMETER_ANGULAR_KP:
+		gains.angular_kp = value;
+		break;
+	case PARAMETER_ANGULAR_KI:
+		gains.angular_ki = value;
+		break;
+	case PARAMETER_MAX_SPEED:
+		limits.max_speed = value;
+		planner_set_limits(&limits);
+		return;
+	case PARAMETER_MAX_DIAGONAL_SPEED:
+		limits.max_diagonal_speed = value;
+		planner_set_limits(&limits);
+		return;
+	case PARAMETER_LATERAL_ACCELERATION:
+		limits.lateral_acceleration = value;
+		planner_set_limits(&limits);
+		return;
+	case PARAMETER_ACCELERATION:
+	case PARAMETER_S_CURVE:
+		write_ramps(values[PARAMETER_ACCELERATION],
+			    values[PARAMETER_S_CURVE] != 0.f);
+		return;
+	default:
+		return;
+	}
+	control_set_gains(&gains);
+}
+
+static bool valid(uint8_t id, float value)
+{
+	if (id >= PARAMETERS_COUNT || !(value >= info[id].min) ||
+	    !(value <= info[id].max))
+		return false;
+	return info[id].type != PARAMETER_TYPE_INT32 || value == floorf(value);
+}
+
+/**
+ * @brief Read the default values and load the stored ones, if any.
+ *
+ * Must be called after `storage_init()`. Stored values are discarded if the
+ * number of parameters changed or any of them is out of range.
+ */
+void parameters_load(void)
+{
+	float stored[PARAMETERS_COUNT];
+	uint8_t id;
+
+	for (id = 0; id < PARAMETERS_COUNT; id++) {
+		defaults[id] = read((enum parameter_id)id);
+		values[id] = defaults[id];
+	}
+	if (storage_read(STORAGE_PARAMETERS, stored, sizeof(stored))) {
+		for (id = 0; id < PARAMETERS_COUNT; id++)
+			if (!valid(id, stored[id]))
+				break;
+		if (id == PARAMETERS_COUNT)
+			for (id = 0; id < PARAMETERS_COUNT; id++)
+				values[id] = stored[id];
+	}
+	for (id = 0; id < PARAMETERS_COUNT; id++)
+		write((enum parameter_id)id, values[id]);
+}
+
+/**
+ * @brief Get a parameter description and its current value.
+ *
+ * The current value is read from the module it belongs to, so it does not
+ * include staged changes not yet applied, but it does include changes made
+ * by the firmware itself (i.e.: the power limit after a collision).
+ *
+ * @return Whether the parameter exists.
+ */
+bool parameters_get(uint8_t id, struct parameter *parameter)
+{
+	if (id >= PARAMETERS_COUNT)
+		return false;
+	parameter->type = info[id].type;
+	parameter->when = info[id].when;
+	parameter->min = info[id].min;
+	parameter->max = info[id].max;
+	parameter->default_value = defaults[id];
+	parameter->value = read((enum parameter_id)id);
+	return true;
+}
+
+/**
+ * @brief Stage a new parameter value, to be applied with the next call to
+ * `parameters_apply()`.
+ *
+ * @return Whether the value is valid and could be staged.
+ */
+bool parameters_stage(uint8_t id, float value)
+{
+	if (!valid(id, value))
+		return false;
+	if (info[id].when == PARAMETER_WHEN_STOPPED &&
+	    !control_robot_stopped())
+		return false;
+	staged[id] = value;
+	staged_mask |= 1u << id;
+	return true;
+}
+
+/**
+ * @brief Apply all the staged values at once.
+ *
+ * `STOPPED` parameters take effect immediately. `TICK` parameters are handed
+ * over to `parameters_update()`, so the control loop sees them all change in
+ * the same SysTick period. If the robot started moving since any `STOPPED`
+ * value was staged, nothing is applied and the staged values are discarded.
+ *
+ * @return Whether the staged values were applied.
+ */
+bool parameters_apply(void)
+{
+	uint32_t mask = staged_mask;
+	uint8_t id;
+
+	staged_mask = 0;
+	for (id = 0; id < PARAMETERS_COUNT; id++)
+		if (mask & (1u << id) &&
+		    info[id].when == PARAMETER_WHEN_STOPPED &&
+		    !control_robot_stopped())
+			return false;
+	for (id = 0; id < PARAMETERS_COUNT; id++)
+		if (mask & (1u << id) &&
+		    info[id].when == PARAMETER_WHEN_STOPPED)
+			values[id] = staged[id];
+	for (id = 0; id < PARAMETERS_COUNT; id++)
+		if (mask & (1u << id) &&
+		    info[id].when == PARAMETER_WHEN_STOPPED)
+			write((enum parameter_id)id, values[id]);
+	CM_ATOMIC_BLOCK()
+	{
+		for (id = 0; id < PARAMETERS_COUNT; id++) {
+			if (!(mask & (1u << id)) ||
+			    info[id].when != PARAMETER_WHEN_TICK)
+				continue;
+			pending[id] = staged[id];
+			pending_mask |= 1u << id;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Stage and apply the default value of every parameter.
+ *
+ * @return Whether the defaults were applied (the robot must be stopped).
+ */
+bool parameters_restore_defaults(void)
+{
+	uint8_t id;
+
+	if (!control_robot_stopped())
+		return false;
+	for (id = 0; id < PARAMETERS_COUNT; id++)
+		parameters_stage(id, defaults[id]);
+	return parameters_apply();
+}
+
+/**
+ * @brief Store the applied values, to be loaded on the next startup.
+ *
+ * Values applied but still pending for the next SysTick period are
+ * included. Only allowed while the robot is stopped (see `storage_write()`).
+ *
+ * @return Whether the values could be stored.
+ */
+bool parameters_commit(void)
+{
+	float copy[PARAMETERS_COUNT];
+	uint8_t id;
+
+	if (!control_robot_stopped())
+		return false;
+	CM_ATOMIC_BLOCK()
+	{
+		for (id = 0; id < PARAMETERS_COUNT; id++)
+			copy[id] = pending_mask & (1u << id) ? pending[id]
+							     : values[id];
+	}
+	return storage_write(STORAGE_PARAMETERS, copy, sizeof(copy));
+}
+
+/**
+ * @brief Apply the pending `TICK` parameter values.
+ *
+ * To be called at the start of each SysTick period, before the control
+ * loop.
+ */
+void parameters_update(void)
+{
+	uint8_t id;
+
+	if (!pending_mask)
+		return;
+	for (id = 0; id < PARAMETERS_COUNT; id++) {
+		if (!(pending_mask & (1u << id)))
+			continue;
+		values[id] = pending[id];
+		write((enum parameter_id)id, values[id]);
+	}
+	pending_mask = 0;
+}
@@ -0,0 +1,97 @@
+#ifndef __PARAMETERS_H
+#define __PARAMETERS_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <libopencm3/cm3/cortex.h>
+
+#include "collision.h"
+#include "control.h"
+#include "motion.h"
+#include "motor.h"
+#include "odometry.h"
+#include "planner.h"
+#include "storage.h"
+
+/**
+ * Runtime tunable parameters.
+ *
+ * `PARAMETER(NAME, TYPE, MIN, MAX, WHEN)`, one entry per line. The position
+ * in the list is the parameter identifier, used by the serial protocol and
+ * the stored values, so new parameters must only be appended. The host tools
+ * (`scripts/command.py`) parse this list.
+ *
+ * - Type: `INT32` or `FLOAT`. Values are always exchanged as floats, but
+ *   integer parameters only accept whole values.
+ * - Range, inclusive.
+ * - When the value takes effect: `TICK` parameters are applied all at once
+ *   at the start of a SysTick period, before the control loop runs, so they
+ *   can be changed while moving. `STOPPED` parameters are only accepted while
+ *   the robot is not moving, and take effect in the next run.
+ *
+ * The default values are the module defaults, read at startup.
+ *
+ * - Motors power limit, in PWM counts.
+ * - SysTick periods with saturated PWM output that trigger a collision.
+ * - Speed controller gains (see `struct control_gains`).
+ * - Speed run limits (see `struct planner_limits`). The acceleration is the
+ *   average one, in m/s^2: with S-curve ramps the motion peak acceleration is
+ *   raised to match it.
+ * - Whether velocity ramps have an S-curve shape (1) or are trapezoidal (0).
+ * - Action taken when a collision is detected (`enum collision_policy`).
+ */
+#define PARAMETERS(PARAMETER)                                                  \
+	PARAMETER(POWER_LIMIT, INT32, 0, MAX_PWM_PERIOD, TICK)                 \
+	PARAMETER(SATURATION_TICKS, INT32, 1, 1000, TICK)                      \
+	PARAMETER(FEEDFORWARD, FLOAT, 0, 1000, TICK)                           \
+	PARAMETER(LINEAR_KP, FLOAT, 0, 100000, TICK)                           \
+	PARAMETER(LINEAR_KI, FLOAT, 0, 1000000, TICK)                          \
+	PARAMETER(ANGULAR_KP, FLOAT, 0, 100000, TICK)                          \
+	PARAMETER(ANGULAR_KI, FLOAT, 0, 1000000, TICK)                         \
+	PARAMETER(MAX_SPEED, FLOAT, 0.1, 6, STOPPED)                           \
+	PARAMETER(MAX_DIAGONAL_SPEED, FLOAT, 0.1, 6, STOPPED)                  \
+	PARAMETER(ACCELERATION, FLOAT, 0.5, 30, STOPPED)                       \
+	PARAMETER(LATERAL_ACCELERATION, FLOAT, 0.5, 30, STOPPED)               \
+	PARAMETER(S_CURVE, INT32, 0, 1, STOPPED)                               \
+	PARAMETER(COLLISION_POLICY, INT32, 0, 2, TICK)
+
+/** Identifier to get all the parameters at once */
+#define PARAMETERS_ALL 0xFF
+
+#define PARAMETER_ID(name, type, min, max, when) PARAMETER_##name,
+
+enum parameter_id { PARAMETERS(PARAMETER_ID) PARAMETERS_COUNT };
+
+enum parameter_type {
+	PARAMETER_TYPE_INT32,
+	PARAMETER_TYPE_FLOAT,
+};
+
+enum parameter_when {
+	PARAMETER_WHEN_TICK,
+	PARAMETER_WHEN_STOPPED,
+};
+
+/**
+ * Parameter description and values.
+ */
+struct parameter {
+	enum parameter_type type;
+	enum parameter_when when;
+	float min;
+	float max;
+	float value;
+	float default_value;
+};
+
+void parameters_load(void);
+bool parameters_get(uint8_t id, struct parameter *parameter);
+bool parameters_stage(uint8_t id, float value);
+bool parameters_apply(void);
+bool parameters_restore_defaults(void);
+bool parameters_commit(void);
+void parameters_update(void);
+
+#endif /* __PARAMETERS_H */
@@ -0,0 +1,830 @@
+#include "planner.h"
+
+/**
+ * The planner searches over the half cell grid: with coordinates doubled,
+ * cell centers have two odd coordinates, edges (wall positions) have one
+ * and posts have none. Headings are in 45 degree steps, clockwise from
+ * north.
+ *
+ * A search state is a position and heading right after a turn:
+ *
+ * - A cell center, heading orthogonally (after 90, 180 and 45/135 out
+ *   turns).
+ * - An edge, heading orthogonally through it (after search turns).
+ * - An edge, heading diagonally (after 45/135 in and V90 turns).
+ *
+ * Every search edge is a straight followed by a turn. Each kind of state
+ * has its own speed: all turns ending on the same kind of state share the
+ * lowest of their lateral acceleration-limited speeds. The straight cost is
+ * then exact from the speeds at both ends, while the state only needs the
+ * position and heading (16K states for a 32x32 maze). Only walls known to
+ * be open are used.
+ */
+#define HEADINGS_COUNT 8
+#define MAX_STRAIGHT (2 * MAZE_MAX_SIZE)
+#define MAX_WAYPOINTS 8
+#define NIL UINT16_MAX
+#define UNREACHED UINT16_MAX
+
+#define EDGES_COUNT (MAZE_MAX_CELLS * 2)
+#define CENTER_STATES (MAZE_MAX_CELLS * 4)
+#define EDGE_STATES (EDGES_COUNT * 2)
+#define DIAGONAL_STATES (EDGES_COUNT * 4)
+#define STATES_COUNT (CENTER_STATES + EDGE_STATES + DIAGONAL_STATES)
+
+#define SQRT2 1.41421356f
+
+/**
+ * Move sets, each one including the previous one.
+ *
+ * Turns ending on the same kind of state share a speed, so allowing a
+ * tighter turn slows down the others. Each allowed set is searched with its
+ * own speeds, and the fastest run is kept.
+ */
+enum move_set {
+	SET_ORTHOGONAL,
+	SET_DIAGONAL,
+	SET_DIAGONAL_135,
+	SETS_COUNT,
+};
+
+enum speed_class {
+	CLASS_STOP,
+	CLASS_SEARCH,
+	CLASS_ORTHOGONAL,
+	CLASS_DIAGONAL,
+	CLASSES_COUNT,
+};
+
+struct node {
+	int16_t x;
+	int16_t y;
+	uint8_t heading;
+};
+
+/**
+ * Turn geometry, as a right turn heading north (or north-east for turns
+ * starting diagonally) from the origin.
+ *
+ * - Smallest move set including the turn.
+ * - Angle, in 45 degree steps.
+ * - Radius and path length, in cells.
+ * - Half grid points the path goes through, the last one being the end.
+ *   Edges must be open, and none can be a post (which also rejects
+ *   diagonal starts from the wrong kind of edge).
+ */
+struct turn {
+	uint8_t type;
+	uint8_t set;
+	uint8_t angle;
+	bool diagonal_start;
+	bool center_start;
+	uint8_t end_class;
+	float radius;
+	float length;
+	uint8_t count;
+	int8_t waypoints[MAX_WAYPOINTS][2];
+};
+
+static const struct turn turns[] = {
+    {PLANNER_TURN_SEARCH_90, SET_ORTHOGONAL, 2, false, false, CLASS_SEARCH,
+     0.5f, 0.7854f, 2, {{0, 1}, {1, 1}}},
+    {PLANNER_TURN_90, SET_ORTHOGONAL, 2, false, true, CLASS_ORTHOGONAL, 1.f,
+     1.5708f, 4, {{0, 1}, {0, 2}, {1, 2}, {2, 2}}},
+    {PLANNER_TURN_180, SET_ORTHOGONAL, 4, false, true, CLASS_ORTHOGONAL, 1.f,
+     3.1416f, 8,
+     {{0, 1}, {0, 2}, {1, 2}, {2, 2}, {3, 2}, {4, 2}, {4, 1}, {4, 0}}},
+    {PLANNER_TURN_45_IN, SET_DIAGONAL, 1, false, true, CLASS_DIAGONAL,
+     1.2071f, 1.1552f, 3, {{0, 1}, {0, 2}, {1, 2}}},
+    {PLANNER_TURN_135_IN, SET_DIAGONAL_135, 3, false, true, CLASS_DIAGONAL,
+     0.5858f, 1.4661f, 5, {{0, 1}, {0, 2}, {1, 2}, {2, 2}, {2, 1}}},
+    {PLANNER_TURN_V90, SET_DIAGONAL, 2, true, false, CLASS_DIAGONAL, 0.7071f,
+     1.1107f, 2, {{1, 0}, {2, 0}}},
+    {PLANNER_TURN_45_OUT, SET_DIAGONAL, 1, true, false, CLASS_ORTHOGONAL,
+     1.2071f, 1.1552f, 3, {{0, 1}, {1, 1}, {2, 1}}},
+    {PLANNER_TURN_135_OUT, SET_DIAGONAL_135, 3, true, false, CLASS_ORTHOGONAL,
+     0.5858f, 1.4661f, 5, {{0, 1}, {1, 1}, {2, 1}, {2, 0}, {2, -1}}},
+};
+
+#define TURNS_COUNT (sizeof(turns) / sizeof(turns[0]))
+
+static const int8_t delta_x[HEADINGS_COUNT] = {0, 1, 1, 1, 0, -1, -1, -1};
+static const int8_t delta_y[HEADINGS_COUNT] = {1, 1, 0, -1, -1, -1, 0, 1};
+
+static const struct node start = {1, 1, 0};
+
+static struct planner_limits limits = {
+    .max_speed = 1.5f,
+    .max_diagonal_speed = 1.f,
+    .acceleration = 3.f,
+    .lateral_acceleration = 5.f,
+    .diagonals = true,
+};
+
+/**
+ * Costs, in `PLANNER_TIME_UNIT_US` units, computed for the current limits,
+ * move set and cell size: straights (orthogonal or diagonal) between speed
+ * classes for each length, and turns.
+ */
+static uint8_t move_set;
+static float cell_size;
+static float speeds[CLASSES_COUNT];
+static uint16_t straight_costs[2][CLASSES_COUNT][CLASSES_COUNT]
+			      [MAX_STRAIGHT + 1];
+static uint16_t turn_costs[TURNS_COUNT];
+
+/**
+ * Search buffers: distances (run times) and a bucket queue, where each
+ * bucket is a linked list of the states with a run time equal modulo
+ * `PLANNER_BUCKETS`.
+ */
+static CCM uint16_t times[STATES_COUNT];
+static uint16_t next[STATES_COUNT];
+static uint16_t buckets[PLANNER_BUCKETS];
+static uint16_t queued;
+
+static uint16_t best_time;
+static uint16_t best_state;
+static uint8_t best_length;
+
+static struct planner_stats stats;
+
+void planner_set_limits(const struct planner_limits *new_limits)
+{
+	limits = *new_limits;
+}
+
+void planner_get_limits(struct planner_limits *copy)
+{
+	*copy = limits;
+}
+
+static bool allowed(const struct turn *turn)
+{
+	return turn->set <= move_set;
+}
+
+/**
+ * @brief Time to travel a straight between two speeds, in seconds.
+ *
+ * The speed profile is trapezoidal (or triangular), with the same
+ * acceleration and deceleration.
+ *
+ * @return The time, or a negative value if the end speed can not be
+ * reached.
+ */
+static float straight_time(float distance, float start_speed, float end_speed,
+			   float max_speed)
+{
+	float acceleration = limits.acceleration;
+	float change = end_speed * end_speed - start_speed * start_speed;
+	float peak;
+
+	if (fabsf(change) > 2 * acceleration * distance + 1e-6f)
+		return -1.f;
+	if (distance <= 0.f)
+		return 0.f;
+	peak = sqrtf(acceleration * distance +
+		     (start_speed * start_speed + end_speed * end_speed) / 2);
+	if (peak > max_speed)
+		peak = max_speed;
+	return (2 * peak - start_speed - end_speed) / acceleration +
+	       (distance - (2 * peak * peak - start_speed * start_speed -
+			    end_speed * end_speed) /
+			       (2 * acceleration)) /
+		   peak;
+}
+
+static uint16_t time_units(float time)
+{
+	float units = time * (MICROSECONDS_PER_SECOND / PLANNER_TIME_UNIT_US);
+
+	if (units >= UNREACHED)
+		return UNREACHED;
+	return (uint16_t)(units + 0.5f);
+}
+
+/**
+ * @brief Compute the straight costs between two speed classes.
+ *
+ * Diagonal straights only go from a diagonal state to a turn out of the
+ * diagonal, and orthogonal straights never start diagonally.
+ *
+ * @return Whether any feasible straight, followed by any turn, fits in the
+ * bucket queue.
+ */
+static bool prepare_straights(uint8_t diagonal, uint8_t from, uint8_t to,
+			      uint16_t longest_turn)
+{
+	uint16_t *costs = straight_costs[diagonal][from][to];
+	float max_speed = diagonal ? limits.max_diagonal_speed
+				   : limits.max_speed;
+	float distance;
+	float time;
+	uint8_t length;
+
+	memset(costs, 0xff, sizeof(straight_costs[0][0][0]));
+	if (diagonal ? from != CLASS_DIAGONAL || to == CLASS_STOP ||
+			   to == CLASS_SEARCH
+		     : from == CLASS_DIAGONAL)
+		return true;
+	for (length = 0; length <= 2 * maze_size(); length++) {
+		distance = length * cell_size / 2;
+		if (diagonal)
+			distance *= SQRT2;
+		time = straight_time(distance, speeds[from], speeds[to],
+				     max_speed);
+		if (time < 0.f) {
+			costs[length] = UNREACHED;
+			continue;
+		}
+		costs[length] = time_units(time);
+		if (costs[length] + longest_turn >= PLANNER_BUCKETS)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Compute the costs for the current limits, move set and maze size.
+ *
+ * @return Whether every move fits in the bucket queue.
+ */
+static bool prepare(void)
+{
+	float max_speed = limits.max_speed;
+	float speed;
+	uint16_t longest_turn = 0;
+	uint8_t diagonal;
+	uint8_t from;
+	uint8_t to;
+	uint8_t i;
+
+	cell_size = maze_size() > MAZE_CLASSIC_SIZE ? PLANNER_HALF_CELL_SIZE
+						    : PLANNER_CLASSIC_CELL_SIZE;
+	if (move_set != SET_ORTHOGONAL &&
+	    limits.max_diagonal_speed < max_speed)
+		max_speed = limits.max_diagonal_speed;
+	speeds[CLASS_STOP] = 0.f;
+	for (i = CLASS_SEARCH; i < CLASSES_COUNT; i++)
+		speeds[i] = max_speed;
+	for (i = 0; i < TURNS_COUNT; i++) {
+		if (!allowed(&turns[i]))
+			continue;
+		speed = sqrtf(limits.lateral_acceleration * turns[i].radius *
+			      cell_size);
+		if (speed < speeds[turns[i].end_class])
+			speeds[turns[i].end_class] = speed;
+	}
+	for (i = 0; i < TURNS_COUNT; i++) {
+		turn_costs[i] = time_units(turns[i].length * cell_size /
+					   speeds[turns[i].end_class]);
+		if (!turn_costs[i])
+			turn_costs[i] = 1;
+		if (turn_costs[i] > longest_turn)
+			longest_turn = turn_costs[i];
+	}
+
+	for (diagonal = 0; diagonal < 2; diagonal++)
+		for (from = 0; from < CLASSES_COUNT; from++)
+			for (to = 0; to < CLASSES_COUNT; to++)
+				if (!prepare_straights(diagonal, from, to,
+						       longest_turn))
+					return false;
+	return true;
+}
+
+static bool is_center(int16_t x, int16_t y)
+{
+	return (x & 1) && (y & 1);
+}
+
+/**
+ * @brief Return whether a half grid point can be driven through.
+ *
+ * Cell centers can, posts can not, and edges only if known to be open.
+ */
+static bool passable(int16_t x, int16_t y)
+{
+	int16_t limit = 2 * maze_size();
+
+	if (x < 0 || y < 0 || x > limit || y > limit)
+		return false;
+	if (is_center(x, y))
+		return true;
+	if (x & 1)
+		return y > 0 && y < limit &&
+		       maze_get_wall((uint8_t)(x >> 1), (uint8_t)((y >> 1) - 1),
+				     MAZE_NORTH) == MAZE_WALL_OPEN;
+	if (y & 1)
+		return x > 0 && x < limit &&
+		       maze_get_wall((uint8_t)((x >> 1) - 1), (uint8_t)(y >> 1),
+				     MAZE_EAST) == MAZE_WALL_OPEN;
+	return false;
+}
+
+/**
+ * @brief Return the state index of a node, or `NIL` if it is not a state.
+ *
+ * Edges are indexed as the south (horizontal) or west (vertical) edge of a
+ * cell.
+ */
+static uint16_t state_index(const struct node *node)
+{
+	uint16_t edge;
+
+	if (!passable(node->x, node->y))
+		return NIL;
+	if (is_center(node->x, node->y)) {
+		if (node->heading & 1)
+			return NIL;
+		return (uint16_t)(((node->y >> 1) * MAZE_MAX_SIZE +
+				   (node->x >> 1)) *
+				      4 +
+				  node->heading / 2);
+	}
+	edge = (uint16_t)(((node->y >> 1) * MAZE_MAX_SIZE + (node->x >> 1)) *
+				  2 +
+			  !(node->x & 1));
+	if (node->heading & 1)
+		return (uint16_t)(CENTER_STATES + EDGE_STATES + edge * 4 +
+				  node->heading / 2);
+	if ((node->x & 1) != !(node->heading & 2))
+		return NIL;
+	return (uint16_t)(CENTER_STATES + edge * 2 + (node->heading >= 4));
+}
+
+static void state_node(uint16_t state, struct node *node)
+{
+	uint16_t cell;
+	uint16_t edge;
+
+	if (state < CENTER_STATES) {
+		cell = state / 4;
+		node->x = (int16_t)(2 * (cell % MAZE_MAX_SIZE) + 1);
+		node->y = (int16_t)(2 * (cell / MAZE_MAX_SIZE) + 1);
+		node->heading = (uint8_t)(state % 4 * 2);
+		return;
+	}
+	if (state < CENTER_STATES + EDGE_STATES) {
+		edge = (state - CENTER_STATES) / 2;
+		node->heading = (uint8_t)(edge % 2 ? 2 : 0);
+		if ((state - CENTER_STATES) % 2)
+			node->heading += 4;
+	} else {
+		edge = (state - CENTER_STATES - EDGE_STATES) / 4;
+		node->heading = (uint8_t)(
+		    (state - CENTER_STATES - EDGE_STATES) % 4 * 2 + 1);
+	}
+	cell = edge / 2;
+	node->x = (int16_t)(2 * (cell % MAZE_MAX_SIZE) + !(edge % 2));
+	node->y = (int16_t)(2 * (cell / MAZE_MAX_SIZE) + edge % 2);
+}
+
+static uint8_t node_class(const struct node *node)
+{
+	if (node->heading & 1)
+		return CLASS_DIAGONAL;
+	if (is_center(node->x, node->y))
+		return CLASS_ORTHOGONAL;
+	return CLASS_SEARCH;
+}
+
+/**
+ * @brief Transform a turn point to the start heading and side.
+ *
+ * Left turns are mirrored about the start heading, and then the point is
+ * rotated clockwise in 90 degree steps.
+ */
+static void transform(const struct turn *turn, uint8_t heading, bool left,
+		      const int8_t point[2], int16_t *x, int16_t *y)
+{
+	int16_t rotated;
+	uint8_t quarters;
+
+	*x = point[0];
+	*y = point[1];
+	if (left) {
+		if (turn->diagonal_start) {
+			rotated = *x;
+			*x = *y;
+			*y = rotated;
+		} else {
+			*x = (int16_t)-*x;
+		}
+	}
+	for (quarters = heading / 2; quarters; quarters--) {
+		rotated = *x;
+		*x = *y;
+		*y = (int16_t)-rotated;
+	}
+}
+
+/**
+ * @brief Check a turn from a node, returning where it ends.
+ */
+static bool try_turn(const struct node *from, const struct turn *turn,
+		     bool left, struct node *end)
+{
+	int16_t x = 0;
+	int16_t y = 0;
+	uint8_t i;
+
+	if (turn->diagonal_start != (from->heading & 1))
+		return false;
+	if (!turn->diagonal_start &&
+	    turn->center_start != is_center(from->x, from->y))
+		return false;
+	for (i = 0; i < turn->count; i++) {
+		transform(turn, from->heading, left, turn->waypoints[i], &x,
+			  &y);
+		if (!passable(from->x + x, from->y + y))
+			return false;
+	}
+	end->x = (int16_t)(from->x + x);
+	end->y = (int16_t)(from->y + y);
+	end->heading = (uint8_t)((from->heading +
+				  (left ? HEADINGS_COUNT - turn->angle
+					: turn->angle)) %
+				 HEADINGS_COUNT);
+	return true;
+}
+
+static void bucket_insert(uint16_t state)
+{
+	uint16_t *bucket = &buckets[times[state] % PLANNER_BUCKETS];
+
+	next[state] = *bucket;
+	*bucket = state;
+	queued++;
+}
+
+static void bucket_remove(uint16_t state)
+{
+	uint16_t *link = &buckets[times[state] % PLANNER_BUCKETS];
+
+	while (*link != state)
+		link = &next[*link];
+	*link = next[state];
+	queued--;
+}
+
+static void relax(const struct node *node, uint32_t time)
+{
+	uint16_t state = state_index(node);
+
+	if (state == NIL || time >= times[state])
+		return;
+	if (times[state] != UNREACHED)
+		bucket_remove(state);
+	times[state] = (uint16_t)time;
+	bucket_insert(state);
+	stats.relaxed++;
+}
+
+/**
+ * @brief Relax the moves from a state: straights of any length, each
+ * followed by a turn, or by the final stop on a goal cell.
+ *
+ * @param[in] state State index, or `NIL` for the start.
+ */
+static void expand(uint16_t state, const struct node *node, uint8_t class,
+		   uint32_t time)
+{
+	const uint16_t *costs;
+	const struct turn *turn;
+	struct node position = *node;
+	struct node end;
+	bool diagonal = node->heading & 1;
+	uint8_t length;
+	uint8_t side;
+	uint8_t i;
+
+	stats.expanded++;
+	for (length = 0; length <= MAX_STRAIGHT; length++) {
+		if (length) {
+			position.x += delta_x[node->heading];
+			position.y += delta_y[node->heading];
+			if (!passable(position.x, position.y))
+				break;
+		}
+		for (i = 0; i < TURNS_COUNT; i++) {
+			turn = &turns[i];
+			if (!allowed(turn))
+				continue;
+			costs =
+			    straight_costs[diagonal][class][turn->end_class];
+			if (costs[length] == UNREACHED)
+				continue;
+			for (side = 0; side < 2; side++)
+				if (try_turn(&position, turn, side, &end))
+					relax(&end, time + costs[length] +
+							turn_costs[i]);
+		}
+		if (diagonal || !is_center(position.x, position.y) ||
+		    !maze_is_goal((uint8_t)(position.x >> 1),
+				  (uint8_t)(position.y >> 1)))
+			continue;
+		costs = straight_costs[0][class][CLASS_STOP];
+		if (costs[length] != UNREACHED &&
+		    time + costs[length] < best_time) {
+			best_time = (uint16_t)(time + costs[length]);
+			best_state = state;
+			best_length = length;
+		}
+	}
+}
+
+/**
+ * @brief Find the move that reached a state with its search time.
+ *
+ * Each turn ending at the state is walked backwards, and then the straight
+ * before it, until a state (or the start) with a matching time is found.
+ *
+ * @param[in,out] state State, replaced by the previous one (`NIL` for the
+ * start).
+ *
+ * @return Whether the move was found.
+ */
+static bool previous(uint16_t *state, struct planner_move *turn_move,
+		     uint8_t *straight)
+{
+	const struct turn *turn;
+	struct node node;
+	struct node from;
+	struct node end;
+	struct node position;
+	uint16_t candidate;
+	uint32_t cost;
+	uint8_t length;
+	uint8_t side;
+	uint8_t i;
+	int16_t x;
+	int16_t y;
+
+	state_node(*state, &node);
+	for (i = 0; i < TURNS_COUNT; i++) {
+		turn = &turns[i];
+		if (turn->end_class != node_class(&node) ||
+		    !allowed(turn))
+			continue;
+		for (side = 0; side < 2; side++) {
+			from.heading =
+			    (uint8_t)((node.heading +
+				       (side ? turn->angle
+					     : HEADINGS_COUNT - turn->angle)) %
+				      HEADINGS_COUNT);
+			transform(turn, from.heading, side,
+				  turn->waypoints[turn->count - 1], &x, &y);
+			from.x = (int16_t)(node.x - x);
+			from.y = (int16_t)(node.y - y);
+			if (!try_turn(&from, turn, side, &end) ||
+			    end.x != node.x || end.y != node.y ||
+			    end.heading != node.heading)
+				continue;
+			position = from;
+			for (length = 0; length <= MAX_STRAIGHT; length++) {
+				if (length) {
+					if (!passable(position.x, position.y))
+						break;
+					position.x -= delta_x[from.heading];
+					position.y -= delta_y[from.heading];
+				}
+				cost = turn_costs[i];
+				if (position.x == start.x &&
+				    position.y == start.y &&
+				    position.heading == start.heading &&
+				    straight_costs[0][CLASS_STOP]
+						  [turn->end_class][length] +
+					    cost ==
+					times[*state]) {
+					candidate = NIL;
+				} else {
+					candidate = state_index(&position);
+					if (candidate == NIL ||
+					    times[candidate] == UNREACHED)
+						continue;
+					cost += straight_costs
+					    [from.heading & 1]
+					    [node_class(&position)]
+					    [turn->end_class][length];
+					if (times[candidate] + cost !=
+					    times[*state])
+						continue;
+				}
+				turn_move->type = turn->type;
+				turn_move->value = side ? 1 : -1;
+				*straight = length;
+				*state = candidate;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static bool push_move(struct planner_move *moves, uint16_t max_moves,
+		      uint8_t type, int8_t value)
+{
+	if (stats.moves >= max_moves)
+		return false;
+	moves[stats.moves].type = type;
+	moves[stats.moves].value = value;
+	stats.moves++;
+	return true;
+}
+
+/**
+ * @brief Build the move sequence from the search times, backwards from the
+ * final stop.
+ */
+static uint16_t reconstruct(struct planner_move *moves, uint16_t max_moves)
+{
+	struct planner_move turn;
+	struct planner_move swap;
+	uint16_t state = best_state;
+	uint8_t straight = best_length;
+	uint8_t type = PLANNER_STRAIGHT;
+	uint16_t i;
+
+	if (!push_move(moves, max_moves, PLANNER_STOP, 0))
+		return 0;
+	while (true) {
+		if (straight &&
+		    !push_move(moves, max_moves, type, (int8_t)straight))
+			return 0;
+		if (state == NIL)
+			break;
+		if (!previous(&state, &turn, &straight) ||
+		    !push_move(moves, max_moves, turn.type, turn.value))
+			return 0;
+		if (turn.type == PLANNER_TURN_V90 ||
+		    turn.type == PLANNER_TURN_45_OUT ||
+		    turn.type == PLANNER_TURN_135_OUT)
+			type = PLANNER_DIAGONAL;
+		else
+			type = PLANNER_STRAIGHT;
+	}
+	for (i = 0; i < stats.moves / 2; i++) {
+		swap = moves[i];
+		moves[i] = moves[stats.moves - 1 - i];
+		moves[stats.moves - 1 - i] = swap;
+	}
+	return stats.moves;
+}
+
+/**
+ * @brief Search the fastest run with the current move set.
+ *
+ * A Dijkstra search over the known maze, with a bucket queue (as costs are
+ * bounded integers). The search stops as soon as no queued state can lead
+ * to a faster run than the best one found.
+ *
+ * @return The run time, or `UNREACHED` if there is no known path to the
+ * goal.
+ */
+static uint16_t search(void)
+{
+	struct node node;
+	uint32_t time;
+	uint16_t *bucket;
+	uint16_t state;
+
+	if (!prepare())
+		return UNREACHED;
+	memset(times, 0xff, sizeof(times));
+	memset(buckets, 0xff, sizeof(buckets));
+	queued = 0;
+	best_time = UNREACHED;
+	best_state = NIL;
+
+	expand(NIL, &start, CLASS_STOP, 0);
+	for (time = 0; queued && time < best_time; time++) {
+		bucket = &buckets[time % PLANNER_BUCKETS];
+		while (*bucket != NIL) {
+			state = *bucket;
+			*bucket = next[state];
+			queued--;
+			state_node(state, &node);
+			expand(state, &node, node_class(&node), time);
+		}
+	}
+	return best_time;
+}
+
+/**
+ * @brief Plan the fastest run from the start cell to the goal.
+ *
+ * Every move set allowed by the limits is searched, from the richest one.
+ * If the fastest run was not found by the last search, its set is searched
+ * again before building the moves.
+ *
+ * @param[out] moves Planned moves, ending with `PLANNER_STOP`.
+ * @param[in] max_moves Size of the moves buffer.
+ *
+ * @return Number of moves, or 0 if there is no known path to the goal (or
+ * the moves do not fit).
+ */
+uint16_t planner_plan(struct planner_move *moves, uint16_t max_moves)
+{
+	uint16_t fastest = UNREACHED;
+	uint16_t time;
+	uint8_t fastest_set = SET_ORTHOGONAL;
+	int8_t set;
+
+	memset(&stats, 0, sizeof(stats));
+	for (set = limits.diagonals ? SETS_COUNT - 1 : SET_ORTHOGONAL; set >= 0;
+	     set--) {
+		move_set = (uint8_t)set;
+		time = search();
+		if (time < fastest) {
+			fastest = time;
+			fastest_set = move_set;
+		}
+	}
+	if (fastest == UNREACHED)
+		return 0;
+	if (move_set != fastest_set) {
+		move_set = fastest_set;
+		search();
+	}
+	stats.time = (float)fastest * PLANNER_TIME_UNIT_US /
+		     MICROSECONDS_PER_SECOND;
+	return reconstruct(moves, max_moves);
+}
+
+static const struct turn *find_turn(uint8_t type)
+{
+	uint8_t i;
+
+	for (i = 0; i < TURNS_COUNT; i++)
+		if (turns[i].type == type)
+			return &turns[i];
+	return NULL;
+}
+
+/**
+ * @brief Return the path length of a planned move, in meters.
+ */
+float planner_move_length(const struct planner_move *move)
+{
+	const struct turn *turn;
+
+	switch (move->type) {
+	case PLANNER_STRAIGHT:
+		return move->value * cell_size / 2;
+	case PLANNER_DIAGONAL:
+		return move->value * cell_size * SQRT2 / 2;
+	case PLANNER_STOP:
+		return 0.f;
+	default:
+		turn = find_turn(move->type);
+		return turn ? turn->length * cell_size : 0.f;
+	}
+}
+
+/**
+ * @brief Return the speed limit of a planned move, in m/s.
+ *
+ * Straights may reach the maximum (orthogonal or diagonal) speed, while
+ * turns are run at the constant speed of the state they end on, as in the
+ * last plan. The stop speed is zero.
+ */
+float planner_move_speed(const struct planner_move *move)
+{
+	const struct turn *turn;
+
+	switch (move->type) {
+	case PLANNER_STRAIGHT:
+		return limits.max_speed;
+	case PLANNER_DIAGONAL:
+		return limits.max_diagonal_speed;
+	case PLANNER_STOP:
+		return 0.f;
+	default:
+		turn = find_turn(move->type);
+		return turn ? speeds[turn->end_class] : 0.f;
+	}
+}
+
+/**
+ * @brief Return the heading change of a planned move.
+ *
+ * @return The angle in 45 degree steps, counter-clockwise positive (zero
+ * for straights and the stop).
+ */
+int8_t planner_move_angle(const struct planner_move *move)
+{
+	const struct turn *turn;
+
+	if (move->type == PLANNER_STRAIGHT || move->type == PLANNER_DIAGONAL ||
+	    move->type == PLANNER_STOP)
+		return 0;
+	turn = find_turn(move->type);
+	return turn ? (int8_t)(turn->angle * move->value) : 0;
+}
+
+void planner_get_stats(struct planner_stats *copy)
+{
+	*copy = stats;
+}
@@ -0,0 +1,98 @@
+#ifndef __PLANNER_H
+#define __PLANNER_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "maze.h"
+#include "setup.h"
+
+/** Cell size of the classic and half-size mazes, in meters */
+#define PLANNER_CLASSIC_CELL_SIZE 0.18
+#define PLANNER_HALF_CELL_SIZE 0.09
+
+/**
+ * Search cost units and bucket queue size.
+ *
+ * Costs are run times in `PLANNER_TIME_UNIT_US` units, so a single move
+ * (straight plus turn) must take less than `PLANNER_BUCKETS` units.
+ */
+#define PLANNER_TIME_UNIT_US 2000
+#define PLANNER_BUCKETS 4096
+
+/** Planned moves, including the final stop */
+#define PLANNER_MAX_MOVES 256
+
+/**
+ * Move types.
+ *
+ * - Straights, with the length in half cells (orthogonal) or in half cell
+ *   diagonals (diagonal).
+ * - Turns, with the direction (1 for left, -1 for right). Search turns go
+ *   from an edge to the next edge of the same cell; 90 and 180 degree turns
+ *   go from a cell center to a cell center; 45 and 135 degree turns go from
+ *   a cell center to an edge (in) or from an edge to a cell center (out);
+ *   V90 turns go from an edge to an edge, while moving diagonally.
+ * - The final stop, at the center of a goal cell.
+ */
+enum planner_move_type {
+	PLANNER_STRAIGHT,
+	PLANNER_DIAGONAL,
+	PLANNER_TURN_SEARCH_90,
+	PLANNER_TURN_90,
+	PLANNER_TURN_180,
+	PLANNER_TURN_45_IN,
+	PLANNER_TURN_135_IN,
+	PLANNER_TURN_V90,
+	PLANNER_TURN_45_OUT,
+	PLANNER_TURN_135_OUT,
+	PLANNER_STOP,
+};
+
+struct planner_move {
+	uint8_t type;
+	int8_t value;
+};
+
+/**
+ * Motion limits the costs are computed from.
+ *
+ * - Maximum linear speed in orthogonal and diagonal straights, in m/s.
+ * - Linear acceleration (and deceleration), in m/s^2.
+ * - Lateral acceleration in turns, in m/s^2, which sets each turn speed
+ *   from its radius.
+ * - Whether diagonal moves are allowed.
+ */
+struct planner_limits {
+	float max_speed;
+	float max_diagonal_speed;
+	float acceleration;
+	float lateral_acceleration;
+	bool diagonals;
+};
+
+/**
+ * Statistics of the last plan.
+ *
+ * - States expanded and relaxations that improved a state.
+ * - Predicted run time, in seconds.
+ * - Moves, including the final stop.
+ */
+struct planner_stats {
+	uint32_t expanded;
+	uint32_t relaxed;
+	float time;
+	uint16_t moves;
+};
+
+void planner_set_limits(const struct planner_limits *limits);
+void planner_get_limits(struct planner_limits *limits);
+uint16_t planner_plan(struct planner_move *moves, uint16_t max_moves);
+float planner_move_length(const struct planner_move *move);
+float planner_move_speed(const struct planner_move *move);
+int8_t planner_move_angle(const struct planner_move *move);
+void planner_get_stats(struct planner_stats *stats);
+
+#endif /* __PLANNER_H */
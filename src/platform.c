@@ -1,7 +1,31 @@
 #include "platform.h"
+#include "calibration.h"
+#include "trace.h"
 
 #define MPU_READ 0x80
 
+/**
+ * Battery monitor: DMA buffer length and low-pass filter.
+ *
+ * The filter is an exponential moving average of the ADC counts in Q24.8,
+ * with a smoothing factor of `1 / 2^BATTERY_FILTER_SHIFT`.
+ */
+#define BATTERY_SAMPLES 128
+#define BATTERY_FILTER_SHIFT 3
+#define BATTERY_COUNTS_FRACTION_BITS 8
+
+static volatile uint16_t battery_samples[BATTERY_SAMPLES];
+static volatile int32_t battery_counts;
+static volatile uint16_t battery_millivolts;
+static volatile uint16_t low_battery_threshold;
+static void (*volatile low_battery_callback)(float voltage);
+
+static uint8_t mpu_dma_tx[1 + MPU_BURST_MAX_SIZE];
+static uint8_t mpu_dma_rx[1 + MPU_BURST_MAX_SIZE];
+static volatile uint8_t mpu_dma_size;
+static volatile bool mpu_dma_busy;
+static void (*volatile mpu_dma_callback)(const uint8_t *data, uint8_t size);
+
 /**
  * @brief Read the microcontroller clock cycle counter.
  *
@@ -28,23 +52,114 @@ uint16_t read_encoder_right(void)
 	return (uint16_t)timer_get_counter(TIM4);
 }
 
+/**
+ * @brief Start the background battery monitor.
+ *
+ * ADC2 converts the battery voltage continuously (see `setup_adc2()`). DMA 2
+ * stream 3 (channel 1) stores the conversions in a circular buffer and an
+ * interruption is generated each time the buffer is filled, where the
+ * filtered battery voltage is updated.
+ *
+ * With 480 cycles of sample time, the buffer is filled about every 1.5 ms.
+ */
+void start_battery_monitor(void)
+{
+	dma_stream_reset(DMA2, DMA_STREAM3);
+
+	dma_enable_memory_increment_mode(DMA2, DMA_STREAM3);
+	dma_enable_circular_mode(DMA2, DMA_STREAM3);
+	dma_set_peripheral_size(DMA2, DMA_STREAM3, DMA_SxCR_PSIZE_16BIT);
+	dma_set_memory_size(DMA2, DMA_STREAM3, DMA_SxCR_MSIZE_16BIT);
+	dma_set_priority(DMA2, DMA_STREAM3, DMA_SxCR_PL_LOW);
+	dma_set_transfer_mode(DMA2, DMA_STREAM3,
+			      DMA_SxCR_DIR_PERIPHERAL_TO_MEM);
+
+	dma_set_peripheral_address(DMA2, DMA_STREAM3, (uint32_t)&ADC_DR(ADC2));
+	dma_set_memory_address(DMA2, DMA_STREAM3, (uint32_t)battery_samples);
+	dma_set_number_of_data(DMA2, DMA_STREAM3, BATTERY_SAMPLES);
+
+	dma_enable_transfer_complete_interrupt(DMA2, DMA_STREAM3);
+	dma_channel_select(DMA2, DMA_STREAM3, DMA_SxCR_CHSEL_1);
+	dma_enable_stream(DMA2, DMA_STREAM3);
+
+	adc_start_conversion_regular(ADC2);
+}
+
+/**
+ * @brief Set a function to be called when the battery voltage is low.
+ *
+ * The callback is executed once, from the DMA interruption, the first time
+ * the filtered battery voltage drops below the threshold. Setting a new
+ * callback re-arms the check.
+ *
+ * @param[in] threshold Battery voltage threshold, in volts.
+ * @param[in] callback Function to call, which receives the battery voltage.
+ */
+void set_low_battery_callback(float threshold, void (*callback)(float))
+{
+	low_battery_callback = NULL;
+	low_battery_threshold = (uint16_t)(threshold * 1000);
+	low_battery_callback = callback;
+}
+
+/**
+ * @brief DMA 2 stream 3 interruption routine.
+ *
+ * Executed each time the battery samples buffer is filled. The samples are
+ * averaged and low-pass filtered in fixed point, then converted to
+ * millivolts with the battery calibration (which accounts for the voltage
+ * divider) and compared with the low battery threshold.
+ */
+RAMFUNC void dma2_stream3_isr(void)
+{
+	uint32_t sum = 0;
+	int32_t average;
+	int i;
+
+	TRACE_ISR_BEGIN(TRACE_ISR_BATTERY_DMA);
+	if (dma_get_interrupt_flag(DMA2, DMA_STREAM3, DMA_TCIF))
+		dma_clear_interrupt_flags(DMA2, DMA_STREAM3, DMA_TCIF);
+
+	for (i = 0; i < BATTERY_SAMPLES; i++)
+		sum += battery_samples[i];
+	average = (int32_t)((sum << BATTERY_COUNTS_FRACTION_BITS) /
+			    BATTERY_SAMPLES);
+	if (battery_counts)
+		average = battery_counts +
+			  ((average - battery_counts) >> BATTERY_FILTER_SHIFT);
+	battery_counts = average;
+	battery_millivolts = battery_counts_to_millivolts(
+	    (uint16_t)(average >> BATTERY_COUNTS_FRACTION_BITS));
+
+	if (low_battery_callback &&
+	    battery_millivolts < low_battery_threshold) {
+		low_battery_callback(battery_millivolts / 1000.f);
+		low_battery_callback = NULL;
+	}
+	TRACE_ISR_END(TRACE_ISR_BATTERY_DMA);
+}
+
 /**
  * @brief Function to get battery voltage.
  *
- * The value is converted from bits to voltage taking into account that the
- * battery voltage is read through a voltage divider.
+ * The value is updated in the background by the battery monitor (see
+ * `start_battery_monitor()`), so reading it never waits for a conversion.
  *
- *@return The battery voltage in volts.
+ *@return The low-pass filtered battery voltage in volts.
  */
 float get_battery_voltage(void)
 {
-	uint16_t battery_bits;
+	return battery_millivolts / 1000.f;
+}
 
-	adc_start_conversion_regular(ADC2);
-	while (!adc_eoc(ADC2))
-		;
-	battery_bits = adc_read_regular(ADC2);
-	return battery_bits * ADC_LSB * VOLT_DIV_FACTOR;
+/**
+ * @brief Function to get battery voltage in millivolts (fixed point).
+ *
+ * @see `get_battery_voltage()`.
+ */
+uint16_t get_battery_millivolts(void)
+{
+	return battery_millivolts;
 }
 
 /**
@@ -78,6 +193,123 @@ uint8_t mpu_read_register(uint8_t address)
 	return reading;
 }
 
+/**
+ * @brief Read consecutive MPU registers in a single transaction.
+ *
+ * Chip select is asserted once and the MPU auto-increments the register
+ * address after each byte (except for FIFO_R_W, which is read repeatedly).
+ *
+ * @param[in] address First register address.
+ * @param[out] data Buffer to store the register values.
+ * @param[in] size Number of registers to read.
+ *
+ * @note Must not be called while a DMA burst read is in progress.
+ */
+void mpu_read_registers(uint8_t address, uint8_t *data, uint8_t size)
+{
+	gpio_clear(GPIOA, GPIO15);
+	spi_send(SPI3, (MPU_READ | address));
+	spi_read(SPI3);
+	while (size--) {
+		spi_send(SPI3, 0x00);
+		*data++ = spi_read(SPI3);
+	}
+	gpio_set(GPIOA, GPIO15);
+}
+
+/**
+ * @brief Configure a DMA 1 stream for a SPI3 transfer (channel 0).
+ */
+static void mpu_configure_dma_stream(uint8_t stream, uint32_t direction,
+				     uint8_t *buffer, uint8_t size)
+{
+	dma_stream_reset(DMA1, stream);
+
+	dma_enable_memory_increment_mode(DMA1, stream);
+	dma_set_peripheral_size(DMA1, stream, DMA_SxCR_PSIZE_8BIT);
+	dma_set_memory_size(DMA1, stream, DMA_SxCR_MSIZE_8BIT);
+	dma_set_priority(DMA1, stream, DMA_SxCR_PL_HIGH);
+	dma_set_transfer_mode(DMA1, stream, direction);
+
+	dma_set_peripheral_address(DMA1, stream, (uint32_t)&SPI_DR(SPI3));
+	dma_set_memory_address(DMA1, stream, (uint32_t)buffer);
+	dma_set_number_of_data(DMA1, stream, size);
+
+	dma_channel_select(DMA1, stream, DMA_SxCR_CHSEL_0);
+}
+
+/**
+ * @brief Read consecutive MPU registers in the background using DMA.
+ *
+ * DMA 1 stream 5 feeds SPI3 with the read command and dummy bytes while
+ * DMA 1 stream 0 stores the received bytes. The CPU is not involved until
+ * the reception is complete, when the callback is executed from the DMA
+ * interruption with the register values.
+ *
+ * @param[in] address First register address.
+ * @param[in] size Number of registers to read (up to MPU_BURST_MAX_SIZE).
+ * @param[in] callback Function to call with the register values.
+ *
+ * @return Whether the read was started (fails if another one is in progress).
+ */
+bool mpu_read_registers_dma(uint8_t address, uint8_t size,
+			    void (*callback)(const uint8_t *data, uint8_t size))
+{
+	if (mpu_dma_busy || size > MPU_BURST_MAX_SIZE)
+		return false;
+	mpu_dma_busy = true;
+	mpu_dma_size = size;
+	mpu_dma_callback = callback;
+
+	memset(mpu_dma_tx, 0, size + 1);
+	mpu_dma_tx[0] = MPU_READ | address;
+	mpu_configure_dma_stream(DMA_STREAM0, DMA_SxCR_DIR_PERIPHERAL_TO_MEM,
+				 mpu_dma_rx, size + 1);
+	mpu_configure_dma_stream(DMA_STREAM5, DMA_SxCR_DIR_MEM_TO_PERIPHERAL,
+				 mpu_dma_tx, size + 1);
+	dma_enable_transfer_complete_interrupt(DMA1, DMA_STREAM0);
+
+	gpio_clear(GPIOA, GPIO15);
+	dma_enable_stream(DMA1, DMA_STREAM0);
+	dma_enable_stream(DMA1, DMA_STREAM5);
+	spi_enable_rx_dma(SPI3);
+	spi_enable_tx_dma(SPI3);
+	return true;
+}
+
+/**
+ * @brief Whether a DMA burst read is in progress.
+ */
+bool mpu_read_registers_dma_busy(void)
+{
+	return mpu_dma_busy;
+}
+
+/**
+ * @brief DMA 1 stream 0 interruption routine.
+ *
+ * Executed on SPI3 reception complete. Releases the MPU chip select,
+ * disables SPI3 DMA requests and passes the received register values (the
+ * first byte is received while sending the address) to the callback.
+ */
+RAMFUNC void dma1_stream0_isr(void)
+{
+	TRACE_ISR_BEGIN(TRACE_ISR_GYRO_DMA);
+	if (dma_get_interrupt_flag(DMA1, DMA_STREAM0, DMA_TCIF))
+		dma_clear_interrupt_flags(DMA1, DMA_STREAM0, DMA_TCIF);
+
+	gpio_set(GPIOA, GPIO15);
+	spi_disable_rx_dma(SPI3);
+	spi_disable_tx_dma(SPI3);
+	dma_disable_stream(DMA1, DMA_STREAM0);
+	dma_disable_stream(DMA1, DMA_STREAM5);
+
+	mpu_dma_busy = false;
+	if (mpu_dma_callback)
+		mpu_dma_callback(&mpu_dma_rx[1], mpu_dma_size);
+	TRACE_ISR_END(TRACE_ISR_GYRO_DMA);
+}
+
 /**
  * @brief Write a MPU register with a given value.
  *
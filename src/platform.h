@@ -1,20 +1,34 @@
 #ifndef __PLATFORM_H
 #define __PLATFORM_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <libopencm3/cm3/dwt.h>
 #include <libopencm3/stm32/adc.h>
+#include <libopencm3/stm32/dma.h>
 #include <libopencm3/stm32/timer.h>
 
 #include "setup.h"
 
+/** Maximum DMA burst read size (see `mpu_read_registers_dma()`) */
+#define MPU_BURST_MAX_SIZE 64
+
 uint32_t read_cycle_counter(void);
 uint16_t read_encoder_left(void);
 uint16_t read_encoder_right(void);
+void start_battery_monitor(void);
+void set_low_battery_callback(float threshold, void (*callback)(float));
 float get_battery_voltage(void);
+uint16_t get_battery_millivolts(void);
 float get_motors_voltage(void);
 uint8_t mpu_read_register(uint8_t address);
+void mpu_read_registers(uint8_t address, uint8_t *data, uint8_t size);
+bool mpu_read_registers_dma(
+    uint8_t address, uint8_t size,
+    void (*callback)(const uint8_t *data, uint8_t size));
+bool mpu_read_registers_dma_busy(void);
 void mpu_write_register(uint8_t address, uint8_t value);
 void speaker_on(float hz);
 void speaker_off(void);
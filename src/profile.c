@@ -0,0 +1,67 @@
+#include "profile.h"
+
+CCM struct profile_zone_stats profile_zones[PROFILE_ZONES_COUNT];
+
+/**
+ * @brief Reset the statistics of all profiling zones.
+ *
+ * Only the accumulated statistics are reset. The start of each zone is
+ * kept, so a zone that is open when the reset happens (i.e.: in an
+ * interruption preempting the caller) still accounts for its real cycles.
+ */
+void profile_reset(void)
+{
+	struct profile_zone_stats *stats;
+	int i;
+
+	for (i = 0; i < PROFILE_ZONES_COUNT; i++) {
+		stats = &profile_zones[i];
+		CM_ATOMIC_BLOCK()
+		{
+			stats->count = 0;
+			stats->min = UINT32_MAX;
+			stats->max = 0;
+			stats->total = 0;
+			memset(stats->histogram, 0, sizeof(stats->histogram));
+		}
+	}
+}
+
+/**
+ * @brief Send the statistics of the profiling zones as telemetry records.
+ *
+ * Each zone is copied atomically, so it can be called while zones are being
+ * accounted from interruptions. Zones that never executed are skipped. The
+ * records are sent while they fit in the transmission queue, so a report
+ * that does not fit is continued by calling it again with the returned zone.
+ *
+ * @param[in] first First zone to send.
+ *
+ * @return The first zone not sent, or `PROFILE_ZONES_COUNT` once all the
+ * zones are sent.
+ */
+uint8_t profile_send_report(uint8_t first)
+{
+	struct telemetry_profile record;
+	struct profile_zone_stats stats;
+	uint8_t i;
+
+	for (i = first; i < PROFILE_ZONES_COUNT; i++) {
+		CM_ATOMIC_BLOCK()
+		{
+			stats = profile_zones[i];
+		}
+		if (!stats.count)
+			continue;
+		record.zone = i;
+		record.count = stats.count;
+		record.min = stats.min;
+		record.max = stats.max;
+		record.total = stats.total;
+		memcpy(record.histogram, stats.histogram,
+		       sizeof(record.histogram));
+		if (!telemetry_send(TELEMETRY_PROFILE, &record, sizeof(record)))
+			break;
+	}
+	return i;
+}
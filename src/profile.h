@@ -0,0 +1,86 @@
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+#include <stdint.h>
+
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/dwt.h>
+
+#include "telemetry.h"
+
+/**
+ * Profiling zones.
+ *
+ * The list is shared with the host report tool (`scripts/profile_report.py`)
+ * to name the zones, so keep one `ZONE(NAME)` entry per line.
+ */
+#define PROFILE_ZONES(ZONE)                                                    \
+	ZONE(SYSTICK)                                                          \
+	ZONE(SENSING)                                                          \
+	ZONE(ESTIMATION)                                                       \
+	ZONE(CONTROL)                                                          \
+	ZONE(MOTOR_OUTPUT)                                                     \
+	ZONE(TELEMETRY)                                                        \
+	ZONE(BENCHMARK_IR_FLOAT)                                               \
+	ZONE(BENCHMARK_IR_LUT)                                                 \
+	ZONE(BENCHMARK_BATTERY_FLOAT)                                          \
+	ZONE(BENCHMARK_BATTERY_FIXED)                                          \
+	ZONE(BENCHMARK_ESTIMATOR)
+
+#define PROFILE_HISTOGRAM_BINS 32
+
+#define PROFILE_ZONE_ID(name) PROFILE_##name,
+
+enum profile_zone { PROFILE_ZONES(PROFILE_ZONE_ID) PROFILE_ZONES_COUNT };
+
+/**
+ * Cycle statistics of a profiling zone.
+ *
+ * Histogram bin `n` counts the executions that took between `2^n` and
+ * `2^(n + 1) - 1` cycles (bin 0 includes 0 cycles).
+ */
+struct profile_zone_stats {
+	uint32_t start;
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+	uint32_t histogram[PROFILE_HISTOGRAM_BINS];
+};
+
+extern struct profile_zone_stats profile_zones[PROFILE_ZONES_COUNT];
+
+/**
+ * @brief Mark the beginning of a profiling zone.
+ *
+ * Zones may be nested, but a zone must not be re-entered (i.e.: from an
+ * interruption) before it ends.
+ */
+#define PROFILE_BEGIN(zone) (profile_zones[(zone)].start = DWT_CYCCNT)
+
+/**
+ * @brief Mark the end of a profiling zone and account for its cycles.
+ */
+#define PROFILE_END(zone) profile_account((zone), DWT_CYCCNT)
+
+/**
+ * @brief Update the zone statistics (use through `PROFILE_END()`).
+ */
+static inline void profile_account(enum profile_zone zone, uint32_t now)
+{
+	struct profile_zone_stats *stats = &profile_zones[zone];
+	uint32_t cycles = now - stats->start;
+
+	stats->count++;
+	stats->total += cycles;
+	if (cycles < stats->min)
+		stats->min = cycles;
+	if (cycles > stats->max)
+		stats->max = cycles;
+	stats->histogram[cycles ? 31 - __builtin_clz(cycles) : 0]++;
+}
+
+void profile_reset(void);
+uint8_t profile_send_report(uint8_t first);
+
+#endif /* __PROFILE_H */
@@ -0,0 +1,210 @@
+#include "queue.h"
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+#include <libopencm3/cm3/sync.h>
+
+/*
+ * Any exception entry or return clears the exclusive monitor, so a store
+ * fails if the load was preempted by a handler, even if that handler did not
+ * touch the same index.
+ */
+static inline uint32_t load_exclusive(volatile uint32_t *address)
+{
+	return __ldrex(address);
+}
+
+static inline bool store_exclusive(volatile uint32_t *address,
+				   uint32_t expected, uint32_t value)
+{
+	(void)expected;
+	return !__strex(value, address);
+}
+
+static inline uint32_t load_acquire(volatile uint32_t *address)
+{
+	uint32_t value = *address;
+
+	__dmb();
+	return value;
+}
+
+static inline void store_release(volatile uint32_t *address, uint32_t value)
+{
+	__dmb();
+	*address = value;
+}
+#else
+static inline uint32_t load_exclusive(volatile uint32_t *address)
+{
+	return __atomic_load_n(address, __ATOMIC_RELAXED);
+}
+
+static inline bool store_exclusive(volatile uint32_t *address,
+				   uint32_t expected, uint32_t value)
+{
+	return __atomic_compare_exchange_n(address, &expected, value, true,
+					   __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t load_acquire(volatile uint32_t *address)
+{
+	return __atomic_load_n(address, __ATOMIC_ACQUIRE);
+}
+
+static inline void store_release(volatile uint32_t *address, uint32_t value)
+{
+	__atomic_store_n(address, value, __ATOMIC_RELEASE);
+}
+#endif
+
+/**
+ * @brief Initialize an empty queue.
+ *
+ * @param[in] buffer Storage for `capacity` elements.
+ * @param[in] element_size Size of each element, in bytes.
+ * @param[in] capacity Number of elements, a power of two.
+ *
+ * @return Whether the capacity is valid.
+ */
+bool spsc_queue_init(struct spsc_queue *queue, void *buffer,
+		     uint16_t element_size, uint32_t capacity)
+{
+	if (!QUEUE_CAPACITY_VALID(capacity) || !element_size)
+		return false;
+	queue->buffer = buffer;
+	queue->element_size = element_size;
+	queue->mask = capacity - 1;
+	queue->head = 0;
+	queue->tail = 0;
+	return true;
+}
+
+/**
+ * @brief Copy an element to the queue. To be called by the producer only.
+ *
+ * @return Whether there was room for it.
+ */
+bool spsc_queue_push(struct spsc_queue *queue, const void *element)
+{
+	uint32_t head = queue->head;
+
+	if (head - load_acquire(&queue->tail) > queue->mask)
+		return false;
+	memcpy(&queue->buffer[(head & queue->mask) * queue->element_size],
+	       element, queue->element_size);
+	store_release(&queue->head, head + 1);
+	return true;
+}
+
+/**
+ * @brief Copy the oldest element out of the queue. To be called by the
+ * consumer only.
+ *
+ * @return Whether the queue had any element.
+ */
+bool spsc_queue_pop(struct spsc_queue *queue, void *element)
+{
+	uint32_t tail = queue->tail;
+
+	if (load_acquire(&queue->head) == tail)
+		return false;
+	memcpy(element,
+	       &queue->buffer[(tail & queue->mask) * queue->element_size],
+	       queue->element_size);
+	store_release(&queue->tail, tail + 1);
+	return true;
+}
+
+/**
+ * @brief Number of elements in the queue.
+ *
+ * Exact for the producer and the consumer, a snapshot for anyone else.
+ */
+uint32_t spsc_queue_count(struct spsc_queue *queue)
+{
+	uint32_t tail = load_acquire(&queue->tail);
+
+	return load_acquire(&queue->head) - tail;
+}
+
+/**
+ * @brief Initialize an empty queue.
+ *
+ * @param[in] buffer Storage for `capacity` elements.
+ * @param[in] sequence Storage for `capacity` slot sequence numbers.
+ * @param[in] element_size Size of each element, in bytes.
+ * @param[in] capacity Number of elements, a power of two. At least 2: with
+ * a single slot, a published element would look free for the next lap.
+ *
+ * @return Whether the capacity is valid.
+ */
+bool mpsc_queue_init(struct mpsc_queue *queue, void *buffer,
+		     volatile uint32_t *sequence, uint16_t element_size,
+		     uint32_t capacity)
+{
+	uint32_t i;
+
+	if (!QUEUE_CAPACITY_VALID(capacity) || capacity < 2 || !element_size)
+		return false;
+	queue->buffer = buffer;
+	queue->sequence = sequence;
+	queue->element_size = element_size;
+	queue->mask = capacity - 1;
+	queue->head = 0;
+	queue->tail = 0;
+	for (i = 0; i < capacity; i++)
+		sequence[i] = i;
+	return true;
+}
+
+/**
+ * @brief Copy an element to the queue. Safe to call from any context.
+ *
+ * A slot is free when its sequence number equals the head position it is
+ * claimed for: the consumer sets it one lap ahead when it takes the element.
+ *
+ * @return Whether there was room for it.
+ */
+bool mpsc_queue_push(struct mpsc_queue *queue, const void *element)
+{
+	uint32_t head;
+	int32_t lag;
+
+	do {
+		head = load_exclusive(&queue->head);
+		lag = (int32_t)(load_acquire(
+				    &queue->sequence[head & queue->mask]) -
+				head);
+		if (lag < 0)
+			return false;
+	} while (lag > 0 || !store_exclusive(&queue->head, head, head + 1));
+	memcpy(&queue->buffer[(head & queue->mask) * queue->element_size],
+	       element, queue->element_size);
+	store_release(&queue->sequence[head & queue->mask], head + 1);
+	return true;
+}
+
+/**
+ * @brief Copy the oldest element out of the queue. To be called by the
+ * consumer only.
+ *
+ * Elements are taken in the order their slots were claimed: if a producer
+ * was preempted while copying an element, the ones pushed after it are
+ * only available once it finishes.
+ *
+ * @return Whether an element was available.
+ */
+bool mpsc_queue_pop(struct mpsc_queue *queue, void *element)
+{
+	uint32_t tail = queue->tail;
+	volatile uint32_t *sequence = &queue->sequence[tail & queue->mask];
+
+	if (load_acquire(sequence) != tail + 1)
+		return false;
+	memcpy(element,
+	       &queue->buffer[(tail & queue->mask) * queue->element_size],
+	       queue->element_size);
+	store_release(sequence, tail + queue->mask + 1);
+	queue->tail = tail + 1;
+	return true;
+}
@@ -0,0 +1,71 @@
+#ifndef __QUEUE_H
+#define __QUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Lock-free queues of fixed-size elements, to hand data from interrupt
+ * handlers to the background loop (or the other way around).
+ *
+ * - `struct spsc_queue`: a single producer and a single consumer, which may
+ *   preempt each other.
+ * - `struct mpsc_queue`: any number of producers (i.e.: interrupt handlers
+ *   with different priorities, preempting each other) and a single consumer.
+ *
+ * The capacity must be a power of two (see `QUEUE_CAPACITY_VALID()`). The
+ * element storage is provided by the caller: `capacity * element_size`
+ * bytes, plus `capacity` sequence numbers for MPSC queues. Elements are
+ * copied in and out, so producers never wait for the consumer: pushing to
+ * a full queue fails instead.
+ *
+ * On the Cortex-M4 the indexes are claimed with exclusive accesses
+ * (LDREX/STREX) and published with data memory barriers. Host builds use the
+ * C11 memory model atomics instead, so the same code can be checked with
+ * ThreadSanitizer (see `sim/tools/queue_stress.c`).
+ */
+#define QUEUE_CAPACITY_VALID(capacity)                                        \
+	((capacity) > 0 && ((capacity) & ((capacity)-1)) == 0)
+
+/**
+ * Single-producer/single-consumer queue.
+ *
+ * Both indexes are free-running counters: each side only writes its own.
+ */
+struct spsc_queue {
+	uint8_t *buffer;
+	uint16_t element_size;
+	uint32_t mask;
+	volatile uint32_t head;
+	volatile uint32_t tail;
+};
+
+/**
+ * Multi-producer/single-consumer queue.
+ *
+ * Producers claim a slot by advancing the head with an exclusive access,
+ * then publish it by setting its sequence number once the element is
+ * copied. The consumer only takes published slots, in order.
+ */
+struct mpsc_queue {
+	uint8_t *buffer;
+	volatile uint32_t *sequence;
+	uint16_t element_size;
+	uint32_t mask;
+	volatile uint32_t head;
+	uint32_t tail;
+};
+
+bool spsc_queue_init(struct spsc_queue *queue, void *buffer,
+		     uint16_t element_size, uint32_t capacity);
+bool spsc_queue_push(struct spsc_queue *queue, const void *element);
+bool spsc_queue_pop(struct spsc_queue *queue, void *element);
+uint32_t spsc_queue_count(struct spsc_queue *queue);
+bool mpsc_queue_init(struct mpsc_queue *queue, void *buffer,
+		     volatile uint32_t *sequence, uint16_t element_size,
+		     uint32_t capacity);
+bool mpsc_queue_push(struct mpsc_queue *queue, const void *element);
+bool mpsc_queue_pop(struct mpsc_queue *queue, void *element);
+
+#endif /* __QUEUE_H */
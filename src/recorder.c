@@ -0,0 +1,191 @@
+#include "recorder.h"
+
+/**
+ * The recorder streams the inputs read by the SysTick tasks during each
+ * period, as `TELEMETRY_SENSORS` records, and the commands received, as
+ * `TELEMETRY_RECORDER_COMMAND` records, so that a host replay can feed them
+ * back through the same code. The known maze walls, in
+ * `TELEMETRY_RECORDER_MAZE` records, and a `TELEMETRY_RECORDER_START` record
+ * first capture the state the replay must start from.
+ *
+ * Each record takes 64 bytes on the wire, about 70% of the serial link
+ * bandwidth at one record per period.
+ */
+#define RECORD_GYRO_SAMPLES                                                    \
+	(sizeof(((struct telemetry_sensors *)0)->gyro) / sizeof(int16_t))
+
+/** Maze walls per `TELEMETRY_RECORDER_MAZE` record */
+#define RECORD_MAZE_WALLS (sizeof(((struct telemetry_recorder_maze *)0)->walls))
+
+_Static_assert(
+    sizeof(((struct telemetry_recorder_start *)0)->parameters) ==
+	PARAMETERS_COUNT * sizeof(float),
+    "Recorded parameters mismatch");
+_Static_assert(MAZE_WALLS_SIZE % RECORD_MAZE_WALLS == 0,
+	       "Recorded maze walls mismatch");
+_Static_assert(sizeof(((struct telemetry_recorder_command *)0)->data) >=
+		   sizeof(struct telemetry_maze_row),
+	       "Recorded commands too short");
+
+static volatile bool recording;
+static struct recorder_stats stats;
+
+/**
+ * @brief Send the known maze walls, to start the replay from.
+ *
+ * @return Whether all the records were queued.
+ */
+static bool send_maze(void)
+{
+	static struct maze_map map;
+	struct telemetry_recorder_maze record;
+	uint16_t offset;
+
+	maze_get_map(&map);
+	for (offset = 0; offset < MAZE_WALLS_SIZE;
+	     offset += RECORD_MAZE_WALLS) {
+		record.offset = offset;
+		memcpy(record.walls, &map.walls[offset], RECORD_MAZE_WALLS);
+		if (!telemetry_send(TELEMETRY_RECORDER_MAZE, &record,
+				    sizeof(record)))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Start recording the sensor inputs of every SysTick period.
+ *
+ * The maze walls are sent first, and the start record last, with the
+ * parameter values, so a replay only starts from a complete state. The
+ * replay is only exact when recording from the startup, right after the
+ * sensors and the settings are initialized, or while the robot is stopped,
+ * as the filters state is not recorded.
+ *
+ * @return Whether the start records were queued, or the recorder not
+ * started.
+ */
+bool recorder_start(void)
+{
+	struct telemetry_recorder_start start;
+	struct odometry odometry;
+	struct parameter parameter;
+	uint8_t id;
+
+	if (recording)
+		return true;
+	if (!send_maze())
+		return false;
+	odometry_get(&odometry);
+	start.schema_version = TELEMETRY_SCHEMA_VERSION;
+	start.ticks = get_clock_ticks();
+	start.encoder_left = odometry.raw_left;
+	start.encoder_right = odometry.raw_right;
+	start.gyro_bias = gyro_get_bias();
+	start.gyro_calibrated = gyro_calibrated();
+	start.maze_size = maze_size();
+	for (id = 0; id < PARAMETERS_COUNT; id++) {
+		parameters_get(id, &parameter);
+		start.parameters[id] = parameter.value;
+	}
+	if (!telemetry_send(TELEMETRY_RECORDER_START, &start, sizeof(start)))
+		return false;
+	CM_ATOMIC_BLOCK()
+	{
+		memset(&stats, 0, sizeof(stats));
+		recording = true;
+	}
+	return true;
+}
+
+void recorder_stop(void)
+{
+	recording = false;
+}
+
+bool recorder_is_recording(void)
+{
+	return recording;
+}
+
+/**
+ * @brief Record the sensor inputs of the current period.
+ *
+ * To be called once per SysTick period, after the sensing task, which reads
+ * the encoders and the gyroscope FIFO. Gyroscope bursts longer than the
+ * record are truncated: the record holds the first `RECORD_GYRO_SAMPLES`
+ * samples, and the FIFO count shows how many were read.
+ */
+void recorder_update(void)
+{
+	struct telemetry_sensors record;
+	struct odometry odometry;
+	uint16_t ir[IR_SENSORS_COUNT];
+	const uint8_t *burst;
+	uint16_t size;
+	uint16_t i;
+
+	if (!recording)
+		return;
+	odometry_get(&odometry);
+	record.cycles = read_cycle_counter();
+	record.ticks = get_clock_ticks();
+	record.encoder_left = odometry.raw_left;
+	record.encoder_right = odometry.raw_right;
+	record.battery_millivolts = get_battery_millivolts();
+	record.ir_sequence = (uint16_t)get_ir_readings(ir);
+	memcpy(record.ir, ir, sizeof(record.ir));
+	record.gyro_fifo_count = gyro_get_last_burst(&burst, &size);
+	if (size > RECORD_GYRO_SAMPLES * 2) {
+		stats.truncated++;
+		size = RECORD_GYRO_SAMPLES * 2;
+	}
+	record.gyro_samples = (uint8_t)(size / 2);
+	for (i = 0; i < size; i += 2)
+		record.gyro[i / 2] = (int16_t)(burst[i] << 8 | burst[i + 1]);
+	for (i /= 2; i < RECORD_GYRO_SAMPLES; i++)
+		record.gyro[i] = 0;
+	if (telemetry_send(TELEMETRY_SENSORS, &record, sizeof(record)))
+		stats.records++;
+	else
+		stats.dropped++;
+}
+
+/**
+ * @brief Record a received command, right after it is executed.
+ *
+ * The replay executes it after the SysTick period that precedes it in the
+ * capture, so the record must follow the execution: commands may take
+ * longer than a period (i.e.: planning a run). Commands longer than the
+ * record are dropped. Called from the background, so the statistics are
+ * updated atomically.
+ */
+void recorder_command(uint8_t type, const uint8_t *record, uint16_t size)
+{
+	struct telemetry_recorder_command command;
+
+	if (!recording)
+		return;
+	memset(&command, 0, sizeof(command));
+	command.ticks = get_clock_ticks();
+	command.type = type;
+	command.size = (uint8_t)size;
+	if (size <= sizeof(command.data)) {
+		memcpy(command.data, record, size);
+		if (telemetry_send(TELEMETRY_RECORDER_COMMAND, &command,
+				   sizeof(command)))
+			return;
+	}
+	CM_ATOMIC_BLOCK()
+	{
+		stats.dropped++;
+	}
+}
+
+void recorder_get_stats(struct recorder_stats *copy)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		*copy = stats;
+	}
+}
@@ -0,0 +1,37 @@
+#ifndef __RECORDER_H
+#define __RECORDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mmlib/clock.h"
+
+#include "gyro.h"
+#include "infrared.h"
+#include "maze.h"
+#include "odometry.h"
+#include "parameters.h"
+#include "platform.h"
+#include "telemetry.h"
+
+/**
+ * Recording statistics since the recorder was started.
+ *
+ * - Sensor records queued for transmission.
+ * - Sensor and command records dropped because the serial queue was full.
+ * - Periods with more gyroscope samples than a record holds.
+ */
+struct recorder_stats {
+	uint32_t records;
+	uint32_t dropped;
+	uint32_t truncated;
+};
+
+bool recorder_start(void);
+void recorder_stop(void);
+bool recorder_is_recording(void);
+void recorder_update(void);
+void recorder_command(uint8_t type, const uint8_t *record, uint16_t size);
+void recorder_get_stats(struct recorder_stats *stats);
+
+#endif /* __RECORDER_H */
@@ -1,30 +1,62 @@
 #include "serial.h"
 
-static mutex_t _send_lock;
+#define SERIAL_BUFFER_MASK (SERIAL_BUFFER_SIZE - 1)
+#define SERIAL_RX_BUFFER_MASK (SERIAL_RX_BUFFER_SIZE - 1)
+#define SERIAL_FRAME_DELIMITER 0x00
 
 /**
- * @brief Try to acquire the serial transfer lock.
+ * Transmission queue.
  *
- * @return Whether the lock was acquired or not.
+ * `head` and `tail` are free-running indexes: `head - tail` is the number of
+ * queued bytes, including the `transfer_size` bytes currently being sent by
+ * the DMA (starting at `tail`).
  */
-bool serial_acquire_transfer_lock(void)
-{
-	return (bool)mutex_trylock(&_send_lock);
-}
+static volatile uint8_t buffer[SERIAL_BUFFER_SIZE];
+static volatile uint32_t head;
+static volatile uint32_t tail;
+static volatile uint32_t transfer_size;
+static volatile struct serial_stats stats;
 
 /**
- * @brief Send data through serial.
+ * Reception ring buffer.
  *
- * DMA is configured to read from `data` a number `size` of bytes. It then
- * writes all those bytes to USART1 (Bluetooth).
+ * DMA writes the first `SERIAL_RX_BUFFER_SIZE` bytes circularly. The extra
+ * `SERIAL_RX_MAX_FRAME` bytes at the end are only used to make a frame that
+ * wraps around the ring end contiguous (see `serial_receive()`).
+ *
+ * `rx_head` is the free-running count of bytes written by DMA, updated from
+ * the interruptions (see `rx_advance()`). `rx_tail` is the free-running
+ * index of the first byte of the next frame and `rx_scan` the next byte to
+ * check for a frame delimiter. `rx_discarding` is set while the rest of a
+ * frame already dropped for being too long is skipped, up to its delimiter.
+ */
+static volatile uint8_t rx_buffer[SERIAL_RX_BUFFER_SIZE + SERIAL_RX_MAX_FRAME];
+static volatile uint32_t rx_head;
+static uint32_t rx_last_index;
+static uint32_t rx_tail;
+static uint32_t rx_scan;
+static bool rx_discarding;
+
+/**
+ * @brief Start a DMA transfer of the next contiguous chunk of queued data.
+ *
+ * DMA is configured to read from the transmission queue, starting at `tail`
+ * and up to the queue head or the end of the buffer, whatever comes first.
+ * It then writes all those bytes to USART1 (Bluetooth).
  *
  * An interruption is generated when the transfer is complete.
  *
- * @param[in] data Data to send.
- * @param[in] size Size (number of bytes) to send.
+ * @note Must be called with interruptions masked or from the DMA ISR.
  */
-void serial_send(char *data, int size)
+static void start_transfer(void)
 {
+	uint32_t start = tail & SERIAL_BUFFER_MASK;
+	uint32_t size = head - tail;
+
+	if (size > SERIAL_BUFFER_SIZE - start)
+		size = SERIAL_BUFFER_SIZE - start;
+	transfer_size = size;
+
 	dma_stream_reset(DMA2, DMA_STREAM7);
 
 	dma_enable_memory_increment_mode(DMA2, DMA_STREAM7);
@@ -35,7 +67,7 @@ void serial_send(char *data, int size)
 			      DMA_SxCR_DIR_MEM_TO_PERIPHERAL);
 
 	dma_set_peripheral_address(DMA2, DMA_STREAM7, (uint32_t)&USART1_DR);
-	dma_set_memory_address(DMA2, DMA_STREAM7, (uint32_t)data);
+	dma_set_memory_address(DMA2, DMA_STREAM7, (uint32_t)&buffer[start]);
 	dma_set_number_of_data(DMA2, DMA_STREAM7, size);
 
 	dma_enable_transfer_complete_interrupt(DMA2, DMA_STREAM7);
@@ -45,20 +77,274 @@ void serial_send(char *data, int size)
 }
 
 /**
- * @brief DMA 2 stream 7 interruption routine.
+ * @brief Copy data into the transmission queue, wrapping around its end.
+ */
+static void enqueue(const char *data, uint32_t size)
+{
+	uint32_t start = head & SERIAL_BUFFER_MASK;
+	uint32_t first = SERIAL_BUFFER_SIZE - start;
+
+	if (first > size)
+		first = size;
+	memcpy((uint8_t *)&buffer[start], data, first);
+	memcpy((uint8_t *)&buffer[0], data + first, size - first);
+	head += size;
+}
+
+/**
+ * @brief Send data through serial.
+ *
+ * Data is copied into the transmission queue and sent in the background by
+ * DMA (see `start_transfer()`), so this function never waits for a transfer
+ * in progress. It may be called from interruption routines.
  *
- * Executed on serial transfer complete. Clears the interruption flag, and
- * disables serial transfer DMA until next call to `serial_send()`.
+ * Messages are queued as a whole: if there is not enough free space in the
+ * queue the message is dropped and the overflow counter is incremented.
  *
- * It will also release the serial transfer lock.
+ * @param[in] data Data to send.
+ * @param[in] size Size (number of bytes) to send.
+ *
+ * @return Whether the data was queued or not.
+ */
+bool serial_send(const char *data, int size)
+{
+	bool queued = false;
+	uint32_t queue;
+
+	CM_ATOMIC_BLOCK()
+	{
+		queue = head - tail;
+		if (size <= 0) {
+			queued = true;
+		} else if ((uint32_t)size > SERIAL_BUFFER_SIZE - queue) {
+			stats.overflows++;
+			trace(TRACE_SERIAL_OVERFLOW, TRACE_SERIAL_TX_FULL,
+			      (uint16_t)size);
+		} else {
+			enqueue(data, size);
+			queue += size;
+			stats.bytes_queued += size;
+			if (queue > stats.peak_queue)
+				stats.peak_queue = queue;
+			if (!transfer_size)
+				start_transfer();
+			queued = true;
+		}
+	}
+	return queued;
+}
+
+/**
+ * @brief Start receiving from USART1 (Bluetooth) into the ring buffer.
+ *
+ * DMA 2 stream 2 (channel 4) stores every received byte in the ring buffer,
+ * circularly, so there are no per-byte interruptions. The ring position is
+ * updated on USART1 idle line interruptions, which happen at the end of each
+ * burst of data (usually a frame or a few of them), and on half and full
+ * transfer interruptions, so long bursts are never lost track of.
  */
-void dma2_stream7_isr(void)
+void serial_start_reception(void)
 {
+	dma_stream_reset(DMA2, DMA_STREAM2);
+
+	dma_enable_memory_increment_mode(DMA2, DMA_STREAM2);
+	dma_enable_circular_mode(DMA2, DMA_STREAM2);
+	dma_set_peripheral_size(DMA2, DMA_STREAM2, DMA_SxCR_PSIZE_8BIT);
+	dma_set_memory_size(DMA2, DMA_STREAM2, DMA_SxCR_MSIZE_8BIT);
+	dma_set_priority(DMA2, DMA_STREAM2, DMA_SxCR_PL_HIGH);
+	dma_set_transfer_mode(DMA2, DMA_STREAM2,
+			      DMA_SxCR_DIR_PERIPHERAL_TO_MEM);
+
+	dma_set_peripheral_address(DMA2, DMA_STREAM2, (uint32_t)&USART1_DR);
+	dma_set_memory_address(DMA2, DMA_STREAM2, (uint32_t)rx_buffer);
+	dma_set_number_of_data(DMA2, DMA_STREAM2, SERIAL_RX_BUFFER_SIZE);
+
+	dma_enable_half_transfer_interrupt(DMA2, DMA_STREAM2);
+	dma_enable_transfer_complete_interrupt(DMA2, DMA_STREAM2);
+	dma_channel_select(DMA2, DMA_STREAM2, DMA_SxCR_CHSEL_4);
+	dma_enable_stream(DMA2, DMA_STREAM2);
+	usart_enable_rx_dma(USART1);
+	USART_CR1(USART1) |= USART_CR1_IDLEIE;
+}
+
+/**
+ * @brief Account for the bytes written by DMA since the last call.
+ *
+ * Called from the interruptions, which happen at least every half ring, so
+ * the DMA position can not have wrapped around since the last call.
+ */
+static void rx_advance(void)
+{
+	uint32_t index = SERIAL_RX_BUFFER_SIZE -
+			 dma_get_number_of_data(DMA2, DMA_STREAM2);
+	uint32_t received = (index - rx_last_index) & SERIAL_RX_BUFFER_MASK;
+
+	rx_last_index = index & SERIAL_RX_BUFFER_MASK;
+	rx_head += received;
+	stats.bytes_received += received;
+}
+
+/**
+ * @brief Get the next received frame, in place.
+ *
+ * Frames are delimited by a zero byte (see `TELEMETRY_RECORDS`). The frame
+ * is returned where DMA wrote it, without the delimiter, so it can be
+ * decoded and parsed in place. Only a frame that wraps around the ring end
+ * has its wrapped part copied after the end, so it is contiguous too.
+ *
+ * The frame is valid until the next call, as long as less than a ring
+ * buffer of data is received meanwhile. Frames longer than
+ * `SERIAL_RX_MAX_FRAME` are dropped, once each: a frame still growing past
+ * that size is dropped straight away, and the rest of it is discarded as it
+ * arrives, up to its delimiter. If the pending data was overwritten before
+ * being consumed, it is all discarded.
+ *
+ * @param[out] frame Start of the frame.
+ *
+ * @return The frame size, or zero if no complete frame is pending.
+ */
+uint16_t serial_receive(uint8_t **frame)
+{
+	uint32_t received = rx_head;
+	uint32_t start;
+	uint32_t size;
+
+	if (received - rx_tail > SERIAL_RX_BUFFER_SIZE) {
+		stats.rx_overruns++;
+		trace(TRACE_SERIAL_OVERFLOW, TRACE_SERIAL_RX_OVERRUN, 0);
+		rx_tail = received;
+		rx_scan = received;
+		return 0;
+	}
+	for (; rx_scan != received; rx_scan++) {
+		if (rx_buffer[rx_scan & SERIAL_RX_BUFFER_MASK] !=
+		    SERIAL_FRAME_DELIMITER)
+			continue;
+		start = rx_tail & SERIAL_RX_BUFFER_MASK;
+		size = rx_scan - rx_tail;
+		rx_tail = rx_scan + 1;
+		if (rx_discarding) {
+			rx_discarding = false;
+			continue;
+		}
+		if (!size)
+			continue;
+		if (size > SERIAL_RX_MAX_FRAME) {
+			stats.rx_dropped++;
+			trace(TRACE_SERIAL_OVERFLOW,
+			      TRACE_SERIAL_RX_FRAME_TOO_LONG,
+			      size > UINT16_MAX ? UINT16_MAX : (uint16_t)size);
+			continue;
+		}
+		if (start + size > SERIAL_RX_BUFFER_SIZE)
+			memcpy((uint8_t *)&rx_buffer[SERIAL_RX_BUFFER_SIZE],
+			       (uint8_t *)&rx_buffer[0],
+			       start + size - SERIAL_RX_BUFFER_SIZE);
+		rx_scan = rx_tail;
+		*frame = (uint8_t *)&rx_buffer[start];
+		return (uint16_t)size;
+	}
+	if (!rx_discarding && rx_scan - rx_tail > SERIAL_RX_MAX_FRAME) {
+		stats.rx_dropped++;
+		trace(TRACE_SERIAL_OVERFLOW, TRACE_SERIAL_RX_FRAME_TOO_LONG, 0);
+		rx_discarding = true;
+	}
+	if (rx_discarding)
+		rx_tail = rx_scan;
+	return 0;
+}
+
+/**
+ * @brief Get the transmission and reception statistics.
+ *
+ * @param[out] serial_stats Structure to fill with the current statistics.
+ */
+void serial_get_stats(struct serial_stats *serial_stats)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		serial_stats->bytes_queued = stats.bytes_queued;
+		serial_stats->bytes_sent = stats.bytes_sent;
+		serial_stats->overflows = stats.overflows;
+		serial_stats->peak_queue = stats.peak_queue;
+		serial_stats->bytes_received = stats.bytes_received;
+		serial_stats->rx_overruns = stats.rx_overruns;
+		serial_stats->rx_dropped = stats.rx_dropped;
+	}
+}
+
+/**
+ * @brief Reset the transmission and reception statistics.
+ */
+void serial_reset_stats(void)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		stats.bytes_queued = 0;
+		stats.bytes_sent = 0;
+		stats.overflows = 0;
+		stats.peak_queue = head - tail;
+		stats.bytes_received = 0;
+		stats.rx_overruns = 0;
+		stats.rx_dropped = 0;
+	}
+}
+
+/**
+ * @brief DMA 2 stream 7 interruption routine.
+ *
+ * Executed on serial transfer complete. Clears the interruption flag and
+ * releases the transferred bytes from the queue. If there is more data
+ * queued, the next transfer is chained straight away. Otherwise, serial
+ * transfer DMA is disabled until next call to `serial_send()`.
+ */
+RAMFUNC void dma2_stream7_isr(void)
+{
+	TRACE_ISR_BEGIN(TRACE_ISR_SERIAL_TX_DMA);
 	if (dma_get_interrupt_flag(DMA2, DMA_STREAM7, DMA_TCIF))
 		dma_clear_interrupt_flags(DMA2, DMA_STREAM7, DMA_TCIF);
 
-	dma_disable_transfer_complete_interrupt(DMA2, DMA_STREAM7);
-	usart_disable_tx_dma(USART1);
-	dma_disable_stream(DMA2, DMA_STREAM7);
-	mutex_unlock(&_send_lock);
+	tail += transfer_size;
+	stats.bytes_sent += transfer_size;
+	transfer_size = 0;
+	if (head != tail) {
+		start_transfer();
+	} else {
+		dma_disable_transfer_complete_interrupt(DMA2, DMA_STREAM7);
+		usart_disable_tx_dma(USART1);
+		dma_disable_stream(DMA2, DMA_STREAM7);
+	}
+	TRACE_ISR_END(TRACE_ISR_SERIAL_TX_DMA);
+}
+
+/**
+ * @brief DMA 2 stream 2 interruption routine.
+ *
+ * Executed when the reception ring buffer is half and completely filled.
+ */
+RAMFUNC void dma2_stream2_isr(void)
+{
+	TRACE_ISR_BEGIN(TRACE_ISR_SERIAL_RX_DMA);
+	if (dma_get_interrupt_flag(DMA2, DMA_STREAM2, DMA_HTIF))
+		dma_clear_interrupt_flags(DMA2, DMA_STREAM2, DMA_HTIF);
+	if (dma_get_interrupt_flag(DMA2, DMA_STREAM2, DMA_TCIF))
+		dma_clear_interrupt_flags(DMA2, DMA_STREAM2, DMA_TCIF);
+	rx_advance();
+	TRACE_ISR_END(TRACE_ISR_SERIAL_RX_DMA);
+}
+
+/**
+ * @brief USART1 interruption routine.
+ *
+ * Executed on idle line detection, after the end of each burst of received
+ * data. The flag is cleared reading the status and then the data register.
+ */
+RAMFUNC void usart1_isr(void)
+{
+	TRACE_ISR_BEGIN(TRACE_ISR_USART1);
+	if (USART_SR(USART1) & USART_SR_IDLE) {
+		(void)usart_recv(USART1);
+		rx_advance();
+	}
+	TRACE_ISR_END(TRACE_ISR_USART1);
 }
@@ -4,12 +4,57 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <libopencm3/cm3/cortex.h>
 #include <libopencm3/cm3/nvic.h>
-#include <libopencm3/cm3/sync.h>
 #include <libopencm3/stm32/dma.h>
 #include <libopencm3/stm32/usart.h>
 
-bool serial_acquire_transfer_lock(void);
-void serial_send(char *data, int size);
+#include "setup.h"
+#include "trace.h"
+
+/**
+ * Size of the transmission queue, in bytes (must be a power of two).
+ *
+ * At 921600 bps the queue is drained in about 22 ms.
+ */
+#define SERIAL_BUFFER_SIZE 2048
+
+/**
+ * Size of the reception ring buffer, in bytes (must be a power of two).
+ *
+ * At 921600 bps the ring is filled in about 22 ms, so received frames must
+ * be consumed (see `serial_receive()`) more often than that.
+ */
+#define SERIAL_RX_BUFFER_SIZE 2048
+
+/** Maximum received frame size, in bytes (delimiter excluded) */
+#define SERIAL_RX_MAX_FRAME 256
+
+/**
+ * Serial link statistics.
+ *
+ * - Bytes queued for transmission and bytes already sent.
+ * - Messages dropped because the transmission queue was full.
+ * - Peak transmission queue size, in bytes.
+ * - Bytes received.
+ * - Times the received data was not consumed before the ring buffer wrapped
+ *   around, discarding all the pending data.
+ * - Received frames dropped for being longer than `SERIAL_RX_MAX_FRAME`.
+ */
+struct serial_stats {
+	uint32_t bytes_queued;
+	uint32_t bytes_sent;
+	uint32_t overflows;
+	uint32_t peak_queue;
+	uint32_t bytes_received;
+	uint32_t rx_overruns;
+	uint32_t rx_dropped;
+};
+
+bool serial_send(const char *data, int size);
+void serial_start_reception(void);
+uint16_t serial_receive(uint8_t **frame);
+void serial_get_stats(struct serial_stats *serial_stats);
+void serial_reset_stats(void);
 
 #endif /* __SERIAL_H */
@@ -0,0 +1,102 @@
+#include "settings.h"
+
+struct battery_calibration {
+	int32_t gain;
+	int32_t offset;
+};
+
+static int32_t stored_gyro_bias;
+static bool gyro_bias_stored;
+
+/**
+ * @brief Load the stored settings, replacing the defaults.
+ *
+ * A stored gyroscope bias skips the startup calibration. Must be called
+ * after `start_gyro_fifo()`.
+ */
+void settings_load(void)
+{
+	struct battery_calibration battery;
+
+	storage_init();
+	gyro_bias_stored = storage_read(STORAGE_GYRO_BIAS, &stored_gyro_bias,
+					sizeof(stored_gyro_bias));
+	if (gyro_bias_stored)
+		gyro_set_bias(stored_gyro_bias);
+	storage_read(STORAGE_IR_CALIBRATION, ir_distance_tables,
+		     sizeof(ir_distance_tables));
+	if (storage_read(STORAGE_BATTERY_CALIBRATION, &battery,
+			 sizeof(battery))) {
+		CM_ATOMIC_BLOCK()
+		{
+			battery_millivolts_gain = battery.gain;
+			battery_millivolts_offset = battery.offset;
+		}
+	}
+}
+
+/**
+ * @brief Store the learned values that changed significantly.
+ *
+ * Run as a background task: values are only stored while the robot is
+ * stopped and not about to move (see `storage_write()`).
+ */
+void settings_update(void)
+{
+	int32_t bias;
+
+	if (!gyro_calibrated() || !control_robot_stopped())
+		return;
+	bias = gyro_get_bias();
+	if (gyro_bias_stored &&
+	    abs(bias - stored_gyro_bias) < SETTINGS_GYRO_BIAS_THRESHOLD)
+		return;
+	if (storage_write(STORAGE_GYRO_BIAS, &bias, sizeof(bias))) {
+		stored_gyro_bias = bias;
+		gyro_bias_stored = true;
+	}
+}
+
+/**
+ * @brief Store the current sensors calibration.
+ *
+ * @return Whether the calibration could be stored.
+ */
+bool settings_save_calibration(void)
+{
+	struct battery_calibration battery = {
+	    .gain = battery_millivolts_gain,
+	    .offset = battery_millivolts_offset,
+	};
+
+	return storage_write(STORAGE_IR_CALIBRATION, ir_distance_tables,
+			     sizeof(ir_distance_tables)) &&
+	       storage_write(STORAGE_BATTERY_CALIBRATION, &battery,
+			     sizeof(battery));
+}
+
+/**
+ * @brief Store the discovered maze walls.
+ *
+ * @return Whether the walls could be stored.
+ */
+bool settings_save_maze(void)
+{
+	static struct maze_map map;
+
+	maze_get_map(&map);
+	return storage_write(STORAGE_MAZE_WALLS, &map, sizeof(map));
+}
+
+/**
+ * @brief Restore the stored maze walls and update the distances.
+ *
+ * @return Whether a valid maze was stored.
+ */
+bool settings_load_maze(void)
+{
+	static struct maze_map map;
+
+	return storage_read(STORAGE_MAZE_WALLS, &map, sizeof(map)) &&
+	       maze_set_map(&map);
+}
@@ -0,0 +1,26 @@
+#ifndef __SETTINGS_H
+#define __SETTINGS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <libopencm3/cm3/cortex.h>
+
+#include "calibration.h"
+#include "control.h"
+#include "gyro.h"
+#include "maze.h"
+#include "odometry.h"
+#include "storage.h"
+
+/** Bias change that triggers a new stored value, in LSB (Q8) */
+#define SETTINGS_GYRO_BIAS_THRESHOLD 64
+
+void settings_load(void);
+void settings_update(void);
+bool settings_save_calibration(void);
+bool settings_save_maze(void);
+bool settings_load_maze(void);
+
+#endif /* __SETTINGS_H */
@@ -1,4 +1,24 @@
 #include "setup.h"
+#include "platform.h"
+#include "trace.h"
+
+/* CCM data boundaries, defined in the linker script */
+extern uint32_t _ccm;
+extern uint32_t _eccm;
+
+/**
+ * @brief Zero the CCM data (see `CCM` in `setup.h`).
+ *
+ * The reset handler only initializes `.data` and `.bss`. The stack, at the
+ * top of the CCM, is above `_eccm` and is not affected.
+ */
+static void setup_ccm(void)
+{
+	uint32_t *word;
+
+	for (word = &_ccm; word < &_eccm; word++)
+		*word = 0;
+}
 
 /**
  * @brief Initial clock setup.
@@ -36,15 +56,18 @@ static void setup_clock(void)
 	rcc_periph_clock_enable(RCC_SPI3);
 
 	/* Timers */
+	rcc_periph_clock_enable(RCC_TIM1);
 	rcc_periph_clock_enable(RCC_TIM3);
 	rcc_periph_clock_enable(RCC_TIM4);
 	rcc_periph_clock_enable(RCC_TIM8);
 	rcc_periph_clock_enable(RCC_TIM11);
 
 	/* ADC */
+	rcc_periph_clock_enable(RCC_ADC1);
 	rcc_periph_clock_enable(RCC_ADC2);
 
 	/* DMA */
+	rcc_periph_clock_enable(RCC_DMA1);
 	rcc_periph_clock_enable(RCC_DMA2);
 
 	/* Enable clock cycle counter */
@@ -59,13 +82,21 @@ static void setup_clock(void)
  *
  * Interruptions enabled:
  *
+ * - DMA 1 stream 0 interrupt (MPU burst reads).
+ * - DMA 2 stream 0 interrupt (infrared sensors).
+ * - DMA 2 stream 2 interrupt (serial reception).
+ * - DMA 2 stream 3 interrupt (battery monitor).
  * - DMA 2 stream 7 interrupt.
- * - USART1 interrupt.
+ * - USART1 interrupt (serial reception idle line).
  *
  * @see Programming Manual (PM0214).
  */
 static void setup_exceptions(void)
 {
+	nvic_enable_irq(NVIC_DMA1_STREAM0_IRQ);
+	nvic_enable_irq(NVIC_DMA2_STREAM0_IRQ);
+	nvic_enable_irq(NVIC_DMA2_STREAM2_IRQ);
+	nvic_enable_irq(NVIC_DMA2_STREAM3_IRQ);
 	nvic_enable_irq(NVIC_DMA2_STREAM7_IRQ);
 	nvic_enable_irq(NVIC_USART1_IRQ);
 }
@@ -104,18 +135,60 @@ void disable_systick_interruption(void)
 }
 
 /**
- * @brief Setup for ADC2: configured for regular conversion.
+ * @brief Setup for ADC1: configured for timer-triggered scan conversions.
  *
- * This ADC is used to read the battery status.
+ * This ADC is used to read the infrared receivers.
+ *
+ * - Power off the ADC to be sure that does not run during configuration
+ * - Enable scan mode (convert the four receivers on each trigger)
+ * - Set single conversion mode (wait for the next trigger)
+ * - Configure the alignment (right)
+ * - Configure the sample time (28 cycles of ADC clock)
+ * - Set regular sequence with `channel_sequence` structure
+ * - Trigger conversions on TIM1 channel 1 rising edges
+ * - Issue DMA requests after each conversion, indefinitely
+ * - Power on the ADC
+ *
+ * @see Reference manual (RM0090) "Analog-to-digital converter".
+ */
+static void setup_adc1(void)
+{
+	uint8_t channel_sequence[16];
+
+	channel_sequence[0] = ADC_CHANNEL10;
+	channel_sequence[1] = ADC_CHANNEL11;
+	channel_sequence[2] = ADC_CHANNEL12;
+	channel_sequence[3] = ADC_CHANNEL13;
+	adc_power_off(ADC1);
+	adc_enable_scan_mode(ADC1);
+	adc_set_single_conversion_mode(ADC1);
+	adc_set_right_aligned(ADC1);
+	adc_set_sample_time_on_all_channels(ADC1, ADC_SMPR_SMP_28CYC);
+	adc_set_regular_sequence(ADC1, 4, channel_sequence);
+	adc_enable_external_trigger_regular(ADC1, ADC_CR2_EXTSEL_TIM1_CC1,
+					    ADC_CR2_EXTEN_RISING_EDGE);
+	adc_enable_dma(ADC1);
+	adc_set_dma_continue(ADC1);
+	adc_power_on(ADC1);
+}
+
+/**
+ * @brief Setup for ADC2: configured for continuous conversion with DMA.
+ *
+ * This ADC is used to read the battery status in the background.
  *
  * - Power off the ADC to be sure that does not run during configuration
  * - Disable scan mode
- * - Set single conversion mode triggered by software
+ * - Set continuous conversion mode
  * - Configure the alignment (right)
- * - Configure the sample time (15 cycles of ADC clock)
+ * - Configure the sample time (480 cycles of ADC clock)
  * - Set regular sequence with `channel_sequence` structure
+ * - Issue DMA requests after each conversion, indefinitely
  * - Power on the ADC
  *
+ * Conversions are started with `start_battery_monitor()`, which configures
+ * the DMA stream that collects the results.
+ *
  * @see Reference manual (RM0090) "Analog-to-digital converter".
  */
 static void setup_adc2(void)
@@ -125,10 +198,12 @@ static void setup_adc2(void)
 	channel_sequence[0] = ADC_CHANNEL14;
 	adc_power_off(ADC2);
 	adc_disable_scan_mode(ADC2);
-	adc_set_single_conversion_mode(ADC2);
+	adc_set_continuous_conversion_mode(ADC2);
 	adc_set_right_aligned(ADC2);
-	adc_set_sample_time_on_all_channels(ADC2, ADC_SMPR_SMP_15CYC);
+	adc_set_sample_time_on_all_channels(ADC2, ADC_SMPR_SMP_480CYC);
 	adc_set_regular_sequence(ADC2, 1, channel_sequence);
+	adc_enable_dma(ADC2);
+	adc_set_dma_continue(ADC2);
 	adc_power_on(ADC2);
 }
 
@@ -145,6 +220,10 @@ static void setup_gpio(void)
 	/* Battery */
 	gpio_mode_setup(GPIOC, GPIO_MODE_ANALOG, GPIO_PUPD_NONE, GPIO4);
 
+	/* Infrared receivers */
+	gpio_mode_setup(GPIOC, GPIO_MODE_ANALOG, GPIO_PUPD_NONE,
+			GPIO0 | GPIO1 | GPIO2 | GPIO3);
+
 	/* Infrared emitters */
 	gpio_mode_setup(GPIOA, GPIO_MODE_OUTPUT, GPIO_PUPD_NONE,
 			GPIO4 | GPIO5 | GPIO6 | GPIO7);
@@ -213,6 +292,8 @@ static void setup_usart(void)
  * - Set output compare mode to PWM1 (output is active when the counter is
  *   less than the compare register contents and inactive otherwise.
  * - Reset output compare value (set it to 0).
+ * - Enable output compare preload, so new compare values are applied on the
+ *   next update event (at the end of the PWM period).
  * - Enable channels 1, 2, 3 and 4 outputs.
  * - Enable outputs in the break subsystem (required on an advanced timer).
  * - Enable timer counter.
@@ -239,6 +320,10 @@ static void setup_motor_driver(void)
 	timer_set_oc_value(TIM8, TIM_OC2, 0);
 	timer_set_oc_value(TIM8, TIM_OC3, 0);
 	timer_set_oc_value(TIM8, TIM_OC4, 0);
+	timer_enable_oc_preload(TIM8, TIM_OC1);
+	timer_enable_oc_preload(TIM8, TIM_OC2);
+	timer_enable_oc_preload(TIM8, TIM_OC3);
+	timer_enable_oc_preload(TIM8, TIM_OC4);
 	timer_enable_oc_output(TIM8, TIM_OC1);
 	timer_enable_oc_output(TIM8, TIM_OC2);
 	timer_enable_oc_output(TIM8, TIM_OC3);
@@ -249,6 +334,39 @@ static void setup_motor_driver(void)
 	timer_enable_counter(TIM8);
 }
 
+/**
+ * @brief Setup TIM1 to sequence the infrared sensors acquisition.
+ *
+ * - Count at 1 MHz (APB2 timers are clocked at twice the APB2 frequency),
+ *   with a period of `IR_SLOT_PERIOD_US`.
+ * - Set channel 1 output compare mode to PWM2 with a compare value of
+ *   `IR_SAMPLE_DELAY_US`, so its rising edge triggers the ADC1 conversions
+ *   after the receivers settle.
+ * - Enable channel 1 and the main output (required for the trigger on an
+ *   advanced timer; the pin is not mapped to the timer).
+ * - Issue DMA requests on update events, which switch the emitters.
+ *
+ * The counter is enabled with `start_ir_sensors()`.
+ *
+ * @see Reference manual (RM0090) "Advanced-control timers (TIM1 and TIM8)".
+ */
+static void setup_ir_timer(void)
+{
+	timer_set_mode(TIM1, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE,
+		       TIM_CR1_DIR_UP);
+	timer_set_prescaler(TIM1, (rcc_apb2_frequency * 2 / 1000000 - 1));
+	timer_set_repetition_counter(TIM1, 0);
+	timer_continuous_mode(TIM1);
+	timer_set_period(TIM1, IR_SLOT_PERIOD_US - 1);
+
+	timer_set_oc_mode(TIM1, TIM_OC1, TIM_OCM_PWM2);
+	timer_set_oc_value(TIM1, TIM_OC1, IR_SAMPLE_DELAY_US);
+	timer_enable_oc_output(TIM1, TIM_OC1);
+	timer_enable_break_main_output(TIM1);
+
+	timer_enable_irq(TIM1, TIM_DIER_UDE);
+}
+
 /**
  * @brief Configure timer to read a quadrature encoder.
  *
@@ -367,6 +485,8 @@ static void setup_speaker(void)
  */
 void setup(void)
 {
+	setup_ccm();
+	trace_init();
 	setup_clock();
 	setup_exceptions();
 	setup_gpio();
@@ -374,7 +494,10 @@ void setup(void)
 	setup_motor_driver();
 	setup_encoders();
 	setup_usart();
+	setup_ir_timer();
+	setup_adc1();
 	setup_adc2();
+	start_battery_monitor();
 	setup_mpu();
 	setup_systick();
 }
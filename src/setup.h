@@ -19,6 +19,33 @@
 
 #include "mylibopencm3.h"
 
+/**
+ * Memory placement (see `stm32f405xg.ld`).
+ *
+ * - RAMFUNC: code copied to SRAM at startup, which runs without flash wait
+ *   states nor ART accelerator misses. Used for the interrupt handlers and
+ *   the control loop hot path.
+ * - CCM: zero-initialized data in the core-coupled memory, which the CPU
+ *   accesses without contention with DMA transfers. Never for DMA buffers.
+ *
+ * Build with `MEMORY_PLACEMENT=0` to keep everything in flash and SRAM, in
+ * order to compare the profiling results.
+ */
+#ifdef NO_MEMORY_PLACEMENT
+#define RAMFUNC
+#define CCM
+#else
+#define RAMFUNC __attribute__((section(".ramfunc")))
+#define CCM __attribute__((section(".ccm")))
+#endif
+
+/**
+ * Data in SRAM that is neither initialized nor zeroed at startup, so it is
+ * kept across resets (but not across power cycles). Its users must check
+ * whether it is valid.
+ */
+#define NOINIT __attribute__((section(".noinit")))
+
 /** Universal constants */
 #define MICROMETERS_PER_METER 1000000
 #define MICROSECONDS_PER_SECOND 1000000
@@ -44,10 +71,27 @@
  *
  * After reaching this period we consider there has been a collision. When a
  * collision occurs, the robot motor control stops working and the motor driver
- * is disabled.
+ * is disabled. This is the default, it can be tuned at runtime (see
+ * `parameters.h`).
  */
 #define MAX_PWM_SATURATION_PERIOD 0.01
 
+/** Locomotion geometry */
+#define ENCODER_COUNTS_PER_MOTOR_REVOLUTION 2048
+#define MOTOR_GEAR_RATIO 4
+#define WHEEL_RADIUS_MICROMETERS 12500
+#define WHEELS_SEPARATION_MICROMETERS 70000
+
+/**
+ * Infrared sensors acquisition timing.
+ *
+ * Each sensor is lit for a slot of `IR_SLOT_PERIOD_US`, and sampled
+ * `IR_SAMPLE_DELAY_US` after the slot starts. An extra slot with all the
+ * emitters off is used to sample the ambient light.
+ */
+#define IR_SLOT_PERIOD_US 50
+#define IR_SAMPLE_DELAY_US 30
+
 /** ADC constants */
 #define ADC_RESOLUTION 4096
 #define ADC_LSB (3.3 / ADC_RESOLUTION)
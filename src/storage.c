@@ -0,0 +1,309 @@
+#include "storage.h"
+
+#define SECTOR_MAGIC 0x31564B4D
+#define ERASED_KEY 0xFFFF
+#define CRC32_INIT 0xFFFFFFFF
+
+/**
+ * Sector header, written last when a sector is activated. The active sector
+ * is the valid one with the highest sequence number.
+ */
+struct sector_header {
+	uint32_t magic;
+	uint32_t sequence;
+};
+
+/**
+ * Record header, followed by the data padded to a whole number of words.
+ * The CRC covers the key, the size and the data.
+ */
+struct record_header {
+	uint16_t key;
+	uint16_t size;
+	uint32_t crc;
+};
+
+static uint8_t active = STORAGE_SECTORS;
+static uint32_t sequence;
+static uint32_t write_offset;
+static uint32_t records[STORAGE_MAX_KEYS];
+
+/** CRC-32 (polynomial 0xEDB88320, reflected) lookup table, per nibble */
+static const uint32_t crc32_table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+    0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t size)
+{
+	while (size--) {
+		crc ^= *data++;
+		crc = (crc >> 4) ^ crc32_table[crc & 0x0F];
+		crc = (crc >> 4) ^ crc32_table[crc & 0x0F];
+	}
+	return crc;
+}
+
+static uint32_t record_crc(uint16_t key, uint16_t size, const void *data)
+{
+	uint32_t crc = CRC32_INIT;
+
+	crc = crc32_update(crc, (const uint8_t *)&key, sizeof(key));
+	crc = crc32_update(crc, (const uint8_t *)&size, sizeof(size));
+	return ~crc32_update(crc, data, size);
+}
+
+static uint32_t sector_address(uint8_t sector)
+{
+	return STORAGE_ADDRESS + sector * STORAGE_SECTOR_SIZE;
+}
+
+static const void *flash_pointer(uint8_t sector, uint32_t offset)
+{
+	return (const void *)&MMIO8(sector_address(sector) + offset);
+}
+
+static uint32_t record_size(uint16_t size)
+{
+	return sizeof(struct record_header) + ((size + 3) & ~3u);
+}
+
+static bool valid_header(const struct record_header *header, uint32_t offset)
+{
+	return header->key && header->key < STORAGE_MAX_KEYS &&
+	       header->size <= STORAGE_RECORD_MAX_SIZE &&
+	       offset + record_size(header->size) <= STORAGE_SECTOR_SIZE;
+}
+
+static bool valid_record(uint8_t sector, uint32_t offset)
+{
+	const struct record_header *header = flash_pointer(sector, offset);
+
+	return header->crc ==
+	       record_crc(header->key, header->size, header + 1);
+}
+
+/**
+ * @brief Find the last valid record of a key before a given offset.
+ *
+ * Only used when the latest record of a key is corrupted (i.e.: power was
+ * lost while it was being written).
+ */
+static uint32_t find_valid_record(uint8_t sector, uint16_t key,
+				  uint32_t limit)
+{
+	const struct record_header *header;
+	uint32_t offset;
+	uint32_t found = 0;
+
+	for (offset = sizeof(struct sector_header); offset < limit;
+	     offset += record_size(header->size)) {
+		header = flash_pointer(sector, offset);
+		if (header->key == key && valid_record(sector, offset))
+			found = offset;
+	}
+	return found;
+}
+
+/**
+ * @brief Index the latest record of each key in the active sector.
+ *
+ * Only headers are walked, and only the latest record of each key is
+ * validated, so the time taken does not depend on the data stored. If the
+ * log ends with a corrupted header, the sector is considered full, so that
+ * the next write compacts it.
+ */
+static void index_records(void)
+{
+	const struct record_header *header;
+	uint32_t offset;
+	uint16_t key;
+
+	memset(records, 0, sizeof(records));
+	for (offset = sizeof(struct sector_header);
+	     offset + sizeof(struct record_header) <= STORAGE_SECTOR_SIZE;
+	     offset += record_size(header->size)) {
+		header = flash_pointer(active, offset);
+		if (header->key == ERASED_KEY)
+			break;
+		if (!valid_header(header, offset)) {
+			offset = STORAGE_SECTOR_SIZE;
+			break;
+		}
+		records[header->key] = offset;
+	}
+	write_offset = offset;
+
+	for (key = 1; key < STORAGE_MAX_KEYS; key++)
+		if (records[key] && !valid_record(active, records[key]))
+			records[key] =
+			    find_valid_record(active, key, records[key]);
+}
+
+static void erase_sector(uint8_t sector)
+{
+	flash_unlock();
+	flash_erase_sector(STORAGE_FIRST_SECTOR + sector,
+			   FLASH_CR_PROGRAM_X32);
+	flash_lock();
+	flash_dcache_disable();
+	flash_dcache_reset();
+	flash_dcache_enable();
+}
+
+static void program(uint8_t sector, uint32_t offset, const void *data,
+		    uint32_t size)
+{
+	const uint8_t *bytes = data;
+	uint32_t word;
+	uint32_t i;
+
+	flash_unlock();
+	for (i = 0; i < size; i += sizeof(word)) {
+		word = 0xFFFFFFFF;
+		memcpy(&word, bytes + i,
+		       size - i < sizeof(word) ? size - i : sizeof(word));
+		flash_program_word(sector_address(sector) + offset + i, word);
+	}
+	flash_lock();
+}
+
+static void append(uint16_t key, const void *data, uint16_t size)
+{
+	struct record_header header = {
+	    .key = key, .size = size, .crc = record_crc(key, size, data)};
+
+	program(active, write_offset, &header, sizeof(header));
+	program(active, write_offset + sizeof(header), data, size);
+	records[key] = write_offset;
+	write_offset += record_size(size);
+}
+
+/**
+ * @brief Activate the other sector, keeping the latest record of each key.
+ *
+ * The new sector header is written after all records have been copied, so
+ * that the previous sector remains the active one if power is lost.
+ */
+static void compact(void)
+{
+	const struct record_header *header;
+	struct sector_header sector_header;
+	uint8_t previous = active;
+	uint32_t previous_records[STORAGE_MAX_KEYS];
+	uint16_t key;
+
+	memcpy(previous_records, records, sizeof(records));
+	active = (uint8_t)((previous + 1) % STORAGE_SECTORS);
+	erase_sector(active);
+	write_offset = sizeof(struct sector_header);
+	memset(records, 0, sizeof(records));
+	for (key = 1; key < STORAGE_MAX_KEYS; key++) {
+		if (!previous_records[key])
+			continue;
+		header = flash_pointer(previous, previous_records[key]);
+		append(key, header + 1, header->size);
+	}
+	sector_header.magic = SECTOR_MAGIC;
+	sector_header.sequence = ++sequence;
+	program(active, 0, &sector_header, sizeof(sector_header));
+}
+
+/**
+ * @brief Find the active sector and index its records.
+ */
+void storage_init(void)
+{
+	const struct sector_header *header;
+	uint8_t sector;
+
+	active = STORAGE_SECTORS;
+	sequence = 0;
+	for (sector = 0; sector < STORAGE_SECTORS; sector++) {
+		header = flash_pointer(sector, 0);
+		if (header->magic != SECTOR_MAGIC)
+			continue;
+		if (active == STORAGE_SECTORS || header->sequence > sequence) {
+			active = sector;
+			sequence = header->sequence;
+		}
+	}
+	if (active == STORAGE_SECTORS) {
+		memset(records, 0, sizeof(records));
+		write_offset = STORAGE_SECTOR_SIZE;
+		return;
+	}
+	index_records();
+}
+
+/**
+ * @brief Read the latest value stored for a key.
+ *
+ * @param[in] key Record key.
+ * @param[out] data Buffer to copy the value to.
+ * @param[in] size Expected value size.
+ *
+ * @return Whether a valid value with the expected size was found.
+ */
+bool storage_read(enum storage_key key, void *data, uint16_t size)
+{
+	const struct record_header *header;
+
+	if (active == STORAGE_SECTORS || key >= STORAGE_MAX_KEYS ||
+	    !records[key])
+		return false;
+	header = flash_pointer(active, records[key]);
+	if (header->size != size)
+		return false;
+	memcpy(data, header + 1, size);
+	return true;
+}
+
+/**
+ * @brief Store a new value for a key.
+ *
+ * Values are appended to the active sector, which is compacted when full
+ * (see `compact()`). Erasing a sector stalls the CPU (including interrupts)
+ * for up to a couple of seconds, so values must only be stored while the
+ * robot is stopped.
+ *
+ * @param[in] key Record key.
+ * @param[in] data Value to store.
+ * @param[in] size Value size, up to STORAGE_RECORD_MAX_SIZE.
+ *
+ * @return Whether the value could be stored.
+ */
+bool storage_write(enum storage_key key, const void *data, uint16_t size)
+{
+	if (!key || key >= STORAGE_MAX_KEYS || size > STORAGE_RECORD_MAX_SIZE)
+		return false;
+	if (write_offset + record_size(size) > STORAGE_SECTOR_SIZE)
+		compact();
+	if (write_offset + record_size(size) > STORAGE_SECTOR_SIZE)
+		return false;
+	append(key, data, size);
+	return true;
+}
+
+/**
+ * @brief Erase all stored values.
+ */
+void storage_format(void)
+{
+	uint8_t sector;
+
+	for (sector = 0; sector < STORAGE_SECTORS; sector++)
+		erase_sector(sector);
+	storage_init();
+}
+
+/**
+ * @brief Return the bytes used in the active sector.
+ */
+uint32_t storage_used(void)
+{
+	if (active == STORAGE_SECTORS)
+		return 0;
+	return write_offset;
+}
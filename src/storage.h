@@ -0,0 +1,47 @@
+#ifndef __STORAGE_H
+#define __STORAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/flash.h>
+
+/**
+ * Flash sectors reserved for the store (see `stm32f405xg.ld`).
+ *
+ * Sectors 10 and 11 (128 KiB each) are used alternately: records are
+ * appended to the active sector and, when it is full, the latest record of
+ * each key is copied to the other one, which becomes the active sector.
+ */
+#define STORAGE_FIRST_SECTOR 10
+#define STORAGE_SECTORS 2
+#define STORAGE_ADDRESS 0x080C0000
+#define STORAGE_SECTOR_SIZE (128 * 1024)
+
+#define STORAGE_MAX_KEYS 32
+#define STORAGE_RECORD_MAX_SIZE 1024
+
+/**
+ * Record keys.
+ *
+ * Values are stored in flash, so keys must never be renumbered nor reused.
+ * Key 4 held the speed controller gains, which are now stored with the other
+ * runtime parameters under `STORAGE_PARAMETERS`.
+ */
+enum storage_key {
+	STORAGE_GYRO_BIAS = 1,
+	STORAGE_IR_CALIBRATION = 2,
+	STORAGE_BATTERY_CALIBRATION = 3,
+	STORAGE_MAZE_WALLS = 5,
+	STORAGE_PARAMETERS = 6,
+};
+
+void storage_init(void);
+bool storage_read(enum storage_key key, void *data, uint16_t size);
+bool storage_write(enum storage_key key, const void *data, uint16_t size);
+void storage_format(void);
+uint32_t storage_used(void);
+
+#endif /* __STORAGE_H */
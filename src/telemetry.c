@@ -0,0 +1,235 @@
+#include "telemetry.h"
+#include "profile.h"
+
+#define CRC16_INIT 0xFFFF
+#define COBS_DELIMITER 0x00
+
+/** Type, record and CRC, plus COBS overhead and delimiter */
+#define TELEMETRY_MAX_FRAME_SIZE (1 + TELEMETRY_MAX_RECORD_SIZE + 2 + 2)
+
+_Static_assert(sizeof(struct telemetry_state) <= TELEMETRY_MAX_RECORD_SIZE,
+	       "State record too large");
+_Static_assert(sizeof(struct telemetry_profile) <= TELEMETRY_MAX_RECORD_SIZE,
+	       "Profile record too large");
+_Static_assert(sizeof(struct telemetry_sensors) <= TELEMETRY_MAX_RECORD_SIZE,
+	       "Sensors record too large");
+
+/**
+ * State streaming: SysTick periods between `STATE` records (zero when
+ * stopped) and periods elapsed since the last one.
+ */
+static volatile uint16_t state_period;
+static uint16_t state_ticks;
+
+/** CRC-16/CCITT-FALSE lookup table (polynomial 0x1021) */
+static const uint16_t crc16_table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7, 0x8108,
+    0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF, 0x1231, 0x0210,
+    0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6, 0x9339, 0x8318, 0xB37B,
+    0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE, 0x2462, 0x3443, 0x0420, 0x1401,
+    0x64E6, 0x74C7, 0x44A4, 0x5485, 0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE,
+    0xF5CF, 0xC5AC, 0xD58D, 0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6,
+    0x5695, 0x46B4, 0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D,
+    0xC7BC, 0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B, 0x5AF5,
+    0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12, 0xDBFD, 0xCBDC,
+    0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A, 0x6CA6, 0x7C87, 0x4CE4,
+    0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41, 0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD,
+    0xAD2A, 0xBD0B, 0x8D68, 0x9D49, 0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13,
+    0x2E32, 0x1E51, 0x0E70, 0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A,
+    0x9F59, 0x8F78, 0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E,
+    0xE16F, 0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E, 0x02B1,
+    0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256, 0xB5EA, 0xA5CB,
+    0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D, 0x34E2, 0x24C3, 0x14A0,
+    0x0481, 0x7466, 0x6447, 0x5424, 0x4405, 0xA7DB, 0xB7FA, 0x8799, 0x97B8,
+    0xE75F, 0xF77E, 0xC71D, 0xD73C, 0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657,
+    0x7676, 0x4615, 0x5634, 0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9,
+    0xB98A, 0xA9AB, 0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882,
+    0x28A3, 0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92, 0xFD2E,
+    0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9, 0x7C26, 0x6C07,
+    0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1, 0xEF1F, 0xFF3E, 0xCF5D,
+    0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8, 0x6E17, 0x7E36, 0x4E55, 0x5E74,
+    0x2E93, 0x3EB2, 0x0ED1, 0x1EF0,
+};
+
+static uint16_t crc16_update(uint16_t crc, const uint8_t *data, uint16_t size)
+{
+	while (size--)
+		crc = (crc << 8) ^ crc16_table[(crc >> 8) ^ *data++];
+	return crc;
+}
+
+/**
+ * @brief Consistent Overhead Byte Stuffing (COBS) encoding.
+ *
+ * Replaces all zeros in the input so that a zero can be used as frame
+ * delimiter. Input must be shorter than 254 bytes (a single COBS block).
+ *
+ * @param[in] input Data to encode.
+ * @param[in] size Number of bytes to encode.
+ * @param[out] output Encoded data (at least `size + 1` bytes long).
+ *
+ * @return The number of bytes written to `output`.
+ */
+static uint8_t cobs_encode(const uint8_t *input, uint8_t size, uint8_t *output)
+{
+	uint8_t code_index = 0;
+	uint8_t code = 1;
+	uint8_t index = 1;
+
+	while (size--) {
+		if (*input) {
+			output[index++] = *input;
+			code++;
+		} else {
+			output[code_index] = code;
+			code_index = index++;
+			code = 1;
+		}
+		input++;
+	}
+	output[code_index] = code;
+	return index;
+}
+
+/**
+ * @brief Consistent Overhead Byte Stuffing (COBS) decoding, in place.
+ *
+ * @param[in,out] frame Encoded data (without the delimiter), replaced by the
+ * decoded data.
+ * @param[in] size Number of bytes to decode.
+ *
+ * @return The number of decoded bytes, or zero if the encoding is invalid.
+ */
+static uint16_t cobs_decode(uint8_t *frame, uint16_t size)
+{
+	uint16_t index = 0;
+	uint16_t length = 0;
+	uint8_t code;
+
+	while (index < size) {
+		code = frame[index];
+		if (!code || index + code > size)
+			return 0;
+		memmove(&frame[length], &frame[index + 1], code - 1);
+		length += code - 1;
+		index += code;
+		if (code < 0xFF && index < size)
+			frame[length++] = 0;
+	}
+	return length;
+}
+
+/**
+ * @brief Send a telemetry record through serial.
+ *
+ * The record is framed (see `TELEMETRY_RECORDS`) and queued for transmission
+ * without any text formatting. It may be called from interruption routines.
+ *
+ * @param[in] type Record type.
+ * @param[in] record Record data (a packed structure).
+ * @param[in] size Record size.
+ *
+ * @return Whether the frame was queued or not.
+ */
+bool telemetry_send(enum telemetry_record type, const void *record,
+		    uint8_t size)
+{
+	uint8_t raw[1 + TELEMETRY_MAX_RECORD_SIZE + 2];
+	uint8_t frame[TELEMETRY_MAX_FRAME_SIZE];
+	uint16_t crc;
+	uint8_t length;
+
+	if (size > TELEMETRY_MAX_RECORD_SIZE)
+		return false;
+	raw[0] = type;
+	memcpy(&raw[1], record, size);
+	crc = crc16_update(CRC16_INIT, raw, size + 1);
+	raw[size + 1] = crc & 0xFF;
+	raw[size + 2] = crc >> 8;
+	length = cobs_encode(raw, size + 3, frame);
+	frame[length++] = COBS_DELIMITER;
+	return serial_send((char *)frame, length);
+}
+
+/**
+ * @brief Decode a received frame in place and check its CRC.
+ *
+ * @param[in,out] frame Received frame, without the delimiter (see
+ * `serial_receive()`). On success, it starts with the record type, followed
+ * by the record fields.
+ * @param[in] size Received frame size.
+ *
+ * @return The record type and fields size, or zero if the frame is invalid.
+ */
+uint16_t telemetry_decode(uint8_t *frame, uint16_t size)
+{
+	uint16_t length = cobs_decode(frame, size);
+	uint16_t crc;
+
+	if (length < 3)
+		return 0;
+	length -= 2;
+	crc = (uint16_t)(frame[length] | frame[length + 1] << 8);
+	if (crc16_update(CRC16_INIT, frame, length) != crc)
+		return 0;
+	return length;
+}
+
+/**
+ * @brief Sample the robot state and send it as a telemetry record.
+ *
+ * The gyroscope is not read again: the record carries the last sample read
+ * from the FIFO by `gyro_update()` in the same SysTick period.
+ *
+ * @return Whether the frame was queued or not.
+ */
+bool telemetry_send_state(void)
+{
+	struct telemetry_state state;
+	bool sent;
+
+	PROFILE_BEGIN(PROFILE_TELEMETRY);
+	state.cycles = read_cycle_counter();
+	state.ticks = get_clock_ticks();
+	state.encoder_left = read_encoder_left();
+	state.encoder_right = read_encoder_right();
+	state.gyro_z = gyro_get_last_sample();
+	state.battery_millivolts = get_battery_millivolts();
+	state.pwm_left = (int16_t)get_power_left();
+	state.pwm_right = (int16_t)get_power_right();
+	sent = telemetry_send(TELEMETRY_STATE, &state, sizeof(state));
+	PROFILE_END(PROFILE_TELEMETRY);
+	return sent;
+}
+
+/**
+ * @brief Start streaming the robot state, or stop it.
+ *
+ * Records are sent from the SysTick telemetry task, so the highest rate is
+ * one record per period (`SYSTICK_FREQUENCY_HZ`).
+ *
+ * @param[in] period SysTick periods between `STATE` records, or zero to stop.
+ */
+void telemetry_set_state_period(uint16_t period)
+{
+	state_ticks = 0;
+	state_period = period;
+}
+
+/**
+ * @brief Send a `STATE` record every streaming period.
+ *
+ * To be called once per SysTick period (see `telemetry_set_state_period()`).
+ * Records that do not fit in the transmission queue are dropped, and
+ * accounted as serial overflows.
+ */
+void telemetry_update(void)
+{
+	if (!state_period || ++state_ticks < state_period)
+		return;
+	state_ticks = 0;
+	telemetry_send_state();
+}
@@ -0,0 +1,331 @@
+#ifndef __TELEMETRY_H
+#define __TELEMETRY_H
+
+#include <stdint.h>
+
+#include "mmlib/clock.h"
+
+#include "gyro.h"
+#include "motor.h"
+#include "platform.h"
+#include "serial.h"
+
+/**
+ * Telemetry records schema.
+ *
+ * This is the single definition of the binary records layout. It is shared
+ * with the host decoder (`scripts/telemetry.py`), which parses this file, so
+ * keep the `RECORD(NAME, ID)`, `FIELD(TYPE, NAME)` and `ARRAY(TYPE, NAME,
+ * LENGTH)` lists one entry per line. Fields are little-endian and packed, in
+ * the listed order.
+ *
+ * Each frame on the wire is the COBS encoding of the record type, the record
+ * fields and a CRC-16/CCITT-FALSE of both, followed by a zero delimiter.
+ *
+ * Records from `TELEMETRY_FIRST_COMMAND` on are commands, sent to the robot
+ * with the same framing (see `command.c`).
+ */
+#define TELEMETRY_SCHEMA_VERSION 14
+
+#define TELEMETRY_FIRST_COMMAND 0x80
+
+#define TELEMETRY_RECORDS(RECORD)                                              \
+	RECORD(STATE, 0x01)                                                    \
+	RECORD(PROFILE, 0x02)                                                  \
+	RECORD(RECORDER_START, 0x03)                                           \
+	RECORD(SENSORS, 0x04)                                                  \
+	RECORD(COMMAND_ACK, 0x05)                                              \
+	RECORD(PARAMETER, 0x06)                                                \
+	RECORD(TRACE_INFO, 0x07)                                               \
+	RECORD(TRACE_EVENTS, 0x08)                                             \
+	RECORD(TASK_STATS, 0x09)                                               \
+	RECORD(RECORDER_MAZE, 0x0A)                                            \
+	RECORD(RECORDER_COMMAND, 0x0B)                                         \
+	RECORD(START, 0x80)                                                    \
+	RECORD(STOP, 0x81)                                                     \
+	RECORD(MAZE_ROW, 0x82)                                                 \
+	RECORD(PARAMETER_GET, 0x83)                                            \
+	RECORD(PARAMETER_SET, 0x84)                                            \
+	RECORD(PARAMETER_COMMIT, 0x85)                                         \
+	RECORD(TRACE_DUMP, 0x86)                                               \
+	RECORD(STATE_STREAM, 0x87)                                             \
+	RECORD(PROFILE_DUMP, 0x88)                                             \
+	RECORD(PROFILE_RESET, 0x89)                                            \
+	RECORD(TASK_STATS_DUMP, 0x8A)                                          \
+	RECORD(BENCHMARK, 0x8B)                                                \
+	RECORD(COLLISION_RESET, 0x8C)                                          \
+	RECORD(RECORDER, 0x8D)                                                 \
+	RECORD(MAZE_SAVE, 0x8E)                                                \
+	RECORD(CALIBRATION_SAVE, 0x8F)
+
+#define TELEMETRY_STATE_FIELDS(FIELD, ARRAY)                                   \
+	FIELD(uint32_t, cycles)                                                \
+	FIELD(uint32_t, ticks)                                                 \
+	FIELD(uint16_t, encoder_left)                                          \
+	FIELD(uint16_t, encoder_right)                                         \
+	FIELD(int16_t, gyro_z)                                                 \
+	FIELD(uint16_t, battery_millivolts)                                    \
+	FIELD(int16_t, pwm_left)                                               \
+	FIELD(int16_t, pwm_right)
+
+#define TELEMETRY_PROFILE_FIELDS(FIELD, ARRAY)                                 \
+	FIELD(uint8_t, zone)                                                   \
+	FIELD(uint32_t, count)                                                 \
+	FIELD(uint32_t, min)                                                   \
+	FIELD(uint32_t, max)                                                   \
+	FIELD(uint64_t, total)                                                 \
+	ARRAY(uint32_t, histogram, 32)
+
+#define TELEMETRY_RECORDER_START_FIELDS(FIELD, ARRAY)                         \
+	FIELD(uint8_t, schema_version)                                         \
+	FIELD(uint32_t, ticks)                                                 \
+	FIELD(uint16_t, encoder_left)                                          \
+	FIELD(uint16_t, encoder_right)                                         \
+	FIELD(int32_t, gyro_bias)                                              \
+	FIELD(uint8_t, gyro_calibrated)                                        \
+	FIELD(uint8_t, maze_size)                                              \
+	ARRAY(float, parameters, 13)
+
+#define TELEMETRY_SENSORS_FIELDS(FIELD, ARRAY)                                 \
+	FIELD(uint32_t, cycles)                                                \
+	FIELD(uint32_t, ticks)                                                 \
+	FIELD(uint16_t, encoder_left)                                          \
+	FIELD(uint16_t, encoder_right)                                         \
+	FIELD(uint16_t, battery_millivolts)                                    \
+	FIELD(uint16_t, ir_sequence)                                           \
+	ARRAY(uint16_t, ir, 4)                                                 \
+	FIELD(uint16_t, gyro_fifo_count)                                       \
+	FIELD(uint8_t, gyro_samples)                                           \
+	ARRAY(int16_t, gyro, 16)
+
+#define TELEMETRY_RECORDER_MAZE_FIELDS(FIELD, ARRAY)                          \
+	FIELD(uint16_t, offset)                                                \
+	ARRAY(uint8_t, walls, 128)
+
+#define TELEMETRY_RECORDER_COMMAND_FIELDS(FIELD, ARRAY)                       \
+	FIELD(uint32_t, ticks)                                                 \
+	FIELD(uint8_t, type)                                                   \
+	FIELD(uint8_t, size)                                                   \
+	ARRAY(uint8_t, data, 40)
+
+#define TELEMETRY_COMMAND_ACK_FIELDS(FIELD, ARRAY)                            \
+	FIELD(uint8_t, command)                                                \
+	FIELD(uint8_t, status)
+
+#define TELEMETRY_PARAMETER_FIELDS(FIELD, ARRAY)                              \
+	FIELD(uint8_t, id)                                                     \
+	FIELD(uint8_t, type)                                                   \
+	FIELD(uint8_t, when)                                                   \
+	FIELD(float, value)                                                    \
+	FIELD(float, min)                                                      \
+	FIELD(float, max)                                                      \
+	FIELD(float, default_value)
+
+#define TELEMETRY_TRACE_INFO_FIELDS(FIELD, ARRAY)                             \
+	FIELD(uint16_t, count)                                                 \
+	FIELD(uint32_t, frequency)
+
+#define TELEMETRY_TRACE_EVENTS_FIELDS(FIELD, ARRAY)                           \
+	FIELD(uint16_t, offset)                                                \
+	FIELD(uint8_t, count)                                                  \
+	ARRAY(uint32_t, cycles, 16)                                            \
+	ARRAY(uint8_t, type, 16)                                               \
+	ARRAY(uint8_t, id, 16)                                                 \
+	ARRAY(uint16_t, value, 16)
+
+#define TELEMETRY_TASK_STATS_FIELDS(FIELD, ARRAY)                             \
+	FIELD(uint8_t, task)                                                   \
+	FIELD(uint16_t, load)                                                  \
+	FIELD(uint32_t, runs)                                                  \
+	FIELD(uint32_t, overruns)                                              \
+	FIELD(uint32_t, last)                                                  \
+	FIELD(uint32_t, wcet)                                                  \
+	FIELD(uint64_t, total)
+
+#define TELEMETRY_START_FIELDS(FIELD, ARRAY) FIELD(uint8_t, diagonals)
+
+#define TELEMETRY_STOP_FIELDS(FIELD, ARRAY) FIELD(uint8_t, brake)
+
+#define TELEMETRY_MAZE_ROW_FIELDS(FIELD, ARRAY)                                \
+	FIELD(uint8_t, size)                                                   \
+	FIELD(uint8_t, row)                                                    \
+	ARRAY(uint8_t, walls, 32)
+
+#define TELEMETRY_PARAMETER_GET_FIELDS(FIELD, ARRAY) FIELD(uint8_t, id)
+
+#define TELEMETRY_PARAMETER_SET_FIELDS(FIELD, ARRAY)                          \
+	FIELD(uint8_t, id)                                                     \
+	FIELD(float, value)                                                    \
+	FIELD(uint8_t, apply)
+
+#define TELEMETRY_PARAMETER_COMMIT_FIELDS(FIELD, ARRAY)                       \
+	FIELD(uint8_t, defaults)
+
+#define TELEMETRY_TRACE_DUMP_FIELDS(FIELD, ARRAY) FIELD(uint8_t, resume)
+
+#define TELEMETRY_STATE_STREAM_FIELDS(FIELD, ARRAY) FIELD(uint16_t, period)
+
+#define TELEMETRY_PROFILE_DUMP_FIELDS(FIELD, ARRAY) FIELD(uint8_t, reset)
+
+#define TELEMETRY_PROFILE_RESET_FIELDS(FIELD, ARRAY)
+
+#define TELEMETRY_TASK_STATS_DUMP_FIELDS(FIELD, ARRAY) FIELD(uint8_t, reset)
+
+#define TELEMETRY_BENCHMARK_FIELDS(FIELD, ARRAY) FIELD(uint8_t, test)
+
+#define TELEMETRY_COLLISION_RESET_FIELDS(FIELD, ARRAY)
+
+#define TELEMETRY_RECORDER_FIELDS(FIELD, ARRAY) FIELD(uint8_t, start)
+
+#define TELEMETRY_MAZE_SAVE_FIELDS(FIELD, ARRAY)
+
+#define TELEMETRY_CALIBRATION_SAVE_FIELDS(FIELD, ARRAY)
+
+/** Maximum record size (a single COBS block) */
+#define TELEMETRY_MAX_RECORD_SIZE 250
+
+#define TELEMETRY_STRUCT_FIELD(type, name) type name;
+#define TELEMETRY_STRUCT_ARRAY(type, name, length) type name[length];
+
+#define TELEMETRY_RECORD_ID(name, id) TELEMETRY_##name = id,
+
+enum telemetry_record { TELEMETRY_RECORDS(TELEMETRY_RECORD_ID) };
+
+struct __attribute__((packed)) telemetry_state {
+	TELEMETRY_STATE_FIELDS(TELEMETRY_STRUCT_FIELD, TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_profile {
+	TELEMETRY_PROFILE_FIELDS(TELEMETRY_STRUCT_FIELD, TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_recorder_start {
+	TELEMETRY_RECORDER_START_FIELDS(TELEMETRY_STRUCT_FIELD,
+					TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_sensors {
+	TELEMETRY_SENSORS_FIELDS(TELEMETRY_STRUCT_FIELD, TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_recorder_maze {
+	TELEMETRY_RECORDER_MAZE_FIELDS(TELEMETRY_STRUCT_FIELD,
+				       TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_recorder_command {
+	TELEMETRY_RECORDER_COMMAND_FIELDS(TELEMETRY_STRUCT_FIELD,
+					  TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_command_ack {
+	TELEMETRY_COMMAND_ACK_FIELDS(TELEMETRY_STRUCT_FIELD,
+				     TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_parameter {
+	TELEMETRY_PARAMETER_FIELDS(TELEMETRY_STRUCT_FIELD,
+				   TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_trace_info {
+	TELEMETRY_TRACE_INFO_FIELDS(TELEMETRY_STRUCT_FIELD,
+				    TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_trace_events {
+	TELEMETRY_TRACE_EVENTS_FIELDS(TELEMETRY_STRUCT_FIELD,
+				      TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_task_stats {
+	TELEMETRY_TASK_STATS_FIELDS(TELEMETRY_STRUCT_FIELD,
+				    TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_start {
+	TELEMETRY_START_FIELDS(TELEMETRY_STRUCT_FIELD, TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_stop {
+	TELEMETRY_STOP_FIELDS(TELEMETRY_STRUCT_FIELD, TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_maze_row {
+	TELEMETRY_MAZE_ROW_FIELDS(TELEMETRY_STRUCT_FIELD,
+				  TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_parameter_get {
+	TELEMETRY_PARAMETER_GET_FIELDS(TELEMETRY_STRUCT_FIELD,
+				       TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_parameter_set {
+	TELEMETRY_PARAMETER_SET_FIELDS(TELEMETRY_STRUCT_FIELD,
+				       TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_parameter_commit {
+	TELEMETRY_PARAMETER_COMMIT_FIELDS(TELEMETRY_STRUCT_FIELD,
+					  TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_trace_dump {
+	TELEMETRY_TRACE_DUMP_FIELDS(TELEMETRY_STRUCT_FIELD,
+				    TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_state_stream {
+	TELEMETRY_STATE_STREAM_FIELDS(TELEMETRY_STRUCT_FIELD,
+				      TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_profile_dump {
+	TELEMETRY_PROFILE_DUMP_FIELDS(TELEMETRY_STRUCT_FIELD,
+				      TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_profile_reset {
+	TELEMETRY_PROFILE_RESET_FIELDS(TELEMETRY_STRUCT_FIELD,
+				       TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_task_stats_dump {
+	TELEMETRY_TASK_STATS_DUMP_FIELDS(TELEMETRY_STRUCT_FIELD,
+					 TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_benchmark {
+	TELEMETRY_BENCHMARK_FIELDS(TELEMETRY_STRUCT_FIELD,
+				   TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_collision_reset {
+	TELEMETRY_COLLISION_RESET_FIELDS(TELEMETRY_STRUCT_FIELD,
+					 TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_recorder {
+	TELEMETRY_RECORDER_FIELDS(TELEMETRY_STRUCT_FIELD,
+				  TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_maze_save {
+	TELEMETRY_MAZE_SAVE_FIELDS(TELEMETRY_STRUCT_FIELD,
+				   TELEMETRY_STRUCT_ARRAY)
+};
+
+struct __attribute__((packed)) telemetry_calibration_save {
+	TELEMETRY_CALIBRATION_SAVE_FIELDS(TELEMETRY_STRUCT_FIELD,
+					  TELEMETRY_STRUCT_ARRAY)
+};
+
+bool telemetry_send(enum telemetry_record type, const void *record,
+		    uint8_t size);
+uint16_t telemetry_decode(uint8_t *frame, uint16_t size);
+bool telemetry_send_state(void);
+void telemetry_set_state_period(uint16_t period);
+void telemetry_update(void);
+
+#endif /* __TELEMETRY_H */
@@ -0,0 +1,132 @@
+#include "trace.h"
+
+#define TRACE_MASK (TRACE_SIZE - 1)
+
+_Static_assert((TRACE_SIZE & TRACE_MASK) == 0, "Invalid trace size");
+
+/** Marks the trace state as valid, in memory not initialized at startup */
+#define TRACE_VALID 0x54524143
+
+/**
+ * Trace ring buffer.
+ *
+ * `head` is the free-running count of recorded events: the oldest ones are
+ * overwritten once the buffer is full, until the trace is frozen. The state
+ * is not initialized at startup, so a trace frozen before a reset (i.e.: by
+ * a fault handler) can be dumped afterwards (see `trace_init()`).
+ */
+static NOINIT struct trace_event events[TRACE_SIZE];
+static NOINIT volatile uint32_t head;
+static NOINIT volatile bool frozen;
+static NOINIT volatile uint32_t valid;
+
+/**
+ * @brief Keep a trace frozen before the last reset, or start a new one.
+ *
+ * To be called at startup, before any event is recorded. The trace is only
+ * kept if it is valid (it was initialized before the reset, and the memory
+ * was not lost on a power cycle) and frozen. It then stays frozen, with the
+ * events that led to the reset, until dumped (see `trace_resume()`).
+ */
+void trace_init(void)
+{
+	if (valid == TRACE_VALID && frozen)
+		return;
+	head = 0;
+	frozen = false;
+	valid = TRACE_VALID;
+}
+
+/**
+ * @brief Record an event, unless the trace is frozen.
+ *
+ * Safe to call from any context: interruptions are masked while the event
+ * is stamped and written, so events are stored in time order.
+ */
+RAMFUNC void trace(enum trace_type type, uint8_t id, uint16_t value)
+{
+	struct trace_event *event;
+
+	CM_ATOMIC_BLOCK()
+	{
+		if (!frozen) {
+			event = &events[head++ & TRACE_MASK];
+			event->cycles = read_cycle_counter();
+			event->type = (uint8_t)type;
+			event->id = id;
+			event->value = value;
+		}
+	}
+}
+
+/**
+ * @brief Record a user defined marker.
+ */
+void trace_marker(uint8_t id, uint16_t value)
+{
+	trace(TRACE_MARKER, id, value);
+}
+
+/**
+ * @brief Record the reason and stop recording, keeping the last events.
+ *
+ * Does nothing if the trace is already frozen, so the first reason is kept.
+ */
+void trace_freeze(enum trace_freeze_reason reason)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		trace(TRACE_FREEZE, (uint8_t)reason, 0);
+		frozen = true;
+	}
+}
+
+bool trace_is_frozen(void)
+{
+	return frozen;
+}
+
+/**
+ * @brief Discard the recorded events and start recording again.
+ */
+void trace_resume(void)
+{
+	CM_ATOMIC_BLOCK()
+	{
+		head = 0;
+		frozen = false;
+	}
+}
+
+/**
+ * @brief Return the number of events kept in the buffer.
+ */
+uint32_t trace_count(void)
+{
+	uint32_t count = head;
+
+	return count < TRACE_SIZE ? count : TRACE_SIZE;
+}
+
+/**
+ * @brief Copy recorded events, from the oldest one kept.
+ *
+ * Only consistent while the trace is frozen: otherwise events may be
+ * overwritten while being copied.
+ *
+ * @param[in] offset Position of the first event to copy, from the oldest.
+ * @param[out] copy Copied events.
+ * @param[in] size Maximum number of events to copy.
+ *
+ * @return The number of events copied.
+ */
+uint32_t trace_read(uint32_t offset, struct trace_event *copy, uint32_t size)
+{
+	uint32_t count = trace_count();
+	uint32_t first = head - count;
+	uint32_t i;
+
+	for (i = 0; i < size && offset + i < count; i++)
+		copy[i] = events[(first + offset + i) & TRACE_MASK];
+	return i;
+}
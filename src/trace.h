@@ -0,0 +1,97 @@
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <libopencm3/cm3/cortex.h>
+
+#include "platform.h"
+#include "setup.h"
+
+/** Events kept in the trace ring buffer (a power of two) */
+#define TRACE_SIZE 1024
+
+/**
+ * Traced interruption handlers.
+ *
+ * The list is shared with the host converter (`scripts/trace_export.py`) to
+ * name the handlers, so keep one `ISR(NAME)` entry per line.
+ */
+#define TRACE_ISRS(ISR)                                                        \
+	ISR(SYSTICK)                                                           \
+	ISR(USART1)                                                            \
+	ISR(SERIAL_TX_DMA)                                                     \
+	ISR(SERIAL_RX_DMA)                                                     \
+	ISR(INFRARED_DMA)                                                      \
+	ISR(BATTERY_DMA)                                                       \
+	ISR(GYRO_DMA)
+
+#define TRACE_ISR_ID(name) TRACE_ISR_##name,
+
+enum trace_isr { TRACE_ISRS(TRACE_ISR_ID) TRACE_ISRS_COUNT };
+
+/**
+ * Trace event types, with the meaning of their identifier and value.
+ *
+ * - `TRACE_ISR_ENTER`, `TRACE_ISR_EXIT`: handler (`enum trace_isr`).
+ * - `TRACE_TASK_START`, `TRACE_TASK_STOP`: task index in the executive
+ *   table, with the task context as value (`enum task_context`).
+ * - `TRACE_SATURATION`: 1 when the PWM output starts saturating, 0 when it
+ *   stops, with the saturated SysTick periods as value.
+ * - `TRACE_SERIAL_OVERFLOW`: `enum trace_serial_overflow`, with the bytes
+ *   dropped as value (or zero if unknown).
+ * - `TRACE_MARKER`: user defined (see `trace_marker()`).
+ * - `TRACE_FREEZE`: reason (`enum trace_freeze_reason`), the last event
+ *   before the trace is frozen.
+ */
+enum trace_type {
+	TRACE_ISR_ENTER,
+	TRACE_ISR_EXIT,
+	TRACE_TASK_START,
+	TRACE_TASK_STOP,
+	TRACE_SATURATION,
+	TRACE_SERIAL_OVERFLOW,
+	TRACE_MARKER,
+	TRACE_FREEZE,
+};
+
+enum trace_serial_overflow {
+	TRACE_SERIAL_TX_FULL,
+	TRACE_SERIAL_RX_OVERRUN,
+	TRACE_SERIAL_RX_FRAME_TOO_LONG,
+};
+
+enum trace_freeze_reason {
+	TRACE_FREEZE_REQUEST,
+	TRACE_FREEZE_COLLISION,
+	TRACE_FREEZE_FAULT,
+};
+
+/**
+ * Trace event, stamped with the cycle counter.
+ */
+struct trace_event {
+	uint32_t cycles;
+	uint8_t type;
+	uint8_t id;
+	uint16_t value;
+};
+
+/**
+ * @brief Mark the beginning and the end of an interruption handler.
+ */
+#define TRACE_ISR_BEGIN(isr) trace(TRACE_ISR_ENTER, (isr), 0)
+#define TRACE_ISR_END(isr) trace(TRACE_ISR_EXIT, (isr), 0)
+
+void trace_init(void);
+void trace(enum trace_type type, uint8_t id, uint16_t value);
+void trace_marker(uint8_t id, uint16_t value);
+void trace_freeze(enum trace_freeze_reason reason);
+bool trace_is_frozen(void);
+void trace_resume(void);
+uint32_t trace_count(void);
+uint32_t trace_read(uint32_t offset, struct trace_event *events,
+		    uint32_t size);
+
+#endif /* __TRACE_H */